@@ -12,6 +12,9 @@
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
  * <tr><td>djw</td><td>2023-04-20</td><td>Template.</td></tr>
  * <tr><td>djw</td><td>2023-04-23</td><td>Add lambda support.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add ExprAST::resolved tag.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add inline cache of FunctionCallExprAST.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Inline cache of FunctionCallExprAST is filled at load time.</td></tr>
  * </table>
  */
 #pragma once
@@ -19,6 +22,7 @@
 // member pointer of AST to AST is permitted not to be nullptr; type pointer to nullptr means auto type
 
 #include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <set>
 #include <string>
@@ -36,6 +40,8 @@ using ASTTokenType = std::string;
 
 namespace rulejit {
 
+struct FunctionDefAST;
+
 /**
  * @brief pure virtual base class for all AST node
  *
@@ -70,7 +76,12 @@ template <typename T> bool isType(IAST *ast) { return dynamic_cast<T *>(ast) !=
  *
  */
 struct ExprAST : public IAST {
+    /// @brief value of ExprAST::resolved before any backend resolve pass stamps the node
+    inline static constexpr size_t unresolved = size_t(-1);
+
     std::unique_ptr<TypeInfo> type;
+    /// @brief backend-specific tag (op code, slot, constant index...) stamped by load-time passes, not copied
+    size_t resolved = unresolved;
     virtual std::unique_ptr<ExprAST> copy() = 0;
     ExprAST(std::unique_ptr<TypeInfo> type) : type(std::move(type)) {}
 };
@@ -162,6 +173,10 @@ struct FunctionCallExprAST : public ExprAST {
     ACCEPT_FUNCTION;
     std::unique_ptr<ExprAST> functionIdent;
     std::vector<std::unique_ptr<ExprAST>> params;
+    /// @brief inline cache of direct call filled by CQResolver at load time, not copied
+    FunctionDefAST *callee = nullptr;
+    /// @brief inline cache, bit i is set if param i of callee is passed by value
+    uint64_t byValueParams = 0;
 
     template <typename V>
     FunctionCallExprAST(std::unique_ptr<TypeInfo> type, std::unique_ptr<ExprAST> functionIdent, V &&params)
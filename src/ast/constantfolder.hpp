@@ -0,0 +1,323 @@
+/**
+ * @file constantfolder.hpp
+ * @author djw
+ * @brief AST/Constant folder
+ * @date 2026-10-17
+ *
+ * @details Includes ConstantFolder, an optimization pass over checked AST which folds literal-only
+ * operators, simplifies exact algebraic identities and drops unreachable branch arms.
+ *
+ * Constants defined by "const" are already replaced by literals in ExpressionSemantic, so they are folded
+ * like any other literal. Results follow CQInterpreter exactly: "%" truncates both operands to integer,
+ * "&&"/"||" short-cut to the left operand, and nothing is folded into inf or nan.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Fold blocks of a single literal.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/decompiler.hpp"
+#include "defines/typedef.hpp"
+
+namespace rulejit {
+
+/**
+ * @brief fold constants in checked AST, and record what is folded
+ *
+ */
+struct ConstantFolder : public ASTVisitor {
+    ConstantFolder() : report(), needChange() {}
+    virtual ~ConstantFolder() = default;
+
+    /**
+     * @brief pipe operator| to fold whole ast
+     *
+     * @param ast checked ast, replaced if itself is folded
+     * @param folder receiver
+     */
+    void friend operator|(std::unique_ptr<ExprAST> &ast, ConstantFolder &folder) {
+        if (ast) {
+            folder.callAccept(ast);
+        }
+    }
+
+    /**
+     * @brief get what is folded so far, one line per folded expression, like "(2 * 3) => 6"
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReport() const { return report; }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {}
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        callAccept(v.baseVar);
+        callAccept(v.memberToken);
+    }
+    VISIT_FUNCTION(LiteralExprAST) {}
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        callAccept(v.functionIdent);
+        for (auto &arg : v.params) {
+            callAccept(arg);
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        if (isConstant(&v)) {
+            // fold whole literal-only subtree at once, so it is reported as one line
+            auto before = Decompiler().decompile(&v);
+            if (auto x = evaluate(&v); x) {
+                needChange = literal(*(v.type), *x);
+                report.push_back(std::format("{} => {}", before, *x));
+                return;
+            }
+        }
+        callAccept(v.lhs);
+        callAccept(v.rhs);
+        if (v.op == "=") {
+            return;
+        }
+        auto x = number(v.lhs.get()), y = number(v.rhs.get());
+        auto simplified = [&](std::unique_ptr<ExprAST> &expr) {
+            auto before = Decompiler().decompile(&v);
+            needChange = std::move(expr);
+            report.push_back(std::format("{} => {}", before, Decompiler().decompile(needChange.get())));
+        };
+        if (x && (v.op == "&&" || v.op == "and" || v.op == "||" || v.op == "or")) {
+            bool isAnd = v.op == "&&" || v.op == "and";
+            if ((*x != 0) != isAnd) {
+                // short-cut, result is lhs itself
+                return simplified(v.lhs);
+            }
+            // result is rhs converted to bool
+            std::unique_ptr<ExprAST> converted =
+                std::make_unique<BinOpExprAST>(std::make_unique<TypeInfo>(*(v.type)), "!=", v.rhs->copy(),
+                                               literal(*(v.type), 0));
+            return simplified(converted);
+        }
+        // identities which are exact for every double, including -0, inf and nan
+        bool sameType = *(v.type) == *(v.lhs->type) && *(v.type) == *(v.rhs->type);
+        if (!sameType) {
+            return;
+        }
+        if (y && ((v.op == "*" && *y == 1) || (v.op == "/" && *y == 1) ||
+                  (v.op == "-" && *y == 0 && !std::signbit(*y)) || (v.op == "+" && *y == 0 && std::signbit(*y)))) {
+            return simplified(v.lhs);
+        }
+        if (x && v.op == "*" && *x == 1) {
+            return simplified(v.rhs);
+        }
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) {
+        if (isConstant(&v)) {
+            auto before = Decompiler().decompile(&v);
+            if (auto x = evaluate(&v); x) {
+                needChange = literal(*(v.type), *x);
+                report.push_back(std::format("{} => {}", before, *x));
+                return;
+            }
+        }
+        callAccept(v.rhs);
+        // --x
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(v.rhs.get());
+            p && v.op == "-" && p->op == "-" && *(v.type) == *(p->rhs->type)) {
+            auto before = Decompiler().decompile(&v);
+            needChange = std::move(p->rhs);
+            report.push_back(std::format("{} => {}", before, Decompiler().decompile(needChange.get())));
+        }
+    }
+    VISIT_FUNCTION(BranchExprAST) {
+        auto condition = Decompiler().decompile(v.condition.get());
+        callAccept(v.condition);
+        if (auto x = number(v.condition.get()); x) {
+            auto &taken = *x != 0 ? v.trueExpr : v.falseExpr;
+            // if types of arms differ, branch has no value and can not be replaced by one arm
+            if (*(taken->type) == *(v.type)) {
+                report.push_back(std::format("if({}) => {} arm", condition, *x != 0 ? "true" : "false"));
+                callAccept(taken);
+                needChange = std::move(taken);
+                return;
+            }
+        }
+        callAccept(v.trueExpr);
+        callAccept(v.falseExpr);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        for (auto &[index, value] : v.members) {
+            if (index) {
+                callAccept(index);
+            }
+            callAccept(value);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        callAccept(v.init);
+        callAccept(v.condition);
+        callAccept(v.body);
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        for (auto &stmt : v.exprs) {
+            callAccept(stmt);
+        }
+        // a block of one literal is the literal, so conditions "{c}" of atom rules fold into dead branches too
+        if (v.exprs.size() == 1 && number(v.exprs.front().get()) && *(v.exprs.front()->type) == *(v.type)) {
+            needChange = std::move(v.exprs.front());
+        }
+    }
+    VISIT_FUNCTION(ControlFlowAST) { callAccept(v.value); }
+    VISIT_FUNCTION(TypeDefAST) {}
+    VISIT_FUNCTION(VarDefAST) { callAccept(v.definedValue); }
+    VISIT_FUNCTION(FunctionDefAST) { callAccept(v.returnValue); }
+    VISIT_FUNCTION(SymbolDefAST) {}
+
+  private:
+    void callAccept(std::unique_ptr<ExprAST> &tar) {
+        tar->accept(this);
+        if (needChange) {
+            tar = std::move(needChange);
+        }
+    }
+
+    static bool isNumericalType(const TypeInfo &type) { return type == RealType || type == IntType; }
+
+    /**
+     * @brief get value of numerical literal
+     *
+     * @param expr expression
+     * @return std::optional<double> nullopt if expr is not a numerical literal
+     */
+    static std::optional<double> number(ExprAST *expr) {
+        auto p = dynamic_cast<LiteralExprAST *>(expr);
+        if (!p || !isNumericalType(*(p->type))) {
+            return std::nullopt;
+        }
+        double x;
+        auto [end, ec] = std::from_chars(p->value.data(), p->value.data() + p->value.size(), x);
+        if (ec != std::errc() || end != p->value.data() + p->value.size()) {
+            return std::nullopt;
+        }
+        return x;
+    }
+
+    static std::unique_ptr<ExprAST> literal(const TypeInfo &type, double x) {
+        // "-0" would be an integer zero in generated cpp code
+        auto value = x == 0 && std::signbit(x) ? std::string("-0.0") : std::format("{}", x);
+        return std::make_unique<LiteralExprAST>(std::make_unique<TypeInfo>(type), std::move(value));
+    }
+
+    /**
+     * @brief check if expr is built by operators and numerical literals only
+     *
+     * @param expr expression
+     * @return bool
+     */
+    static bool isConstant(ExprAST *expr) {
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr); p) {
+            return p->op != "=" && isNumericalType(*(p->type)) && isConstant(p->lhs.get()) &&
+                   isConstant(p->rhs.get());
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p) {
+            return isNumericalType(*(p->type)) && isConstant(p->rhs.get());
+        }
+        return number(expr).has_value();
+    }
+
+    /**
+     * @brief evaluate expr checked by isConstant the same way as CQInterpreter
+     *
+     * @param expr expression
+     * @return std::optional<double> nullopt if it can not be folded, like inf, nan or mod by zero
+     */
+    static std::optional<double> evaluate(ExprAST *expr) {
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p) {
+            auto x = evaluate(p->rhs.get());
+            if (!x) {
+                return std::nullopt;
+            }
+            if (p->op == "-") {
+                return -*x;
+            }
+            if (p->op == "!" || p->op == "not") {
+                return double(!*x);
+            }
+            return std::nullopt;
+        }
+        auto p = dynamic_cast<BinOpExprAST *>(expr);
+        if (!p) {
+            return number(expr);
+        }
+        auto x = evaluate(p->lhs.get());
+        if (!x) {
+            return std::nullopt;
+        }
+        auto &op = p->op;
+        if (op == "&&" || op == "and" || op == "||" || op == "or") {
+            bool isAnd = op == "&&" || op == "and";
+            if ((*x != 0) != isAnd) {
+                return x;
+            }
+            auto y = evaluate(p->rhs.get());
+            if (!y) {
+                return std::nullopt;
+            }
+            return double(isAnd ? (*x && *y) : (*x || *y));
+        }
+        auto y = evaluate(p->rhs.get());
+        if (!y) {
+            return std::nullopt;
+        }
+        double ret;
+        if (op == "+") {
+            ret = *x + *y;
+        } else if (op == "-") {
+            ret = *x - *y;
+        } else if (op == "*") {
+            ret = *x * *y;
+        } else if (op == "/") {
+            ret = *x / *y;
+        } else if (op == "%") {
+            // integer mod, fails at runtime when truncated divisor is zero
+            if (!(std::fabs(*x) < 0x1p63) || !(std::fabs(*y) < 0x1p63) || static_cast<int64_t>(*y) == 0) {
+                return std::nullopt;
+            }
+            ret = static_cast<double>(static_cast<int64_t>(*x) % static_cast<int64_t>(*y));
+        } else if (op == ">") {
+            ret = *x > *y;
+        } else if (op == "<") {
+            ret = *x < *y;
+        } else if (op == "==") {
+            ret = *x == *y;
+        } else if (op == "!=") {
+            ret = *x != *y;
+        } else if (op == ">=") {
+            ret = *x >= *y;
+        } else if (op == "<=") {
+            ret = *x <= *y;
+        } else {
+            return std::nullopt;
+        }
+        if (!std::isfinite(ret)) {
+            return std::nullopt;
+        }
+        return ret;
+    }
+
+    /// @brief folded expressions
+    std::vector<std::string> report;
+    std::unique_ptr<ExprAST> needChange;
+};
+
+} // namespace rulejit
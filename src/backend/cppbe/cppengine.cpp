@@ -15,6 +15,12 @@
  * <tr><td>djw</td><td>2023-04-18</td><td>make every intermediate var a subruleset</td></tr>
  * <tr><td>djw</td><td>2023-04-18</td><td>make all intermediate var a single subruleset</td></tr>
  * <tr><td>djw</td><td>2023-05-11</td><td>sort type before generate defines</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Inline small functions before code generation.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Fold constants before code generation.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Share subexpressions of conditions before code generation.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Build decision trees of subrulesets when enabled.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Reorder shortcut logical operators by selectivity profile.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Run ast passes shared with other backends.</td></tr>
  * </table>
  */
 #include <iostream>
@@ -22,6 +28,7 @@
 
 #include "backend/cppbe/template.hpp"
 #include "cppengine.h"
+#include "frontend/ruleset/astpasses.hpp"
 #include "rapidxml-1.13/rapidxml.hpp"
 #include "tools/seterror.hpp"
 #include "defines/marco.hpp"
@@ -105,6 +112,8 @@ void CppEngine::buildFromSource(const std::string &srcXML) {
     // TODO: execute preDefines once(in RuleSet::Init()) to handle init value?
     auto [preDefines, preProcess, subRuleSets] = RuleSetParser::readSource(srcXML, context, data);
     context.scope.begin()->varDef.clear();
+    // subrulesets are named as in cq::RuleSetEngine, where the profile is recorded
+    runAstPasses(context.global, preProcess, subRuleSets, selectivityProfile, passReports);
 
     std::set<std::string> notGenerate{preProcess.begin(), preProcess.end()};
     notGenerate.emplace(preDefines);
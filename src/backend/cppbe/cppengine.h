@@ -8,18 +8,25 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add report of constant folding.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add report of shared subexpressions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Apply selectivity profile of shortcut logical operators.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keep reports of ast passes together.</td></tr>
  * </table>
  */
 #pragma once
 
 #include <fstream>
 #include <list>
+#include <optional>
 
 #include "backend/cppbe/metainfo.hpp"
 #include "backend/cppbe/subrulesetgen.hpp"
 #include "frontend/lexer.h"
 #include "frontend/parser.h"
+#include "frontend/ruleset/astpasses.hpp"
 #include "frontend/ruleset/rulesetparser.h"
+#include "frontend/ruleset/selectivity.hpp"
 #include "frontend/semantic.hpp"
 
 namespace rulejit::cppgen {
@@ -29,7 +36,9 @@ namespace rulejit::cppgen {
  * 
  */
 struct CppEngine {
-    CppEngine() : context(), data(), semantic(context), codegen(context, data), prefix() {};
+    CppEngine()
+        : context(), data(), semantic(context), codegen(context, data), prefix(), passReports(),
+          selectivityProfile() {};
     CppEngine(const CppEngine &) = delete;
     CppEngine(CppEngine &&) = delete;
     CppEngine &operator=(const CppEngine &) = delete;
@@ -65,6 +74,39 @@ struct CppEngine {
     }
     std::string prefix, namespaceName, outputPath;
 
+    /**
+     * @brief get expressions folded by ConstantFolder when built, one line per folded expression
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getFoldingReport() const { return passReports.folding; }
+
+    /**
+     * @brief get subexpressions of conditions shared by ConditionCSE when built, one line per temporary
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getSharingReport() const { return passReports.sharing; }
+
+    /**
+     * @brief reorder operands of "&&"/"||" in following builds by a profile recorded by cq::RuleSetEngine
+     * @attention call before buildFromSource
+     *
+     * @param profileText content of profile file, see cq::RuleSetEngine::dumpSelectivityProfile
+     * @return bool false if profile is ill-formed
+     */
+    bool loadSelectivityProfile(const std::string &profileText) {
+        selectivityProfile = ruleset::SelectivityProfile::parse(profileText);
+        return selectivityProfile.has_value();
+    }
+
+    /**
+     * @brief get chains of "&&"/"||" reordered by ShortCutReorderer when built, one line per chain
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReorderingReport() const { return passReports.reordering; }
+
   private:
     ruleset::RuleSetMetaInfo data;
     ContextStack context;
@@ -72,6 +114,8 @@ struct CppEngine {
     ExpressionParser parser;
     ExpressionSemantic semantic;
     SubRuleSetCodeGen codegen;
+    ruleset::AstPassReports passReports;
+    std::optional<ruleset::SelectivityProfile> selectivityProfile;
 };
 
 } // namespace rulejit::cppgen
\ No newline at end of file
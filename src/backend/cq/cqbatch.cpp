@@ -0,0 +1,92 @@
+/**
+ * @file cqbatch.cpp
+ * @author djw
+ * @brief CQ/Interpreter/Batch
+ * @date 2026-10-17
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include "cqbatch.h"
+
+#include <algorithm>
+#include <memory>
+
+namespace rulejit::cq {
+
+void RuleSetBatch::buildFromSource(const std::string &srcXML, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        auto &engine = instances.emplace_back();
+        engine.buildFromSource(srcXML);
+        // instances already run in parallel
+        engine.setParallelism(1);
+    }
+    errors.resize(instances.size());
+}
+
+std::optional<size_t> RuleSetBatch::pop(Block &block) {
+    auto range = block.range.load(std::memory_order_acquire);
+    while (true) {
+        auto begin = range >> 32, end = range & UINT32_MAX;
+        if (begin >= end) {
+            return std::nullopt;
+        }
+        if (block.range.compare_exchange_weak(range, pack(begin + 1, end), std::memory_order_acq_rel)) {
+            return begin;
+        }
+    }
+}
+
+bool RuleSetBatch::steal(Block &victim, Block &thief) {
+    auto range = victim.range.load(std::memory_order_acquire);
+    while (true) {
+        auto begin = range >> 32, end = range & UINT32_MAX;
+        if (begin >= end) {
+            return false;
+        }
+        auto mid = begin + (end - begin) / 2;
+        if (victim.range.compare_exchange_weak(range, pack(begin, mid), std::memory_order_acq_rel)) {
+            thief.range.store(pack(mid, end), std::memory_order_release);
+            return true;
+        }
+    }
+}
+
+size_t RuleSetBatch::tickAll() {
+    auto &pool = TickThreadPool::instance();
+    size_t width =
+        std::min({threads == 0 ? pool.size() : threads, pool.size(), std::max<size_t>(instances.size(), 1)});
+    auto blocks = std::make_unique<Block[]>(width);
+    for (size_t t = 0; t < width; t++) {
+        blocks[t].range.store(pack(instances.size() * t / width, instances.size() * (t + 1) / width));
+    }
+    std::atomic<size_t> stolen = 0;
+    pool.run(width, width, [&](size_t t) {
+        while (true) {
+            while (auto i = pop(blocks[t])) {
+                errors[*i].reset();
+                try {
+                    instances[*i].tick();
+                } catch (std::logic_error &e) {
+                    errors[*i] = e.what();
+                }
+            }
+            bool found = false;
+            for (size_t k = 1; k < width && !found; k++) {
+                found = steal(blocks[(t + k) % width], blocks[t]);
+            }
+            if (!found) {
+                // instances stolen by others but not published yet are ticked by them
+                return;
+            }
+            stolen.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+    steals += stolen.load();
+    return std::ranges::count_if(errors, [](auto &e) { return e.has_value(); });
+}
+
+} // namespace rulejit::cq
@@ -0,0 +1,189 @@
+/**
+ * @file cqbatch.h
+ * @author djw
+ * @brief CQ/Interpreter/Batch
+ * @date 2026-10-17
+ *
+ * @details Includes RuleSetBatch, which owns many RuleSetEngine instances built from the same rule set, like one
+ * instance per entity of a scenario, and ticks all of them in one call per frame on TickThreadPool.
+ *
+ * Instances are split into contiguous blocks, one per thread. A thread ticks instances of its own block from the
+ * front, and when its block is empty, steals the back half of the block of another thread, so threads finishing
+ * early help slow ones. Instances do not share any state, so the result of a frame does not depend on which thread
+ * ticks which instance; inputs and outputs are accessed by index of instance between frames.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <any>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "backend/cq/cqparallel.h"
+#include "backend/cq/cqrulesetengine.h"
+
+namespace rulejit::cq {
+
+/**
+ * @brief many rule set engines of the same rule set, ticked together
+ *
+ */
+struct RuleSetBatch {
+    using CSValueMap = std::unordered_map<std::string, std::any>;
+
+    RuleSetBatch() : instances(), errors(), threads(0), steals(0) {}
+    RuleSetBatch(const RuleSetBatch &) = delete;
+    RuleSetBatch(RuleSetBatch &&) = delete;
+    RuleSetBatch &operator=(const RuleSetBatch &) = delete;
+    RuleSetBatch &operator=(RuleSetBatch &&) = delete;
+
+    /**
+     * @brief build instances from the XML source, instances already built are kept
+     * @attention instances are built one by one, since the rule set parser is not reentrant
+     *
+     * @param srcXML The string content of the XML file.
+     * @param count count of instances to add
+     */
+    void buildFromSource(const std::string &srcXML, size_t count);
+
+    /**
+     * @brief build instances from the XML file, instances already built are kept
+     *
+     * @param XMLFilePath The string path of the XML file.
+     * @param count count of instances to add
+     */
+    void buildFromFile(const std::string &XMLFilePath, size_t count) {
+        std::ifstream file(XMLFilePath);
+        std::string buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        buildFromSource(buffer, count);
+    }
+
+    /**
+     * @brief initialize all instances
+     *
+     */
+    void init() {
+        for (auto &engine : instances) {
+            engine.init();
+        }
+    }
+
+    /**
+     * @brief get count of instances
+     *
+     * @return size_t
+     */
+    size_t size() const { return instances.size(); }
+
+    /**
+     * @brief get an instance, e.g. to set its execution mode
+     * @attention must not be used during tickAll
+     *
+     * @param i index of instance
+     * @return RuleSetEngine&
+     */
+    RuleSetEngine &instance(size_t i) { return instances[i]; }
+
+    /**
+     * @brief select how subrulesets of all instances are executed
+     *
+     * @param mode execution mode
+     */
+    void setExecutionMode(RuleSetEngine::ExecutionMode mode) {
+        for (auto &engine : instances) {
+            engine.setExecutionMode(mode);
+        }
+    }
+
+    /**
+     * @brief set max count of threads ticking instances
+     *
+     * @param n count of threads including the calling thread, 0 to use all threads of TickThreadPool
+     */
+    void setThreads(size_t n) { threads = n; }
+
+    /**
+     * @brief Set the input data of an instance for next frame.
+     *
+     * @param i index of instance
+     * @param input The unordered map of input data.
+     */
+    void setInput(size_t i, const CSValueMap &input) { instances[i].setInput(input); }
+
+    /**
+     * @brief get the output data of an instance after last frame.
+     *
+     * @param i index of instance
+     * @return CSValueMap*
+     */
+    CSValueMap *getOutput(size_t i) { return instances[i].getOutput(); }
+
+    /**
+     * @brief tick all instances once, instances failed do not stop others
+     *
+     * @return size_t count of instances failed in this frame, see getError
+     */
+    size_t tickAll();
+
+    /**
+     * @brief get error of an instance in last frame
+     *
+     * @param i index of instance
+     * @return const std::optional<std::string>& nullopt if ticked successfully
+     */
+    const std::optional<std::string> &getError(size_t i) const { return errors[i]; }
+
+    /**
+     * @brief get count of blocks stolen by threads since built
+     *
+     * @return size_t
+     */
+    size_t getSteals() const { return steals; }
+
+  private:
+    /**
+     * @brief instances not ticked in a block of one thread, as begin << 32 | end, so both are changed at once
+     *
+     */
+    struct alignas(64) Block {
+        std::atomic<uint64_t> range;
+    };
+
+    static uint64_t pack(uint64_t begin, uint64_t end) { return begin << 32 | end; }
+
+    /**
+     * @brief take the first instance of block
+     *
+     * @return std::optional<size_t> nullopt if block is empty
+     */
+    static std::optional<size_t> pop(Block &block);
+
+    /**
+     * @brief move the back half of victim into thief, which is empty
+     *
+     * @return bool false if victim is empty
+     */
+    static bool steal(Block &victim, Block &thief);
+
+    /// @brief instances, not moved since built
+    std::deque<RuleSetEngine> instances;
+    /// @brief error of each instance in last frame
+    std::vector<std::optional<std::string>> errors;
+    /// @brief max count of threads, 0 for all
+    size_t threads;
+    /// @brief count of blocks stolen
+    size_t steals;
+};
+
+} // namespace rulejit::cq
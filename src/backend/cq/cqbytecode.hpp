@@ -0,0 +1,1181 @@
+/**
+ * @file cqbytecode.hpp
+ * @author djw
+ * @brief CQ/Interpreter/ByteCode backend
+ * @date 2026-10-17
+ *
+ * @details Includes CQByteCodeGenerator, which lowers resolved subrulesets and user functions into
+ * bytecode::Function, and CQByteCodeEngine, which ticks one subruleset on bytecode::ByteCodeVM.
+ * CQDataSegment, which maps variables onto data segment, is shared with CQJITEngine.
+ *
+ * Variables of DataStore are mapped onto a flat data segment, whose layout is computed from
+ * RuleSetMetaInfo::typeDefines by dynamicstruct::StructLayoutManager. Only numerical code is lowered,
+ * subrulesets using strings, arrays, complex literals, print... are left to CQInterpreter, so are the ticks
+ * whose data can not be mapped onto the data segment or which fail in VM. Results and error messages are
+ * always the same as CQInterpreter.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Run lowered subrulesets with register dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add sequence profiling.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Move data segment mapping into CQDataSegment.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record changed variables in write back.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Copy variables in typed storage of DataStore without conversion.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <any>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "ast/type.hpp"
+#include "backend/cq/cqinterpreter.hpp"
+#include "backend/cq/cqresolver.hpp"
+#include "backend/cq/cqresourcehandler.h"
+#include "backend/cq/cqtypedlayout.h"
+#include "bytecode/bytecode.h"
+#include "tools/anyprocess.hpp"
+#include "tools/myassert.hpp"
+#include "tools/seterror.hpp"
+
+namespace rulejit::cq {
+
+/**
+ * @brief bytecode program shared by all subrulesets of a rule set engine,
+ * includes linked functions and layout of data segment
+ *
+ */
+struct ByteCodeProgram {
+    using TypeLayout = cq::TypeLayout;
+
+    /**
+     * @brief variable in DataStore mapped onto data segment
+     *
+     */
+    struct ExternVar {
+        std::string name;
+        size_t offset;
+        const TypeLayout *layout;
+        /// @brief output or cache variable, whose access is recorded so only accessed ones are written back
+        bool writable;
+    };
+
+    ByteCodeProgram() : layout(), context(layout), typeLayouts(), externVars(), flagBase(0), functionIDs(), nativeID() {
+        using namespace bytecode;
+        nativeID[size_t(CallCode::RAND)] =
+            context.addNativeFunction({0, [](const MemUnit *) { return std::bit_cast<MemUnit>(myrand()); }});
+        [this]<size_t... I>(std::index_sequence<I...>) {
+            ((nativeID[size_t(CallCode::SIN) + I] = context.addNativeFunction({1, &oneParamNative<I>})), ...);
+        }(std::make_index_sequence<buildInOneParamFunc.size()>{});
+        [this]<size_t... I>(std::index_sequence<I...>) {
+            ((nativeID[size_t(CallCode::POW) + I] = context.addNativeFunction({2, &twoParamNative<I>})), ...);
+        }(std::make_index_sequence<buildInTwoParamFunc.size()>{});
+    }
+    ByteCodeProgram(const ByteCodeProgram &) = delete;
+    ByteCodeProgram &operator=(const ByteCodeProgram &) = delete;
+
+    /**
+     * @brief map all variables in meta info onto data segment, variables whose type can not be mapped are skipped
+     *
+     * @param metaInfo meta info of rule set
+     */
+    void buildLayout(ruleset::RuleSetMetaInfo &metaInfo) {
+        dynamicstruct::StructInfo members;
+        std::vector<std::tuple<std::string, const TypeLayout *>> mapped;
+        for (auto &[name, type] : metaInfo.varType) {
+            if (auto p = mapType(type, metaInfo)) {
+                members.emplace_back(name, p->layoutName);
+                mapped.emplace_back(name, p);
+            }
+        }
+        auto externType = layout.addDefinition("@extern", members);
+        my_assert(externType, "layout of data segment is already built");
+        std::set<std::string> writable{metaInfo.outputVar.begin(), metaInfo.outputVar.end()};
+        writable.insert(metaInfo.cacheVar.begin(), metaInfo.cacheVar.end());
+        for (auto &[name, p] : mapped) {
+            externVars.emplace(name,
+                               ExternVar{name, static_cast<size_t>(externType->getOffset(name)), p, writable.contains(name)});
+        }
+        // access flags of each subruleset follow the variables
+        flagBase = externType->getLayout().size;
+    }
+
+    /// @brief layouts and functions used by ByteCodeVM
+    dynamicstruct::StructLayoutManager layout;
+    bytecode::ByteCodeVM::Context context;
+    /// @brief xml type -> flat layout, nullptr if the type can not be mapped
+    std::unordered_map<std::string, std::unique_ptr<TypeLayout>> typeLayouts;
+    /// @brief variable name -> position in data segment
+    std::unordered_map<std::string, ExternVar> externVars;
+    /// @brief offset of the first access flag in data segment
+    size_t flagBase;
+    /// @brief user function -> id in context, nullopt if it can not be lowered
+    std::unordered_map<FunctionDefAST *, std::optional<size_t>> functionIDs;
+    /// @brief CallCode of build-in function -> id of native function in context
+    std::array<size_t, size_t(CallCode::INDIRECT)> nativeID;
+
+  private:
+    template <size_t I> static bytecode::MemUnit oneParamNative(const bytecode::MemUnit *params) {
+        return std::bit_cast<bytecode::MemUnit>(buildInOneParamFunc[I](std::bit_cast<double>(params[0])));
+    }
+    template <size_t I> static bytecode::MemUnit twoParamNative(const bytecode::MemUnit *params) {
+        return std::bit_cast<bytecode::MemUnit>(
+            buildInTwoParamFunc[I](std::bit_cast<double>(params[0]), std::bit_cast<double>(params[1])));
+    }
+
+    const TypeLayout *mapType(const std::string &type, ruleset::RuleSetMetaInfo &metaInfo) {
+        using Kind = TypeLayout::Kind;
+        static const std::unordered_map<std::string, std::tuple<Kind, std::string>> baseType{
+            {"bool", {Kind::BOOL, "u8"}},     {"int8", {Kind::I8, "i8"}},      {"uint8", {Kind::U8, "u8"}},
+            {"int16", {Kind::I16, "i16"}},    {"uint16", {Kind::U16, "u16"}},  {"int32", {Kind::I32, "i32"}},
+            {"uint32", {Kind::U32, "u32"}},   {"int64", {Kind::I64, "i64"}},   {"uint64", {Kind::U64, "u64"}},
+            {"float32", {Kind::F32, "f32"}},  {"float64", {Kind::F64, "f64"}},
+        };
+        if (auto it = typeLayouts.find(type); it != typeLayouts.end()) {
+            // nullptr also marks a struct being mapped, so recursive struct is rejected
+            return it->second.get();
+        }
+        auto &ret = typeLayouts[type];
+        if (auto it = baseType.find(type); it != baseType.end()) {
+            auto &name = std::get<1>(it->second);
+            ret = std::make_unique<TypeLayout>(
+                TypeLayout{std::get<0>(it->second), name, {}, layout.getTypeLayoutInfo(name).size, true});
+            return ret.get();
+        }
+        if (type.ends_with("[]") || ruleset::baseData.contains(type)) {
+            ret = std::make_unique<TypeLayout>(
+                TypeLayout{Kind::OPAQUE, "ptr", {}, layout.getTypeLayoutInfo("ptr").size, false});
+            return ret.get();
+        }
+        auto defines = metaInfo.typeDefines.find(type);
+        if (defines == metaInfo.typeDefines.end() || layout.hasType(type)) {
+            return nullptr;
+        }
+        dynamicstruct::StructInfo members;
+        std::vector<const TypeLayout *> memberLayouts;
+        for (auto &[name, memberType] : defines->second) {
+            auto p = mapType(memberType, metaInfo);
+            if (!p) {
+                return nullptr;
+            }
+            members.emplace_back(name, p->layoutName);
+            memberLayouts.push_back(p);
+        }
+        auto complexType = layout.addDefinition(type, members);
+        auto tmp =
+            std::make_unique<TypeLayout>(TypeLayout{Kind::STRUCT, type, {}, complexType->getLayout().size, true});
+        for (size_t i = 0; i < members.size(); i++) {
+            auto &name = std::get<0>(members[i]);
+            tmp->members.emplace_back(name, complexType->getOffset(name), memberLayouts[i]);
+            tmp->flat = tmp->flat && memberLayouts[i]->flat;
+        }
+        // typeLayouts may rehash while mapping members
+        auto &slot = typeLayouts[type];
+        slot = std::move(tmp);
+        return slot.get();
+    }
+};
+
+/**
+ * @brief lower resolved ast into bytecode::Function
+ *
+ * @attention ast must be piped through CQResolver before generate
+ *
+ */
+struct CQByteCodeGenerator : public ASTVisitor {
+    /**
+     * @brief subruleset lowered to bytecode
+     *
+     */
+    struct Lowered {
+        /// @brief id of function in ByteCodeProgram::context
+        size_t functionID;
+        /// @brief variables read or written by the function
+        std::vector<const ByteCodeProgram::ExternVar *> externs;
+        /// @brief access flag offset in data segment of each writable one in externs
+        std::vector<std::optional<size_t>> flags;
+    };
+
+    CQByteCodeGenerator(ContextStack &c, DataStore &data, const ConstantPool &pool, ByteCodeProgram &program)
+        : context(c), data(data), constantPool(pool), program(program), states(), kind(Kind::NONE), reason() {}
+    virtual ~CQByteCodeGenerator() = default;
+
+    /**
+     * @brief lower subruleset into function and link it
+     *
+     * @param expr subruleset
+     * @param name unique name of subruleset
+     * @return std::optional<Lowered> nullopt if subruleset can not be lowered, see getReason()
+     */
+    std::optional<Lowered> generate(std::unique_ptr<ExprAST> &expr, const std::string &name) {
+        externs.clear();
+        states.emplace_back(name, true);
+        std::optional<size_t> id;
+        try {
+            emitValue(expr);
+            emit(bytecode::OPCode::RET, bytecode::DataType::NONE, 1);
+            id = finish();
+        } catch (std::logic_error &e) {
+            states.clear();
+            reason = e.what();
+            return std::nullopt;
+        }
+        if (!id.has_value() || !program.context.linkFunction(id.value()).has_value()) {
+            reason = "link failed: " + name;
+            return std::nullopt;
+        }
+        Lowered ret{id.value(), {}, {}};
+        for (auto &[var, flag] : externs) {
+            ret.externs.push_back(var);
+            ret.flags.push_back(flag);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief get reason why last generate failed
+     *
+     * @return const std::string&
+     */
+    const std::string &getReason() { return reason; }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before generate");
+        if (v.resolved == CQResolver::externalVar) {
+            emitExternLoad(externPath(v));
+        } else {
+            emit(bytecode::OPCode::LOAD_VAR, bytecode::DataType::F64, slotOffset(v.resolved));
+        }
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        emitExternLoad(externPath(v));
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(LiteralExprAST) {
+        if (!(*(v.type) == RealType)) {
+            setError("only numerical literal is supported");
+        }
+        emitNumber(v.resolved == ExprAST::unresolved ? std::stod(v.value) : constantPool.numbers[v.resolved]);
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        using namespace bytecode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveCall(v));
+        }
+        auto code = static_cast<CallCode>(v.resolved);
+        if (code == CallCode::USER) {
+            emitUserCall(v);
+        } else if (code >= CallCode::RAND && code <= CallCode::ATAN2) {
+            size_t paramCount = code == CallCode::RAND ? 0 : (code < CallCode::POW ? 1 : 2);
+            if (v.params.size() != paramCount) {
+                setError("wrong param count of build-in function");
+            }
+            for (auto &param : v.params) {
+                emitValue(param);
+            }
+            emit(OPCode::CALL_NATIVE, DataType::NONE, program.nativeID[v.resolved]);
+        } else {
+            setError("only numerical function call is supported");
+        }
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        using namespace bytecode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveBinOp(v.op));
+        }
+        auto code = static_cast<BinOpCode>(v.resolved);
+        switch (code) {
+        case BinOpCode::ASSIGN:
+            emitAssign(v);
+            kind = Kind::NONE;
+            return;
+        case BinOpCode::AND:
+        case BinOpCode::OR: {
+            // if shortcutted, result is lhs itself
+            emitValue(v.lhs);
+            emit(OPCode::COPY, DataType::NONE, 1);
+            auto shortcut = emitJump(code == BinOpCode::AND ? OPCode::BEZ : OPCode::BNZ, DataType::F64);
+            emit(OPCode::POP);
+            emitValue(v.rhs);
+            emitNumber(0);
+            emit(OPCode::BIN_OP, DataType::F64, BinaryOP::NEQ);
+            emit(OPCode::TYPE_TRANS, DataType::U64, DataType::F64);
+            patch(shortcut);
+            break;
+        }
+        case BinOpCode::MOD:
+            // same as interpreter, operands are truncated
+            emitValue(v.lhs);
+            emit(OPCode::TYPE_TRANS, DataType::F64, DataType::I64);
+            emitValue(v.rhs);
+            emit(OPCode::TYPE_TRANS, DataType::F64, DataType::I64);
+            emit(OPCode::BIN_OP, DataType::I64, BinaryOP::MOD);
+            emit(OPCode::TYPE_TRANS, DataType::I64, DataType::F64);
+            break;
+        case BinOpCode::UNKNOWN:
+            setError(std::format("bin op \"{}\" not support for now", v.op));
+        default:
+            emitValue(v.lhs);
+            emitValue(v.rhs);
+            emit(OPCode::BIN_OP, DataType::F64, binaryOP(code));
+            if (isCompare(code)) {
+                emit(OPCode::TYPE_TRANS, DataType::U64, DataType::F64);
+            }
+        }
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) {
+        using namespace bytecode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveUnaryOp(v.op));
+        }
+        switch (static_cast<UnaryOpCode>(v.resolved)) {
+        case UnaryOpCode::NEG:
+            emitValue(v.rhs);
+            emit(OPCode::UNARY_OP, DataType::F64, UnaryOP::NEG);
+            break;
+        case UnaryOpCode::NOT:
+            emitValue(v.rhs);
+            emit(OPCode::UNARY_OP, DataType::F64, UnaryOP::NOT);
+            emit(OPCode::TYPE_TRANS, DataType::U64, DataType::F64);
+            break;
+        default:
+            setError(std::format("unary op \"{}\" not support for now", v.op));
+        }
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(BranchExprAST) {
+        auto falseJumps = emitCondition(v.condition, false);
+        auto trueKind = emitAny(v.trueExpr);
+        auto end = emitJump(bytecode::OPCode::BRANCH);
+        patch(falseJumps);
+        auto falseKind = emitAny(v.falseExpr);
+        patch(end);
+        if (trueKind != falseKind) {
+            setError("branches return different kind of value");
+        }
+        kind = trueKind;
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) { setError("complex literal is not supported"); }
+    VISIT_FUNCTION(LoopAST) {
+        using namespace bytecode;
+        // same as interpreter, loop returns the last (false) condition
+        emitStatement(v.init);
+        auto begin = current().func.code.size();
+        emitValue(v.condition);
+        emit(OPCode::COPY, DataType::NONE, 1);
+        auto exit = emitJump(OPCode::BEZ, DataType::F64);
+        emit(OPCode::POP);
+        emitStatement(v.body);
+        emitJumpTo(OPCode::BRANCH, begin);
+        patch(exit);
+        kind = Kind::NUM;
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        auto ret = Kind::NONE;
+        for (size_t i = 0; i < v.exprs.size(); i++) {
+            if (i + 1 == v.exprs.size()) {
+                ret = emitAny(v.exprs[i]);
+            } else {
+                emitStatement(v.exprs[i]);
+            }
+        }
+        kind = ret;
+    }
+    VISIT_FUNCTION(ControlFlowAST) { setError("ControlFlowAST is not supported"); }
+    VISIT_FUNCTION(TypeDefAST) { setError("TypeDefAST is not supported"); }
+    VISIT_FUNCTION(VarDefAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before generate");
+        if (v.resolved == CQResolver::redefinedVar) {
+            setError("redefine variable: " + v.name);
+        }
+        emitValue(v.definedValue);
+        nameSlot(v.resolved, v.name);
+        emit(bytecode::OPCode::STORE_VAR, bytecode::DataType::F64, slotOffset(v.resolved));
+        kind = Kind::NONE;
+    }
+    VISIT_FUNCTION(FunctionDefAST) { setError("function def is not supported"); }
+    VISIT_FUNCTION(SymbolDefAST) { setError("symbol def is not supported"); }
+
+  private:
+    /**
+     * @brief kind of value an expression leaves on register stack
+     *
+     */
+    enum class Kind {
+        /// nothing
+        NONE,
+        /// one F64
+        NUM,
+    };
+
+    /**
+     * @brief function being generated
+     *
+     */
+    struct State {
+        State(const std::string &name, bool allowExtern) : func(), allowExtern(allowExtern) {
+            func.symbol.push_back(name);
+        }
+        bytecode::Function func;
+        /// @brief generating subruleset, which can access data segment
+        bool allowExtern;
+        /// @brief bits of compile time constant -> index
+        std::unordered_map<bytecode::MemUnit, size_t> constantIndex;
+        /// @brief LOAD_CONST of compile time constant, whose offset is fixed when linked function count is known
+        std::vector<size_t> constantLoads;
+        /// @brief frame member name of each slot
+        std::vector<std::string> slotNames;
+    };
+
+    State &current() { return states.back(); }
+
+    void emit(bytecode::OPCode::Type op, bytecode::DataType::Type type = bytecode::DataType::NONE, size_t data = 0) {
+        if (data > UINT16_MAX) {
+            setError("operand overflow");
+        }
+        current().func.code.push_back(bytecode::ByteCode{static_cast<uint8_t>(op), static_cast<uint8_t>(type),
+                                                         static_cast<uint16_t>(data)});
+    }
+
+    /// @return position of jump, patched by patch()
+    size_t emitJump(bytecode::OPCode::Type op, bytecode::DataType::Type type = bytecode::DataType::NONE) {
+        emit(op, type);
+        return current().func.code.size() - 1;
+    }
+    /// @brief jump to target, relative to next instruction
+    void emitJumpTo(bytecode::OPCode::Type op, size_t target) {
+        emit(op);
+        setJumpTarget(current().func.code.size() - 1, target);
+    }
+    /// @brief make jump at pos go to the next emitted instruction
+    void patch(size_t pos) { setJumpTarget(pos, current().func.code.size()); }
+    void patch(const std::vector<size_t> &pos) {
+        for (auto p : pos) {
+            patch(p);
+        }
+    }
+    void setJumpTarget(size_t pos, size_t target) {
+        auto diff = static_cast<std::ptrdiff_t>(target) - static_cast<std::ptrdiff_t>(pos + 1);
+        if (diff < INT16_MIN || diff > INT16_MAX) {
+            setError("jump out of range");
+        }
+        current().func.code[pos].data = std::bit_cast<uint16_t>(static_cast<bytecode::ByteCode::TypedData>(diff));
+    }
+
+    void emitNumber(double x) {
+        auto &s = current();
+        auto bits = std::bit_cast<bytecode::MemUnit>(x);
+        auto [it, inserted] = s.constantIndex.try_emplace(bits, s.func.constTableInfo.compileTimeConstant.size());
+        if (inserted) {
+            s.func.constTableInfo.compileTimeConstant.push_back(bits);
+        }
+        s.constantLoads.push_back(s.func.code.size());
+        emit(bytecode::OPCode::LOAD_CONST, bytecode::DataType::F64, it->second * sizeof(bytecode::MemUnit));
+    }
+
+    size_t slotOffset(size_t slot) { return slot * sizeof(double); }
+    void nameSlot(size_t slot, const std::string &name) {
+        auto &names = current().slotNames;
+        if (names.size() <= slot) {
+            names.resize(slot + 1);
+        }
+        if (names[slot].empty()) {
+            names[slot] = std::format("{}${}", name, slot);
+        }
+    }
+
+    /**
+     * @brief fix offsets of constants, build frame layout and add function to program
+     *
+     * @return std::optional<size_t> function id
+     */
+    std::optional<size_t> finish() {
+        auto &s = current();
+        auto &func = s.func;
+        func.constTableInfo.linkedFunctionCount = func.symbol.size();
+        for (auto pos : s.constantLoads) {
+            auto offset = func.code[pos].data + func.symbol.size() * sizeof(bytecode::MemUnit);
+            if (offset > UINT16_MAX) {
+                setError("too many constants");
+            }
+            func.code[pos].data = static_cast<uint16_t>(offset);
+        }
+        // slots are f64, so slot i is at i * 8
+        dynamicstruct::StructInfo frame;
+        for (size_t i = 0; i < s.slotNames.size(); i++) {
+            frame.emplace_back(s.slotNames[i].empty() ? std::format("${}", i) : s.slotNames[i], "f64");
+        }
+        func.varTableInfo = {program.layout.addDefinition(func.symbol[0] + "@frame", frame),
+                             frame.size() * sizeof(double), false};
+        func.registerInfo.registerStackSizeRequired = 0;
+        auto id = program.context.addFunction(func);
+        states.pop_back();
+        return id;
+    }
+
+    Kind emitAny(std::unique_ptr<ExprAST> &expr) {
+        if (!expr) {
+            return Kind::NONE;
+        }
+        expr->accept(this);
+        return kind;
+    }
+    /// @brief leaves exactly one F64 on register stack
+    void emitValue(std::unique_ptr<ExprAST> &expr) {
+        if (emitAny(expr) != Kind::NUM) {
+            setError("expression returns no numerical value");
+        }
+    }
+    /// @brief leaves nothing on register stack
+    void emitStatement(std::unique_ptr<ExprAST> &expr) {
+        if (emitAny(expr) == Kind::NUM) {
+            emit(bytecode::OPCode::POP);
+        }
+    }
+
+    /**
+     * @brief evaluate expression as condition, shortcut and compare jump directly without making F64
+     *
+     * @param expr condition
+     * @param jumpWhen jump when condition is true or false
+     * @return std::vector<size_t> jumps need to be patched to target
+     */
+    std::vector<size_t> emitCondition(std::unique_ptr<ExprAST> &expr, bool jumpWhen) {
+        using namespace bytecode;
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(CQResolver::resolveBinOp(p->op));
+            }
+            auto code = static_cast<BinOpCode>(p->resolved);
+            if (code == BinOpCode::AND || code == BinOpCode::OR) {
+                // truth of shortcut value is same as truth of the whole expression
+                bool isAnd = code == BinOpCode::AND;
+                if (jumpWhen != isAnd) {
+                    // (a and b) jump when false, (a or b) jump when true
+                    auto ret = emitCondition(p->lhs, jumpWhen);
+                    auto tmp = emitCondition(p->rhs, jumpWhen);
+                    ret.insert(ret.end(), tmp.begin(), tmp.end());
+                    return ret;
+                }
+                auto decided = emitCondition(p->lhs, !jumpWhen);
+                auto ret = emitCondition(p->rhs, jumpWhen);
+                patch(decided);
+                return ret;
+            }
+            if (isCompare(code)) {
+                emitValue(p->lhs);
+                emitValue(p->rhs);
+                emit(OPCode::BIN_OP, DataType::F64, binaryOP(code));
+                return {emitJump(jumpWhen ? OPCode::BNZ : OPCode::BEZ)};
+            }
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(CQResolver::resolveUnaryOp(p->op));
+            }
+            if (static_cast<UnaryOpCode>(p->resolved) == UnaryOpCode::NOT) {
+                return emitCondition(p->rhs, !jumpWhen);
+            }
+        }
+        emitValue(expr);
+        return {emitJump(jumpWhen ? OPCode::BNZ : OPCode::BEZ, DataType::F64)};
+    }
+
+    static bool isCompare(BinOpCode code) { return code >= BinOpCode::GT && code <= BinOpCode::LE; }
+    static bytecode::BinaryOP::Type binaryOP(BinOpCode code) {
+        using namespace bytecode;
+        switch (code) {
+        case BinOpCode::ADD:
+            return BinaryOP::ADD;
+        case BinOpCode::SUB:
+            return BinaryOP::SUB;
+        case BinOpCode::MUL:
+            return BinaryOP::MUL;
+        case BinOpCode::DIV:
+            return BinaryOP::DIV;
+        case BinOpCode::GT:
+            return BinaryOP::GT;
+        case BinOpCode::LT:
+            return BinaryOP::LT;
+        case BinOpCode::EQ:
+            return BinaryOP::EQU;
+        case BinOpCode::NE:
+            return BinaryOP::NEQ;
+        case BinOpCode::GE:
+            return BinaryOP::GE;
+        case BinOpCode::LE:
+            return BinaryOP::LE;
+        default:
+            my_assert(false, "unreachable");
+            return BinaryOP::ADD;
+        }
+    }
+
+    /**
+     * @brief get position of variable or member of variable in data segment
+     *
+     * @param v identifier of external variable, or member access on it
+     * @return std::tuple<const ExternVar *, size_t, const TypeLayout *> {variable, offset, layout of the value}
+     */
+    std::tuple<const ByteCodeProgram::ExternVar *, size_t, const ByteCodeProgram::TypeLayout *>
+    externPath(ExprAST &v) {
+        if (!current().allowExtern) {
+            setError("function can not access variable in DataStore");
+        }
+        if (auto p = dynamic_cast<IdentifierExprAST *>(&v)) {
+            if (p->resolved != CQResolver::externalVar) {
+                setError("member access of local variable is not supported");
+            }
+            auto it = program.externVars.find(p->name);
+            if (it == program.externVars.end()) {
+                setError("variable can not be mapped onto data segment: " + p->name);
+            }
+            return {&it->second, it->second.offset, it->second.layout};
+        }
+        auto p = dynamic_cast<MemberAccessExprAST *>(&v);
+        if (!p || !p->baseVar) {
+            setError("only member access on variable is supported");
+        }
+        auto [var, offset, layout] = externPath(*p->baseVar);
+        auto member = dynamic_cast<LiteralExprAST *>(p->memberToken.get());
+        if (!member || !(*(member->type) == StringType) || layout->kind != ByteCodeProgram::TypeLayout::Kind::STRUCT) {
+            setError("only struct member access is supported");
+        }
+        for (auto &[name, memberOffset, memberLayout] : layout->members) {
+            if (name == member->value) {
+                return {var, offset + memberOffset, memberLayout};
+            }
+        }
+        setError("unknown member: " + member->value);
+    }
+
+    /// @brief mark variable accessed in this run, same as ResourceHandler::readIn
+    void touch(const ByteCodeProgram::ExternVar *var) {
+        auto [it, inserted] = externs.try_emplace(var, std::nullopt);
+        if (inserted && var->writable) {
+            size_t cnt = 0;
+            for (auto &[_, flag] : externs) {
+                cnt += flag.has_value();
+            }
+            it->second = program.flagBase + cnt;
+        }
+        if (it->second.has_value()) {
+            emit(bytecode::OPCode::LOAD_IMM, bytecode::DataType::NONE, 1);
+            emit(bytecode::OPCode::STORE_GLOBAL, bytecode::DataType::U8, it->second.value());
+        }
+    }
+
+    /**
+     * @brief {memory type, register type when loaded, register type before stored}
+     *
+     */
+    static std::tuple<bytecode::DataType::Type, bytecode::DataType::Type, bytecode::DataType::Type>
+    numericalType(ByteCodeProgram::TypeLayout::Kind kind) {
+        using namespace bytecode;
+        using Kind = ByteCodeProgram::TypeLayout::Kind;
+        switch (kind) {
+        case Kind::BOOL:
+            return {DataType::U8, DataType::U64, DataType::U64};
+        case Kind::I8:
+            return {DataType::I8, DataType::I64, DataType::I64};
+        case Kind::U8:
+            return {DataType::U8, DataType::U64, DataType::I64};
+        case Kind::I16:
+            return {DataType::I16, DataType::I64, DataType::I64};
+        case Kind::U16:
+            return {DataType::U16, DataType::U64, DataType::I64};
+        case Kind::I32:
+            return {DataType::I32, DataType::I64, DataType::I64};
+        case Kind::U32:
+            return {DataType::U32, DataType::U64, DataType::I64};
+        case Kind::I64:
+            return {DataType::I64, DataType::I64, DataType::I64};
+        case Kind::U64:
+            return {DataType::U64, DataType::U64, DataType::U64};
+        case Kind::F32:
+            return {DataType::F32, DataType::F64, DataType::F64};
+        default:
+            return {DataType::F64, DataType::F64, DataType::F64};
+        }
+    }
+
+    void emitExternLoad(
+        std::tuple<const ByteCodeProgram::ExternVar *, size_t, const ByteCodeProgram::TypeLayout *> path) {
+        using namespace bytecode;
+        auto [var, offset, layout] = path;
+        if (!layout->isNumerical()) {
+            setError("only numerical variable is supported");
+        }
+        touch(var);
+        auto [memory, reg, _] = numericalType(layout->kind);
+        emit(OPCode::LOAD_GLOBAL, memory, offset);
+        if (reg != DataType::F64) {
+            emit(OPCode::TYPE_TRANS, reg, DataType::F64);
+        }
+    }
+
+    /// @brief store F64 on register stack, converted same as ResourceHandler::writeValue
+    void emitExternStore(
+        std::tuple<const ByteCodeProgram::ExternVar *, size_t, const ByteCodeProgram::TypeLayout *> path) {
+        using namespace bytecode;
+        auto [var, offset, layout] = path;
+        if (!layout->isNumerical()) {
+            setError("only numerical variable is supported");
+        }
+        touch(var);
+        auto [memory, _, reg] = numericalType(layout->kind);
+        if (layout->kind == ByteCodeProgram::TypeLayout::Kind::BOOL) {
+            emitNumber(0);
+            emit(OPCode::BIN_OP, DataType::F64, BinaryOP::NEQ);
+        } else if (reg != DataType::F64) {
+            emit(OPCode::TYPE_TRANS, DataType::F64, reg);
+        }
+        emit(OPCode::STORE_GLOBAL, memory, offset);
+    }
+
+    void emitAssign(BinOpExprAST &v) {
+        if (auto p = dynamic_cast<IdentifierExprAST *>(v.lhs.get());
+            p && p->resolved != CQResolver::externalVar) {
+            my_assert(p->resolved != ExprAST::unresolved, "ast should be resolved before generate");
+            emitValue(v.rhs);
+            emit(bytecode::OPCode::STORE_VAR, bytecode::DataType::F64, slotOffset(p->resolved));
+            return;
+        }
+        if (!v.lhs) {
+            setError("only allow direct or member variable assignment for now");
+        }
+        auto path = externPath(*v.lhs);
+        emitValue(v.rhs);
+        emitExternStore(path);
+    }
+
+    void emitUserCall(FunctionCallExprAST &v) {
+        using namespace bytecode;
+        auto name = dynamic_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+        auto f = context.global.realFuncDefinition.find(name);
+        if (f == context.global.realFuncDefinition.end()) {
+            setError(std::format("function \"{}\" not found", name));
+        }
+        auto &callee = *(f->second);
+        if (v.params.size() != callee.params.size()) {
+            setError(std::format("wrong param count of function \"{}\"", name));
+        }
+        generateFunction(name, callee);
+        for (auto &param : v.params) {
+            emitValue(param);
+        }
+        auto &symbol = current().func.symbol;
+        auto it = std::find(symbol.begin(), symbol.end(), name);
+        auto index = static_cast<size_t>(it - symbol.begin());
+        if (it == symbol.end()) {
+            symbol.push_back(name);
+        }
+        emit(OPCode::LOAD_CONST, DataType::U64, index * sizeof(MemUnit));
+        emit(OPCode::CALL, DataType::NONE, v.params.size());
+    }
+
+    /**
+     * @brief lower user function if not lowered, params are passed as F64 on register stack
+     *
+     * @param name function name
+     * @param func function define
+     */
+    void generateFunction(const std::string &name, FunctionDefAST &func) {
+        using namespace bytecode;
+        my_assert(func.resolved != ExprAST::unresolved, "function should be resolved before generate");
+        auto [it, inserted] = program.functionIDs.try_emplace(&func, std::nullopt);
+        if (!inserted) {
+            if (!it->second.has_value() && !generating.contains(&func)) {
+                setError(std::format("function \"{}\" can not be lowered", name));
+            }
+            // lowered, or being lowered by recursion
+            return;
+        }
+        generating.insert(&func);
+        states.emplace_back(name, false);
+        try {
+            for (auto &param : func.params) {
+                if (!(*(param->type) == RealType || *(param->type) == IntType)) {
+                    setError(std::format("function \"{}\" has non-numerical param", name));
+                }
+                nameSlot(param->resolved, param->name);
+            }
+            // last param is on the top of register stack
+            for (auto p = func.params.rbegin(); p != func.params.rend(); ++p) {
+                emit(OPCode::STORE_VAR, DataType::F64, slotOffset((*p)->resolved));
+            }
+            emitValue(func.returnValue);
+            emit(OPCode::RET, DataType::NONE, 1);
+            auto id = finish();
+            if (!id.has_value()) {
+                setError(std::format("function \"{}\" can not be added", name));
+            }
+            program.functionIDs[&func] = id;
+            generating.erase(&func);
+        } catch (...) {
+            states.pop_back();
+            generating.erase(&func);
+            throw;
+        }
+    }
+
+    /// @brief context, includes function defines
+    ContextStack &context;
+    DataStore &data;
+    /// @brief literals pre-parsed by CQResolver
+    const ConstantPool &constantPool;
+    ByteCodeProgram &program;
+    /// @brief functions being generated, caller first
+    std::vector<State> states;
+    /// @brief user functions being generated
+    std::set<FunctionDefAST *> generating;
+    /// @brief variables accessed by current subruleset -> access flag offset
+    std::unordered_map<const ByteCodeProgram::ExternVar *, std::optional<size_t>> externs;
+    /// @brief kind of value left by last visited expression
+    Kind kind;
+    /// @brief reason why last generate failed
+    std::string reason;
+
+    SET_ERROR_MEMBER("(ByteCode)Generation", void)
+};
+/**
+ * @brief variables accessed by one subruleset mapped onto a flat data segment,
+ * shared by backends running lowered subrulesets
+ *
+ */
+struct CQDataSegment {
+    /**
+     * @brief Constructor
+     *
+     * @param data DataStore which variables are read from and written back to
+     * @param memory data segment, owned by backend
+     */
+    CQDataSegment(DataStore &data, std::vector<bytecode::MemUnit> &memory)
+        : data(data), memory(memory), externs(), flags(), originals(), typed(), schemaVersion(SIZE_MAX),
+          originalAt(), originalBytes(), flagBase(0), pendingWriteBack(false) {}
+    CQDataSegment(const CQDataSegment &) = delete;
+    CQDataSegment &operator=(const CQDataSegment &) = delete;
+
+    /**
+     * @brief set variables accessed by subruleset and resize data segment to hold their access flags
+     *
+     * @param accessed variables read or written by subruleset
+     * @param accessFlags access flag offset of each writable one in accessed
+     * @param base offset of the first access flag, see ByteCodeProgram::flagBase
+     */
+    void bind(const std::vector<const ByteCodeProgram::ExternVar *> &accessed,
+              const std::vector<std::optional<size_t>> &accessFlags, size_t base) {
+        externs = accessed;
+        flags = accessFlags;
+        flagBase = base;
+        size_t flagEnd = flagBase;
+        for (auto &flag : flags) {
+            if (flag.has_value()) {
+                flagEnd = std::max(flagEnd, flag.value() + 1);
+            }
+        }
+        memory.assign((flagEnd + sizeof(bytecode::MemUnit) - 1) / sizeof(bytecode::MemUnit), 0);
+        originals.resize(externs.size());
+        originalAt.assign(externs.size(), 0);
+        size_t originalSize = 0;
+        for (size_t i = 0; i < externs.size(); i++) {
+            if (externs[i]->writable && externs[i]->layout->flat) {
+                originalAt[i] = originalSize;
+                originalSize += externs[i]->layout->size;
+            }
+        }
+        originalBytes.assign(originalSize, 0);
+        schemaVersion = SIZE_MAX;
+    }
+
+    /**
+     * @brief get begin of data segment
+     *
+     * @return uint8_t*
+     */
+    uint8_t *get() { return reinterpret_cast<uint8_t *>(memory.data()); }
+
+    /**
+     * @brief clear access flags and copy accessed variables from DataStore into data segment
+     *
+     * @return bool false if some variable is missing or not of its declared type
+     */
+    bool load() {
+        pendingWriteBack = false;
+        auto segment = get();
+        std::fill(segment + flagBase, segment + memory.size() * sizeof(bytecode::MemUnit), 0);
+        if (schemaVersion != data.schemaVersion) {
+            // typed storage is compiled or dropped between ticks, places do not move until then
+            typed.assign(externs.size(), nullptr);
+            for (size_t i = 0; i < externs.size(); i++) {
+                if (auto it = data.typedVars.find(externs[i]->name); it != data.typedVars.end()) {
+                    typed[i] = &it->second;
+                }
+            }
+            schemaVersion = data.schemaVersion;
+        }
+        for (size_t i = 0; i < externs.size(); i++) {
+            auto var = externs[i];
+            auto dst = segment + var->offset;
+            if (typed[i] && typed[i]->recordValid) {
+                // record uses the same layout as data segment
+                std::memcpy(dst, data.recordOf(*typed[i]), var->layout->size);
+            } else {
+                std::any scratch;
+                auto src = data.find(var->name, scratch);
+                if (!src || !var->layout->pack(dst, *src)) {
+                    return false;
+                }
+                if (var->writable && !typed[i]) {
+                    // copy, former subrulesets may write back before this one
+                    originals[i] = *src;
+                }
+            }
+            if (var->writable && typed[i]) {
+                std::memcpy(originalBytes.data() + originalAt[i], dst, var->layout->size);
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief mark data segment of last load as result of a finished run, which should be written back
+     *
+     */
+    void commit() { pendingWriteBack = true; }
+
+    /**
+     * @brief write accessed output and changed cache back to DataStore, same as ResourceHandler::writeBack
+     *
+     */
+    void writeBack() {
+        if (!pendingWriteBack) {
+            return;
+        }
+        pendingWriteBack = false;
+        // so outputs are compared with their value in record below
+        data.syncRecord();
+        auto segment = get();
+        for (size_t i = 0; i < externs.size(); i++) {
+            auto var = externs[i];
+            auto &flag = flags[i];
+            if (!flag.has_value() || segment[flag.value()] == 0) {
+                continue;
+            }
+            auto now = segment + var->offset;
+            if (auto p = typed[i]) {
+                auto stored = data.recordOf(*p);
+                if (p->table == &data.output) {
+                    if (data.trackChanges && !(p->recordValid && var->layout->equal(now, stored))) {
+                        data.markChanged(var->name);
+                    }
+                } else if (var->layout->equal(now, originalBytes.data() + originalAt[i])) {
+                    continue;
+                } else {
+                    data.markChanged(var->name);
+                }
+                std::memcpy(stored, now, var->layout->size);
+                data.recordWritten(*p);
+            } else if (auto it = data.output.find(var->name); it != data.output.end()) {
+                auto value = var->layout->unpack(now, originals[i]);
+                if (data.trackChanges && !tools::myany::anyEqual(value, it->second)) {
+                    data.markChanged(var->name);
+                }
+                it->second = std::move(value);
+            } else if (auto it = data.cache.find(var->name); it != data.cache.end()) {
+                auto value = var->layout->unpack(now, originals[i]);
+                if (!tools::myany::anyEqual(value, originals[i])) {
+                    data.markChanged(var->name);
+                    it->second = std::move(value);
+                }
+            }
+        }
+    }
+
+  private:
+    DataStore &data;
+    /// @brief data segment, may be memory of VM
+    std::vector<bytecode::MemUnit> &memory;
+    /// @brief variables read or written by subruleset
+    std::vector<const ByteCodeProgram::ExternVar *> externs;
+    /// @brief access flag offset in data segment of each writable one in externs
+    std::vector<std::optional<size_t>> flags;
+    /// @brief value of each writable variable in externs not in typed storage when last load
+    std::vector<std::any> originals;
+    /// @brief place in typed storage of each one in externs, nullptr if not typed
+    std::vector<DataStore::TypedVar *> typed;
+    /// @brief DataStore::schemaVersion when typed is found
+    size_t schemaVersion;
+    /// @brief offset in originalBytes of each writable one in externs whose layout is flat
+    std::vector<size_t> originalAt;
+    /// @brief flat value of each writable variable in typed storage when last load
+    std::vector<uint8_t> originalBytes;
+    /// @brief offset of the first access flag
+    size_t flagBase;
+    /// @brief last run is not written back yet
+    bool pendingWriteBack;
+};
+
+/**
+ * @brief execute one subruleset on ByteCodeVM
+ *
+ */
+struct CQByteCodeEngine {
+    /**
+     * @brief Constructor
+     *
+     * @param data DataStore which variables are read from and written back to
+     * @param program program shared by all subrulesets of rule set
+     */
+    CQByteCodeEngine(DataStore &data, ByteCodeProgram &program)
+        : data(data), program(program), vm(program.context), dispatch(defaultDispatch), segment(data, vm.dataSegment),
+          lowered(), returned(0), executed(false), reason() {}
+    CQByteCodeEngine(const CQByteCodeEngine &) = delete;
+    CQByteCodeEngine &operator=(const CQByteCodeEngine &) = delete;
+
+    /**
+     * @brief lower subruleset into bytecode, leave it not compiled if it can not be lowered
+     * @attention ByteCodeProgram::buildLayout must be called before
+     *
+     * @param c context, includes function defines
+     * @param pool constant pool of resolved literals
+     * @param expr resolved subruleset
+     * @param name unique name of subruleset
+     */
+    void compile(ContextStack &c, const ConstantPool &pool, std::unique_ptr<ExprAST> &expr, const std::string &name) {
+        CQByteCodeGenerator generator(c, data, pool, program);
+        lowered = generator.generate(expr, name);
+        if (!lowered.has_value()) {
+            reason = generator.getReason();
+            return;
+        }
+        segment.bind(lowered->externs, lowered->flags, program.flagBase);
+        vm.dispatch = dispatch;
+    }
+
+    /**
+     * @brief check if subruleset is lowered into bytecode
+     *
+     * @return bool
+     */
+    bool isCompiled() const { return lowered.has_value(); }
+
+    /**
+     * @brief get reason why subruleset is not lowered
+     *
+     * @return const std::string&
+     */
+    const std::string &getReason() const { return reason; }
+
+    /**
+     * @brief count executed sequences of bytecode in following runs, which is slower
+     *
+     * @param on false to restore default dispatch
+     */
+    void setProfiling(bool on) { vm.dispatch = on ? bytecode::ByteCodeVM::Dispatch::PROFILE : dispatch; }
+
+    /**
+     * @brief run threaded bytecode instead of register bytecode in following runs, superinstructions are only fused
+     * into threaded bytecode, so they take effect only then
+     *
+     * @param on false to restore register bytecode
+     */
+    void setThreaded(bool on) {
+        dispatch = on ? bytecode::ByteCodeVM::Dispatch::THREADED : defaultDispatch;
+        if (vm.dispatch != bytecode::ByteCodeVM::Dispatch::PROFILE) {
+            vm.dispatch = dispatch;
+        }
+    }
+
+    /**
+     * @brief get sequences counted since profiling
+     *
+     * @return const bytecode::SequenceProfile&
+     */
+    const bytecode::SequenceProfile &getSequenceProfile() const { return vm.sequenceProfile; }
+
+    /**
+     * @brief run subruleset in VM
+     *
+     * @return bool false if not compiled, data can not be mapped or VM failed;
+     * nothing is changed then and the tick should be executed by CQInterpreter
+     */
+    bool run() {
+        executed = false;
+        if (!lowered.has_value() || !segment.load()) {
+            return false;
+        }
+        auto ret = vm.getFunc<double()>(lowered->functionID)();
+        if (!ret.has_value()) {
+            return false;
+        }
+        returned = ret.value();
+        executed = true;
+        segment.commit();
+        return true;
+    }
+
+    /**
+     * @brief check if last run is executed by VM
+     *
+     * @return bool
+     */
+    bool isExecuted() const { return executed; }
+
+    /**
+     * @brief get value returned by last run
+     *
+     * @return double
+     */
+    double getReturned() const { return returned; }
+
+    /**
+     * @brief write accessed output and changed cache back to DataStore, same as ResourceHandler::writeBack
+     *
+     */
+    void writeBack() { segment.writeBack(); }
+
+  private:
+    // functions not convertible to register bytecode still run threaded
+    inline static constexpr auto defaultDispatch = bytecode::ByteCodeVM::Dispatch::REGISTER;
+
+    DataStore &data;
+    ByteCodeProgram &program;
+    bytecode::ByteCodeVM vm;
+    /// @brief dispatch when not profiling
+    bytecode::ByteCodeVM::Dispatch dispatch;
+    /// @brief variables mapped onto data segment of vm
+    CQDataSegment segment;
+    /// @brief lowered subruleset, nullopt if it can not be lowered
+    std::optional<CQByteCodeGenerator::Lowered> lowered;
+    /// @brief value returned by last run
+    double returned;
+    /// @brief last run is executed by VM
+    bool executed;
+    /// @brief reason why subruleset is not lowered
+    std::string reason;
+};
+
+} // namespace rulejit::cq
@@ -0,0 +1,805 @@
+/**
+ * @file cqclosure.hpp
+ * @author djw
+ * @brief CQ/Interpreter/Closure engine
+ * @date 2026-10-17
+ *
+ * @details Includes CQClosureEngine, which compiles a resolved ast once into a tree of pre-bound
+ * closures and executes them instead of walking the ast through ASTVisitor.
+ *
+ * Semantics (shortcut, lazy runtime errors, returned value of each node) are same as CQInterpreter.
+ * Error context is captured while exception unwinds through closures, so a successful tick
+ * pays nothing for it.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Hold numerical local variables by value.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Access struct members through index resolved at load time.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "ast/type.hpp"
+#include "backend/cq/cqinterpreter.hpp"
+#include "backend/cq/cqresolver.hpp"
+#include "backend/cq/cqresourcehandler.h"
+#include "tools/myassert.hpp"
+#include "tools/seterror.hpp"
+
+namespace rulejit::cq {
+
+/**
+ * @brief compile ast into closures and execute them in cq environment
+ *
+ * @attention ast must be piped through CQResolver before compile
+ *
+ */
+struct CQClosureEngine : public ASTVisitor {
+    /**
+     * @brief Value type returned by closures, same as the one passes through CQInterpreter
+     *
+     */
+    struct Value {
+        union {
+            size_t token;
+            double value;
+        };
+        enum valueType {
+            TOKEN,
+            VALUE,
+            EMPTY,
+        } type;
+    };
+    using ValueClosure = std::function<Value()>;
+    using NumClosure = std::function<double()>;
+
+    /**
+     * @brief Constructor
+     *
+     * @param c context, includes function defines
+     * @param h ResourceHandler which handles variable for this object
+     * @param pool constant pool of resolved literals, handler should have pinned its strings
+     */
+    CQClosureEngine(ContextStack &c, ResourceHandler &h, const ConstantPool *pool = nullptr)
+        : context(c), handler(h), constantPool(pool), slots(), frameBase(0), root(), functions(), compiled(), runCount(0),
+          externalTokens(), externalIndex() {
+        slots.reserve(64);
+        returned.type = Value::EMPTY;
+    }
+    CQClosureEngine(const CQClosureEngine &) = delete;
+    CQClosureEngine &operator=(const CQClosureEngine &) = delete;
+
+    /**
+     * @brief compile given ast as the expression executed by run()
+     *
+     * @param expr resolved ast, must outlive this object
+     */
+    void compile(std::unique_ptr<ExprAST> &expr) { root = compileValue(expr); }
+
+    /**
+     * @brief execute compiled expression
+     * @attention if exception thrown, currentExpr holds the context from outermost to innermost expression
+     *
+     */
+    void run() {
+        currentExpr.clear();
+        runCount++;
+        slots.clear();
+        frameBase = 0;
+        try {
+            returned = root();
+        } catch (...) {
+            // closures push context while unwinding, which is innermost first
+            std::reverse(currentExpr.begin(), currentExpr.end());
+            throw;
+        }
+    }
+
+    /// @brief context of last runtime error, from outermost to innermost expression
+    std::vector<ExprAST *> currentExpr;
+
+    /**
+     * @brief get value returned by last run
+     *
+     * @return double
+     */
+    double getReturned() {
+        my_assert(returned.type == Value::VALUE);
+        return returned.value;
+    }
+
+  private:
+    /**
+     * @brief wrap closure of a node, record the node as error context when exception passes through
+     *
+     * @param node ast node which closure f executes
+     * @param f closure
+     * @return closure with same result as f
+     */
+    template <typename F> auto guard(ExprAST *node, F &&f) {
+        return [this, node, f = std::forward<F>(f)]() -> decltype(f()) {
+            try {
+                return f();
+            } catch (...) {
+                currentExpr.push_back(node);
+                throw;
+            }
+        };
+    }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before compile");
+        if (v.resolved == CQResolver::externalVar) {
+            compiled = guard(&v, [this, name = v.name, cache = externalCache(v.name)] {
+                return token(readIn(name, cache));
+            });
+            return;
+        }
+        compiled = [this, slot = v.resolved] { return slots[frameBase + slot]; };
+    }
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        auto base = compileValue(v.baseVar);
+        if (*(v.memberToken->type) == StringType && v.resolved != ExprAST::unresolved) {
+            compiled = guard(&v, [this, base, index = v.resolved] {
+                auto b = base();
+                if (b.type != Value::TOKEN) {
+                    setError("number have no members");
+                }
+                return token(handler.memberAccess(b.token, index));
+            });
+        } else if (*(v.memberToken->type) == StringType) {
+            compiled = guard(&v, [this, base, name = dynamic_cast<LiteralExprAST *>(v.memberToken.get())->value] {
+                auto b = base();
+                if (b.type != Value::TOKEN) {
+                    setError("number have no members");
+                }
+                return token(handler.memberAccess(b.token, name));
+            });
+        } else if (*(v.memberToken->type) == RealType) {
+            compiled = guard(&v, [this, base, index = compileNum(v.memberToken)] {
+                auto b = base();
+                if (b.type != Value::TOKEN) {
+                    setError("number have no members");
+                }
+                auto i = index();
+                setErrorWhenFailed(i == (double)floor(i), "array index out of range (should can be cast to int)");
+                return token(handler.arrayAccess(b.token, (size_t)i));
+            });
+        } else {
+            compiled = guard(&v, [this, base]() -> Value {
+                if (base().type != Value::TOKEN) {
+                    setError("number have no members");
+                }
+                setError("member access only accept string or int");
+            });
+        }
+    }
+    VISIT_FUNCTION(LiteralExprAST) {
+        if (*(v.type) == RealType) {
+            compiled = [x = number(v)] { return value(x); };
+        } else if (*(v.type) == StringType) {
+            if (v.resolved != ExprAST::unresolved) {
+                compiled = [t = v.resolved] { return token(t); };
+            } else {
+                compiled = [this, s = v.value] { return token(handler.takeString(s)); };
+            }
+        } else if (v.type->isFunctionType()) {
+            compiled = [this, s = v.value] { return token(handler.takeString(s)); };
+        } else {
+            compiled = [] { return empty(); };
+        }
+    }
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveCall(v));
+        }
+        auto code = static_cast<CallCode>(v.resolved);
+        switch (code) {
+        case CallCode::PRINT: {
+            if (v.params.size() != 1) {
+                compiled = fail(&v, "\"print\" only accept 1 param");
+                return;
+            }
+            compiled = guard(&v, [this, arg = compileValue(v.params[0])] {
+                auto a = arg();
+                if (a.type == Value::TOKEN) {
+                    if (handler.isString(a.token)) {
+                        std::cout << handler.readString(a.token) << std::endl;
+                    } else {
+                        std::cout << handler.readValue(a.token) << std::endl;
+                    }
+                } else {
+                    std::cout << a.value << std::endl;
+                }
+                return empty();
+            });
+            return;
+        }
+        case CallCode::PUSH: {
+            if (v.params.size() != 2) {
+                compiled = fail(&v, "\"push\" only accept 2 param");
+                return;
+            }
+            // same as interpreter, push returns its second argument
+            compiled = guard(&v, [this, arg1 = compileValue(v.params[0]), arg2 = compileValue(v.params[1])] {
+                auto a1 = arg1();
+                auto a2 = arg2();
+                setErrorWhenFailed(a1.type == Value::TOKEN, "expect array as receiver of \"push\"");
+                if (a2.type == Value::VALUE) {
+                    handler.arrayExtend(a1.token, a2.value);
+                } else if (a2.type == Value::TOKEN) {
+                    handler.arrayExtend(a1.token, a2.token);
+                } else {
+                    setError("arg2 of \"push\" has no return");
+                }
+                return a2;
+            });
+            return;
+        }
+        case CallCode::RESIZE: {
+            if (v.params.size() != 2) {
+                compiled = fail(&v, "\"resize\" only accept 2 param");
+                return;
+            }
+            compiled = guard(&v, [this, arg1 = compileValue(v.params[0]), arg2 = compileNum(v.params[1])] {
+                auto a1 = arg1();
+                auto a2 = arg2();
+                setErrorWhenFailed(a1.type == Value::TOKEN, "expect array as receiver of \"resize\"");
+                setErrorWhenFailed(a2 == (double)floor(a2), "array index out of range (should can be cast to int)");
+                handler.arrayResize(a1.token, static_cast<size_t>(a2));
+                return value(a2);
+            });
+            return;
+        }
+        case CallCode::USER:
+            compileUserCall(v);
+            return;
+        case CallCode::INDIRECT:
+            compiled = guard(&v, [this]() -> Value {
+                setError("only allow direct function call, cannot call function through variable");
+            });
+            return;
+        default:
+            compiled = [f = compileNumCall(v)] { return value(f()); };
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveBinOp(v.op));
+        }
+        if (static_cast<BinOpCode>(v.resolved) == BinOpCode::ASSIGN) {
+            compileAssign(v);
+            return;
+        }
+        compiled = [f = compileNumBinOp(v)] { return value(f()); };
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) { compiled = [f = compileNumUnaryOp(v)] { return value(f()); }; }
+    VISIT_FUNCTION(BranchExprAST) {
+        compiled = guard(&v, [cond = compileNum(v.condition), t = compileValue(v.trueExpr),
+                              f = compileValue(v.falseExpr)] { return cond() != 0 ? t() : f(); });
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        std::vector<ValueClosure> values;
+        for (auto &&[name, value] : v.members) {
+            values.push_back(compileValue(value));
+        }
+        if (v.type->isArrayType()) {
+            std::vector<bool> designated;
+            for (auto &&[name, value] : v.members) {
+                designated.push_back(name != nullptr);
+            }
+            compiled = guard(&v, [this, typeName = v.type->toString(), values, designated] {
+                auto tmp = handler.makeInstance(typeName);
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (designated[i]) {
+                        error("do not support designated initializer for array");
+                    }
+                    auto r = values[i]();
+                    switch (r.type) {
+                    case Value::VALUE:
+                        handler.arrayExtend(tmp, r.value);
+                        break;
+                    case Value::TOKEN:
+                        handler.arrayExtend(tmp, r.token);
+                        break;
+                    default:
+                        error("invalid value type");
+                    }
+                }
+                return token(tmp);
+            });
+        } else {
+            // empty name means key is not a string literal, which is reported when reached
+            std::vector<std::string> names;
+            for (auto &&[name, value] : v.members) {
+                auto p = dynamic_cast<LiteralExprAST *>(name.get());
+                names.push_back(p == nullptr || !(*(p->type) == StringType) ? std::string{} : p->value);
+            }
+            compiled = guard(&v, [this, typeName = v.type->toString(), values, names] {
+                auto tmp = handler.makeInstance(typeName);
+                for (size_t i = 0; i < values.size(); i++) {
+                    if (names[i].empty()) {
+                        setError("only allow string literal as key for now");
+                    }
+                    auto r = values[i]();
+                    auto memberToken = handler.memberAccess(tmp, names[i]);
+                    switch (r.type) {
+                    case Value::VALUE:
+                        handler.writeValue(memberToken, r.value);
+                        break;
+                    case Value::TOKEN:
+                        handler.assign(memberToken, r.token);
+                        break;
+                    default:
+                        error("invalid value type");
+                    }
+                }
+                return token(tmp);
+            });
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        // same as interpreter, loop returns the last (false) condition
+        compiled = guard(&v, [init = compileValue(v.init), cond = compileNum(v.condition), body = compileValue(v.body)] {
+            init();
+            double c;
+            while ((c = cond()) != 0) {
+                body();
+            }
+            return value(c);
+        });
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        std::vector<ValueClosure> exprs;
+        for (auto &expr : v.exprs) {
+            exprs.push_back(compileValue(expr));
+        }
+        compiled = guard(&v, [exprs] {
+            auto r = empty();
+            for (auto &expr : exprs) {
+                r = expr();
+            }
+            return r;
+        });
+    }
+    VISIT_FUNCTION(ControlFlowAST) { compiled = fail(&v, "ControlFlowAST should never be visit directly", true); }
+    VISIT_FUNCTION(TypeDefAST) { compiled = fail(&v, "TypeDefAST should never be visit directly", true); }
+    VISIT_FUNCTION(VarDefAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before compile");
+        if (v.resolved == CQResolver::redefinedVar) {
+            compiled = fail(&v, "redefine variable: " + v.name, true);
+            return;
+        }
+        if (*(v.valueType) == RealType || *(v.valueType) == IntType) {
+            // numerical variable is held by value, no instance needed
+            compiled = guard(&v, [this, slot = v.resolved, definedValue = compileNum(v.definedValue)] {
+                auto r = value(definedValue());
+                auto s = frameBase + slot;
+                if (s >= slots.size()) {
+                    slots.resize(s + 1);
+                }
+                slots[s] = r;
+                return empty();
+            });
+            return;
+        }
+        compiled = guard(&v, [this, slot = v.resolved, definedValue = compileValue(v.definedValue)] {
+            auto r = definedValue();
+            if (r.type == Value::TOKEN) {
+                auto tmp = handler.makeInstanceAs(r.token);
+                handler.assign(tmp, r.token);
+                r.token = tmp;
+            } else if (r.type == Value::EMPTY) {
+                setError("def var to empty value");
+            }
+            // frame of function is fully reserved at call, only top-level frame grows here
+            auto s = frameBase + slot;
+            if (s >= slots.size()) {
+                slots.resize(s + 1);
+            }
+            slots[s] = r;
+            return empty();
+        });
+    }
+    VISIT_FUNCTION(FunctionDefAST) { compiled = fail(&v, "function def should never be visit directly", true); }
+    VISIT_FUNCTION(SymbolDefAST) { compiled = fail(&v, "symbol def should never be visit directly", true); }
+
+  private:
+    static Value token(size_t t) {
+        Value ret;
+        ret.token = t;
+        ret.type = Value::TOKEN;
+        return ret;
+    }
+    static Value value(double x) {
+        Value ret;
+        ret.value = x;
+        ret.type = Value::VALUE;
+        return ret;
+    }
+    static Value empty() {
+        Value ret;
+        ret.type = Value::EMPTY;
+        return ret;
+    }
+
+    /**
+     * @brief closure which always fails when executed, keeps error lazy as interpreter
+     *
+     * @param node ast node
+     * @param msg error message
+     * @param prefixed whether message is prefixed like setError, or plain like error
+     * @return ValueClosure
+     */
+    ValueClosure fail(ExprAST *node, std::string msg, bool prefixed = false) {
+        if (prefixed) {
+            return guard(node, [msg]() -> Value { setError(msg); });
+        }
+        return guard(node, [msg]() -> Value { error(msg); });
+    }
+
+    /**
+     * @brief same as getReturnedValue in CQInterpreter
+     *
+     * @param v value
+     * @return double
+     */
+    double toNumber(const Value &v) {
+        if (v.type == Value::EMPTY) {
+            setError("no value returned");
+        }
+        if (v.type == Value::TOKEN) {
+            return handler.readValue(v.token);
+        }
+        return v.value;
+    }
+
+    /**
+     * @brief get index of cached token for external variable
+     *
+     * @param name variable name
+     * @return size_t index in externalTokens
+     */
+    size_t externalCache(const std::string &name) {
+        auto [it, inserted] = externalIndex.try_emplace(name, externalTokens.size());
+        if (inserted) {
+            externalTokens.push_back({0, 0});
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief same as ResourceHandler::readIn, but token is cached during one run
+     * since handler keeps it until writeBack
+     *
+     * @param name variable name
+     * @param cache index in externalTokens
+     * @return size_t token
+     */
+    size_t readIn(const std::string &name, size_t cache) {
+        auto &[epoch, t] = externalTokens[cache];
+        if (epoch != runCount) {
+            t = handler.readIn(name);
+            epoch = runCount;
+        }
+        return t;
+    }
+
+    double number(LiteralExprAST &v) {
+        return v.resolved == ExprAST::unresolved ? std::stod(v.value) : constantPool->numbers[v.resolved];
+    }
+
+    ValueClosure compileValue(std::unique_ptr<ExprAST> &expr) {
+        if (!expr) {
+            return [] { return empty(); };
+        }
+        expr->accept(this);
+        return std::move(compiled);
+    }
+
+    /**
+     * @brief compile expression whose value is used as number, specialized for numerical nodes
+     *
+     * @param expr expression
+     * @return NumClosure
+     */
+    NumClosure compileNum(std::unique_ptr<ExprAST> &expr) {
+        if (auto p = dynamic_cast<LiteralExprAST *>(expr.get()); p && *(p->type) == RealType) {
+            return [x = number(*p)] { return x; };
+        }
+        if (auto p = dynamic_cast<IdentifierExprAST *>(expr.get()); p && p->resolved != ExprAST::unresolved) {
+            if (p->resolved == CQResolver::externalVar) {
+                return [this, in = guard(p, [this, name = p->name, cache = externalCache(p->name)] {
+                            return readIn(name, cache);
+                        })] {
+                    return handler.readValue(in());
+                };
+            }
+            return [this, slot = p->resolved] { return toNumber(slots[frameBase + slot]); };
+        }
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(CQResolver::resolveBinOp(p->op));
+            }
+            if (static_cast<BinOpCode>(p->resolved) != BinOpCode::ASSIGN) {
+                return compileNumBinOp(*p);
+            }
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr.get())) {
+            return compileNumUnaryOp(*p);
+        }
+        if (auto p = dynamic_cast<FunctionCallExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(CQResolver::resolveCall(*p));
+            }
+            auto code = static_cast<CallCode>(p->resolved);
+            if (code == CallCode::LENGTH || code == CallCode::STR_EQUAL ||
+                (code >= CallCode::RAND && code <= CallCode::ATAN2)) {
+                return compileNumCall(*p);
+            }
+        }
+        return [this, f = compileValue(expr)] { return toNumber(f()); };
+    }
+
+    NumClosure compileNumBinOp(BinOpExprAST &v) {
+        auto code = static_cast<BinOpCode>(v.resolved);
+        if (code == BinOpCode::UNKNOWN) {
+            return guard(&v, [op = v.op]() -> double { setError(std::format("bin op \"{}\" not support for now", op)); });
+        }
+        auto l = compileNum(v.lhs);
+        auto r = compileNum(v.rhs);
+        // lhs must be evaluated before rhs
+        switch (code) {
+        case BinOpCode::ADD:
+            return guard(&v, [l, r] { auto x = l(); return x + r(); });
+        case BinOpCode::SUB:
+            return guard(&v, [l, r] { auto x = l(); return x - r(); });
+        case BinOpCode::MUL:
+            return guard(&v, [l, r] { auto x = l(); return x * r(); });
+        case BinOpCode::DIV:
+            return guard(&v, [l, r] { auto x = l(); return x / r(); });
+        case BinOpCode::MOD:
+            // TODO: not make sense
+            return guard(&v, [l, r] {
+                auto x = l();
+                return static_cast<double>(static_cast<int64_t>(x) % static_cast<int64_t>(r()));
+            });
+        case BinOpCode::GT:
+            return guard(&v, [l, r] { auto x = l(); return double(x > r()); });
+        case BinOpCode::LT:
+            return guard(&v, [l, r] { auto x = l(); return double(x < r()); });
+        case BinOpCode::EQ:
+            return guard(&v, [l, r] { auto x = l(); return double(x == r()); });
+        case BinOpCode::NE:
+            return guard(&v, [l, r] { auto x = l(); return double(x != r()); });
+        case BinOpCode::GE:
+            return guard(&v, [l, r] { auto x = l(); return double(x >= r()); });
+        case BinOpCode::LE:
+            return guard(&v, [l, r] { auto x = l(); return double(x <= r()); });
+        case BinOpCode::AND:
+            // if shortcutted, result is lhs itself
+            return guard(&v, [l, r] {
+                auto x = l();
+                return x != 0 ? double(r() != 0) : x;
+            });
+        case BinOpCode::OR:
+            return guard(&v, [l, r] {
+                auto x = l();
+                return x == 0 ? double(r() != 0) : x;
+            });
+        default:
+            my_assert(false, "unreachable");
+            return {};
+        }
+    }
+
+    NumClosure compileNumUnaryOp(UnaryOpExprAST &v) {
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveUnaryOp(v.op));
+        }
+        switch (static_cast<UnaryOpCode>(v.resolved)) {
+        case UnaryOpCode::NEG:
+            return guard(&v, [rhs = compileNum(v.rhs)] { return -rhs(); });
+        case UnaryOpCode::NOT:
+            return guard(&v, [rhs = compileNum(v.rhs)] { return double(!rhs()); });
+        default:
+            return guard(&v,
+                         [op = v.op]() -> double { setError(std::format("unary op \"{}\" not support for now", op)); });
+        }
+    }
+
+    /**
+     * @brief compile build-in function call which returns number
+     *
+     * @param v function call
+     * @return NumClosure
+     */
+    NumClosure compileNumCall(FunctionCallExprAST &v) {
+        auto code = static_cast<CallCode>(v.resolved);
+        auto name = dynamic_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+        auto failNum = [&](std::string msg) { return guard(&v, [msg]() -> double { error(msg); }); };
+        if (code == CallCode::LENGTH) {
+            if (v.params.size() != 1) {
+                return failNum("\"length\" only accept 1 param");
+            }
+            return guard(&v, [this, arg = compileValue(v.params[0])] {
+                auto a = arg();
+                setErrorWhenFailed(a.type == Value::TOKEN, "expect array as receiver of \"length\"");
+                return static_cast<double>(handler.arrayLength(a.token));
+            });
+        }
+        if (code == CallCode::STR_EQUAL) {
+            return guard(&v, [this, arg1 = compileValue(v.params[0]), arg2 = compileValue(v.params[1])] {
+                auto tmp = arg1().token;
+                auto a2 = arg2();
+                if (a2.type != Value::TOKEN || !handler.isString(a2.token)) {
+                    setError("can't compare string with non-string");
+                }
+                return double(handler.stringComp(tmp, a2.token));
+            });
+        }
+        if (code == CallCode::RAND) {
+            if (v.params.size() != 0) {
+                return failNum("\"rand\" only accept 0 param");
+            }
+            return [] { return myrand(); };
+        }
+        if (code < CallCode::POW) {
+            if (v.params.size() != 1) {
+                return failNum(std::format("\"{}\" only accept 1 param", name));
+            }
+            return guard(&v, [f = buildInOneParamFunc[size_t(code) - size_t(CallCode::SIN)],
+                              arg = compileNum(v.params[0])] { return f(arg()); });
+        }
+        if (v.params.size() != 2) {
+            return failNum(std::format("\"{}\" only accept 2 param", name));
+        }
+        return guard(&v, [f = buildInTwoParamFunc[size_t(code) - size_t(CallCode::POW)],
+                          arg1 = compileNum(v.params[0]), arg2 = compileNum(v.params[1])] {
+            auto x = arg1();
+            return f(x, arg2());
+        });
+    }
+
+    void compileUserCall(FunctionCallExprAST &v) {
+        auto name = dynamic_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+        auto f = context.global.realFuncDefinition.find(name);
+        if (f == context.global.realFuncDefinition.end()) {
+            compiled = fail(&v, std::format("function \"{}\" not found", name), true);
+            return;
+        }
+        auto &callee = f->second;
+        my_assert(callee->resolved != ExprAST::unresolved, "function should be resolved before compile");
+        std::vector<ValueClosure> args;
+        std::vector<bool> numerical;
+        for (size_t i = 0; i < callee->params.size(); i++) {
+            args.push_back(compileValue(v.params[i]));
+            auto &type = *(callee->params[i]->type);
+            numerical.push_back(type == RealType || type == IntType);
+        }
+        compiled = guard(&v, [this, body = compileFunction(*callee), frameSize = callee->resolved, args, numerical] {
+            // args are evaluated before the new frame is taken, as top-level frame still grows when variables
+            // defined in them are reached, which would otherwise overlap params
+            std::array<Value, inlineArgs> inlineValues;
+            std::vector<Value> moreValues(args.size() > inlineArgs ? args.size() : 0);
+            auto values = args.size() > inlineArgs ? moreValues.data() : inlineValues.data();
+            for (size_t i = 0; i < args.size(); i++) {
+                auto a = args[i]();
+                values[i] = numerical[i] ? value(toNumber(a)) : a;
+            }
+            auto base = slots.size();
+            slots.resize(base + frameSize);
+            std::copy_n(values, args.size(), slots.begin() + base);
+            auto callerBase = frameBase;
+            frameBase = base;
+            auto r = (*body)();
+            frameBase = callerBase;
+            slots.resize(base);
+            return r;
+        });
+    }
+
+    /**
+     * @brief get compiled body of user function, compile it if not compiled yet
+     *
+     * @param func function define
+     * @return ValueClosure* stable pointer, so recursive function can refer to itself
+     */
+    ValueClosure *compileFunction(FunctionDefAST &func) {
+        auto [it, inserted] = functions.try_emplace(&func, nullptr);
+        if (inserted) {
+            it->second = std::make_unique<ValueClosure>();
+            auto p = it->second.get();
+            *p = compileValue(func.returnValue);
+            return p;
+        }
+        return it->second.get();
+    }
+
+    void compileAssign(BinOpExprAST &v) {
+        if (auto p = dynamic_cast<IdentifierExprAST *>(v.lhs.get())) {
+            my_assert(p->resolved != ExprAST::unresolved, "ast should be resolved before compile");
+            // rhs is evaluated before lhs
+            auto rhs = compileValue(v.rhs);
+            auto lhs = compileValue(v.lhs);
+            compiled = guard(&v, [this, rhs, lhs, slot = p->resolved] {
+                auto r = rhs();
+                auto l = lhs();
+                if (l.type == Value::TOKEN) {
+                    if (r.type == Value::TOKEN) {
+                        handler.assign(l.token, r.token);
+                    } else {
+                        handler.writeValue(l.token, r.value);
+                    }
+                } else {
+                    // lhs is defined in program and stored in slots
+                    slots[frameBase + slot] = value(toNumber(r));
+                }
+                return empty();
+            });
+        } else if (isType<MemberAccessExprAST>(v.lhs.get())) {
+            auto lhs = compileValue(v.lhs);
+            auto rhs = compileValue(v.rhs);
+            compiled = guard(&v, [this, lhs, rhs] {
+                auto l = lhs();
+                auto r = rhs();
+                if (r.type == Value::VALUE) {
+                    handler.writeValue(l.token, r.value);
+                } else {
+                    handler.assign(l.token, r.token);
+                }
+                return empty();
+            });
+        } else {
+            compiled = fail(&v, "only allow direct or member variable assignment for now", true);
+        }
+    }
+
+    /// @brief args of a call held outside slots while evaluated, more ones are held in heap
+    static constexpr size_t inlineArgs = 8;
+
+    /// @brief context, includes function defines
+    ContextStack &context;
+    /// @brief holds CQ-related variables
+    ResourceHandler &handler;
+    /// @brief literals pre-parsed by CQResolver
+    const ConstantPool *constantPool;
+    /// @brief local variables, each activation takes [frameBase, frameBase + frame size) of it
+    std::vector<Value> slots;
+    /// @brief start of current activation in slots
+    size_t frameBase;
+    /// @brief compiled expression
+    ValueClosure root;
+    /// @brief compiled bodies of user functions
+    std::unordered_map<FunctionDefAST *, std::unique_ptr<ValueClosure>> functions;
+    /// @brief closure passed through visit functions
+    ValueClosure compiled;
+    /// @brief value returned by last run
+    Value returned;
+    /// @brief number of run() called, increased before each run so cache with epoch 0 is always stale
+    size_t runCount;
+    /// @brief {epoch, token} of external variables read in current run
+    std::vector<std::tuple<size_t, size_t>> externalTokens;
+    /// @brief external variable name -> index in externalTokens
+    std::unordered_map<std::string, size_t> externalIndex;
+
+    SET_ERROR_MEMBER("(Closure)Runtime", void)
+};
+
+} // namespace rulejit::cq
@@ -0,0 +1,396 @@
+/**
+ * @file cqincremental.h
+ * @author djw
+ * @brief CQ/Interpreter/Incremental
+ * @date 2026-10-17
+ *
+ * @details Includes AccessAnalyzer, which collects variables a subruleset reads and writes, and IncrementalState,
+ * which decides if a subruleset can be skipped in a tick of incremental mode.
+ *
+ * A subruleset reads input, cache and output variables through member-access paths like "selfInfo.baseInfo.hp",
+ * and its result only depends on values at these paths. When DataStore::trackChanges is set, DataStore records when
+ * each variable changes in SetInput and write back; a subruleset is skipped if no variable it reads changed since
+ * it was executed last time, or if values at its paths of changed variables are still the same as then. Skipped
+ * subruleset does not write back, so its outputs and caches keep what it wrote last time, and hit rule is the same.
+ *
+ * This is only right if nothing else writes these outputs and caches, so a subruleset is always executed if it
+ * calls "rand", "print" or functions through variables, or shares any output or cache it may write with another
+ * subruleset. Outputs accessed are written back even if not assigned, so they are treated as written.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Find variables in typed storage.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Tell if variables written are all collected.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <any>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "backend/cq/cqresolver.hpp"
+#include "backend/cq/cqresourcehandler.h"
+#include "tools/anyprocess.hpp"
+
+namespace rulejit::cq {
+
+/**
+ * @brief statistics of incremental mode of one subruleset
+ *
+ */
+struct IncrementalStatistics {
+    /// @brief ticks executed in incremental mode
+    size_t executed = 0;
+    /// @brief ticks skipped since inputs did not change
+    size_t skipped = 0;
+    /// @brief subruleset is never skipped, calls functions like "rand" or shares written variables
+    bool alwaysDirty = false;
+};
+
+/**
+ * @brief collect member-access paths read, and variables may be written by a subruleset, including functions
+ * called by it
+ *
+ */
+struct AccessAnalyzer : public ASTVisitor {
+    /// @brief path as {variable, member, member...}
+    using Path = std::vector<std::string>;
+
+    /**
+     * @brief Constructor
+     *
+     * @param global context with function defines
+     * @param metaInfo meta info of DataStore, only its variables are collected
+     */
+    AccessAnalyzer(const ContextGlobal &global, const ruleset::RuleSetMetaInfo &metaInfo)
+        : reads(), writes(), deterministic(true), complete(true), global(global), metaInfo(metaInfo), analyzed() {}
+
+    /**
+     * @brief pipe operator| to analyze subruleset
+     *
+     * @param ast resolved subruleset
+     * @param analyzer receiver
+     */
+    void friend operator|(std::unique_ptr<ExprAST> &ast, AccessAnalyzer &analyzer) {
+        if (ast) {
+            ast->accept(&analyzer);
+        }
+    }
+
+    /// @brief paths read, a path covers all paths it is prefix of
+    std::set<Path> reads;
+    /// @brief variables assigned, or passed to functions which may change them
+    std::set<std::string> writes;
+    /// @brief result only depends on variables read
+    bool deterministic;
+    /// @brief all variables may be written are collected, which is not known through closures and unknown functions
+    bool complete;
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) { read({v.name}); }
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        if (auto path = pathOf(&v); path) {
+            return read(std::move(*path));
+        }
+        v.baseVar->accept(this);
+        v.memberToken->accept(this);
+    }
+    VISIT_FUNCTION(LiteralExprAST) {}
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        switch (CQResolver::resolveCall(v)) {
+        case CallCode::PRINT:
+        case CallCode::RAND:
+            deterministic = false;
+            break;
+        case CallCode::INDIRECT:
+            deterministic = complete = false;
+            break;
+        case CallCode::USER: {
+            auto name = static_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+            auto func = global.realFuncDefinition.find(name);
+            if (func == global.realFuncDefinition.end()) {
+                // extern function not known by interpreter
+                deterministic = complete = false;
+                break;
+            }
+            if (analyzed.insert(name).second) {
+                func->second->returnValue->accept(this);
+            }
+            [[fallthrough]];
+        }
+        case CallCode::PUSH:
+        case CallCode::RESIZE:
+            // params are passed by reference
+            for (auto &arg : v.params) {
+                write(arg.get());
+            }
+            break;
+        default:
+            break;
+        }
+        for (auto &arg : v.params) {
+            arg->accept(this);
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        if (v.op == "=") {
+            write(v.lhs.get());
+            // target itself is not read, but indexes in it are
+            if (!pathOf(v.lhs.get())) {
+                v.lhs->accept(this);
+            }
+            v.rhs->accept(this);
+            return;
+        }
+        v.lhs->accept(this);
+        v.rhs->accept(this);
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) { v.rhs->accept(this); }
+    VISIT_FUNCTION(BranchExprAST) {
+        v.condition->accept(this);
+        v.trueExpr->accept(this);
+        v.falseExpr->accept(this);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        for (auto &[index, value] : v.members) {
+            if (index) {
+                index->accept(this);
+            }
+            value->accept(this);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        v.init->accept(this);
+        v.condition->accept(this);
+        v.body->accept(this);
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        for (auto &stmt : v.exprs) {
+            stmt->accept(this);
+        }
+    }
+    VISIT_FUNCTION(ControlFlowAST) {
+        if (v.value) {
+            v.value->accept(this);
+        }
+    }
+    VISIT_FUNCTION(TypeDefAST) {}
+    VISIT_FUNCTION(VarDefAST) { v.definedValue->accept(this); }
+    VISIT_FUNCTION(FunctionDefAST) {}
+    VISIT_FUNCTION(SymbolDefAST) {}
+    VISIT_FUNCTION(TemplateDefAST) {}
+    VISIT_FUNCTION(ClosureExprAST) { deterministic = complete = false; }
+
+  private:
+    /**
+     * @brief get path of variable or its struct member
+     *
+     * @param expr expression
+     * @return std::optional<Path> nullopt if expr is not a path, like array element
+     */
+    static std::optional<Path> pathOf(ExprAST *expr) {
+        if (auto p = dynamic_cast<IdentifierExprAST *>(expr); p) {
+            return Path{p->name};
+        }
+        if (auto p = dynamic_cast<MemberAccessExprAST *>(expr); p) {
+            auto token = dynamic_cast<LiteralExprAST *>(p->memberToken.get());
+            if (!token || *(token->type) != StringType) {
+                return std::nullopt;
+            }
+            auto base = pathOf(p->baseVar.get());
+            if (base) {
+                base->push_back(token->value);
+            }
+            return base;
+        }
+        return std::nullopt;
+    }
+
+    bool isVariable(const std::string &name) const { return metaInfo.varType.contains(name); }
+
+    void read(Path path) {
+        // locals shadowing variables are collected too, which only makes subruleset executed more often
+        if (isVariable(path.front())) {
+            reads.insert(std::move(path));
+        }
+    }
+
+    void write(ExprAST *expr) {
+        while (auto p = dynamic_cast<MemberAccessExprAST *>(expr)) {
+            expr = p->baseVar.get();
+        }
+        if (auto p = dynamic_cast<IdentifierExprAST *>(expr); p && isVariable(p->name)) {
+            writes.insert(p->name);
+        }
+    }
+
+    const ContextGlobal &global;
+    const ruleset::RuleSetMetaInfo &metaInfo;
+    /// @brief real functions analyzed, each is analyzed once
+    std::set<std::string> analyzed;
+};
+
+/**
+ * @brief decide if a subruleset can be skipped in incremental mode
+ *
+ */
+struct IncrementalState {
+    IncrementalState() : reads(), writes(), deterministic(true), valid(false), lastRun(0), snapshot(), statistics() {}
+
+    /**
+     * @brief set variables accessed by subruleset
+     *
+     * @param analyzer analyzer which visited the subruleset
+     * @param data data store
+     */
+    void setAccess(const AccessAnalyzer &analyzer, const DataStore &data) {
+        reads.clear();
+        for (auto &path : analyzer.reads) {
+            reads[path.front()].push_back(path);
+        }
+        writes = analyzer.writes;
+        // accessed outputs are written back even if not assigned
+        for (auto &var : data.metaInfo.outputVar) {
+            if (reads.contains(var)) {
+                writes.insert(var);
+            }
+        }
+        std::erase_if(writes, [&](auto &var) {
+            // inputs are never written back
+            return std::ranges::find(data.metaInfo.inputVar, var) != data.metaInfo.inputVar.end();
+        });
+        deterministic = analyzer.deterministic;
+        statistics.alwaysDirty = !deterministic;
+        invalidate();
+    }
+
+    /**
+     * @brief get outputs and caches may be written by subruleset
+     *
+     * @return const std::set<std::string>&
+     */
+    const std::set<std::string> &getWrites() const { return writes; }
+
+    /**
+     * @brief never skip subruleset, used when it shares written variables with another one
+     *
+     */
+    void setAlwaysDirty() { statistics.alwaysDirty = true; }
+
+    /**
+     * @brief forget last execution, so subruleset is executed in next tick
+     *
+     */
+    void invalidate() { valid = false; }
+
+    /**
+     * @brief check if executing subruleset now gives the same result as last execution
+     *
+     * @param data data store, whose trackChanges is set since last execution
+     * @return bool
+     */
+    bool isClean(const DataStore &data) const {
+        if (!valid || statistics.alwaysDirty) {
+            return false;
+        }
+        size_t i = 0;
+        for (auto &[var, paths] : reads) {
+            if (data.lastChanged(var) <= lastRun) {
+                i += paths.size();
+                continue;
+            }
+            // variable changed, but maybe not the members read
+            for (auto &path : paths) {
+                if (path.size() == 1) {
+                    // SetInput and write back only record variables whose value changed
+                    return false;
+                }
+                std::any scratch;
+                auto now = find(data, path, scratch);
+                auto &before = snapshot[i++];
+                if (!now ? before.has_value() : !before.has_value() || !tools::myany::anyEqual(*now, before)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief record values read by a successful execution, call before write back
+     *
+     * @param data data store
+     */
+    void executed(const DataStore &data) {
+        snapshot.clear();
+        for (auto &[var, paths] : reads) {
+            for (auto &path : paths) {
+                // whole variables are not copied, see isClean
+                std::any scratch;
+                auto now = path.size() == 1 ? nullptr : find(data, path, scratch);
+                snapshot.push_back(now ? *now : std::any());
+            }
+        }
+        lastRun = data.changeClock;
+        valid = true;
+        statistics.executed++;
+    }
+
+    /**
+     * @brief record a skipped tick
+     *
+     */
+    void skipped() { statistics.skipped++; }
+
+    /**
+     * @brief get statistics
+     *
+     * @return const IncrementalStatistics&
+     */
+    const IncrementalStatistics &getStatistics() const { return statistics; }
+
+  private:
+    /**
+     * @brief find value at path in data store, in the same order as ResourceHandler::readIn
+     *
+     * @param scratch holds the variable if it is unpacked from typed storage
+     * @return const std::any* nullptr if not found
+     */
+    static const std::any *find(const DataStore &data, const AccessAnalyzer::Path &path, std::any &scratch) {
+        auto ret = data.find(path.front(), scratch);
+        for (size_t i = 1; ret && i < path.size(); i++) {
+            auto p = std::any_cast<DataStore::CSValueMap>(ret);
+            if (!p) {
+                return nullptr;
+            }
+            auto it = p->find(path[i]);
+            ret = it == p->end() ? nullptr : &it->second;
+        }
+        return ret;
+    }
+
+    /// @brief variable -> paths read in it
+    std::map<std::string, std::vector<AccessAnalyzer::Path>> reads;
+    /// @brief outputs and caches may be written
+    std::set<std::string> writes;
+    bool deterministic;
+    /// @brief executed successfully since invalidated
+    bool valid;
+    /// @brief DataStore::changeClock of last execution
+    size_t lastRun;
+    /// @brief values of paths in reads of last execution, in the same order
+    std::vector<std::any> snapshot;
+    IncrementalStatistics statistics;
+};
+
+} // namespace rulejit::cq
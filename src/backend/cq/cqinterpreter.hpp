@@ -11,23 +11,37 @@
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
  * <tr><td>djw</td><td>2023-03-29</td><td>Add semantic support.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Dispatch operators and build-in functions by resolved op code.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Read literals from constant pool.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Slot-indexed local variables.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Inline-cached user function calls and reused frame stack.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Hold numerical local variables by value.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record operands of shortcut logical operators when profiling.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Random engine per thread.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record error context while unwinding instead of on each visit.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Access struct members through index resolved at load time.</td></tr>
  * </table>
  */
 
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
 #include <format>
 #include <functional>
 #include <iostream>
 #include <random>
+#include <thread>
+#include <unordered_map>
 
 #include "ast/ast.hpp"
 #include "ast/astvisitor.hpp"
 #include "ast/context.hpp"
 #include "ast/decompiler.hpp"
 #include "ast/type.hpp"
+#include "backend/cq/cqresolver.hpp"
 #include "backend/cq/cqresourcehandler.h"
 #include "defines/marco.hpp"
 #include "tools/seterror.hpp"
@@ -46,9 +60,10 @@ int main();
 namespace rulejit::cq {
 
 inline double myrand() {
-    static auto seed = std::chrono::system_clock::now().time_since_epoch().count();
-    static std::default_random_engine e(seed);
-    static std::uniform_real_distribution<double> u(0, 1.);
+    // subrulesets may run on different threads, see TickThreadPool
+    static thread_local std::default_random_engine e(std::chrono::system_clock::now().time_since_epoch().count() ^
+                                                     std::hash<std::thread::id>()(std::this_thread::get_id()));
+    static thread_local std::uniform_real_distribution<double> u(0, 1.);
     return u(e);
 }
 
@@ -95,6 +110,22 @@ inline double normCDFInv(double x) {
     return fmaf(-1.41421356f, erfcinv(float(x + x)), 0.0f);
 }
 
+/// @brief build in function with 1 param, indexed by CallCode - CallCode::SIN
+inline constexpr std::array<double (*)(double), size_t(CallCode::POW) - size_t(CallCode::SIN)> buildInOneParamFunc{
+    [](double x) { return sin(x); },   [](double x) { return cos(x); },   [](double x) { return tan(x); },
+    [](double x) { return 1.0 / tan(x); }, [](double x) { return atan(x); }, [](double x) { return asin(x); },
+    [](double x) { return acos(x); },  [](double x) { return fabs(x); },  [](double x) { return exp(x); },
+    [](double x) { return fabs(x); },  [](double x) { return floor(x); }, [](double x) { return sqrt(x); },
+    [](double x) { return normCDFInv(x); },
+};
+
+/// @brief build in function with 2 param, indexed by CallCode - CallCode::POW
+inline constexpr std::array<double (*)(double, double), size_t(CallCode::INDIRECT) - size_t(CallCode::POW)>
+    buildInTwoParamFunc{
+        [](double x, double y) { return pow(x, y); },
+        [](double x, double y) { return atan2(x, y); },
+    };
+
 /**
  * @brief main class to interprete ast in cq environment
  *
@@ -109,15 +140,22 @@ struct CQInterpreter : public ASTVisitor {
      * then set handler to h
      *
      * @param h ResourceHandler which handles variable for this object
+     * @param pool constant pool of resolved literals, handler should have pinned its strings
      */
-    CQInterpreter(ContextStack& c, ResourceHandler& h) : context(c), symbolStack({{{}}}), handler(h) {}
+    CQInterpreter(ContextStack& c, ResourceHandler& h, const ConstantPool* pool = nullptr)
+        : handler(h), context(c), constantPool(pool), symbolStack({{{}}}), slots(64), frameBase(0), frameTop(0),
+          visited(0), profiling(false), shortCutProfile() {}
 
     /**
-     * @brief reset the interpreter(reset symbolStack, specifically)
+     * @brief reset the interpreter(reset symbolStack and slots, specifically)
      * @attention will not remove the function definitions
      *
      */
-    void reset() { symbolStack = {{{}}}; }
+    void reset() {
+        symbolStack = {{{}}};
+        frameBase = 0;
+        frameTop = 0;
+    }
 
     /**
      * @brief pipe operator| to interprete ast
@@ -130,11 +168,29 @@ struct CQInterpreter : public ASTVisitor {
         interpreter.ruleCnt = 1;
 #endif
         interpreter.currentExpr.clear();
-        interpreter.callAccept(expr);
+        // resolved top-level expression always starts with an empty frame
+        interpreter.frameBase = 0;
+        interpreter.frameTop = 0;
+        try {
+            interpreter.callAccept(expr);
+        } catch (...) {
+            // callAccept pushes context while unwinding, which is innermost first
+            std::reverse(interpreter.currentExpr.begin(), interpreter.currentExpr.end());
+            throw;
+        }
     }
 
   protected:
     VISIT_FUNCTION(IdentifierExprAST) {
+        if (v.resolved == CQResolver::externalVar) {
+            returned.token = handler.readIn(v.name);
+            returned.type = Value::TOKEN;
+            return;
+        }
+        if (v.resolved != ExprAST::unresolved) {
+            returned = slots[frameBase + v.resolved];
+            return;
+        }
         auto find = seekValue(v.name);
         if (!find) {
             // !find means its a variable hold by CQResourceHandler, so read it
@@ -150,7 +206,9 @@ struct CQInterpreter : public ASTVisitor {
         }
         if (*(v.memberToken->type) == StringType) {
             returned.token =
-                handler.memberAccess(base.token, dynamic_cast<LiteralExprAST*>(v.memberToken.get())->value);
+                v.resolved != ExprAST::unresolved
+                    ? handler.memberAccess(base.token, v.resolved)
+                    : handler.memberAccess(base.token, dynamic_cast<LiteralExprAST*>(v.memberToken.get())->value);
         } else if (*(v.memberToken->type) == RealType) {
             callAccept(v.memberToken);
             getReturnedValue();
@@ -163,12 +221,13 @@ struct CQInterpreter : public ASTVisitor {
         returned.type = Value::TOKEN;
     }
     VISIT_FUNCTION(LiteralExprAST) {
+        // resolved literal refers to constantPool, whose strings are pinned by handler
         if (*(v.type) == RealType) {
-            returned.value = std::stod(v.value);
+            returned.value = v.resolved == ExprAST::unresolved ? std::stod(v.value) : constantPool->numbers[v.resolved];
             returned.type = Value::VALUE;
         } else if (*(v.type) == StringType) {
             // TODO: check
-            returned.token = handler.takeString(v.value);
+            returned.token = v.resolved == ExprAST::unresolved ? handler.takeString(v.value) : v.resolved;
             returned.type = Value::TOKEN;
         } else if (v.type->isFunctionType()) {
             returned.token = handler.takeString(v.value);
@@ -178,33 +237,12 @@ struct CQInterpreter : public ASTVisitor {
         }
     }
     VISIT_FUNCTION(FunctionCallExprAST) {
-        // build in function with 1 param
-        static std::map<std::string, std::function<double()>> noParamFunc{
-            {"rand", myrand},
-        };
-        static std::map<std::string, std::function<double(double)>> oneParamFunc{
-            {"sin", [](double x) {return sin(x); }},     {"cos", [](double x) {return cos(x); }},
-            {"tan", [](double x) {return tan(x); }},     {"cot", [](double x) {return 1.0/tan(x); }},
-            {"atan", [](double x) {return atan(x); }},   {"asin", [](double x) {return asin(x); }},
-            {"acos", [](double x) {return acos(x); }},   {"fabs", [](double x) {return fabs(x); }},
-            {"exp", [](double x) {return exp(x); }},     {"abs", [](double x) {return fabs(x); }},
-            {"floor", [](double x) {return floor(x); }}, {"sqrt", [](double x) {return sqrt(x); }},
-            {"normCDFInv", normCDFInv},
-        };
-        // build in function with 2 param
-        static std::map<std::string, std::function<double(double, double)>> twoParamFunc{
-            {"pow", [](double x, double y) { return pow(x, y); }},
-            {"atan2", [](double x, double y) { return atan2(x, y); }},
-        };
-        // should provide all function defined in initprocess in frontend/ruleset/rulesetparser.cpp
-        std::string funcName;
-        if (isType<LiteralExprAST>(v.functionIdent.get())) {
-            auto p = dynamic_cast<LiteralExprAST*>(v.functionIdent.get());
-            funcName = p->value;
-        } else {
-            return setError("only allow direct function call, cannot call function through variable");
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveCall(v));
         }
-        if (funcName == "print") {
+        auto code = static_cast<CallCode>(v.resolved);
+        switch (code) {
+        case CallCode::PRINT:
             setErrorWhenFailed(v.params.size() == 1, "\"print\" only accept 1 param");
             callAccept(v.params[0]);
             if (returned.type == Value::TOKEN) {
@@ -217,13 +255,15 @@ struct CQInterpreter : public ASTVisitor {
                 std::cout << returned.value << std::endl;
             }
             returned.type = Value::EMPTY;
-        } else if (funcName == "length") {
+            break;
+        case CallCode::LENGTH:
             setErrorWhenFailed(v.params.size() == 1, "\"length\" only accept 1 param");
             callAccept(v.params[0]);
             setErrorWhenFailed(returned.type == Value::TOKEN, "expect array as receiver of \"length\"");
             returned.type = Value::VALUE;
             returned.value = static_cast<double>(handler.arrayLength(returned.token));
-        } else if (funcName == "push") {
+            break;
+        case CallCode::PUSH: {
             setErrorWhenFailed(v.params.size() == 2, "\"push\" only accept 2 param");
             callAccept(v.params[0]);
             auto arg1 = returned;
@@ -237,7 +277,9 @@ struct CQInterpreter : public ASTVisitor {
             } else {
                 setError("arg2 of \"push\" has no return");
             }
-        } else if (funcName == "resize") {
+            break;
+        }
+        case CallCode::RESIZE: {
             setErrorWhenFailed(v.params.size() == 2, "\"resize\" only accept 2 param");
             callAccept(v.params[0]);
             auto arg1 = returned;
@@ -247,9 +289,10 @@ struct CQInterpreter : public ASTVisitor {
             setErrorWhenFailed(arg1.type == Value::TOKEN, "expect array as receiver of \"resize\"");
             setErrorWhenFailed(arg2 == (double)floor(arg2), "array index out of range (should can be cast to int)");
             handler.arrayResize(arg1.token, static_cast<size_t>(arg2));
-        } else if (funcName == "strEqual") {
+            break;
+        }
+        case CallCode::STR_EQUAL: {
             callAccept(v.params[0]);
-            returned.type == Value::TOKEN&& handler.isString(returned.token);
             auto tmp = returned.token;
             callAccept(v.params[1]);
             if (returned.type != Value::TOKEN || !handler.isString(returned.token)) {
@@ -257,31 +300,59 @@ struct CQInterpreter : public ASTVisitor {
             }
             returned.type = Value::VALUE;
             returned.value = handler.stringComp(tmp, returned.token);
-        } else if (auto it = noParamFunc.find(funcName); it != noParamFunc.end()) {
-            setErrorWhenFailed(v.params.size() == 0, std::format("\"{}\" only accept 0 param", funcName));
-            returned.value = it->second();
+            break;
+        }
+        case CallCode::RAND:
+            setErrorWhenFailed(v.params.size() == 0, "\"rand\" only accept 0 param");
+            returned.value = myrand();
             returned.type = Value::VALUE;
-        } else if (auto it = oneParamFunc.find(funcName); it != oneParamFunc.end()) {
-            setErrorWhenFailed(v.params.size() == 1, std::format("\"{}\" only accept 1 param", funcName));
+            break;
+        case CallCode::SIN:
+        case CallCode::COS:
+        case CallCode::TAN:
+        case CallCode::COT:
+        case CallCode::ATAN:
+        case CallCode::ASIN:
+        case CallCode::ACOS:
+        case CallCode::FABS:
+        case CallCode::EXP:
+        case CallCode::ABS:
+        case CallCode::FLOOR:
+        case CallCode::SQRT:
+        case CallCode::NORM_CDF_INV:
+            setErrorWhenFailed(v.params.size() == 1, std::format("\"{}\" only accept 1 param", funcName(v)));
             callAccept(v.params[0]);
             getReturnedValue();
-            returned.value = it->second(returned.value);
+            returned.value = buildInOneParamFunc[v.resolved - size_t(CallCode::SIN)](returned.value);
             returned.type = Value::VALUE;
-        } else if (auto it = twoParamFunc.find(funcName); it != twoParamFunc.end()) {
-            setErrorWhenFailed(v.params.size() == 2, std::format("\"{}\" only accept 2 param", funcName));
+            break;
+        case CallCode::POW:
+        case CallCode::ATAN2: {
+            setErrorWhenFailed(v.params.size() == 2, std::format("\"{}\" only accept 2 param", funcName(v)));
             callAccept(v.params[0]);
             getReturnedValue();
             double tmp = returned.value;
             callAccept(v.params[1]);
             getReturnedValue();
-            returned.value = it->second(tmp, returned.value);
+            returned.value = buildInTwoParamFunc[v.resolved - size_t(CallCode::POW)](tmp, returned.value);
             returned.type = Value::VALUE;
-        } else {
-            auto f = context.global.realFuncDefinition.find(funcName);
+            break;
+        }
+        case CallCode::USER: {
+            if (v.callee && v.callee->resolved != ExprAST::unresolved) {
+                callSlotted(v, *(v.callee), v.byValueParams);
+                break;
+            }
+            auto f = context.global.realFuncDefinition.find(funcName(v));
             if (f == context.global.realFuncDefinition.end()) {
-                setError(std::format("function \"{}\" not found", funcName));
+                setError(std::format("function \"{}\" not found", funcName(v)));
             }
             auto& callee = f->second;
+            if (callee->resolved != ExprAST::unresolved && callee->params.size() <= 64) {
+                // call site not filled by CQResolver, ast is not written as it may be shared by threads
+                callSlotted(v, *callee, CQResolver::byValueParams(*callee));
+                break;
+            }
             std::vector<std::map<std::string, rulejit::cq::CQInterpreter::Value>> frame{{}};
             for (size_t i = 0; i < callee->params.size(); i++) {
                 auto& param = callee->params[i];
@@ -296,125 +367,84 @@ struct CQInterpreter : public ASTVisitor {
             returned.type = Value::EMPTY;
             callAccept(callee->returnValue);
             symbolStack.pop_back();
+            break;
+        }
+        default:
+            setError("only allow direct function call, cannot call function through variable");
         }
     }
     VISIT_FUNCTION(BinOpExprAST) {
-        static std::map<std::string, std::function<double(double, double)>> normalBinOp{
-            {"+", [](auto x, auto y) { return x + y; }},
-            {"-", [](auto x, auto y) { return x - y; }},
-            {"*", [](auto x, auto y) { return x * y; }},
-            {"/", [](auto x, auto y) { return x / y; }},
-            {">", [](auto x, auto y) { return x > y; }},
-            {"<", [](auto x, auto y) { return x < y; }},
-            {"==", [](auto x, auto y) { return x == y; }},
-            {"!=", [](auto x, auto y) { return x != y; }},
-            {">=", [](auto x, auto y) { return x >= y; }},
-            {"<=", [](auto x, auto y) { return x <= y; }},
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveBinOp(v.op));
+        }
+        auto code = static_cast<BinOpCode>(v.resolved);
+        switch (code) {
+        case BinOpCode::ASSIGN:
+            return assign(v);
+        case BinOpCode::AND:
+        case BinOpCode::OR:
+            return shortCut(v, code == BinOpCode::AND);
+        case BinOpCode::UNKNOWN:
+            return setError(std::format("bin op \"{}\" not support for now", v.op));
+        default:
+            break;
+        }
+        callAccept(v.lhs);
+        getReturnedValue();
+        auto x = returned.value;
+        callAccept(v.rhs);
+        getReturnedValue();
+        auto y = returned.value;
+        switch (code) {
+        case BinOpCode::ADD:
+            returned.value = x + y;
+            break;
+        case BinOpCode::SUB:
+            returned.value = x - y;
+            break;
+        case BinOpCode::MUL:
+            returned.value = x * y;
+            break;
+        case BinOpCode::DIV:
+            returned.value = x / y;
+            break;
+        case BinOpCode::MOD:
             // TODO: not make sense
-            {"%", [](auto x, auto y) { return static_cast<int64_t>(x) % static_cast<int64_t>(y); }},
-        };
-        static std::map<std::string, std::function<double(double, double)>> shortCutBinOp{
-            {"&&", [](auto x, auto y) { return x && y; }},
-            {"and", [](auto x, auto y) { return x && y; }},
-            {"||", [](auto x, auto y) { return x || y; }},
-            {"or", [](auto x, auto y) { return x || y; }},
-        };
-        if (v.op == "=") {
-            if (isType<IdentifierExprAST>(v.lhs.get())) {
-                callAccept(v.rhs);
-                auto rhs = returned;
-                auto p = dynamic_cast<IdentifierExprAST*>(v.lhs.get());
-                callAccept(v.lhs);
-                auto lhs = returned;
-                if (lhs.type == Value::TOKEN) {
-                    if (rhs.type == Value::TOKEN) {
-                        handler.assign(lhs.token, rhs.token);
-                    } else {
-                        handler.writeValue(lhs.token, rhs.value);
-                    }
-                } else {
-                    // lhs is defined in program and stored in symbol stack
-                    returned = rhs;
-                    getReturnedValue();
-                    for (auto it = symbolStack.back().rbegin(); it != symbolStack.back().rend(); it++) {
-                        if (auto varIt = it->find(p->name); varIt != it->end()) {
-                            varIt->second = returned;
-                            returned.type = Value::EMPTY;
-                            return;
-                        }
-                    }
-                }
-            } else if (isType<MemberAccessExprAST>(v.lhs.get())) {
-                callAccept(v.lhs);
-                auto lhs = returned;
-                callAccept(v.rhs);
-                auto rhs = returned;
-                if (returned.type == Value::VALUE) {
-                    handler.writeValue(lhs.token, rhs.value);
-                } else {
-                    handler.assign(lhs.token, rhs.token);
-                }
-                returned.type = Value::EMPTY;
-            } else {
-                setError("only allow direct or member variable assignment for now");
-            }
-            returned.type = Value::EMPTY;
-        } else if (auto it = normalBinOp.find(v.op); it != normalBinOp.end()) {
-            callAccept(v.lhs);
-            getReturnedValue();
-            auto tmp = returned.value;
-            callAccept(v.rhs);
-            getReturnedValue();
-            returned.value = it->second(tmp, returned.value);
-        } else if (auto it = shortCutBinOp.find(v.op); it != shortCutBinOp.end()) {
-            callAccept(v.lhs);
-            getReturnedValue();
-            auto tmp = returned.value;
-#ifdef __RULEJIT_INTERPRETER_DEBUG
-            bool rhsEvaluate = false;
-            double tmp1;
-#endif
-            if (it->second(tmp, 0) != it->second(tmp, 1)) {
-                callAccept(v.rhs);
-                getReturnedValue();
-#ifdef __RULEJIT_INTERPRETER_DEBUG
-                rhsEvaluate = true;
-                tmp1 = returned.value;
-#endif
-                returned.value = it->second(tmp, returned.value);
-            }
-            returned.type = Value::VALUE;
-#ifdef __RULEJIT_INTERPRETER_DEBUG
-            if (rhsEvaluate) {
-                std::cout << std::format("Evaluate: {0} {1} {2} =>\n"
-                                         "          {3} {1} {4} =>\n"
-                                         "          {5}",
-                                         v.lhs | Decompiler(), v.op, v.rhs | Decompiler(), tmp, tmp1, returned.value)
-                          << std::endl;
-            } else {
-                std::cout << std::format("Evaluate: {0} {1} {2} =>\n"
-                                         "          {3} {1} [Shortcutted] =>\n"
-                                         "          {4}",
-                                         v.lhs | Decompiler(), v.op, v.rhs | Decompiler(), tmp, returned.value)
-                          << std::endl;
-            }
-#endif
-        } else {
-            setError(std::format("bin op \"{}\" not support for now", v.op));
+            returned.value = static_cast<double>(static_cast<int64_t>(x) % static_cast<int64_t>(y));
+            break;
+        case BinOpCode::GT:
+            returned.value = x > y;
+            break;
+        case BinOpCode::LT:
+            returned.value = x < y;
+            break;
+        case BinOpCode::EQ:
+            returned.value = x == y;
+            break;
+        case BinOpCode::NE:
+            returned.value = x != y;
+            break;
+        case BinOpCode::GE:
+            returned.value = x >= y;
+            break;
+        case BinOpCode::LE:
+            returned.value = x <= y;
+            break;
+        default:
+            my_assert(false, "unreachable");
         }
     }
     VISIT_FUNCTION(UnaryOpExprAST) {
-        static std::map<std::string, std::function<double(double)>> unaryFunc{
-            {"-", [](double x) { return -x; }},
-            {"not", [](double x) { return !x; }},
-            {"!", [](double x) { return !x; }},
-        };
-        if (!unaryFunc.contains(v.op)) {
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(CQResolver::resolveUnaryOp(v.op));
+        }
+        auto code = static_cast<UnaryOpCode>(v.resolved);
+        if (code == UnaryOpCode::UNKNOWN) {
             setError(std::format("unary op \"{}\" not support for now", v.op));
         }
         callAccept(v.rhs);
         getReturnedValue();
-        returned.value = unaryFunc[v.op](returned.value);
+        returned.value = code == UnaryOpCode::NEG ? -returned.value : double(!returned.value);
     }
     VISIT_FUNCTION(BranchExprAST) {
 #ifdef __RULEJIT_INTERPRETER_DEBUG
@@ -478,61 +508,128 @@ struct CQInterpreter : public ASTVisitor {
     }
     VISIT_FUNCTION(LoopAST) {
         returned.type = Value::EMPTY;
-        symbolStack.back().emplace_back();
+        bool named = v.resolved == ExprAST::unresolved;
+        if (named) {
+            symbolStack.back().emplace_back();
+        }
         callAccept(v.init);
         while (callAccept(v.condition), getReturnedValue(), returned.value != 0) {
             callAccept(v.body);
         }
-        symbolStack.back().pop_back();
+        if (named) {
+            symbolStack.back().pop_back();
+        }
     }
     VISIT_FUNCTION(BlockExprAST) {
         returned.type = Value::EMPTY;
-        symbolStack.back().emplace_back();
+        bool named = v.resolved == ExprAST::unresolved;
+        if (named) {
+            symbolStack.back().emplace_back();
+        }
         for (auto it = v.exprs.begin(); it != v.exprs.end();) {
             callAccept((*it));
             it++;
         }
-        symbolStack.back().pop_back();
+        if (named) {
+            symbolStack.back().pop_back();
+        }
     }
     VISIT_FUNCTION(ControlFlowAST) { setError("ControlFlowAST should never be visit directly"); }
     VISIT_FUNCTION(TypeDefAST) { setError("TypeDefAST should never be visit directly"); }
     VISIT_FUNCTION(VarDefAST) {
         returned.type = Value::EMPTY;
-        if (auto it = symbolStack.back().back().find(v.name); it != symbolStack.back().back().end()) {
+        bool named = v.resolved == ExprAST::unresolved;
+        if (named) {
+            if (auto it = symbolStack.back().back().find(v.name); it != symbolStack.back().back().end()) {
+                setError("redefine variable: " + v.name);
+            }
+        } else if (v.resolved == CQResolver::redefinedVar) {
             setError("redefine variable: " + v.name);
         }
         callAccept(v.definedValue);
-        if (returned.type == Value::TOKEN) {
+        if (returned.type == Value::TOKEN && isNumericalType(*(v.valueType))) {
+            // numerical variable is held by value, no instance needed
+            getReturnedValue();
+        } else if (returned.type == Value::TOKEN) {
             auto tmp = handler.makeInstanceAs(returned.token);
             handler.assign(tmp, returned.token);
             returned.token = tmp;
-            symbolStack.back().back()[v.name] = returned;
-        } else if (returned.type == Value::VALUE) {
-            symbolStack.back().back()[v.name] = returned;
         } else if (returned.type == Value::EMPTY) {
             setError("def var to empty value");
-        } else {
+        } else if (returned.type != Value::VALUE) {
             setError("unsupported type");
         }
+        if (named) {
+            symbolStack.back().back()[v.name] = returned;
+        } else {
+            // frame of function is fully reserved at call, only top-level frame grows here
+            auto slot = frameBase + v.resolved;
+            if (slot >= frameTop) {
+                reserveFrame(slot + 1 - frameTop);
+            }
+            slots[slot] = returned;
+        }
         returned.type = Value::EMPTY;
     }
     VISIT_FUNCTION(FunctionDefAST) { setError("function def should never be visit directly"); }
     VISIT_FUNCTION(SymbolDefAST) { setError("symbol def should never be visit directly"); }
 
   public:
+    /// @brief context of last runtime error, from outermost to innermost expression
     std::vector<ExprAST*> currentExpr;
     double getReturned() {
         my_assert(returned.type == Value::VALUE);
         return returned.value;
     }
 
+    /**
+     * @brief statistics of one operand of shortcut logical operator
+     *
+     */
+    struct OperandStatistics {
+        /// @brief times evaluated
+        size_t evaluated = 0;
+        /// @brief times evaluated as non-zero
+        size_t truthy = 0;
+        /// @brief ast nodes visited by evaluations
+        size_t cost = 0;
+    };
+
+    /**
+     * @brief record operands of "&&"/"||" in following interpretations
+     *
+     * @param on false to stop recording, recorded statistics are kept
+     */
+    void setProfiling(bool on) { profiling = on; }
+
+    /**
+     * @brief get recorded statistics of operands of "&&"/"||"
+     *
+     * @param op logical operator
+     * @return const std::array<OperandStatistics, 2>* lhs and rhs, nullptr if never recorded
+     */
+    const std::array<OperandStatistics, 2>* getShortCutStatistics(const ExprAST* op) const {
+        auto it = shortCutProfile.find(op);
+        return it == shortCutProfile.end() ? nullptr : &(it->second);
+    }
+
   private:
+    /**
+     * @brief visit a node, record the node as error context when exception passes through,
+     * so nothing but unwinding pays for the context
+     *
+     * @param v node
+     */
     void callAccept(std::unique_ptr<ExprAST>& v) {
-        currentExpr.push_back(v.get());
-        if (v != nullptr) {
-            v->accept(this);
+        visited++;
+        try {
+            if (v != nullptr) {
+                v->accept(this);
+            }
+        } catch (...) {
+            currentExpr.push_back(v.get());
+            throw;
         }
-        currentExpr.pop_back();
     }
 
     /**
@@ -577,6 +674,180 @@ struct CQInterpreter : public ASTVisitor {
         return false;
     }
 
+    /**
+     * @brief get name of directly called function
+     *
+     * @param v function call expression whose functionIdent is LiteralExprAST
+     * @return const std::string& function name
+     */
+    const std::string& funcName(FunctionCallExprAST& v) {
+        return static_cast<LiteralExprAST*>(v.functionIdent.get())->value;
+    }
+
+    /**
+     * @brief take size slots above frameTop, slots only grows so frames are reused by following calls
+     *
+     * @param size slot count
+     * @return size_t start of taken slots
+     */
+    size_t reserveFrame(size_t size) {
+        auto base = frameTop;
+        frameTop += size;
+        if (frameTop > slots.size()) {
+            slots.resize(std::max(frameTop, slots.size() * 2));
+        }
+        return base;
+    }
+
+    /**
+     * @brief call user function whose variables are resolved to slots
+     *
+     * @param v call site
+     * @param callee called function, resolved by CQResolver
+     * @param byValueParams bit i is set if param i is passed by value
+     */
+    void callSlotted(FunctionCallExprAST& v, FunctionDefAST& callee, uint64_t byValueParams) {
+        auto count = callee.params.size();
+        // args are evaluated before the new frame is reserved, as top-level frame still grows when variables
+        // defined in them are reached, which would otherwise overlap params
+        std::array<Value, inlineArgs> inlineValues;
+        std::vector<Value> moreValues(count > inlineArgs ? count : 0);
+        auto values = count > inlineArgs ? moreValues.data() : inlineValues.data();
+        for (size_t i = 0; i < count; i++) {
+            callAccept(v.params[i]);
+            if (byValueParams >> i & 1) {
+                getReturnedValue();
+            }
+            values[i] = returned;
+        }
+        // callee.resolved is frame size, params take the first slots
+        auto base = reserveFrame(callee.resolved);
+        std::copy_n(values, count, slots.begin() + base);
+        auto callerBase = frameBase;
+        frameBase = base;
+        returned.type = Value::EMPTY;
+        callAccept(callee.returnValue);
+        frameBase = callerBase;
+        frameTop = base;
+    }
+
+    /**
+     * @brief interprete assignment "lhs = rhs"
+     *
+     * @param v assignment expression
+     */
+    void assign(BinOpExprAST& v) {
+        if (isType<IdentifierExprAST>(v.lhs.get())) {
+            callAccept(v.rhs);
+            auto rhs = returned;
+            auto p = dynamic_cast<IdentifierExprAST*>(v.lhs.get());
+            callAccept(v.lhs);
+            auto lhs = returned;
+            if (lhs.type == Value::TOKEN) {
+                if (rhs.type == Value::TOKEN) {
+                    handler.assign(lhs.token, rhs.token);
+                } else {
+                    handler.writeValue(lhs.token, rhs.value);
+                }
+            } else {
+                // lhs is defined in program and stored in slots or symbol stack
+                returned = rhs;
+                getReturnedValue();
+                if (p->resolved != ExprAST::unresolved) {
+                    slots[frameBase + p->resolved] = returned;
+                    returned.type = Value::EMPTY;
+                    return;
+                }
+                for (auto it = symbolStack.back().rbegin(); it != symbolStack.back().rend(); it++) {
+                    if (auto varIt = it->find(p->name); varIt != it->end()) {
+                        varIt->second = returned;
+                        returned.type = Value::EMPTY;
+                        return;
+                    }
+                }
+            }
+        } else if (isType<MemberAccessExprAST>(v.lhs.get())) {
+            callAccept(v.lhs);
+            auto lhs = returned;
+            callAccept(v.rhs);
+            auto rhs = returned;
+            if (returned.type == Value::VALUE) {
+                handler.writeValue(lhs.token, rhs.value);
+            } else {
+                handler.assign(lhs.token, rhs.token);
+            }
+            returned.type = Value::EMPTY;
+        } else {
+            setError("only allow direct or member variable assignment for now");
+        }
+        returned.type = Value::EMPTY;
+    }
+
+    /**
+     * @brief interprete shortcut logical operator, rhs only evaluated when lhs can not decide the result
+     * @attention if shortcutted, result is lhs itself rather than its bool value
+     *
+     * @param v logical expression
+     * @param isAnd true for "&&"/"and", false for "||"/"or"
+     */
+    void shortCut(BinOpExprAST& v, bool isAnd) {
+        auto start = visited;
+        callAccept(v.lhs);
+        getReturnedValue();
+        auto tmp = returned.value;
+        if (profiling) {
+            record(v, 0, tmp, start);
+        }
+#ifdef __RULEJIT_INTERPRETER_DEBUG
+        bool rhsEvaluate = false;
+        double tmp1;
+#endif
+        if ((tmp != 0) == isAnd) {
+            start = visited;
+            callAccept(v.rhs);
+            getReturnedValue();
+            if (profiling) {
+                record(v, 1, returned.value, start);
+            }
+#ifdef __RULEJIT_INTERPRETER_DEBUG
+            rhsEvaluate = true;
+            tmp1 = returned.value;
+#endif
+            returned.value = isAnd ? (tmp && returned.value) : (tmp || returned.value);
+        }
+        returned.type = Value::VALUE;
+#ifdef __RULEJIT_INTERPRETER_DEBUG
+        if (rhsEvaluate) {
+            std::cout << std::format("Evaluate: {0} {1} {2} =>\n"
+                                     "          {3} {1} {4} =>\n"
+                                     "          {5}",
+                                     v.lhs | Decompiler(), v.op, v.rhs | Decompiler(), tmp, tmp1, returned.value)
+                      << std::endl;
+        } else {
+            std::cout << std::format("Evaluate: {0} {1} {2} =>\n"
+                                     "          {3} {1} [Shortcutted] =>\n"
+                                     "          {4}",
+                                     v.lhs | Decompiler(), v.op, v.rhs | Decompiler(), tmp, returned.value)
+                      << std::endl;
+        }
+#endif
+    }
+
+    /**
+     * @brief record one evaluation of operand of "&&"/"||"
+     *
+     * @param v logical expression
+     * @param side 0 for lhs, 1 for rhs
+     * @param value value of operand
+     * @param start visited before evaluation
+     */
+    void record(BinOpExprAST& v, size_t side, double value, size_t start) {
+        auto& s = shortCutProfile[&v][side];
+        s.evaluated++;
+        s.truthy += value != 0;
+        s.cost += visited - start;
+    }
+
     /**
      * @brief check if given type is numerical type
      *
@@ -602,24 +873,70 @@ struct CQInterpreter : public ASTVisitor {
         }
     }
 
+    /// @brief args of a call held outside slots while evaluated, more ones are held in heap
+    static constexpr size_t inlineArgs = 8;
+
     /**
      * @brief context, includes function defines
      *
      */
     ContextStack& context;
 
+    /**
+     * @brief literals pre-parsed by CQResolver
+     *
+     */
+    const ConstantPool* constantPool;
+
     /**
      * @brief caller pop stack, stack frame is scope stack
      *
      */
     std::vector<std::vector<std::map<std::string, Value>>> symbolStack;
 
+    /**
+     * @brief local variables of resolved ast, each activation takes
+     * [frameBase, frameBase + frame size) of it
+     *
+     */
+    std::vector<Value> slots;
+
+    /**
+     * @brief start of current activation in slots
+     *
+     */
+    size_t frameBase;
+
+    /**
+     * @brief end of the last activation in slots, slots above are free
+     *
+     */
+    size_t frameTop;
+
     /**
      * @brief value passed through visit functions
      *
      */
     Value returned;
 
+    /**
+     * @brief count of ast nodes visited, used as cost of operands when profiling
+     *
+     */
+    size_t visited;
+
+    /**
+     * @brief record operands of "&&"/"||"
+     *
+     */
+    bool profiling;
+
+    /**
+     * @brief logical operator -> statistics of lhs and rhs
+     *
+     */
+    std::unordered_map<const ExprAST*, std::array<OperandStatistics, 2>> shortCutProfile;
+
     SET_ERROR_MEMBER("(Interpreter)Runtime", void)
 
 #ifdef __RULEJIT_INTERPRETER_DEBUG
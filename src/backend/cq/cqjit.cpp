@@ -0,0 +1,64 @@
+/**
+ * @file cqjit.cpp
+ * @author djw
+ * @brief CQ/Interpreter/JIT backend
+ * @date 2026-10-17
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include "cqjit.h"
+
+#include "backend/jit/jitengine.hpp"
+#include "ir/irgen.hpp"
+#include "ir/irholder.hpp"
+
+namespace rulejit::cq {
+
+struct JITProgram::Impl {
+    std::unique_ptr<jit::engine::ORCJIT> engine;
+};
+
+JITProgram::JITProgram() : impl() {}
+JITProgram::~JITProgram() = default;
+
+void CQJITEngine::compile(ContextStack &c, const ConstantPool &pool, std::unique_ptr<ExprAST> &expr,
+                          const std::string &name) {
+    entry = nullptr;
+    if (!jit.impl) {
+        auto created = jit::engine::ORCJIT::Create();
+        if (!created) {
+            reason = "create jit failed: " + llvm::toString(created.takeError());
+            return;
+        }
+        jit.impl = std::make_unique<JITProgram::Impl>(JITProgram::Impl{std::move(*created)});
+    }
+    auto &engine = *jit.impl->engine;
+    ir::IRHolder holder;
+    holder.module->setDataLayout(engine.getDataLayout());
+    ir::IRGenerator generator(holder, c, pool, program);
+    auto lowered = generator.generate(expr, name);
+    if (!lowered.has_value()) {
+        reason = generator.getReason();
+        return;
+    }
+    holder.optimize();
+    holder.builder.reset();
+    if (auto err = engine.addModule(
+            llvm::orc::ThreadSafeModule(std::move(holder.module), llvm::orc::ThreadSafeContext(std::move(holder.context))))) {
+        reason = "add module failed: " + llvm::toString(std::move(err));
+        return;
+    }
+    auto address = engine.lookupAddress(lowered->symbol);
+    if (!address) {
+        reason = "lookup failed: " + llvm::toString(address.takeError());
+        return;
+    }
+    segment.bind(lowered->externs, lowered->flags, program.flagBase);
+    entry = reinterpret_cast<Entry>(static_cast<uintptr_t>(*address));
+}
+
+} // namespace rulejit::cq
@@ -0,0 +1,154 @@
+/**
+ * @file cqjit.h
+ * @author djw
+ * @brief CQ/Interpreter/JIT backend
+ * @date 2026-10-17
+ *
+ * @details Includes CQJITEngine, which ticks one subruleset compiled into native code by ir::IRGenerator and ORC.
+ *
+ * Subruleset is lowered with the same data segment layout and semantics as CQByteCodeEngine, then optimized by the
+ * default O2 pipeline. Subrulesets which can not be lowered, and the ticks whose data can not be mapped or which fail
+ * at runtime, are left to CQInterpreter. LLVM is only included by cqjit.cpp.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/context.hpp"
+#include "backend/cq/cqbytecode.hpp"
+#include "backend/cq/cqresolver.hpp"
+#include "backend/cq/cqresourcehandler.h"
+
+namespace rulejit::cq {
+
+/**
+ * @brief native code shared by all subrulesets of a rule set engine
+ *
+ */
+struct JITProgram {
+    JITProgram();
+    ~JITProgram();
+    JITProgram(const JITProgram &) = delete;
+    JITProgram &operator=(const JITProgram &) = delete;
+
+    /// @brief ORC session, created when the first subruleset is compiled
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+/**
+ * @brief execute one subruleset compiled into native code
+ *
+ */
+struct CQJITEngine {
+    /**
+     * @brief Constructor
+     *
+     * @param data DataStore which variables are read from and written back to
+     * @param program layout of data segment shared by all subrulesets of rule set
+     * @param jit native code shared by all subrulesets of rule set
+     */
+    CQJITEngine(DataStore &data, ByteCodeProgram &program, JITProgram &jit)
+        : program(program), jit(jit), memory(), segment(data, memory), entry(nullptr), returned(0), executed(false),
+          reason() {}
+    CQJITEngine(const CQJITEngine &) = delete;
+    CQJITEngine &operator=(const CQJITEngine &) = delete;
+
+    /**
+     * @brief compile subruleset into native code, leave it not compiled if it can not be lowered
+     * @attention ByteCodeProgram::buildLayout must be called before
+     *
+     * @param c context, includes function defines
+     * @param pool constant pool of resolved literals
+     * @param expr resolved subruleset
+     * @param name unique name of subruleset
+     */
+    void compile(ContextStack &c, const ConstantPool &pool, std::unique_ptr<ExprAST> &expr, const std::string &name);
+
+    /**
+     * @brief check if subruleset is compiled into native code
+     *
+     * @return bool
+     */
+    bool isCompiled() const { return entry != nullptr; }
+
+    /**
+     * @brief get reason why subruleset is not compiled
+     *
+     * @return const std::string&
+     */
+    const std::string &getReason() const { return reason; }
+
+    /**
+     * @brief run native code of subruleset
+     *
+     * @return bool false if not compiled, data can not be mapped or failed at runtime;
+     * nothing is changed then and the tick should be executed by CQInterpreter
+     */
+    bool run() {
+        executed = false;
+        if (!entry || !segment.load()) {
+            return false;
+        }
+        uint8_t failed = 0;
+        auto ret = entry(segment.get(), &failed);
+        if (failed) {
+            return false;
+        }
+        returned = ret;
+        executed = true;
+        segment.commit();
+        return true;
+    }
+
+    /**
+     * @brief check if last run is executed by native code
+     *
+     * @return bool
+     */
+    bool isExecuted() const { return executed; }
+
+    /**
+     * @brief get value returned by last run
+     *
+     * @return double
+     */
+    double getReturned() const { return returned; }
+
+    /**
+     * @brief write accessed output and changed cache back to DataStore, same as ResourceHandler::writeBack
+     *
+     */
+    void writeBack() { segment.writeBack(); }
+
+  private:
+    /// @brief see ir::IRGenerator, double (i8 *segment, i8 *failed)
+    using Entry = double (*)(uint8_t *, uint8_t *);
+
+    ByteCodeProgram &program;
+    JITProgram &jit;
+    /// @brief data segment
+    std::vector<bytecode::MemUnit> memory;
+    /// @brief variables mapped onto memory
+    CQDataSegment segment;
+    /// @brief native code of subruleset, nullptr if not compiled
+    Entry entry;
+    /// @brief value returned by last run
+    double returned;
+    /// @brief last run is executed by native code
+    bool executed;
+    /// @brief reason why subruleset is not compiled
+    std::string reason;
+};
+
+} // namespace rulejit::cq
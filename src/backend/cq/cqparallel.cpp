@@ -0,0 +1,88 @@
+/**
+ * @file cqparallel.cpp
+ * @author djw
+ * @brief CQ/Interpreter/Parallel
+ * @date 2026-10-17
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include "cqparallel.h"
+
+#include <algorithm>
+
+namespace rulejit::cq {
+
+TickThreadPool &TickThreadPool::instance() {
+    static TickThreadPool pool;
+    return pool;
+}
+
+TickThreadPool::TickThreadPool() : mutex(), cv(), finished(), batches(), stop(false), workers() {
+    size_t hardware = std::max(std::thread::hardware_concurrency(), 1u);
+    for (size_t i = 1; i < hardware; i++) {
+        workers.emplace_back([this] { work(); });
+    }
+}
+
+TickThreadPool::~TickThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void TickThreadPool::run(size_t count, size_t width, const std::function<void(size_t)> &job) {
+    Batch batch{&job, count, 0, 0, width == 0 ? size() : width, 1};
+    std::unique_lock lock(mutex);
+    bool shared = batch.width > 1 && count > 1 && !workers.empty();
+    if (shared) {
+        batches.push_back(&batch);
+        cv.notify_all();
+    }
+    take(lock, batch);
+    if (shared) {
+        std::erase(batches, &batch);
+    }
+    // calls taken by workers may be running
+    finished.wait(lock, [&batch] { return batch.done == batch.count; });
+}
+
+void TickThreadPool::take(std::unique_lock<std::mutex> &lock, Batch &batch) {
+    while (batch.next < batch.count) {
+        auto i = batch.next++;
+        lock.unlock();
+        (*batch.job)(i);
+        lock.lock();
+        if (++batch.done == batch.count) {
+            finished.notify_all();
+        }
+    }
+}
+
+void TickThreadPool::work() {
+    std::unique_lock lock(mutex);
+    auto available = [this] {
+        return std::ranges::find_if(batches, [](Batch *b) { return b->threads < b->width && b->next < b->count; });
+    };
+    while (true) {
+        cv.wait(lock, [&] { return stop || available() != batches.end(); });
+        if (stop) {
+            return;
+        }
+        auto &batch = **available();
+        batch.threads++;
+        take(lock, batch);
+        // caller does not return before lock is released, so batch is still alive here
+        batch.threads--;
+    }
+}
+
+} // namespace rulejit::cq
@@ -0,0 +1,103 @@
+/**
+ * @file cqparallel.h
+ * @author djw
+ * @brief CQ/Interpreter/Parallel
+ * @date 2026-10-17
+ *
+ * @details Includes TickThreadPool, which runs subrulesets of one tick on persistent worker threads.
+ *
+ * In a tick every subruleset reads DataStore into its own ResourceHandler or data segment, and nothing is written
+ * back before all subrulesets of the rule set finished, so subrulesets can run at the same time as long as nothing
+ * else changes DataStore. Write back is still done by the tick thread in order of subrulesets, so a variable written
+ * by more than one subruleset ends with the same value as in serial execution.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rulejit::cq {
+
+/**
+ * @brief process wide worker threads shared by all rule set engines, the calling thread also takes part in its job
+ *
+ */
+struct TickThreadPool {
+    /**
+     * @brief get the pool, which is started when first used with one thread less than hardware threads
+     *
+     * @return TickThreadPool&
+     */
+    static TickThreadPool &instance();
+
+    TickThreadPool(const TickThreadPool &) = delete;
+    TickThreadPool &operator=(const TickThreadPool &) = delete;
+    ~TickThreadPool();
+
+    /**
+     * @brief get max count of threads running a job, including the calling thread
+     *
+     * @return size_t
+     */
+    size_t size() const { return workers.size() + 1; }
+
+    /**
+     * @brief call job(0) ... job(count - 1) on at most width threads, return when all calls finished
+     *
+     * @param count count of calls
+     * @param width max count of threads, including the calling thread, 0 for size()
+     * @param job job which must not throw
+     */
+    void run(size_t count, size_t width, const std::function<void(size_t)> &job);
+
+  private:
+    /**
+     * @brief calls of one run, all members are guarded by mutex
+     *
+     */
+    struct Batch {
+        const std::function<void(size_t)> *job;
+        size_t count;
+        /// @brief next call to be taken
+        size_t next;
+        /// @brief calls finished
+        size_t done;
+        size_t width;
+        /// @brief threads taking calls of the batch
+        size_t threads;
+    };
+
+    TickThreadPool();
+    void work();
+
+    /**
+     * @brief take and make calls of batch until all are taken
+     *
+     * @param lock lock of mutex, held when called and returned
+     * @param batch batch
+     */
+    void take(std::unique_lock<std::mutex> &lock, Batch &batch);
+
+    std::mutex mutex;
+    /// @brief notifies workers of new batch or stop
+    std::condition_variable cv;
+    /// @brief notifies callers of finished calls
+    std::condition_variable finished;
+    /// @brief batches with calls not taken
+    std::deque<Batch *> batches;
+    bool stop;
+    std::vector<std::thread> workers;
+};
+
+} // namespace rulejit::cq
@@ -0,0 +1,439 @@
+/**
+ * @file cqresolver.hpp
+ * @author djw
+ * @brief CQ/Interpreter/Resolver
+ * @date 2026-10-17
+ *
+ * @details Includes CQResolver, a load-time pass which stamps operator and function call nodes
+ * with op codes, so CQInterpreter can dispatch through a switch instead of string-keyed maps,
+ * and ConstantPool, which holds literals parsed once by CQResolver. CQResolver also assigns
+ * local variables and function params a fixed slot in their activation frame, and fills the inline cache of
+ * direct user function calls.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add constant pool.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add local variable slots.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Fill inline cache of user function calls.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Resolve struct members to index.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "ast/type.hpp"
+
+namespace rulejit::cq {
+
+/**
+ * @brief op code of build-in binary operators
+ *
+ */
+enum class BinOpCode : size_t {
+    ASSIGN,
+    ADD,
+    SUB,
+    MUL,
+    DIV,
+    MOD,
+    GT,
+    LT,
+    EQ,
+    NE,
+    GE,
+    LE,
+    AND,
+    OR,
+    UNKNOWN,
+};
+
+/**
+ * @brief op code of build-in unary operators
+ *
+ */
+enum class UnaryOpCode : size_t {
+    NEG,
+    NOT,
+    UNKNOWN,
+};
+
+/**
+ * @brief op code of function calls, build-in function first, then user defined function
+ *
+ * @attention order of [SIN, NORM_CDF_INV] must match buildInOneParamFunc in cqinterpreter.hpp,
+ * order of [POW, ATAN2] must match buildInTwoParamFunc in cqinterpreter.hpp
+ *
+ */
+enum class CallCode : size_t {
+    PRINT,
+    LENGTH,
+    PUSH,
+    RESIZE,
+    STR_EQUAL,
+    RAND,
+    SIN,
+    COS,
+    TAN,
+    COT,
+    ATAN,
+    ASIN,
+    ACOS,
+    FABS,
+    EXP,
+    ABS,
+    FLOOR,
+    SQRT,
+    NORM_CDF_INV,
+    POW,
+    ATAN2,
+    // call through non-literal function
+    INDIRECT,
+    // call to function in ContextGlobal::realFuncDefinition
+    USER,
+};
+
+/**
+ * @brief literals of a ruleset, LiteralExprAST::resolved is index in numbers or strings
+ * according to its type
+ *
+ */
+struct ConstantPool {
+    /// @brief pre-parsed numerical literals
+    std::vector<double> numbers;
+    /// @brief string literals, pinned by every ResourceHandler so index is also the string token
+    std::vector<std::string> strings;
+};
+
+/**
+ * @brief load-time pass stamping ExprAST::resolved of BinOpExprAST, UnaryOpExprAST and FunctionCallExprAST,
+ * and of LiteralExprAST if a ConstantPool is provided.
+ *
+ * Also stamps local variables: IdentifierExprAST and VarDefAST get slot index in current frame
+ * (or externalVar / redefinedVar), FunctionDefAST gets its frame size, BlockExprAST and LoopAST
+ * get scopedBySlot so interpreter no longer opens a named scope for them.
+ *
+ * If a ContextGlobal is provided, direct calls to its user functions get FunctionCallExprAST::callee and
+ * byValueParams, so ast is only read while executed, and MemberAccessExprAST of struct members gets index of the
+ * member.
+ *
+ * @attention CQInterpreter also calls the static resolve functions for nodes not visited by this pass; callees
+ * filled in call sites must be resolved by the same pass before executed
+ *
+ */
+struct CQResolver : public ASTVisitor {
+    CQResolver() : pool(nullptr), global(nullptr) {}
+    CQResolver(ConstantPool &pool) : pool(&pool), global(nullptr) {}
+    CQResolver(ConstantPool &pool, ContextGlobal &global) : pool(&pool), global(&global) {}
+    virtual ~CQResolver() = default;
+
+    /**
+     * @brief pipe operator| to resolve whole ast
+     *
+     * @param ast ast need to be resolved
+     * @param resolver receiver
+     */
+    void friend operator|(std::unique_ptr<ExprAST> &ast, CQResolver &resolver) {
+        if (ast) {
+            // top-level expression owns a frame like a function without params
+            resolver.frames.emplace_back();
+            ast->accept(&resolver);
+            resolver.frames.pop_back();
+        }
+    }
+
+    /**
+     * @brief pipe operator| to resolve function define, params take the first slots in frame
+     *
+     * @param func function need to be resolved
+     * @param resolver receiver
+     */
+    void friend operator|(std::unique_ptr<FunctionDefAST> &func, CQResolver &resolver) {
+        if (func) {
+            func->accept(&resolver);
+        }
+    }
+
+    /// @brief IdentifierExprAST::resolved of variable not defined in script, which should be read from ResourceHandler
+    inline static constexpr size_t externalVar = ExprAST::unresolved - 1;
+    /// @brief VarDefAST::resolved of variable already defined in the same scope, error when executed
+    inline static constexpr size_t redefinedVar = ExprAST::unresolved - 2;
+    /// @brief BlockExprAST::resolved and LoopAST::resolved when their variables are resolved to slots
+    inline static constexpr size_t scopedBySlot = 0;
+
+    /**
+     * @brief get op code of binary operator
+     *
+     * @param op operator token
+     * @return BinOpCode
+     */
+    static BinOpCode resolveBinOp(const std::string &op) {
+        static const std::unordered_map<std::string, BinOpCode> table{
+            {"=", BinOpCode::ASSIGN}, {"+", BinOpCode::ADD},   {"-", BinOpCode::SUB},  {"*", BinOpCode::MUL},
+            {"/", BinOpCode::DIV},    {"%", BinOpCode::MOD},   {">", BinOpCode::GT},   {"<", BinOpCode::LT},
+            {"==", BinOpCode::EQ},    {"!=", BinOpCode::NE},   {">=", BinOpCode::GE},  {"<=", BinOpCode::LE},
+            {"&&", BinOpCode::AND},   {"and", BinOpCode::AND}, {"||", BinOpCode::OR},  {"or", BinOpCode::OR},
+        };
+        auto it = table.find(op);
+        return it == table.end() ? BinOpCode::UNKNOWN : it->second;
+    }
+
+    /**
+     * @brief get op code of unary operator
+     *
+     * @param op operator token
+     * @return UnaryOpCode
+     */
+    static UnaryOpCode resolveUnaryOp(const std::string &op) {
+        if (op == "-") {
+            return UnaryOpCode::NEG;
+        }
+        if (op == "!" || op == "not") {
+            return UnaryOpCode::NOT;
+        }
+        return UnaryOpCode::UNKNOWN;
+    }
+
+    /**
+     * @brief get op code of function call
+     *
+     * @param v function call expression
+     * @return CallCode
+     */
+    static CallCode resolveCall(FunctionCallExprAST &v) {
+        // should provide all function defined in initprocess in frontend/ruleset/rulesetparser.cpp
+        static const std::unordered_map<std::string, CallCode> table{
+            {"print", CallCode::PRINT},
+            {"length", CallCode::LENGTH},
+            {"push", CallCode::PUSH},
+            {"resize", CallCode::RESIZE},
+            {"strEqual", CallCode::STR_EQUAL},
+            {"rand", CallCode::RAND},
+            {"sin", CallCode::SIN},
+            {"cos", CallCode::COS},
+            {"tan", CallCode::TAN},
+            {"cot", CallCode::COT},
+            {"atan", CallCode::ATAN},
+            {"asin", CallCode::ASIN},
+            {"acos", CallCode::ACOS},
+            {"fabs", CallCode::FABS},
+            {"exp", CallCode::EXP},
+            {"abs", CallCode::ABS},
+            {"floor", CallCode::FLOOR},
+            {"sqrt", CallCode::SQRT},
+            {"normCDFInv", CallCode::NORM_CDF_INV},
+            {"pow", CallCode::POW},
+            {"atan2", CallCode::ATAN2},
+        };
+        auto p = dynamic_cast<LiteralExprAST *>(v.functionIdent.get());
+        if (!p) {
+            return CallCode::INDIRECT;
+        }
+        auto it = table.find(p->value);
+        return it == table.end() ? CallCode::USER : it->second;
+    }
+
+    /**
+     * @brief get params of a user function passed by value
+     *
+     * @param func function define, at most 64 params
+     * @return uint64_t bit i is set if param i is numerical
+     */
+    static uint64_t byValueParams(const FunctionDefAST &func) {
+        uint64_t mask = 0;
+        for (size_t i = 0; i < func.params.size(); i++) {
+            auto &type = *(func.params[i]->type);
+            if (type == RealType || type == IntType) {
+                mask |= uint64_t(1) << i;
+            }
+        }
+        return mask;
+    }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {
+        auto &scopes = frames.back().scopes;
+        for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+            if (auto var = it->find(v.name); var != it->end()) {
+                v.resolved = var->second;
+                return;
+            }
+        }
+        v.resolved = externalVar;
+    }
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        resolve(v.baseVar);
+        if (*(v.memberToken->type) == StringType) {
+            v.resolved = resolveMember(v);
+        } else {
+            resolve(v.memberToken);
+        }
+    }
+    VISIT_FUNCTION(LiteralExprAST) {
+        if (!pool) {
+            return;
+        }
+        if (*(v.type) == RealType) {
+            auto [it, inserted] = numberIndex.try_emplace(v.value, pool->numbers.size());
+            if (inserted) {
+                pool->numbers.push_back(std::stod(v.value));
+            }
+            v.resolved = it->second;
+        } else if (*(v.type) == StringType) {
+            auto [it, inserted] = stringIndex.try_emplace(v.value, pool->strings.size());
+            if (inserted) {
+                pool->strings.push_back(v.value);
+            }
+            v.resolved = it->second;
+        }
+    }
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        v.resolved = static_cast<size_t>(resolveCall(v));
+        if (v.resolved == static_cast<size_t>(CallCode::INDIRECT)) {
+            resolve(v.functionIdent);
+        } else if (v.resolved == static_cast<size_t>(CallCode::USER) && global) {
+            auto name = static_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+            if (auto f = global->realFuncDefinition.find(name); f != global->realFuncDefinition.end()) {
+                auto &callee = *(f->second);
+                if (callee.params.size() <= 64 && callee.params.size() == v.params.size()) {
+                    v.callee = &callee;
+                    v.byValueParams = byValueParams(callee);
+                }
+            }
+        }
+        for (auto &arg : v.params) {
+            resolve(arg);
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        v.resolved = static_cast<size_t>(resolveBinOp(v.op));
+        resolve(v.lhs);
+        resolve(v.rhs);
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) {
+        v.resolved = static_cast<size_t>(resolveUnaryOp(v.op));
+        resolve(v.rhs);
+    }
+    VISIT_FUNCTION(BranchExprAST) {
+        resolve(v.condition);
+        resolve(v.trueExpr);
+        resolve(v.falseExpr);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        // keys are read directly by interpreter
+        for (auto &[index, value] : v.members) {
+            resolve(value);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        v.resolved = scopedBySlot;
+        openScope();
+        resolve(v.init);
+        resolve(v.condition);
+        resolve(v.body);
+        closeScope();
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        v.resolved = scopedBySlot;
+        openScope();
+        for (auto &stmt : v.exprs) {
+            resolve(stmt);
+        }
+        closeScope();
+    }
+    VISIT_FUNCTION(ControlFlowAST) { resolve(v.value); }
+    VISIT_FUNCTION(TypeDefAST) {}
+    VISIT_FUNCTION(VarDefAST) {
+        // defined value can not see the variable itself
+        resolve(v.definedValue);
+        auto &frame = frames.back();
+        auto [it, inserted] = frame.scopes.back().try_emplace(v.name, frame.next);
+        if (!inserted) {
+            v.resolved = redefinedVar;
+            return;
+        }
+        v.resolved = frame.next++;
+        frame.size = std::max(frame.size, frame.next);
+    }
+    VISIT_FUNCTION(FunctionDefAST) {
+        frames.emplace_back();
+        auto &frame = frames.back();
+        for (auto &param : v.params) {
+            param->resolved = frame.next;
+            frame.scopes.back().try_emplace(param->name, frame.next++);
+        }
+        frame.size = frame.next;
+        resolve(v.returnValue);
+        v.resolved = frames.back().size;
+        frames.pop_back();
+    }
+    VISIT_FUNCTION(SymbolDefAST) {}
+
+  private:
+    void resolve(std::unique_ptr<ExprAST> &v) {
+        if (v) {
+            v->accept(this);
+        }
+    }
+
+    /**
+     * @brief get index of struct member in its type define, which is also its index in TypeDescriptor::members as
+     * both follow the order of definition in xml
+     *
+     * @param v member access expression whose member token is a string
+     * @return size_t ExprAST::unresolved if not known, then member is found by name when executed
+     */
+    size_t resolveMember(MemberAccessExprAST &v) {
+        auto member = dynamic_cast<LiteralExprAST *>(v.memberToken.get());
+        auto &type = v.baseVar->type;
+        if (!global || !member || !type || !type->isBaseType()) {
+            return ExprAST::unresolved;
+        }
+        auto def = global->typeDef.find(type->getBaseTypeString());
+        if (def == global->typeDef.end()) {
+            return ExprAST::unresolved;
+        }
+        auto it = std::ranges::find_if(def->second, [&](auto &m) { return std::get<0>(m) == member->value; });
+        return it == def->second.end() ? ExprAST::unresolved : static_cast<size_t>(it - def->second.begin());
+    }
+
+    void openScope() {
+        auto &frame = frames.back();
+        frame.scopes.emplace_back();
+        frame.scopeBase.push_back(frame.next);
+    }
+    void closeScope() {
+        auto &frame = frames.back();
+        frame.scopes.pop_back();
+        // slots of closed scope can be reused by following siblings
+        frame.next = frame.scopeBase.back();
+        frame.scopeBase.pop_back();
+    }
+
+    /**
+     * @brief activation frame being resolved
+     *
+     */
+    struct Frame {
+        std::vector<std::unordered_map<std::string, size_t>> scopes{{}};
+        std::vector<size_t> scopeBase;
+        size_t next = 0;
+        size_t size = 0;
+    };
+
+    std::vector<Frame> frames;
+    ConstantPool *pool;
+    ContextGlobal *global;
+    std::unordered_map<std::string, size_t> numberIndex;
+    std::unordered_map<std::string, size_t> stringIndex;
+};
+
+} // namespace rulejit::cq
@@ -8,15 +8,28 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Pin string literals.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Track changes of variables.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Only read DataStore in ticks, so subrulesets can run in parallel.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add typed storage of variables of flat layout.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Refer to members and elements instead of copying them.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Only write back members written.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Compare strings by ids in StringTable.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keep TypeDescriptor instead of type name of buffered values.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Access members through index resolved at load time.</td></tr>
  * </table>
  */
 #pragma once
 
+#include <algorithm>
 #include <any>
+#include <cstdint>
+#include <deque>
 #include <format>
 #include <list>
 #include <map>
 #include <memory>
+#include <ranges>
 #include <set>
 #include <stack>
 #include <string>
@@ -24,6 +37,9 @@
 #include <unordered_map>
 #include <vector>
 
+#include "backend/cq/cqstringtable.h"
+#include "backend/cq/cqtypedlayout.h"
+#include "backend/cq/cqtyperegistry.h"
 #include "frontend/ruleset/rulesetparser.h"
 #include "tools/anyprocess.hpp"
 #include "tools/myassert.hpp"
@@ -45,6 +61,236 @@ struct DataStore {
     CSValueMap output;
     CSValueMap cache;
     ruleset::RuleSetMetaInfo metaInfo;
+    /// @brief descriptors of types in metaInfo
+    TypeRegistry types{metaInfo};
+    /// @brief record when each variable changes, in SetInput and write back, see markChanged
+    bool trackChanges = false;
+    /// @brief count of changes recorded, used as clock
+    size_t changeClock = 0;
+    /// @brief variable name -> changeClock when it changed last time
+    std::unordered_map<std::string, size_t> changedAt;
+
+    /**
+     * @brief place of a variable in typed storage, see compileSchema
+     *
+     */
+    struct TypedVar {
+        std::string name;
+        const TypeLayout *layout;
+        /// @brief offset in record
+        size_t offset;
+        /// @brief input, output or cache, which holds the variable
+        CSValueMap *table;
+        /// @brief record holds current value
+        bool recordValid;
+        /// @brief table holds current value, at least one of record and table does
+        bool tableValid;
+        /// @brief in unpacked, waiting for syncRecord
+        bool pending;
+    };
+    /// @brief variable name -> place in record, empty if typed storage is not used
+    std::unordered_map<std::string, TypedVar> typedVars;
+    /// @brief flat values of variables in typedVars
+    std::vector<uint64_t> record;
+    /// @brief changed each time typedVars is compiled or dropped, so places cached by others can be checked
+    size_t schemaVersion = 0;
+    /// @brief variables whose table is written, packed into record by syncRecord
+    std::vector<TypedVar *> unpacked;
+    /// @brief string literals of rule set, strings compared by ResourceHandler are looked up in it
+    StringTable strings;
+
+    /**
+     * @brief keep values of variables whose layout is flat in record, at precomputed offsets; they are converted
+     * from and to tables when set by SetInput, got by GetOutput, or read and written back by ResourceHandler, and
+     * copied into and out of data segment of bytecode directly when the record uses the same offsets
+     *
+     * @param vars {variable name, offset in record, layout}, variables of layout not flat are skipped
+     * @param size size of record in bytes
+     */
+    void compileSchema(const std::vector<std::tuple<std::string, size_t, const TypeLayout *>> &vars, size_t size) {
+        dropSchema();
+        record.assign((size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+        for (auto &[name, offset, layout] : vars) {
+            CSValueMap *table = nullptr;
+            size_t declared = 0;
+            for (auto [list, candidate] : {std::tuple{&metaInfo.inputVar, &input},
+                                           std::tuple{&metaInfo.cacheVar, &cache},
+                                           std::tuple{&metaInfo.outputVar, &output}}) {
+                if (std::ranges::find(*list, name) != list->end()) {
+                    table = candidate;
+                    declared++;
+                }
+            }
+            // variable declared twice is read from one table and written back to another
+            if (!layout->flat || declared != 1) {
+                continue;
+            }
+            auto it = typedVars.emplace(name, TypedVar{name, layout, offset, table, false, true, false}).first;
+            tableWritten(it->second);
+        }
+        syncRecord();
+        schemaVersion++;
+    }
+
+    /**
+     * @brief stop using typed storage, values in record are moved back into tables
+     *
+     */
+    void dropSchema() {
+        syncTables();
+        typedVars.clear();
+        record.clear();
+        unpacked.clear();
+        schemaVersion++;
+    }
+
+    /**
+     * @brief get flat value of a variable in record
+     *
+     * @param var variable in typedVars
+     * @return uint8_t*
+     */
+    uint8_t *recordOf(const TypedVar &var) { return reinterpret_cast<uint8_t *>(record.data()) + var.offset; }
+    const uint8_t *recordOf(const TypedVar &var) const {
+        return reinterpret_cast<const uint8_t *>(record.data()) + var.offset;
+    }
+
+    /**
+     * @brief record that value of a typed variable in table is written, so record is packed again by syncRecord
+     *
+     * @param var variable in typedVars
+     */
+    void tableWritten(TypedVar &var) {
+        var.tableValid = true;
+        var.recordValid = false;
+        if (!var.pending) {
+            var.pending = true;
+            unpacked.push_back(&var);
+        }
+    }
+
+    /**
+     * @brief record that value of a variable in table is written, if it is in typed storage
+     *
+     * @param name variable name
+     */
+    void tableWritten(const std::string &name) {
+        if (auto it = typedVars.find(name); it != typedVars.end()) {
+            tableWritten(it->second);
+        }
+    }
+
+    /**
+     * @brief record that value of a typed variable in record is written, so table is unpacked again when needed
+     *
+     * @param var variable in typedVars
+     */
+    void recordWritten(TypedVar &var) {
+        var.recordValid = true;
+        var.tableValid = false;
+        // not packed from table by syncRecord any more
+        var.pending = false;
+    }
+
+    /**
+     * @brief pack values of variables written in tables into record
+     * @attention must not be called during parallel execution of subrulesets
+     *
+     */
+    void syncRecord() {
+        for (auto var : unpacked) {
+            if (!var->pending) {
+                continue;
+            }
+            var->pending = false;
+            auto it = var->table->find(var->name);
+            // value of other type is left in table only, and found by type check when accessed
+            var->recordValid = it != var->table->end() && var->layout->pack(recordOf(*var), it->second);
+        }
+        unpacked.clear();
+    }
+
+    /**
+     * @brief unpack value of a typed variable written in record into its table
+     *
+     * @param var variable in typedVars
+     */
+    void syncTable(TypedVar &var) {
+        if (!var.tableValid) {
+            auto &v = (*var.table)[var.name];
+            v = var.layout->unpack(recordOf(var), v);
+            var.tableValid = true;
+        }
+    }
+
+    /**
+     * @brief unpack values of all typed variables written in record into tables
+     *
+     */
+    void syncTables() {
+        for (auto &[name, var] : typedVars) {
+            syncTable(var);
+        }
+    }
+
+    /**
+     * @brief find value of a variable in the same order as ResourceHandler::readIn, DataStore is not changed,
+     * so it can be called by subrulesets running in parallel
+     *
+     * @param name variable name
+     * @param scratch holds the value if it is unpacked from record
+     * @return const std::any* nullptr if not found
+     */
+    const std::any *find(const std::string &name, std::any &scratch) const {
+        const std::any *ret = nullptr;
+        for (auto table : {&input, &cache, &output}) {
+            if (auto it = table->find(name); it != table->end()) {
+                ret = &it->second;
+                break;
+            }
+        }
+        if (ret && !typedVars.empty()) {
+            if (auto it = typedVars.find(name); it != typedVars.end() && !it->second.tableValid) {
+                scratch = it->second.layout->unpack(recordOf(it->second), *ret);
+                return &scratch;
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * @brief record that a variable is changed now, if trackChanges is set
+     *
+     * @param name variable name
+     */
+    void markChanged(const std::string &name) {
+        if (trackChanges) {
+            changedAt[name] = ++changeClock;
+        }
+    }
+
+    /**
+     * @brief get changeClock when a variable changed last time
+     *
+     * @param name variable name
+     * @return size_t 0 if never changed since tracking
+     */
+    size_t lastChanged(const std::string &name) const {
+        auto it = changedAt.find(name);
+        return it == changedAt.end() ? 0 : it->second;
+    }
+
+    /**
+     * @brief add strings into string table
+     * @attention must not be called during ticks, strings are looked up by subrulesets running in parallel
+     *
+     * @param literals strings, typically ConstantPool::strings
+     */
+    void internStrings(const std::vector<std::string> &literals) {
+        for (auto &s : literals) {
+            strings.intern(s);
+        }
+    }
 
     /**
      * @brief generate core dump
@@ -52,6 +298,7 @@ struct DataStore {
      * @return std::string core dump
      */
     std::string dump() {
+        syncTables();
         return std::format("Input:\n{}\n\nOutput:\n{}\n\nCache:\n{}\n",
                            tools::mystr::autoIdent(tools::myany::printCSValueMapToString(input), 1),
                            tools::mystr::autoIdent(tools::myany::printCSValueMapToString(output), 1),
@@ -100,6 +347,7 @@ struct DataStore {
      * @return std::string type check info, empty if no error
      */
     std::string genTypeCheckInfo() {
+        syncTables();
         std::string ret;
         // use inner class act as a recursible lambda to avoid private function used only once / y-combinator
         struct TypeChecker {
@@ -174,13 +422,20 @@ struct DataStore {
         // fill input, output and cache
         for (auto &&s : metaInfo.inputVar) {
             input[s] = makeTypeEmptyInstance(metaInfo.varType[s]);
+            markChanged(s);
         }
         for (auto &&s : metaInfo.outputVar) {
             output[s] = makeTypeEmptyInstance(metaInfo.varType[s]);
+            markChanged(s);
         }
         for (auto &&s : metaInfo.cacheVar) {
             cache[s] = makeTypeEmptyInstance(metaInfo.varType[s]);
+            markChanged(s);
+        }
+        for (auto &[name, var] : typedVars) {
+            tableWritten(var);
         }
+        syncRecord();
     }
 
     /**
@@ -190,7 +445,18 @@ struct DataStore {
      */
     void SetInput(const CSValueMap &v) {
         for (auto &&[k, v] : v) {
+            if (trackChanges) {
+                auto it = input.find(k);
+                if (it != input.end() && tools::myany::anyEqual(it->second, v)) {
+                    continue;
+                }
+                markChanged(k);
+            }
             input[k] = v;
+            if (auto it = typedVars.find(k); it != typedVars.end()) {
+                auto &var = it->second;
+                var.recordValid = var.layout->pack(recordOf(var), v);
+            }
         }
     }
 
@@ -199,7 +465,30 @@ struct DataStore {
      *
      * @return CSValueMap* pointer to output data
      */
-    CSValueMap *GetOutput() { return &output; }
+    CSValueMap *GetOutput() {
+        for (auto &[name, var] : typedVars) {
+            if (var.table == &output) {
+                syncTable(var);
+                // outputs may be changed through the pointer
+                tableWritten(var);
+            }
+        }
+        return &output;
+    }
+
+    /**
+     * @brief Get the Caches
+     *
+     * @return const CSValueMap& cache data
+     */
+    const CSValueMap &GetCache() {
+        for (auto &[name, var] : typedVars) {
+            if (var.table == &cache) {
+                syncTable(var);
+            }
+        }
+        return cache;
+    }
 
     /**
      * @brief check if a type is array type
@@ -272,17 +561,40 @@ struct DataStore {
  * @brief data structure for buffering data in DataStore,
  * and provide functions for CQInterpreter to access and modify data.
  *
+ * Values in buffer refer to the storage they are read from as long as they are not written: input variables refer
+ * to DataStore, which is not changed during ticks, and members and elements refer to the value of their parent.
+ * A value is copied into the buffer when it is written, and merged into its parent by assemble, so reading
+ * a[i].b.c costs O(depth) without copying a or a[i].
+ *
+ * Outputs and caches only written back by this subruleset refer to DataStore too, and members written are copied
+ * into DataStore in writeBack, so reading them without change costs nothing.
+ *
  */
 struct ResourceHandler {
     using CSValueMap = std::unordered_map<std::string, std::any>;
     DataStore &data;
     ResourceHandler(DataStore &data)
-        : data(data), managedString(), buffer(), bufferMap(), originalValue(), relation(){};
+        : data(data), pinnedString(0), managedString(), buffer(), bufferMap(), originalValue(), shared(){};
     ResourceHandler(const ResourceHandler &) = delete;
     ResourceHandler(ResourceHandler &&) = delete;
     ResourceHandler &operator=(const ResourceHandler &) = delete;
     ResourceHandler &operator=(ResourceHandler &&) = delete;
 
+    /**
+     * @brief pin strings at the head of buffer, so the i-th string always has token i
+     * and survives writeBack
+     * @attention must be called before any value is taken into buffer
+     *
+     * @param strings strings need to be pinned, typically ConstantPool::strings
+     */
+    void pinStrings(const std::vector<std::string> &strings) {
+        my_assert(buffer.empty(), "strings must be pinned before any value is buffered");
+        for (auto &s : strings) {
+            push(s, data.types.get("string"));
+        }
+        pinnedString = buffer.size();
+    }
+
     /**
      * @brief manage a string, if the string is already in the buffer, return the index of the string,
      *
@@ -293,9 +605,9 @@ struct ResourceHandler {
         if (managedString.contains(s)) {
             return managedString[s];
         }
-        buffer.emplace_back(s, "string");
-        managedString[s] = buffer.size() - 1;
-        return buffer.size() - 1;
+        auto token = push(s, data.types.get("string"));
+        managedString[s] = token;
+        return token;
     }
 
     /**
@@ -306,7 +618,7 @@ struct ResourceHandler {
      */
     std::string getString(size_t index) {
         my_assert(isString(index), "not a string");
-        return std::any_cast<std::string>(std::get<1>(buffer[index]));
+        return std::any_cast<std::string>(value(index));
     }
 
     /**
@@ -315,7 +627,7 @@ struct ResourceHandler {
      * @param index token which referring to the value
      * @return bool
      */
-    bool isString(size_t index) { return std::get<1>(buffer[index]) == "string"; }
+    bool isString(size_t index) { return buffer[index].type->isString(); }
 
     /**
      * @brief read string from buffer
@@ -323,7 +635,7 @@ struct ResourceHandler {
      * @param index token which referring to the string
      * @return std::string
      */
-    std::string readString(size_t index) { return std::any_cast<std::string>(std::get<0>(buffer[index])); }
+    std::string readString(size_t index) { return std::any_cast<std::string>(value(index)); }
 
     /**
      * @brief compare managed string
@@ -335,8 +647,12 @@ struct ResourceHandler {
      */
     bool stringComp(size_t v1, size_t v2) {
         my_assert(isString(v1) && isString(v2), "string comparison only allowed on string");
-        return std::any_cast<std::string>(std::get<0>(buffer[v1])) ==
-               std::any_cast<std::string>(std::get<0>(buffer[v2]));
+        // a string compared with many literals is looked up once
+        auto lhs = stringId(v1), rhs = stringId(v2);
+        if (StringTable::comparable(lhs, rhs)) {
+            return lhs == rhs;
+        }
+        return std::any_cast<const std::string &>(value(v1)) == std::any_cast<const std::string &>(value(v2));
     }
 
     /**
@@ -353,18 +669,30 @@ struct ResourceHandler {
         if (auto it = bufferMap.find(s); it != bufferMap.end()) {
             return it->second;
         }
-        if (auto it1 = data.input.find(s); it1 != data.input.end()) {
-            buffer.emplace_back(it1->second, data.metaInfo.varType[s]);
-        } else if (auto it2 = data.cache.find(s); it2 != data.cache.end()) {
-            buffer.emplace_back(it2->second, data.metaInfo.varType[s]);
-        } else if (auto it3 = data.output.find(s); it3 != data.output.end()) {
-            buffer.emplace_back(it3->second, data.metaInfo.varType[s]);
+        // DataStore is shared by subrulesets running in parallel, so never insert into it here
+        size_t token;
+        if (auto it = data.input.find(s); it != data.input.end()) {
+            // inputs are only set between ticks, and never held by typed storage only
+            token = push({}, data.types.get(data.metaInfo.varType.at(s)), &it->second);
         } else {
-            error(std::string("unknown token: ") + s);
+            std::any scratch;
+            auto found = data.find(s, scratch);
+            if (!found) {
+                error(std::string("unknown token: ") + s);
+            }
+            auto type = data.types.get(data.metaInfo.varType.at(s));
+            if (found != &scratch && !shared.contains(s)) {
+                // not written back by others before this one, so DataStore keeps it until write back
+                token = push({}, type, found);
+            } else {
+                token = push(found == &scratch ? std::move(scratch) : *found, type);
+                if (shared.contains(s) && data.cache.contains(s)) {
+                    originalValue[s] = buffer[token].value;
+                }
+            }
         }
-        bufferMap[s] = buffer.size() - 1;
-        originalValue[s] = std::get<0>(buffer[buffer.size() - 1]);
-        return buffer.size() - 1;
+        bufferMap[s] = token;
+        return token;
     }
 
     /**
@@ -374,26 +702,69 @@ struct ResourceHandler {
      */
     void writeBack() {
         for (auto &&[name, ind] : bufferMap) {
-            if (auto it = data.output.find(name); it != data.output.end()) {
+            auto output = data.output.find(name);
+            auto cache = data.cache.find(name);
+            if (!shared.contains(name) && (output != data.output.end() || cache != data.cache.end())) {
+                // values not written are the same as in DataStore
+                auto &target = output != data.output.end() ? output->second : cache->second;
+                // outputs accessed are always written back, caches only if changed, same as below
+                if (output != data.output.end() ? buffer[ind].written : differs(ind, target)) {
+                    if (data.trackChanges && (cache != data.cache.end() || differs(ind, target))) {
+                        data.markChanged(name);
+                    }
+                    patch(ind, target);
+                    data.tableWritten(name);
+                }
+                continue;
+            }
+            if (auto it = output; it != data.output.end()) {
                 // should not access output unless assign to it
                 auto &now = assemble(ind);
+                std::any scratch;
+                if (data.trackChanges && !tools::myany::anyEqual(now, *data.find(name, scratch))) {
+                    data.markChanged(name);
+                }
                 it->second = now;
-            } else if (auto it = data.cache.find(name); it != data.cache.end()) {
+                data.tableWritten(name);
+            } else if (auto it = cache; it != data.cache.end()) {
                 // may access cache without access to it, so use the same method in cpp-backend to
                 // determine whether to write back
                 auto &now = assemble(ind);
                 if (!tools::myany::anyEqual(now, originalValue[name])) {
+                    data.markChanged(name);
                     it->second = now;
+                    data.tableWritten(name);
                 }
             }
         }
-        buffer.clear();
+        buffer.erase(buffer.begin() + pinnedString, buffer.end());
         bufferMap.clear();
         originalValue.clear();
-        relation.clear();
         managedString.clear();
     }
 
+    /**
+     * @brief copy variables referred by the buffer, so they are kept as read when the tick fails before write back
+     * and DataStore is changed
+     *
+     */
+    void keepValues() {
+        for (auto token : std::views::values(bufferMap)) {
+            if (buffer[token].view) {
+                materialize(token);
+            }
+        }
+    }
+
+    /**
+     * @brief set outputs and caches written back by more than one subruleset, which are copied when read and
+     * written back as a whole, as others may write them back before this one; the others are referred, and only
+     * members written are copied back
+     *
+     * @param vars variable names
+     */
+    void setShared(std::set<std::string> vars) { shared = std::move(vars); }
+
     /**
      * @brief create a new instance of given type
      *
@@ -402,8 +773,7 @@ struct ResourceHandler {
      */
     size_t makeInstance(const std::string &s) {
         auto xmlType = data.innerType2XMLType(s);
-        buffer.emplace_back(data.makeTypeEmptyInstance(xmlType), xmlType);
-        return buffer.size() - 1;
+        return push(data.makeTypeEmptyInstance(xmlType), data.types.get(xmlType));
     }
 
     /**
@@ -414,7 +784,7 @@ struct ResourceHandler {
      */
     size_t makeInstanceAs(size_t token) {
         // TODO: make array, array push back
-        return makeInstance(std::get<1>(buffer[token]));
+        return makeInstance(buffer[token].type->name);
     }
 
     /**
@@ -438,16 +808,22 @@ struct ResourceHandler {
      */
     void assign(size_t dst, size_t src) {
         // TODO: allow assign base type to base type
-        if (ruleset::baseNumericalData.contains(std::get<1>(buffer[dst])) && ruleset::baseNumericalData.contains(std::get<1>(buffer[src]))) {
+        if (buffer[dst].type->isNumber() && buffer[src].type->isNumber()) {
             auto v = readValue(src);
             writeValue(dst, v);
             return;
         }
-        my_assert(std::get<1>(buffer[dst]) == std::get<1>(buffer[src]),
-                  "assignment of different types are not allowed");
-        auto &tmp = assemble(src);
-        std::get<0>(buffer[dst]) = tmp;
-        relation[dst].clear();
+        my_assert(buffer[dst].type == buffer[src].type, "assignment of different types are not allowed");
+        if (dst < pinnedString) {
+            error("can not assign to string literal");
+        }
+        auto tmp = assemble(src);
+        // members taken before keep the old value
+        detach(dst);
+        buffer[dst].value = std::move(tmp);
+        buffer[dst].view = nullptr;
+        buffer[dst].id = buffer[src].id;
+        markWritten(dst);
     }
 
     /**
@@ -459,21 +835,22 @@ struct ResourceHandler {
      * @return size_t token which referring to the returned value
      */
     size_t arrayAccess(size_t base, size_t index) {
-        if (auto it = relation[base].find(std::to_string(index)); it != relation[base].end()) {
-            return it->second;
+        for (auto &[i, token] : buffer[base].elements) {
+            if (i == index) {
+                return token;
+            }
         }
-        if (!data.isArray(std::get<1>(buffer[base]))) {
-            error(std::format("type \"{}\" is not an array", std::get<1>(buffer[base])));
+        if (!buffer[base].type->isArray()) {
+            error(std::format("type \"{}\" is not an array", buffer[base].type->name));
         }
-        auto array = std::any_cast<std::vector<std::any>>(std::get<0>(buffer[base]));
+        auto &array = std::any_cast<const std::vector<std::any> &>(value(base));
         if (index >= array.size()) {
             error(std::format("array out of range, index: {}, size: {}", index, array.size()));
         }
-        auto tmp = array[index];
-        auto baseType = std::get<1>(buffer[base]);
-        buffer.emplace_back(tmp, data.arrayElementType(baseType));
-        relation[base].emplace(std::to_string(index), buffer.size() - 1);
-        return buffer.size() - 1;
+        // buffer is a deque, so the slot of base is not moved by push
+        auto token = push({}, buffer[base].type->element, &array[index], base);
+        buffer[base].elements.emplace_back(index, token);
+        return token;
     }
 
     /**
@@ -487,23 +864,50 @@ struct ResourceHandler {
      * @return size_t token which referring to the returned value
      */
     size_t memberAccess(size_t base, const std::string &name) {
-        if (auto it = relation[base].find(name); it != relation[base].end()) {
-            return it->second;
+        auto baseType = buffer[base].type;
+        if (baseType->isArray()) {
+            error(std::format("type \"{}\" is an array", baseType->name));
         }
-        if (data.isArray(std::get<1>(buffer[base]))) {
-            error(std::format("type \"{}\" is an array", std::get<1>(buffer[base])));
+        auto index = baseType->memberIndex(name);
+        if (index == baseType->members.size()) {
+            error(std::format("type \"{}\" has no member {}", baseType->name, name));
         }
-        auto tmp = std::any_cast<CSValueMap>(std::get<0>(buffer[base]))[name];
-        auto baseType = std::get<1>(buffer[base]);
-        auto it = std::find_if(data.metaInfo.typeDefines[baseType].begin(), data.metaInfo.typeDefines[baseType].end(),
-                               [&](auto &x) { return std::get<0>(x) == name; });
-        if (it == data.metaInfo.typeDefines[baseType].end()) {
-            error(std::format("type \"{}\" has no member {}", std::get<1>(buffer[base]), name));
+        return memberAccess(base, index);
+    }
+
+    /**
+     * @brief get member of the given value through its index in TypeDescriptor::members, which is resolved at load
+     * time, store it in buffer and return the token reffering to it
+     *
+     * @param base token which referring to the value
+     * @param index index of member
+     * @return size_t token which referring to the returned value
+     */
+    size_t memberAccess(size_t base, size_t index) {
+        for (auto &[i, token] : buffer[base].members) {
+            if (i == index) {
+                return token;
+            }
         }
-        auto newType = std::get<1>(*it);
-        buffer.emplace_back(tmp, newType);
-        relation[base].emplace(name, buffer.size() - 1);
-        return buffer.size() - 1;
+        auto baseType = buffer[base].type;
+        if (baseType->isArray()) {
+            error(std::format("type \"{}\" is an array", baseType->name));
+        }
+        if (index >= baseType->members.size()) {
+            error(std::format("type \"{}\" has no member #{}", baseType->name, index));
+        }
+        auto &record = std::any_cast<const CSValueMap &>(value(base));
+        auto &[name, newType] = baseType->members[index];
+        size_t token;
+        if (auto member = record.find(name); member != record.end()) {
+            token = push({}, newType, &member->second, base);
+        } else {
+            // missing member is taken as empty value, which is added to base when assembled
+            token = push(std::any(), newType, nullptr, base);
+            markWritten(token);
+        }
+        buffer[base].members.emplace_back(index, token);
+        return token;
     }
 
     /**
@@ -513,7 +917,7 @@ struct ResourceHandler {
      * @return size_t
      */
     size_t arrayLength(size_t index) {
-        auto &tmp = std::any_cast<std::vector<std::any> &>(std::get<0>(buffer[index]));
+        auto &tmp = std::any_cast<const std::vector<std::any> &>(value(index));
         return tmp.size();
     }
 
@@ -524,9 +928,9 @@ struct ResourceHandler {
      * @param size new size of the array
      */
     void arrayResize(size_t index, size_t size) {
-        auto &origin = assemble(index);
+        auto &origin = mutate(index);
         auto &tmp = std::any_cast<std::vector<std::any> &>(origin);
-        tmp.resize(size, data.makeTypeEmptyInstance(data.arrayElementType(std::get<1>(buffer[index]))));
+        tmp.resize(size, data.makeTypeEmptyInstance(buffer[index].type->element->name));
     }
 
     /**
@@ -536,10 +940,11 @@ struct ResourceHandler {
      * @param newElementIndex token referring to the new element append to array
      */
     void arrayExtend(size_t index, size_t newElementIndex) {
-        auto &origin = assemble(index);
+        auto &origin = mutate(index);
         auto &tmp = std::any_cast<std::vector<std::any> &>(origin);
-        auto &newElement = assemble(newElementIndex);
-        tmp.emplace_back(newElement);
+        // copied before extended, new element may refer to an element of the array
+        auto newElement = assemble(newElementIndex);
+        tmp.emplace_back(std::move(newElement));
     }
 
     /**
@@ -563,7 +968,7 @@ struct ResourceHandler {
      * @return bool
      */
     bool isBaseType(size_t index) {
-        return ruleset::baseData.contains(std::get<1>(buffer[index]));
+        return buffer[index].type->isNumber() || buffer[index].type->isString();
     }
 
     /**
@@ -575,7 +980,11 @@ struct ResourceHandler {
      * @return double
      */
     double readValue(size_t index) {
-        auto &v = std::get<0>(buffer[index]);
+        auto &v = value(index);
+        // value of declared type is read without checking others
+        if (double ret; readScalar(buffer[index].type->scalar, v, ret)) {
+            return ret;
+        }
         if (v.type() == typeid(bool)) {
             return std::any_cast<bool>(v);
         } else if (v.type() == typeid(int8_t)) {
@@ -622,7 +1031,10 @@ struct ResourceHandler {
      * @param tar assigned value
      */
     void writeValue(size_t index, double tar) {
-        auto &v = std::get<0>(buffer[index]);
+        auto &v = own(index);
+        if (writeScalar(buffer[index].type->scalar, v, tar)) {
+            return;
+        }
         if (v.type() == typeid(bool)) {
             v = (bool)(tar);
         } else if (v.type() == typeid(int8_t)) {
@@ -651,39 +1063,322 @@ struct ResourceHandler {
     }
 
   private:
+    template <typename T> static bool readAs(const std::any &v, double &ret) {
+        auto p = std::any_cast<T>(&v);
+        if (p) {
+            ret = static_cast<double>(*p);
+        }
+        return p;
+    }
 
-    std::any &assemble(size_t index) {
-        auto &[v, type] = buffer[index];
-        if (ruleset::baseData.contains(type)) {
-            return v;
+    template <typename T> static bool writeAs(std::any &v, double tar) {
+        auto p = std::any_cast<T>(&v);
+        if (p) {
+            *p = static_cast<T>(tar);
         }
-        if (data.isArray(type)) {
-            auto tmp = std::any_cast<std::vector<std::any>>(std::move(v));
-            for (auto &&[name, ind] : relation[index]) {
-                tmp[std::stoi(name)] = assemble(ind);
+        return p;
+    }
+
+    /**
+     * @brief read value stored as given kind
+     *
+     * @return bool false if value is not stored as the kind
+     */
+    static bool readScalar(TypeLayout::Kind kind, const std::any &v, double &ret) {
+        using Kind = TypeLayout::Kind;
+        switch (kind) {
+        case Kind::BOOL:
+            return readAs<bool>(v, ret);
+        case Kind::I8:
+            return readAs<int8_t>(v, ret);
+        case Kind::U8:
+            return readAs<uint8_t>(v, ret);
+        case Kind::I16:
+            return readAs<int16_t>(v, ret);
+        case Kind::U16:
+            return readAs<uint16_t>(v, ret);
+        case Kind::I32:
+            return readAs<int32_t>(v, ret);
+        case Kind::U32:
+            return readAs<uint32_t>(v, ret);
+        case Kind::I64:
+            return readAs<int64_t>(v, ret);
+        case Kind::U64:
+            return readAs<uint64_t>(v, ret);
+        case Kind::F32:
+            return readAs<float>(v, ret);
+        case Kind::F64:
+            return readAs<double>(v, ret);
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief write value stored as given kind
+     *
+     * @return bool false if value is not stored as the kind
+     */
+    static bool writeScalar(TypeLayout::Kind kind, std::any &v, double tar) {
+        using Kind = TypeLayout::Kind;
+        switch (kind) {
+        case Kind::BOOL:
+            return writeAs<bool>(v, tar);
+        case Kind::I8:
+            return writeAs<int8_t>(v, tar);
+        case Kind::U8:
+            return writeAs<uint8_t>(v, tar);
+        case Kind::I16:
+            return writeAs<int16_t>(v, tar);
+        case Kind::U16:
+            return writeAs<uint16_t>(v, tar);
+        case Kind::I32:
+            return writeAs<int32_t>(v, tar);
+        case Kind::U32:
+            return writeAs<uint32_t>(v, tar);
+        case Kind::I64:
+            return writeAs<int64_t>(v, tar);
+        case Kind::U64:
+            return writeAs<uint64_t>(v, tar);
+        case Kind::F32:
+            return writeAs<float>(v, tar);
+        case Kind::F64:
+            return writeAs<double>(v, tar);
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief value in buffer
+     *
+     */
+    struct Slot {
+        /// @brief value held by the slot, empty while it refers to others
+        std::any value;
+        const TypeDescriptor *type;
+        /// @brief value referred, in DataStore or value of parent; nullptr if value is held by the slot
+        const std::any *view;
+        /// @brief token of value whose member or element is the slot, npos if none
+        size_t parent;
+        /// @brief slot or some member of it is written and not merged into parent yet
+        bool written;
+        /// @brief id in DataStore::strings if value is a string, see stringId
+        uint32_t id;
+        /// @brief {index in TypeDescriptor::members, token} taken from the slot
+        std::vector<std::tuple<size_t, size_t>> members;
+        /// @brief {index, token} taken from the slot
+        std::vector<std::tuple<size_t, size_t>> elements;
+    };
+
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t push(std::any value, const TypeDescriptor *type, const std::any *view = nullptr, size_t parent = npos) {
+        buffer.push_back(Slot{std::move(value), type, view, parent, false, StringTable::unknown, {}, {}});
+        return buffer.size() - 1;
+    }
+
+    static const std::string &memberName(const Slot &slot, size_t index) {
+        return std::get<0>(slot.type->members[index]);
+    }
+
+    /**
+     * @brief get id of string in DataStore::strings, looked up when first asked
+     *
+     */
+    uint32_t stringId(size_t index) {
+        auto &slot = buffer[index];
+        if (slot.id == StringTable::unknown) {
+            slot.id = data.strings.find(std::any_cast<const std::string &>(value(index)));
+        }
+        return slot.id;
+    }
+
+    const std::any &value(size_t index) const {
+        auto &slot = buffer[index];
+        return slot.view ? *slot.view : slot.value;
+    }
+
+    /**
+     * @brief mark the slot and its parents written, so they are merged by assemble
+     *
+     */
+    void markWritten(size_t index) {
+        for (auto p = index; p != npos && !buffer[p].written; p = buffer[p].parent) {
+            buffer[p].written = true;
+        }
+    }
+
+    /**
+     * @brief copy value referred into the slot, members taken from it refer to the copy then
+     *
+     */
+    void materialize(size_t index) {
+        auto &slot = buffer[index];
+        slot.value = *slot.view;
+        slot.view = nullptr;
+        refer(index);
+    }
+
+    /**
+     * @brief make members taken from the slot, which are not copied, refer to its value again
+     *
+     */
+    void refer(size_t index) {
+        auto &slot = buffer[index];
+        if (!slot.elements.empty()) {
+            auto &array = std::any_cast<const std::vector<std::any> &>(value(index));
+            for (auto &[i, token] : slot.elements) {
+                if (buffer[token].view) {
+                    buffer[token].view = &array[i];
+                    refer(token);
+                }
             }
-            relation[index].clear();
-            std::get<0>(buffer[index]) = std::move(tmp);
-            return std::get<0>(buffer[index]);
-        } else {
-            auto tmp = std::any_cast<CSValueMap>(std::move(v));
-            for (auto &&[name, ind] : relation[index]) {
-                tmp[name] = assemble(ind);
+        }
+        if (!slot.members.empty()) {
+            auto &record = std::any_cast<const CSValueMap &>(value(index));
+            for (auto &[i, token] : slot.members) {
+                if (buffer[token].view) {
+                    buffer[token].view = &record.find(memberName(slot, i))->second;
+                    refer(token);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief forget members taken from the slot before it is changed as a whole, they keep value of now
+     *
+     */
+    void detach(size_t index) {
+        auto &slot = buffer[index];
+        for (auto token : std::views::values(slot.members)) {
+            if (buffer[token].view) {
+                materialize(token);
+            }
+            buffer[token].parent = npos;
+        }
+        for (auto token : std::views::values(slot.elements)) {
+            if (buffer[token].view) {
+                materialize(token);
+            }
+            buffer[token].parent = npos;
+        }
+        slot.members.clear();
+        slot.elements.clear();
+    }
+
+    /**
+     * @brief get value of the slot with written members merged into it
+     *
+     */
+    const std::any &assemble(size_t index) {
+        auto &slot = buffer[index];
+        auto written = [this](auto &children) {
+            return std::ranges::any_of(std::views::values(children), [this](auto t) { return buffer[t].written; });
+        };
+        if (!written(slot.elements) && !written(slot.members)) {
+            return value(index);
+        }
+        if (slot.view) {
+            materialize(index);
+        }
+        for (auto &[i, token] : slot.elements) {
+            if (buffer[token].written) {
+                std::any_cast<std::vector<std::any> &>(slot.value)[i] = assemble(token);
+                buffer[token].written = false;
+            }
+        }
+        for (auto &[i, token] : slot.members) {
+            if (buffer[token].written) {
+                std::any_cast<CSValueMap &>(slot.value)[memberName(slot, i)] = assemble(token);
+                buffer[token].written = false;
+            }
+        }
+        return slot.value;
+    }
+
+    /**
+     * @brief check if members written of the slot are different from target, which the slot is read from
+     *
+     */
+    bool differs(size_t index, std::any &target) {
+        auto &slot = buffer[index];
+        if (!slot.written) {
+            return false;
+        }
+        if (!slot.view) {
+            return !tools::myany::anyEqual(assemble(index), target);
+        }
+        for (auto &[i, token] : slot.elements) {
+            if (differs(token, std::any_cast<std::vector<std::any> &>(target)[i])) {
+                return true;
+            }
+        }
+        for (auto &[i, token] : slot.members) {
+            auto &record = std::any_cast<CSValueMap &>(target);
+            auto it = record.find(memberName(slot, i));
+            if (buffer[token].written && (it == record.end() || differs(token, it->second))) {
+                return true;
             }
-            relation[index].clear();
-            std::get<0>(buffer[index]) = std::move(tmp);
-            return std::get<0>(buffer[index]);
         }
+        return false;
+    }
+
+    /**
+     * @brief copy members written of the slot into target, which the slot is read from
+     *
+     */
+    void patch(size_t index, std::any &target) {
+        auto &slot = buffer[index];
+        if (!slot.written) {
+            return;
+        }
+        if (!slot.view) {
+            assemble(index);
+            target = std::move(slot.value);
+            return;
+        }
+        for (auto &[i, token] : slot.elements) {
+            patch(token, std::any_cast<std::vector<std::any> &>(target)[i]);
+        }
+        for (auto &[i, token] : slot.members) {
+            patch(token, std::any_cast<CSValueMap &>(target)[memberName(slot, i)]);
+        }
+    }
+
+    /**
+     * @brief get value of the slot to change it as a whole
+     *
+     */
+    std::any &own(size_t index) {
+        if (buffer[index].view) {
+            materialize(index);
+        }
+        markWritten(index);
+        return buffer[index].value;
+    }
+
+    /**
+     * @brief get value of the slot to change its structure, members taken from it are forgotten
+     *
+     */
+    std::any &mutate(size_t index) {
+        assemble(index);
+        detach(index);
+        return own(index);
     }
+
+    size_t pinnedString;                         /**< number of strings pinned at head of buffer */
     std::map<std::string, size_t> managedString; /**< string managed by this context */
-    // {value, type}
-    std::vector<std::tuple<std::any, std::string>> buffer; /**< buffer for storing values */
-    // index -> {memberName, index}
-    std::map<size_t, std::map<std::string, size_t>> relation; /**< relation between values */
+    /// @brief buffer for storing values, a deque so slots are not moved when pushed
+    std::deque<Slot> buffer;
     // name -> index
     std::map<std::string, size_t> bufferMap; /**< map from input/output/cache value name to index in buffer */
-    // name -> value
+    // name -> value, of shared caches only
     std::unordered_map<std::string, std::any> originalValue;
+    /// @brief outputs and caches written back by other subrulesets too, see setShared
+    std::set<std::string> shared;
 };
 
-} // namespace rulejit::cq
\ No newline at end of file
+} // namespace rulejit::cq
@@ -14,12 +14,33 @@
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
  * <tr><td>djw</td><td>2023-03-29</td><td>Move XML-Parsering to frontend/ruleset</td></tr>
  * <tr><td>djw</td><td>2023-04-18</td><td>make every <Value> a single subruleset</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Resolve op codes, constant pool and local slots after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Compile closures after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Lower subrulesets to bytecode after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Compile subrulesets into native code in jit mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Name subrulesets, skip ones compiled in background.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Fill callees of user function calls at load time.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Inline small functions after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Fold constants after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Share subexpressions of conditions after build.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Build decision trees of subrulesets when enabled.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Reorder shortcut logical operators by selectivity profile.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Analyze variables accessed by subrulesets for incremental mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Compile typed storage after layout of data segment.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Tell handlers variables written back by more than one subruleset.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Intern string literals.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Describe types of variables.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Run ast passes shared with other backends.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Skip ast passes when turned off.</td></tr>
  * </table>
  */
 #include "cqrulesetengine.h"
 
 #include <iostream>
+#include <set>
 
+#include "backend/cq/cqresolver.hpp"
+#include "frontend/ruleset/astpasses.hpp"
 #include "frontend/ruleset/rulesetparser.h"
 #include "rapidxml-1.13/rapidxml.hpp"
 #include "tools/seterror.hpp"
@@ -34,27 +55,124 @@ void RuleSetEngine::buildFromSource(const std::string &srcXML) {
     // TODO: execute preDefines once to handle init value?
     auto [preDefines, preProcess, subRuleSets] = RuleSetParser::readSource(srcXML, context, dataStorage.metaInfo);
 
+    if (astPasses) {
+        runAstPasses(context.global, preProcess, subRuleSets, selectivityProfile, passReports);
+    }
+
     std::set<std::string> notGenerate{preProcess.begin(), preProcess.end()};
     notGenerate.emplace(preDefines);
 
+    size_t cnt = 0;
     for (auto &&name : preProcess) {
         notGenerate.insert(name);
-        preprocess.subRuleSets.emplace_back(context, dataStorage);
-        preprocess.subRuleSets.back().subruleset = std::move(context.global.realFuncDefinition[name]->returnValue);
+        auto &tmp = addSubRuleSet(preprocess);
+        tmp.subruleset = std::move(context.global.realFuncDefinition[name]->returnValue);
+        tmp.name = preProcessName(cnt++);
     }
 
     // for each subruleset node, store generated ast in ruleset
-    for (auto &&subRuleSetName : subRuleSets) {
-        notGenerate.insert(subRuleSetName);
-        ruleset.subRuleSets.emplace_back(context, dataStorage);
-        auto &tmp = ruleset.subRuleSets.back();
-        tmp.subruleset = std::move(context.global.realFuncDefinition[subRuleSetName]->returnValue);
+    cnt = 0;
+    for (auto &&name : subRuleSets) {
+        notGenerate.insert(name);
+        auto &tmp = addSubRuleSet(ruleset);
+        tmp.subruleset = std::move(context.global.realFuncDefinition[name]->returnValue);
+        tmp.name = subRuleSetName(cnt++);
     }
 
     std::erase_if(context.global.realFuncDefinition, [&](auto &tar) {
         // clear all func that represent a subruleset
         return notGenerate.contains(tar.first);
     });
+
+    // stamp op codes, collect literals and fill callees once at load time, so interpreter dispatches without
+    // string compare and only reads ast during ticks
+    CQResolver resolver(constantPool, context.global);
+    for (auto &sub : preprocess.subRuleSets) {
+        sub.subruleset | resolver;
+    }
+    for (auto &sub : ruleset.subRuleSets) {
+        sub.subruleset | resolver;
+    }
+    for (auto &[name, func] : context.global.realFuncDefinition) {
+        func | resolver;
+    }
+
+    // after resolving, so calls are classified as interpreter does
+    std::map<std::string, size_t> writers;
+    bool writesKnown = true;
+    for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+        for (auto &sub : ruleset->subRuleSets) {
+            AccessAnalyzer access(context.global, dataStorage.metaInfo);
+            sub.subruleset | access;
+            sub.incremental.setAccess(access, dataStorage);
+            for (auto &var : sub.incremental.getWrites()) {
+                writers[var]++;
+            }
+            writesKnown = writesKnown && access.complete;
+        }
+    }
+    // handlers refer to outputs and caches no one else writes back, and copy the others
+    std::set<std::string> shared;
+    for (auto *vars : {&dataStorage.metaInfo.outputVar, &dataStorage.metaInfo.cacheVar}) {
+        for (auto &var : *vars) {
+            if (!writesKnown || writers[var] > 1) {
+                shared.insert(var);
+            }
+        }
+    }
+    for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+        for (auto &sub : ruleset->subRuleSets) {
+            if (std::ranges::any_of(sub.incremental.getWrites(), [&](auto &var) { return writers[var] > 1; })) {
+                sub.incremental.setAlwaysDirty();
+            }
+        }
+    }
+    // before pinned, so literals are compared with strings in input by ids
+    dataStorage.internStrings(constantPool.strings);
+    dataStorage.types.registerAll();
+    for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+        for (auto &sub : ruleset->subRuleSets) {
+            sub.handler.pinStrings(constantPool.strings);
+            sub.handler.setShared(shared);
+            sub.closure.compile(sub.subruleset);
+        }
+    }
+    byteCodeProgram.buildLayout(dataStorage.metaInfo);
+    compileTypedStorage();
+    for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+        for (auto &sub : ruleset->subRuleSets) {
+            sub.bytecode.compile(context, constantPool, sub.subruleset, sub.name);
+        }
+    }
+    built = true;
+#ifdef __RULEJIT_CQ_JIT
+    if (mode == ExecutionMode::JIT) {
+        compileJIT();
+    }
+#endif // __RULEJIT_CQ_JIT
+}
+
+#ifdef __RULEJIT_CQ_JIT
+void RuleSetEngine::compileJIT() {
+    if (backgroundUsed) {
+        // queued ones are compiled here instead
+        BackgroundCompiler::instance().cancel(this);
+    }
+    for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+        for (auto &sub : ruleset->subRuleSets) {
+            auto state = sub.background.load(std::memory_order_acquire);
+            if (state == BackgroundState::READY || state == BackgroundState::FAILED) {
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            sub.jit.compile(context, constantPool, sub.subruleset, sub.name);
+            sub.jitCompileTime =
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            sub.background.store(sub.jit.isCompiled() ? BackgroundState::READY : BackgroundState::FAILED,
+                                 std::memory_order_release);
+        }
+    }
 }
+#endif // __RULEJIT_CQ_JIT
 
 } // namespace rulejit::cq
\ No newline at end of file
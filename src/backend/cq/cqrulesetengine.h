@@ -9,6 +9,22 @@
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-27</td><td>Initial version.</td></tr>
  * <tr><td>djw</td><td>2023-03-29</td><td>Add semantic support.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add constant pool.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add closure execution mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add bytecode execution mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add sequence profile of bytecode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add jit execution mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add tiered execution mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add report of constant folding.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add report of shared subexpressions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add selectivity profile of shortcut logical operators.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add incremental mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Run subrulesets of a tick on TickThreadPool in parallel mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add typed storage of variables.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keep inputs referred by buffers of a failed tick.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keep caches and outputs referred by buffers of a failed tick.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keep reports of ast passes together.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add setAstPasses and getInliningReport.</td></tr>
  * </table>
  */
 #pragma once
@@ -16,19 +32,30 @@
 #include "defines/marco.hpp"
 
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <list>
+#include <optional>
 #include "tools/stringprocess.hpp"
 #include <ranges>
-#ifdef __RULEJIT_PARALLEL_ENGINE
-#include <algorithm>
-#include <execution>
-#endif // __RULEJIT_PARALLEL_ENGINE
+#include <vector>
 
 #include "ast/context.hpp"
 #include "ast/decompiler.hpp"
+#include "backend/cq/cqbytecode.hpp"
+#include "backend/cq/cqclosure.hpp"
+#include "backend/cq/cqincremental.h"
 #include "backend/cq/cqinterpreter.hpp"
+#include "backend/cq/cqparallel.h"
+#include "backend/cq/cqresolver.hpp"
 #include "backend/cq/cqresourcehandler.h"
+#ifdef __RULEJIT_CQ_JIT
+#include "backend/cq/cqjit.h"
+#include "backend/cq/cqtiering.h"
+#endif // __RULEJIT_CQ_JIT
+#include "frontend/ruleset/astpasses.hpp"
+#include "frontend/ruleset/selectivity.hpp"
 
 namespace rulejit::cq {
 
@@ -41,9 +68,21 @@ struct SubRuleSet {
      *
      * @param context context which contains function defines.
      * @param dataStorage The DataStore object.
+     * @param pool constant pool shared by the whole rule set engine.
+     * @param program bytecode program shared by the whole rule set engine.
+     * @param jitProgram native code shared by the whole rule set engine.
      */
-    SubRuleSet(ContextStack &context, DataStore &dataStorage)
-        : handler(dataStorage), interpreter(context, handler), subruleset(nullptr) {}
+#ifdef __RULEJIT_CQ_JIT
+    SubRuleSet(ContextStack &context, DataStore &dataStorage, const ConstantPool &pool, ByteCodeProgram &program,
+               JITProgram &jitProgram)
+        : handler(dataStorage), interpreter(context, handler, &pool), closure(context, handler, &pool),
+          bytecode(dataStorage, program), jit(dataStorage, program, jitProgram), subruleset(nullptr), name(),
+          tiering(), background(BackgroundState::NONE), jitCompileTime(0), incremental() {}
+#else
+    SubRuleSet(ContextStack &context, DataStore &dataStorage, const ConstantPool &pool, ByteCodeProgram &program)
+        : handler(dataStorage), interpreter(context, handler, &pool), closure(context, handler, &pool),
+          bytecode(dataStorage, program), subruleset(nullptr), name(), incremental() {}
+#endif // __RULEJIT_CQ_JIT
     SubRuleSet() = delete;
     SubRuleSet(const SubRuleSet &) = delete;
     SubRuleSet(SubRuleSet &&) = delete;
@@ -54,8 +93,28 @@ struct SubRuleSet {
     ResourceHandler handler;
     /// @brief expression interpreter
     CQInterpreter interpreter;
+    /// @brief closure compiled from subruleset
+    CQClosureEngine closure;
+    /// @brief bytecode lowered from subruleset
+    CQByteCodeEngine bytecode;
+#ifdef __RULEJIT_CQ_JIT
+    /// @brief native code compiled from subruleset
+    CQJITEngine jit;
+#endif // __RULEJIT_CQ_JIT
     /// @brief subruleset AST
     std::unique_ptr<ExprAST> subruleset;
+    /// @brief unique name, used as symbol of compiled code
+    std::string name;
+#ifdef __RULEJIT_CQ_JIT
+    /// @brief statistics of tiered execution, only accessed by tick thread
+    TierStatistics tiering;
+    /// @brief state of compiling jit in background, jit and jitCompileTime are published by READY or FAILED
+    std::atomic<BackgroundState> background;
+    /// @brief time of compiling jit, in microseconds
+    double jitCompileTime;
+#endif // __RULEJIT_CQ_JIT
+    /// @brief variables accessed and last execution, used in incremental mode
+    IncrementalState incremental;
 };
 
 /**
@@ -69,11 +128,76 @@ struct RuleSet {
  * @brief Structure for rule set engine.
  */
 struct RuleSetEngine {
-    RuleSetEngine() : dataStorage(), ruleset(), context(), preprocess() {}
+    /**
+     * @brief how subrulesets are executed
+     *
+     */
+    enum class ExecutionMode {
+        /// walk ast by CQInterpreter
+        INTERPRETER,
+        /// run closures compiled by CQClosureEngine
+        CLOSURE,
+        /// run bytecode on ByteCodeVM, subrulesets which can not be lowered fall back to CQInterpreter
+        BYTECODE,
+#ifdef __RULEJIT_CQ_JIT
+        /// run native code compiled by CQJITEngine, subrulesets which can not be lowered fall back to CQInterpreter
+        JIT,
+        /// start in CQInterpreter, move hot subrulesets to bytecode and to jit compiled in background
+        TIERED,
+#endif // __RULEJIT_CQ_JIT
+    };
+
+#if (defined(__RULEJIT_CQ_TIERED_ENGINE) || defined(__RULEJIT_CQ_JIT_ENGINE)) && !defined(__RULEJIT_CQ_JIT)
+#error "jit and tiered engine are only built with CMake option RULEJIT_CQ_JIT"
+#endif
+
+#if defined(__RULEJIT_CQ_TIERED_ENGINE)
+    inline static constexpr ExecutionMode defaultExecutionMode = ExecutionMode::TIERED;
+#elif defined(__RULEJIT_CQ_JIT_ENGINE)
+    inline static constexpr ExecutionMode defaultExecutionMode = ExecutionMode::JIT;
+#elif defined(__RULEJIT_CQ_BYTECODE_ENGINE)
+    inline static constexpr ExecutionMode defaultExecutionMode = ExecutionMode::BYTECODE;
+#elif defined(__RULEJIT_CQ_CLOSURE_ENGINE)
+    inline static constexpr ExecutionMode defaultExecutionMode = ExecutionMode::CLOSURE;
+#else
+    inline static constexpr ExecutionMode defaultExecutionMode = ExecutionMode::INTERPRETER;
+#endif // __RULEJIT_CQ_TIERED_ENGINE
+#ifdef __RULEJIT_PARALLEL_ENGINE
+    inline static constexpr size_t defaultParallelism = 0;
+#else
+    inline static constexpr size_t defaultParallelism = 1;
+#endif // __RULEJIT_PARALLEL_ENGINE
+#ifdef __RULEJIT_CQ_INCREMENTAL_ENGINE
+    inline static constexpr bool defaultIncremental = true;
+#else
+    inline static constexpr bool defaultIncremental = false;
+#endif // __RULEJIT_CQ_INCREMENTAL_ENGINE
+#ifdef __RULEJIT_CQ_TYPED_STORAGE
+    inline static constexpr bool defaultTypedStorage = true;
+#else
+    inline static constexpr bool defaultTypedStorage = false;
+#endif // __RULEJIT_CQ_TYPED_STORAGE
+
+    RuleSetEngine()
+        : dataStorage(), ruleset(), context(), preprocess(), constantPool(), byteCodeProgram(),
+#ifdef __RULEJIT_CQ_JIT
+          jitProgram(), backgroundUsed(false), tieringOptions(),
+#endif // __RULEJIT_CQ_JIT
+          built(false), mode(defaultExecutionMode), passReports(), astPasses(true), selectivityProfile(),
+          incremental(false), parallelism(defaultParallelism), typedStorage(defaultTypedStorage) {
+        setIncremental(defaultIncremental);
+    }
     RuleSetEngine(const RuleSetEngine &) = delete;
     RuleSetEngine(RuleSetEngine &&) = delete;
     RuleSetEngine &operator=(const RuleSetEngine &) = delete;
     RuleSetEngine &operator=(RuleSetEngine &&) = delete;
+    ~RuleSetEngine() {
+#ifdef __RULEJIT_CQ_JIT
+        if (backgroundUsed) {
+            BackgroundCompiler::instance().cancel(this);
+        }
+#endif // __RULEJIT_CQ_JIT
+    }
 
     /**
      * @brief Build the rule set engine from the XML source.
@@ -101,7 +225,10 @@ struct RuleSetEngine {
      *
      * @return void.
      */
-    void init() { dataStorage.Init(); }
+    void init() {
+        dataStorage.Init();
+        invalidateIncremental();
+    }
 
     /**
      * @brief Execute a tick of the rule set engine.
@@ -110,6 +237,252 @@ struct RuleSetEngine {
      */
     void tick() { execute(); }
 
+    /**
+     * @brief select how subrulesets are executed, can be changed between ticks
+     * @attention subrulesets are compiled into native code when jit mode is selected the first time after build
+     *
+     * @param m execution mode
+     */
+    void setExecutionMode(ExecutionMode m) {
+        mode = m;
+        // returned value of last execution is kept by the engine of old mode
+        invalidateIncremental();
+#ifdef __RULEJIT_CQ_JIT
+        if (mode == ExecutionMode::JIT && built) {
+            compileJIT();
+        }
+#endif // __RULEJIT_CQ_JIT
+    }
+
+#ifdef __RULEJIT_CQ_JIT
+    /**
+     * @brief set thresholds of tiered mode, subrulesets already moved to hotter tier stay there
+     *
+     * @param options thresholds
+     */
+    void setTieringOptions(const TieringOptions &options) { tieringOptions = options; }
+#endif // __RULEJIT_CQ_JIT
+
+    /**
+     * @brief skip subrulesets whose variables read are not changed since last execution in following ticks,
+     * see cqincremental.h; can be changed between ticks
+     * @attention changes made to outputs or caches out of engine, like through getOutput, are not tracked
+     *
+     * @param on false to execute all subrulesets in each tick
+     */
+    void setIncremental(bool on) {
+        incremental = on;
+        dataStorage.trackChanges = on;
+        invalidateIncremental();
+    }
+
+    /**
+     * @brief run subrulesets of a tick on TickThreadPool in following ticks, see cqparallel.h; can be changed
+     * between ticks
+     * @attention DataStore must not be changed by other threads during a tick
+     *
+     * @param threads max count of threads running subrulesets of one engine, including tick thread;
+     * 1 to run on tick thread only, 0 to use all threads of TickThreadPool
+     */
+    void setParallelism(size_t threads) { parallelism = threads; }
+
+    /**
+     * @brief get max count of threads running subrulesets
+     *
+     * @return size_t 0 if all threads of TickThreadPool are used
+     */
+    size_t getParallelism() const { return parallelism; }
+
+    /**
+     * @brief keep variables of numerical types, and structs of them, in a flat record laid out as data segment of
+     * bytecode, see DataStore::compileSchema; bytecode and jit copy them without conversion, which is done in
+     * setInput, getOutput and CQInterpreter instead; can be changed between ticks
+     *
+     * @param on false to keep all variables in unordered maps
+     */
+    void setTypedStorage(bool on) {
+        typedStorage = on;
+        if (built) {
+            compileTypedStorage();
+        }
+    }
+
+    /**
+     * @brief get statistics of incremental mode of each subruleset, pre-process first
+     *
+     * @return std::vector<IncrementalStatistics>
+     */
+    std::vector<IncrementalStatistics> getIncrementalStatistics() {
+        std::vector<IncrementalStatistics> ret;
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                ret.push_back(s.incremental.getStatistics());
+            }
+        }
+        return ret;
+    }
+
+#ifdef __RULEJIT_CQ_JIT
+    /**
+     * @brief get thresholds of tiered mode
+     *
+     * @return const TieringOptions&
+     */
+    const TieringOptions &getTieringOptions() const { return tieringOptions; }
+
+    /**
+     * @brief get statistics of tiered mode of each subruleset, pre-process first
+     *
+     * @return std::vector<TierStatistics>
+     */
+    std::vector<TierStatistics> getTierStatistics() {
+        std::vector<TierStatistics> ret;
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                ret.push_back(s.tiering);
+            }
+        }
+        return ret;
+    }
+#endif // __RULEJIT_CQ_JIT
+
+    /**
+     * @brief run ast passes when built, on by default; turn off to check optimized results against plain ast
+     * @attention call before buildFromSource
+     *
+     * @param on run passes
+     */
+    void setAstPasses(bool on) { astPasses = on; }
+
+    /**
+     * @brief get calls inlined by FunctionInliner when built, one line per call
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getInliningReport() const { return passReports.inlining; }
+
+    /**
+     * @brief get expressions folded by ConstantFolder when built, one line per folded expression
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getFoldingReport() const { return passReports.folding; }
+
+    /**
+     * @brief get subexpressions of conditions shared by ConditionCSE when built, one line per temporary
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getSharingReport() const { return passReports.sharing; }
+
+    /**
+     * @brief count executed bytecode sequences in following ticks of bytecode mode
+     *
+     * @param on false to stop counting
+     */
+    void setSequenceProfiling(bool on) {
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                s.bytecode.setProfiling(on);
+            }
+        }
+    }
+
+    /**
+     * @brief get sequences counted by all subrulesets, which can be saved as a profile file
+     *
+     * @return std::string see bytecode::SequenceProfile::dump
+     */
+    std::string dumpSequenceProfile() {
+        bytecode::SequenceProfile profile;
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                profile.merge(s.bytecode.getSequenceProfile());
+            }
+        }
+        return profile.dump();
+    }
+
+    /**
+     * @brief fuse superinstructions selected by a recorded profile into bytecode
+     * @attention superinstructions only exist in threaded bytecode, so while any is selected, bytecode of following
+     * ticks is dispatched threaded instead of through registers; this is the only case fusion applies
+     *
+     * @param profileText content of profile file, see dumpSequenceProfile
+     * @return size_t count of superinstructions selected, 0 if profile is ill-formed
+     */
+    size_t loadSequenceProfile(const std::string &profileText) {
+        auto profile = bytecode::SequenceProfile::parse(profileText);
+        auto selected = profile.has_value() ? byteCodeProgram.context.setSuperinstructions(profile.value()) : 0;
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                s.bytecode.setThreaded(selected != 0);
+            }
+        }
+        return selected;
+    }
+
+    /**
+     * @brief record operands of "&&"/"||" in following ticks of interpreter mode
+     *
+     * @param on false to stop recording
+     */
+    void setSelectivityProfiling(bool on) {
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                s.interpreter.setProfiling(on);
+            }
+        }
+    }
+
+    /**
+     * @brief get operands of "&&"/"||" recorded by all subrulesets, which can be saved as a profile file
+     * @attention record on an engine built without selectivity profile, so chains are numbered as in source
+     *
+     * @return std::string see ruleset::SelectivityProfile::dump
+     */
+    std::string dumpSelectivityProfile() {
+        ruleset::SelectivityProfile profile;
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            for (auto &s : ruleset->subRuleSets) {
+                auto chains = ruleset::ShortCutChains::collect(s.subruleset);
+                for (size_t i = 0; i < chains.size(); i++) {
+                    auto &operands = profile.chains[{s.name, i}];
+                    for (auto &operand : chains[i].operands) {
+                        auto &o = operands.emplace_back();
+                        o.text = ruleset::SelectivityProfile::textOf(ruleset::ShortCutChains::slotOf(operand).get());
+                        if (auto stat = s.interpreter.getShortCutStatistics(operand.first); stat) {
+                            auto &side = (*stat)[operand.second];
+                            o.evaluated = side.evaluated;
+                            o.truthy = side.truthy;
+                            o.cost = side.cost;
+                        }
+                    }
+                }
+            }
+        }
+        return profile.dump();
+    }
+
+    /**
+     * @brief reorder operands of "&&"/"||" by a recorded profile in following builds
+     * @attention call before buildFromSource
+     *
+     * @param profileText content of profile file, see dumpSelectivityProfile
+     * @return bool false if profile is ill-formed
+     */
+    bool loadSelectivityProfile(const std::string &profileText) {
+        selectivityProfile = ruleset::SelectivityProfile::parse(profileText);
+        return selectivityProfile.has_value();
+    }
+
+    /**
+     * @brief get chains of "&&"/"||" reordered by ShortCutReorderer when built, one line per chain
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReorderingReport() const { return passReports.reordering; }
+
     /**
      * @brief Set the input data for the rule set engine.
      *
@@ -130,7 +503,7 @@ struct RuleSetEngine {
      *
      * @return const std::unordered_map<std::string, std::any>&
      */
-    const std::unordered_map<std::string, std::any> &getCache() { return dataStorage.cache; }
+    const std::unordered_map<std::string, std::any> &getCache() { return dataStorage.GetCache(); }
 
     /**
      * @brief get the input data from the rule set engine.
@@ -141,58 +514,274 @@ struct RuleSetEngine {
 
     std::vector<int> hitRules() {
         std::vector<int> ret;
+        auto returned = [this](SubRuleSet& s) {
+            if (mode == ExecutionMode::BYTECODE && s.bytecode.isExecuted()) {
+                return s.bytecode.getReturned();
+            }
+#ifdef __RULEJIT_CQ_JIT
+            if (mode == ExecutionMode::JIT && s.jit.isExecuted()) {
+                return s.jit.getReturned();
+            }
+            if (mode == ExecutionMode::TIERED) {
+                if (s.tiering.tier == Tier::JIT && s.jit.isExecuted()) {
+                    return s.jit.getReturned();
+                }
+                if (s.tiering.tier == Tier::BYTECODE && s.bytecode.isExecuted()) {
+                    return s.bytecode.getReturned();
+                }
+            }
+#endif // __RULEJIT_CQ_JIT
+            return mode == ExecutionMode::CLOSURE ? s.closure.getReturned() : s.interpreter.getReturned();
+        };
         for (auto& ruleset : preprocess.subRuleSets) {
-            ret.push_back(static_cast<int>(ruleset.interpreter.getReturned()));
+            ret.push_back(static_cast<int>(returned(ruleset)));
         }
         for (auto& ruleset : ruleset.subRuleSets) {
-            ret.push_back(static_cast<int>(ruleset.interpreter.getReturned()));
+            ret.push_back(static_cast<int>(returned(ruleset)));
         }
         return ret;
     }
 
   // private:
-    void execute() {
+    /**
+     * @brief add a subruleset, whose ast is not set yet
+     *
+     * @param target rule set which subruleset belongs to
+     * @return SubRuleSet&
+     */
+    SubRuleSet &addSubRuleSet(RuleSet &target) {
+#ifdef __RULEJIT_CQ_JIT
+        return target.subRuleSets.emplace_back(context, dataStorage, constantPool, byteCodeProgram, jitProgram);
+#else
+        return target.subRuleSets.emplace_back(context, dataStorage, constantPool, byteCodeProgram);
+#endif // __RULEJIT_CQ_JIT
+    }
+
+#ifdef __RULEJIT_CQ_JIT
+    /**
+     * @brief compile all subrulesets into native code if not compiled
+     *
+     */
+    void compileJIT();
+#endif // __RULEJIT_CQ_JIT
+
+    /**
+     * @brief compile or drop typed storage of DataStore, as typedStorage
+     *
+     */
+    void compileTypedStorage() {
+        if (!typedStorage) {
+            dataStorage.dropSchema();
+            return;
+        }
+        std::vector<std::tuple<std::string, size_t, const TypeLayout *>> vars;
+        for (auto &[name, var] : byteCodeProgram.externVars) {
+            vars.emplace_back(name, var.offset, var.layout);
+        }
+        // same offsets as data segment, whose access flags follow the variables
+        dataStorage.compileSchema(vars, byteCodeProgram.flagBase);
+    }
+
+    /**
+     * @brief execute all subrulesets in next tick of incremental mode
+     *
+     */
+    void invalidateIncremental() {
         for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
-#ifdef __RULEJIT_PARALLEL_ENGINE
-            std::foreach (std::execution::par_unseq, ruleset->subRuleSets.begin(), ruleset->subRuleSets.end(),
-                          [](auto &s) { s.subruleset | s.interpreter; });
-#else // __RULEJIT_PARALLEL_ENGINE
-            size_t cnt = 0;
             for (auto &s : ruleset->subRuleSets) {
-                try {
+                s.incremental.invalidate();
+            }
+        }
+    }
+
+#ifdef __RULEJIT_CQ_JIT
+    /**
+     * @brief execute subruleset in its tier, move it to hotter tier if it is hot enough
+     *
+     * @param s subruleset
+     */
+    void runTiered(SubRuleSet &s) {
+        auto &t = s.tiering;
+        if (t.tier != Tier::JIT) {
+            promote(s);
+        }
+        t.ticks[size_t(t.tier)]++;
+        bool executed = false;
+        if (t.tier == Tier::JIT) {
+            executed = s.jit.run();
+        } else if (t.tier == Tier::BYTECODE) {
+            executed = s.bytecode.run();
+        }
+        if (!executed) {
+            t.fallbacks += t.tier != Tier::INTERPRETER;
+            s.subruleset | s.interpreter;
+        }
+    }
+
+    /**
+     * @brief move subruleset to hotter tier between ticks, queue it to BackgroundCompiler when it becomes hot
+     *
+     * @param s subruleset
+     */
+    void promote(SubRuleSet &s) {
+        auto &t = s.tiering;
+        size_t total = 0;
+        for (auto cnt : t.ticks) {
+            total += cnt;
+        }
+        if (t.tier == Tier::INTERPRETER && total >= tieringOptions.bytecodeThreshold && s.bytecode.isCompiled()) {
+            t.tier = Tier::BYTECODE;
+        }
+        switch (s.background.load(std::memory_order_acquire)) {
+        case BackgroundState::NONE:
+            if (total >= tieringOptions.jitThreshold) {
+                s.background.store(BackgroundState::QUEUED, std::memory_order_relaxed);
+                backgroundUsed = true;
+                BackgroundCompiler::instance().submit(this, [this, &s] {
+                    auto start = std::chrono::steady_clock::now();
+                    s.jit.compile(context, constantPool, s.subruleset, s.name);
+                    s.jitCompileTime =
+                        std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+                    s.background.store(s.jit.isCompiled() ? BackgroundState::READY : BackgroundState::FAILED,
+                                       std::memory_order_release);
+                });
+            }
+            break;
+        case BackgroundState::READY:
+            t.tier = Tier::JIT;
+            t.jitCompileTime = s.jitCompileTime;
+            break;
+        case BackgroundState::FAILED:
+            t.jitFailed = true;
+            t.jitCompileTime = s.jitCompileTime;
+            break;
+        default:
+            break;
+        }
+    }
+#endif // __RULEJIT_CQ_JIT
+
+    /**
+     * @brief execute subruleset by the engine of current mode, skip it if it is clean in incremental mode
+     * @attention may be called by threads of TickThreadPool at the same time for different subrulesets
+     *
+     * @param s subruleset
+     */
+    void run(SubRuleSet &s) {
+        if (incremental) {
+            if (s.incremental.isClean(dataStorage)) {
+                // nothing to write back, outputs and returned value of last execution are kept
+                s.incremental.skipped();
+                return;
+            }
+            s.incremental.invalidate();
+        }
+        try {
+            if (mode == ExecutionMode::CLOSURE) {
+                s.closure.run();
+            } else if (mode == ExecutionMode::BYTECODE) {
+                if (!s.bytecode.run()) {
+                    s.subruleset | s.interpreter;
+                }
+#ifdef __RULEJIT_CQ_JIT
+            } else if (mode == ExecutionMode::JIT) {
+                if (!s.jit.run()) {
+                    s.subruleset | s.interpreter;
+                }
+            } else if (mode == ExecutionMode::TIERED) {
+                runTiered(s);
+#endif // __RULEJIT_CQ_JIT
+            } else {
+                s.subruleset | s.interpreter;
+            }
+        } catch (std::logic_error &e) {
+            throw e;
+        } catch (...) {
+            error("[Unhandled Exception]");
+        }
+        if (incremental) {
+            // before write back, so values read are recorded
+            s.incremental.executed(dataStorage);
+        }
+    }
+
+    /**
+     * @brief throw error of a failed subruleset with its context and core dump
+     *
+     * @param ruleset rule set which subruleset belongs to
+     * @param cnt index of subruleset in rule set
+     * @param s subruleset
+     * @param what message of error
+     */
+    [[noreturn]] void reportError(RuleSet *ruleset, size_t cnt, SubRuleSet &s, const std::string &what) {
+        using namespace std::views;
+        using namespace std::literals;
+        using namespace tools::mystr;
+        // values taken by the failed tick stay in buffers until next write back
+        for (auto &sub : ruleset->subRuleSets) {
+            sub.handler.keepValues();
+        }
+        Decompiler decompiler;
+        std::string name =
+            ruleset == &preprocess ? "pre processing" : "sub ruleset " + std::to_string(cnt) + "(zero-based)";
+        std::string info = what + "\n\nin "s + name + " when try to execute expression\n";
+        info += "decompiled context:\n";
+        auto &currentExpr = mode == ExecutionMode::CLOSURE ? s.closure.currentExpr : s.interpreter.currentExpr;
+        for (auto p : currentExpr | reverse | take(7)) {
+            info += ("    at context(decompiled): "s + decompiler.decompile(p) + "\n");
+        }
+        info += "Core dump: \n\n";
+        info += dataStorage.dump();
+        auto typeCheck = dataStorage.genTypeCheckInfo();
+        if (!typeCheck.empty()) {
+            info += "Type Check info: \n\n";
+            info += std::move(typeCheck);
+        }
+        error(info);
+    }
+
+    void execute() {
+        for (auto &ruleset : std::array<RuleSet *, 2>{&preprocess, &ruleset}) {
+            // values written into tables since last write back
+            dataStorage.syncRecord();
+            if (parallelism != 1 && ruleset->subRuleSets.size() > 1) {
+                // DataStore is only read until write back below
+                std::vector<SubRuleSet *> subRuleSets;
+                subRuleSets.reserve(ruleset->subRuleSets.size());
+                for (auto &s : ruleset->subRuleSets) {
+                    subRuleSets.push_back(&s);
+                }
+                std::vector<std::optional<std::string>> errors(subRuleSets.size());
+                TickThreadPool::instance().run(subRuleSets.size(), parallelism, [&](size_t i) {
                     try {
-                        s.subruleset | s.interpreter;
+                        run(*subRuleSets[i]);
                     } catch (std::logic_error &e) {
-                        throw e;
-                    } catch (...) {
-                        error("[Unhandled Exception]");
+                        errors[i] = e.what();
                     }
-                } catch (std::logic_error &e) {
-                    using namespace std::views;
-                    using namespace std::literals;
-                    using namespace tools::mystr;
-                    Decompiler decompiler;
-                    std::string name = ruleset == &preprocess ? "pre processing"
-                                                              : "sub ruleset " + std::to_string(cnt) + "(zero-based)";
-                    std::string info = e.what() + "\n\nin "s + name + " when try to execute expression\n";
-                    info += "decompiled context:\n";
-                    for (auto p : s.interpreter.currentExpr | reverse | take(7)) {
-                        info += ("    at context(decompiled): "s + decompiler.decompile(p) + "\n");
+                });
+                // report the first failed one, as in serial execution
+                for (size_t i = 0; i < errors.size(); i++) {
+                    if (errors[i]) {
+                        reportError(ruleset, i, *subRuleSets[i], *errors[i]);
                     }
-                    info += "Core dump: \n\n";
-                    info += dataStorage.dump();
-                    auto typeCheck = dataStorage.genTypeCheckInfo();
-                    if (!typeCheck.empty()) {
-                        info += "Type Check info: \n\n";
-                        info += std::move(typeCheck);
+                }
+            } else {
+                size_t cnt = 0;
+                for (auto &s : ruleset->subRuleSets) {
+                    try {
+                        run(s);
+                    } catch (std::logic_error &e) {
+                        reportError(ruleset, cnt, s, e.what());
                     }
-                    error(info);
+                    cnt++;
                 }
-                cnt++;
             }
-#endif // __RULEJIT_PARALLEL_ENGINE
             for (auto &s : ruleset->subRuleSets) {
                 s.handler.writeBack();
+                s.bytecode.writeBack();
+#ifdef __RULEJIT_CQ_JIT
+                s.jit.writeBack();
+#endif // __RULEJIT_CQ_JIT
                 s.interpreter.reset();
             }
         }
@@ -206,6 +795,34 @@ struct RuleSetEngine {
     ContextStack context;
     /// @brief pre-process subruleset, which will called tick() and writeBack() before all subruleset
     RuleSet preprocess;
+    /// @brief literals of all subruleset
+    ConstantPool constantPool;
+    /// @brief functions and data segment layout of bytecode
+    ByteCodeProgram byteCodeProgram;
+#ifdef __RULEJIT_CQ_JIT
+    /// @brief native code of subrulesets
+    JITProgram jitProgram;
+    /// @brief some subruleset is queued to BackgroundCompiler, may be set by threads of TickThreadPool
+    std::atomic<bool> backgroundUsed;
+    /// @brief thresholds of tiered mode
+    TieringOptions tieringOptions;
+#endif // __RULEJIT_CQ_JIT
+    /// @brief rule set is built from source
+    bool built;
+    /// @brief how subrulesets are executed
+    ExecutionMode mode;
+    /// @brief changes made by ast passes when built
+    ruleset::AstPassReports passReports;
+    /// @brief run ast passes in build
+    bool astPasses;
+    /// @brief profile applied in build
+    std::optional<ruleset::SelectivityProfile> selectivityProfile;
+    /// @brief skip subrulesets whose variables read are not changed
+    bool incremental;
+    /// @brief max count of threads running subrulesets, 1 for serial
+    size_t parallelism;
+    /// @brief keep variables of flat layout in typed storage of DataStore
+    bool typedStorage;
 };
 
 } // namespace rulejit::cq
\ No newline at end of file
@@ -0,0 +1,91 @@
+/**
+ * @file cqstringtable.h
+ * @author djw
+ * @brief CQ/Interpreter/StringTable
+ * @date 2026-10-17
+ *
+ * @details Includes StringTable, which gives each distinct string a 32-bit id, so strings looked up in the same
+ * table are compared by id.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rulejit::cq {
+
+/**
+ * @brief table of interned strings
+ *
+ */
+struct StringTable {
+    /// @brief id of string not looked up
+    static constexpr uint32_t unknown = UINT32_MAX;
+    /// @brief id of string looked up but not in table, which is different from all strings in table
+    static constexpr uint32_t absent = UINT32_MAX - 1;
+
+    StringTable() : ids(), names() {}
+    StringTable(const StringTable &) = delete;
+    StringTable &operator=(const StringTable &) = delete;
+
+    /**
+     * @brief add string into table if it is not in it
+     *
+     * @param s string
+     * @return uint32_t id of string
+     */
+    uint32_t intern(const std::string &s) {
+        auto [it, inserted] = ids.try_emplace(s, static_cast<uint32_t>(names.size()));
+        if (inserted) {
+            names.push_back(&it->first);
+        }
+        return it->second;
+    }
+
+    /**
+     * @brief find id of string
+     *
+     * @param s string
+     * @return uint32_t absent if string is not in table
+     */
+    uint32_t find(const std::string &s) const {
+        auto it = ids.find(s);
+        return it == ids.end() ? absent : it->second;
+    }
+
+    /**
+     * @brief get string through id
+     *
+     * @param id id returned by intern or find
+     * @return const std::string&
+     */
+    const std::string &str(uint32_t id) const { return *names[id]; }
+
+    size_t size() const { return names.size(); }
+
+    /**
+     * @brief check if two strings are equal through their ids, without comparing characters
+     *
+     * @param lhs id of string looked up in this table, or unknown
+     * @param rhs id of string looked up in this table, or unknown
+     * @return bool false if it can not be told by ids
+     */
+    static bool comparable(uint32_t lhs, uint32_t rhs) {
+        return lhs != unknown && rhs != unknown && (lhs != absent || rhs != absent);
+    }
+
+  private:
+    std::unordered_map<std::string, uint32_t> ids;
+    /// @brief keys of ids in order of id, node keys of unordered_map are never moved
+    std::vector<const std::string *> names;
+};
+
+} // namespace rulejit::cq
@@ -0,0 +1,71 @@
+/**
+ * @file cqtiering.cpp
+ * @author djw
+ * @brief CQ/Interpreter/Tiering
+ * @date 2026-10-17
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include "cqtiering.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace rulejit::cq {
+
+BackgroundCompiler &BackgroundCompiler::instance() {
+    static BackgroundCompiler compiler;
+    return compiler;
+}
+
+BackgroundCompiler::BackgroundCompiler() : mutex(), cv(), jobs(), running(nullptr), stop(false), worker() {
+    worker = std::thread([this] { work(); });
+}
+
+BackgroundCompiler::~BackgroundCompiler() {
+    {
+        std::lock_guard lock(mutex);
+        stop = true;
+        jobs.clear();
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+void BackgroundCompiler::submit(const void *owner, std::function<void()> job) {
+    {
+        std::lock_guard lock(mutex);
+        jobs.emplace_back(owner, std::move(job));
+    }
+    cv.notify_all();
+}
+
+void BackgroundCompiler::cancel(const void *owner) {
+    std::unique_lock lock(mutex);
+    std::erase_if(jobs, [owner](auto &job) { return std::get<0>(job) == owner; });
+    cv.wait(lock, [this, owner] { return running != owner; });
+}
+
+void BackgroundCompiler::work() {
+    std::unique_lock lock(mutex);
+    while (true) {
+        cv.wait(lock, [this] { return stop || !jobs.empty(); });
+        if (stop) {
+            return;
+        }
+        auto [owner, job] = std::move(jobs.front());
+        jobs.pop_front();
+        running = owner;
+        lock.unlock();
+        job();
+        lock.lock();
+        running = nullptr;
+        cv.notify_all();
+    }
+}
+
+} // namespace rulejit::cq
@@ -0,0 +1,134 @@
+/**
+ * @file cqtiering.h
+ * @author djw
+ * @brief CQ/Interpreter/Tiering
+ * @date 2026-10-17
+ *
+ * @details Includes thresholds and statistics of tiered execution, and BackgroundCompiler, which compiles hot
+ * subrulesets off the tick thread.
+ *
+ * In tiered mode every subruleset starts in CQInterpreter. After TieringOptions::bytecodeThreshold ticks it runs
+ * the bytecode lowered at build, after TieringOptions::jitThreshold ticks it is queued to BackgroundCompiler, and
+ * the native code is swapped in at the start of the first tick after compiling finished.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <tuple>
+
+namespace rulejit::cq {
+
+/**
+ * @brief tier a subruleset is executed in, ordered from cold to hot
+ *
+ */
+enum class Tier : size_t {
+    INTERPRETER,
+    BYTECODE,
+    JIT,
+    // count of tiers
+    END,
+};
+
+/**
+ * @brief thresholds of tiered execution
+ *
+ */
+struct TieringOptions {
+    /// @brief ticks in CQInterpreter before running bytecode, 0 to start in bytecode
+    size_t bytecodeThreshold = 2;
+    /// @brief ticks before compiling into native code in background, SIZE_MAX to never
+    size_t jitThreshold = 1000;
+};
+
+/**
+ * @brief statistics of tiered execution of one subruleset
+ *
+ */
+struct TierStatistics {
+    /// @brief tier the subruleset is executed in now
+    Tier tier = Tier::INTERPRETER;
+    /// @brief ticks executed by each tier, including ticks which fall back to CQInterpreter
+    std::array<size_t, size_t(Tier::END)> ticks{};
+    /// @brief ticks of bytecode or jit tier executed by CQInterpreter instead
+    size_t fallbacks = 0;
+    /// @brief time of compiling into native code, in microseconds
+    double jitCompileTime = 0;
+    /// @brief subruleset can not be compiled into native code
+    bool jitFailed = false;
+};
+
+/**
+ * @brief state of compiling one subruleset in background
+ *
+ */
+enum class BackgroundState : int {
+    /// not queued
+    NONE,
+    /// queued or being compiled
+    QUEUED,
+    /// compiled, can be swapped in
+    READY,
+    /// can not be compiled
+    FAILED,
+};
+
+/**
+ * @brief process wide worker thread compiling hot subrulesets of all rule set engines, one by one
+ *
+ */
+struct BackgroundCompiler {
+    /**
+     * @brief get the worker, which is started when first used
+     *
+     * @return BackgroundCompiler&
+     */
+    static BackgroundCompiler &instance();
+
+    BackgroundCompiler(const BackgroundCompiler &) = delete;
+    BackgroundCompiler &operator=(const BackgroundCompiler &) = delete;
+    ~BackgroundCompiler();
+
+    /**
+     * @brief queue job
+     *
+     * @param owner key used to cancel jobs, e.g. rule set engine
+     * @param job compile job, which must not throw
+     */
+    void submit(const void *owner, std::function<void()> job);
+
+    /**
+     * @brief drop jobs of owner in queue and wait for the running one of owner
+     *
+     * @param owner key passed to submit
+     */
+    void cancel(const void *owner);
+
+  private:
+    BackgroundCompiler();
+    void work();
+
+    std::mutex mutex;
+    /// @brief notifies worker of new job or stop, and cancel of finished job
+    std::condition_variable cv;
+    std::deque<std::tuple<const void *, std::function<void()>>> jobs;
+    /// @brief owner of running job, nullptr if idle
+    const void *running;
+    bool stop;
+    std::thread worker;
+};
+
+} // namespace rulejit::cq
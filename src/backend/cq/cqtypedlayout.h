@@ -0,0 +1,225 @@
+/**
+ * @file cqtypedlayout.h
+ * @author djw
+ * @brief CQ/Interpreter/TypedLayout
+ * @date 2026-10-17
+ *
+ * @details Includes TypeLayout, the flat layout of a xml type computed by dynamicstruct::StructLayoutManager, and
+ * conversion between values in CSValueMap and their flat form. Shared by the data segment of bytecode and the typed
+ * storage of DataStore, which use the same layout, so variables are copied between them without conversion.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version, moved from cqbytecode.hpp.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <any>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+namespace rulejit::cq {
+
+/**
+ * @brief flat layout of a xml type
+ *
+ */
+struct TypeLayout {
+    using CSValueMap = std::unordered_map<std::string, std::any>;
+
+    enum class Kind {
+        BOOL,
+        I8,
+        U8,
+        I16,
+        U16,
+        I32,
+        U32,
+        I64,
+        U64,
+        F32,
+        F64,
+        // string, array..., takes place but never accessed by bytecode
+        OPAQUE,
+        STRUCT,
+    } kind;
+    /// @brief type name in StructLayoutManager
+    std::string layoutName;
+    /// @brief {member name, offset, layout} of struct
+    std::vector<std::tuple<std::string, size_t, const TypeLayout *>> members;
+    /// @brief size in bytes
+    size_t size;
+    /// @brief numerical, or struct whose members are all flat, so the whole value is held by its layout
+    bool flat;
+
+    bool isNumerical() const { return kind < Kind::OPAQUE; }
+
+    /**
+     * @brief copy value into flat form
+     *
+     * @param dst flat form
+     * @param v value
+     * @return bool false if value is not of the type
+     */
+    bool pack(uint8_t *dst, const std::any &v) const {
+        switch (kind) {
+        case Kind::BOOL:
+            return packAs<bool>(dst, v);
+        case Kind::I8:
+            return packAs<int8_t>(dst, v);
+        case Kind::U8:
+            return packAs<uint8_t>(dst, v);
+        case Kind::I16:
+            return packAs<int16_t>(dst, v);
+        case Kind::U16:
+            return packAs<uint16_t>(dst, v);
+        case Kind::I32:
+            return packAs<int32_t>(dst, v);
+        case Kind::U32:
+            return packAs<uint32_t>(dst, v);
+        case Kind::I64:
+            return packAs<int64_t>(dst, v);
+        case Kind::U64:
+            return packAs<uint64_t>(dst, v);
+        case Kind::F32:
+            return packAs<float>(dst, v);
+        case Kind::F64:
+            return packAs<double>(dst, v);
+        case Kind::OPAQUE:
+            return true;
+        case Kind::STRUCT: {
+            auto p = std::any_cast<CSValueMap>(&v);
+            if (!p) {
+                return false;
+            }
+            for (auto &[name, offset, memberLayout] : members) {
+                auto it = p->find(name);
+                if (it == p->end() || !memberLayout->pack(dst + offset, it->second)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        }
+        return false;
+    }
+
+    /**
+     * @brief make value from flat form, members not held by layout are copied from original
+     *
+     * @param src flat form
+     * @param original value before, may be empty if the layout is flat
+     * @return std::any
+     */
+    std::any unpack(const uint8_t *src, const std::any &original) const {
+        switch (kind) {
+        case Kind::BOOL:
+            return unpackAs<bool>(src);
+        case Kind::I8:
+            return unpackAs<int8_t>(src);
+        case Kind::U8:
+            return unpackAs<uint8_t>(src);
+        case Kind::I16:
+            return unpackAs<int16_t>(src);
+        case Kind::U16:
+            return unpackAs<uint16_t>(src);
+        case Kind::I32:
+            return unpackAs<int32_t>(src);
+        case Kind::U32:
+            return unpackAs<uint32_t>(src);
+        case Kind::I64:
+            return unpackAs<int64_t>(src);
+        case Kind::U64:
+            return unpackAs<uint64_t>(src);
+        case Kind::F32:
+            return unpackAs<float>(src);
+        case Kind::F64:
+            return unpackAs<double>(src);
+        case Kind::STRUCT: {
+            auto p = std::any_cast<CSValueMap>(&original);
+            auto ret = p ? *p : CSValueMap{};
+            for (auto &[name, offset, memberLayout] : members) {
+                auto &member = ret[name];
+                member = memberLayout->unpack(src + offset, member);
+            }
+            return ret;
+        }
+        default:
+            return original;
+        }
+    }
+
+    /**
+     * @brief compare two flat forms member by member, same as tools::myany::anyEqual of their values
+     * @attention only for flat layout
+     *
+     * @return bool
+     */
+    bool equal(const uint8_t *lhs, const uint8_t *rhs) const {
+        switch (kind) {
+        case Kind::BOOL:
+            return equalAs<bool>(lhs, rhs);
+        case Kind::I8:
+            return equalAs<int8_t>(lhs, rhs);
+        case Kind::U8:
+            return equalAs<uint8_t>(lhs, rhs);
+        case Kind::I16:
+            return equalAs<int16_t>(lhs, rhs);
+        case Kind::U16:
+            return equalAs<uint16_t>(lhs, rhs);
+        case Kind::I32:
+            return equalAs<int32_t>(lhs, rhs);
+        case Kind::U32:
+            return equalAs<uint32_t>(lhs, rhs);
+        case Kind::I64:
+            return equalAs<int64_t>(lhs, rhs);
+        case Kind::U64:
+            return equalAs<uint64_t>(lhs, rhs);
+        case Kind::F32:
+            return equalAs<float>(lhs, rhs);
+        case Kind::F64:
+            return equalAs<double>(lhs, rhs);
+        case Kind::STRUCT:
+            for (auto &[name, offset, memberLayout] : members) {
+                if (!memberLayout->equal(lhs + offset, rhs + offset)) {
+                    return false;
+                }
+            }
+            return true;
+        default:
+            return false;
+        }
+    }
+
+  private:
+    template <typename T> static bool packAs(uint8_t *dst, const std::any &v) {
+        auto p = std::any_cast<T>(&v);
+        if (!p) {
+            return false;
+        }
+        std::memcpy(dst, p, sizeof(T));
+        return true;
+    }
+
+    template <typename T> static std::any unpackAs(const uint8_t *src) {
+        T ret;
+        std::memcpy(&ret, src, sizeof(T));
+        return ret;
+    }
+
+    template <typename T> static bool equalAs(const uint8_t *lhs, const uint8_t *rhs) {
+        T l, r;
+        std::memcpy(&l, lhs, sizeof(T));
+        std::memcpy(&r, rhs, sizeof(T));
+        return l == r;
+    }
+};
+
+} // namespace rulejit::cq
@@ -0,0 +1,174 @@
+/**
+ * @file cqtyperegistry.h
+ * @author djw
+ * @brief CQ/Interpreter/TypeRegistry
+ * @date 2026-10-17
+ *
+ * @details Includes TypeRegistry, which describes each xml type by a TypeDescriptor computed once, so kind, element
+ * type and members of a value are known without looking up its type name.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Find members by index.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "backend/cq/cqtypedlayout.h"
+#include "frontend/ruleset/rulesetparser.h"
+
+namespace rulejit::cq {
+
+/**
+ * @brief precomputed information of a xml type
+ *
+ */
+struct TypeDescriptor {
+    enum class Kind : uint8_t {
+        NUMBER,
+        STRING,
+        ARRAY,
+        STRUCT,
+        // struct not defined yet
+        UNDEFINED,
+    };
+
+    /// @brief xml type name
+    std::string name;
+    /// @brief index in TypeRegistry
+    uint32_t id;
+    Kind kind;
+    /// @brief storage of number, OPAQUE if it is not one of TypeLayout
+    TypeLayout::Kind scalar;
+    /// @brief element type of array
+    const TypeDescriptor *element;
+    /// @brief {member name, member type} of struct, in order of definition, so index of a member is known at load time
+    std::vector<std::tuple<std::string, const TypeDescriptor *>> members;
+
+    bool isNumber() const { return kind == Kind::NUMBER; }
+    bool isString() const { return kind == Kind::STRING; }
+    bool isArray() const { return kind == Kind::ARRAY; }
+
+    /**
+     * @brief find index of a member, only for member names not resolved at load time
+     *
+     * @param member member name
+     * @return size_t members.size() if not a member
+     */
+    size_t memberIndex(const std::string &member) const {
+        for (size_t i = 0; i < members.size(); i++) {
+            if (std::get<0>(members[i]) == member) {
+                return i;
+            }
+        }
+        return members.size();
+    }
+};
+
+/**
+ * @brief descriptors of xml types, each type has one descriptor, so types are compared by address
+ *
+ * Types of variables and type defines are described by registerAll when the rule set is built, and never changed
+ * then, so they are found without lock by subrulesets running in parallel; other types like arrays of arrays are
+ * described when first asked, under lock.
+ *
+ */
+struct TypeRegistry {
+    TypeRegistry(const ruleset::RuleSetMetaInfo &metaInfo)
+        : metaInfo(metaInfo), descriptors(), registered(), mutex(), added() {}
+    TypeRegistry(const TypeRegistry &) = delete;
+    TypeRegistry &operator=(const TypeRegistry &) = delete;
+
+    /**
+     * @brief get descriptor of a type
+     *
+     * @param name xml type name
+     * @return const TypeDescriptor*
+     */
+    const TypeDescriptor *get(const std::string &name) {
+        if (auto it = registered.find(name); it != registered.end()) {
+            return it->second;
+        }
+        std::lock_guard lock(mutex);
+        return describe(name, added);
+    }
+
+    /**
+     * @brief describe base types, type defines, types of variables and arrays of them
+     * @attention must not be called during ticks
+     *
+     */
+    void registerAll() {
+        std::lock_guard lock(mutex);
+        // descriptors keep addresses, only lookup tables are rebuilt
+        registered.merge(added);
+        for (auto &base : ruleset::baseData) {
+            describe(base + "[]", registered);
+        }
+        for (auto &[name, members] : metaInfo.typeDefines) {
+            describe(name + "[]", registered);
+        }
+        for (auto &[var, type] : metaInfo.varType) {
+            describe(type, registered);
+        }
+    }
+
+  private:
+    const TypeDescriptor *describe(const std::string &name, std::unordered_map<std::string, TypeDescriptor *> &table) {
+        using Kind = TypeLayout::Kind;
+        static const std::unordered_map<std::string, Kind> scalars{
+            {"bool", Kind::BOOL},   {"int8", Kind::I8},       {"uint8", Kind::U8},      {"int16", Kind::I16},
+            {"uint16", Kind::U16},  {"int32", Kind::I32},     {"uint32", Kind::U32},    {"int64", Kind::I64},
+            {"uint64", Kind::U64},  {"float32", Kind::F32},   {"float64", Kind::F64},
+        };
+        if (auto it = registered.find(name); it != registered.end()) {
+            return it->second;
+        }
+        if (auto it = added.find(name); it != added.end()) {
+            return it->second;
+        }
+        auto id = static_cast<uint32_t>(descriptors.size());
+        auto &ret = descriptors.emplace_back(
+            TypeDescriptor{name, id, TypeDescriptor::Kind::UNDEFINED, Kind::OPAQUE, nullptr, {}});
+        // added before members, so recursive struct refers to itself
+        table[name] = &ret;
+        if (name.ends_with("[]")) {
+            ret.kind = TypeDescriptor::Kind::ARRAY;
+            ret.element = describe(name.substr(0, name.size() - 2), table);
+        } else if (name == "string") {
+            ret.kind = TypeDescriptor::Kind::STRING;
+        } else if (ruleset::baseNumericalData.contains(name)) {
+            ret.kind = TypeDescriptor::Kind::NUMBER;
+            if (auto it = scalars.find(name); it != scalars.end()) {
+                ret.scalar = it->second;
+            }
+        } else if (auto it = metaInfo.typeDefines.find(name); it != metaInfo.typeDefines.end()) {
+            ret.kind = TypeDescriptor::Kind::STRUCT;
+            for (auto &[member, type] : it->second) {
+                ret.members.emplace_back(member, describe(type, table));
+            }
+        }
+        return &ret;
+    }
+
+    const ruleset::RuleSetMetaInfo &metaInfo;
+    /// @brief a deque, so descriptors are not moved when added
+    std::deque<TypeDescriptor> descriptors;
+    /// @brief described by registerAll, only read during ticks
+    std::unordered_map<std::string, TypeDescriptor *> registered;
+    std::mutex mutex;
+    /// @brief described during ticks, guarded by mutex
+    std::unordered_map<std::string, TypeDescriptor *> added;
+};
+
+} // namespace rulejit::cq
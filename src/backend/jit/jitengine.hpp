@@ -1,20 +1,23 @@
 /**
  * @file jitengine.hpp
  * @author djw
- * @brief
+ * @brief Backend/JIT/Engine
  * @date 2023-03-28
  *
- * @details
+ * @details Includes ORCJIT, a thin wrapper of ORC which compiles LLVM modules into native code of current process.
  *
  * @par history
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-28</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Rename to ORCJIT, initialize native target and look up address.</td></tr>
  * </table>
  */
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <mutex>
 
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/Orc/CompileUtils.h"
@@ -27,13 +30,18 @@
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/LLVMContext.h"
+#include "llvm/Support/TargetSelect.h"
 
 namespace rulejit::jit::engine {
 
 using namespace llvm;
 using namespace llvm::orc;
 
-class KaleidoscopeJIT {
+/**
+ * @brief compile modules added into native code, symbols of current process are visible to them
+ *
+ */
+class ORCJIT {
   private:
     std::unique_ptr<ExecutionSession> ES;
 
@@ -46,7 +54,7 @@ class KaleidoscopeJIT {
     JITDylib &MainJD;
 
   public:
-    KaleidoscopeJIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB, DataLayout DL)
+    ORCJIT(std::unique_ptr<ExecutionSession> ES, JITTargetMachineBuilder JTMB, DataLayout DL)
         : ES(std::move(ES)), DL(std::move(DL)), Mangle(*this->ES, this->DL),
           ObjectLayer(*this->ES, []() { return std::make_unique<SectionMemoryManager>(); }),
           CompileLayer(*this->ES, ObjectLayer, std::make_unique<ConcurrentIRCompiler>(std::move(JTMB))),
@@ -54,12 +62,18 @@ class KaleidoscopeJIT {
         MainJD.addGenerator(cantFail(DynamicLibrarySearchGenerator::GetForCurrentProcess(DL.getGlobalPrefix())));
     }
 
-    ~KaleidoscopeJIT() {
+    ~ORCJIT() {
         if (auto Err = ES->endSession())
             ES->reportError(std::move(Err));
     }
 
-    static Expected<std::unique_ptr<KaleidoscopeJIT>> Create() {
+    static Expected<std::unique_ptr<ORCJIT>> Create() {
+        static std::once_flag initialized;
+        std::call_once(initialized, [] {
+            InitializeNativeTarget();
+            InitializeNativeTargetAsmPrinter();
+        });
+
         auto EPC = SelfExecutorProcessControl::Create();
         if (!EPC)
             return EPC.takeError();
@@ -72,7 +86,7 @@ class KaleidoscopeJIT {
         if (!DL)
             return DL.takeError();
 
-        return std::make_unique<KaleidoscopeJIT>(std::move(ES), std::move(JTMB), std::move(*DL));
+        return std::make_unique<ORCJIT>(std::move(ES), std::move(JTMB), std::move(*DL));
     }
 
     const DataLayout &getDataLayout() const { return DL; }
@@ -86,6 +100,19 @@ class KaleidoscopeJIT {
     }
 
     Expected<JITEvaluatedSymbol> lookup(StringRef Name) { return ES->lookup({&MainJD}, Mangle(Name.str())); }
+
+    /**
+     * @brief look up symbol and materialize it
+     *
+     * @param Name unmangled symbol
+     * @return Expected<uint64_t> address of symbol
+     */
+    Expected<uint64_t> lookupAddress(StringRef Name) {
+        auto Sym = lookup(Name);
+        if (!Sym)
+            return Sym.takeError();
+        return static_cast<uint64_t>(Sym->getAddress());
+    }
 };
 
 } // namespace rulejit::jit::engine
\ No newline at end of file
@@ -1,5 +1,20 @@
+/**
+ * @file bytecode.cpp
+ * @author djw
+ * @brief
+ * @date 2023-09-18
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2023-09-18</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Execute linked text segment, add data segment and native calls.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Move system calls out of switch dispatch, shared with threaded dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Select register dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record executed sequences in profile dispatch.</td></tr>
+ * </table>
+ */
 #include <chrono>
-#include <expected>
 
 #include "bytecode.h"
 
@@ -86,7 +101,7 @@ std::string Function::decompile() const {
     for (size_t i = 0; i < constTableInfo.compileTimeConstant.size() * 4; ++i) {
         ret += std::format("{:#x} ", reinterpret_cast<const uint8_t*>(constTableInfo.compileTimeConstant.data())[i]);
     }
-    ret += std::format("\n    stack frame size: {} byte\n\n", varTableInfo.stackFrameType->getLayout().size);
+    ret += std::format("\n    stack frame size: {} byte\n\n", varTableInfo.byteSize);
     for (size_t i = 0; i < code.size(); i++) {
         auto opCode = code[i].opCode;
         auto opCodeName = OPCode(opCode).getName();
@@ -114,17 +129,24 @@ std::string Function::decompile() const {
             attachedInfo = std::format("({})", UnaryOP(data).getName());
         } else if (opCode == OPCode::SYSCALL) {
             attachedInfo = std::format("({})", SystemCall(data).getName());
-        }else if (opCode == OPCode::TYPE_TRANS) {
+        } else if (opCode == OPCode::TYPE_TRANS) {
             attachedInfo = std::format("({})", DataType(data).getName());
-        } 
+        } else if (opCode == OPCode::LOAD_CONST && data < constTableInfo.linkedFunctionCount * sizeof(MemUnit)) {
+            attachedInfo = std::format("({})", symbol[data / sizeof(MemUnit)]);
+        }
         std::string dataStr;
         if (opCode == OPCode::LOAD_IMM) {
             dataStr = std::format("{:#010x}", data);
+        } else if (opCode == OPCode::BEZ || opCode == OPCode::BNZ || opCode == OPCode::BRANCH) {
+            // relative to next instruction
+            dataStr = std::format("{:>10}", std::bit_cast<ByteCode::TypedData>(data));
         } else if (opCode == OPCode::COPY || opCode == OPCode::LOAD_VAR || opCode == OPCode::LOAD_CONST ||
                    opCode == OPCode::LOAD_MEM || opCode == OPCode::STORE_VAR || opCode == OPCode::STORE_MEM ||
                    opCode == OPCode::VAR_ADDRESS || opCode == OPCode::CONST_ADDRESS || opCode == OPCode::BIN_OP ||
                    opCode == OPCode::UNARY_OP || opCode == OPCode::SYSCALL || opCode == OPCode::BEZ ||
-                   opCode == OPCode::CALL || opCode == OPCode::RET) {
+                   opCode == OPCode::BNZ || opCode == OPCode::BRANCH || opCode == OPCode::CALL ||
+                   opCode == OPCode::RET || opCode == OPCode::LOAD_GLOBAL || opCode == OPCode::STORE_GLOBAL ||
+                   opCode == OPCode::CALL_NATIVE) {
             dataStr = std::format("{:>10}", data);
         } else {
             dataStr = "          ";
@@ -170,8 +192,14 @@ uint64_t ByteCodeVM::applyUnaryop(uint64_t lhs, DataType::Type type, UnaryOP::Ty
                 lhs = std::bit_cast<uint64_t>(-a);
             }
         });
+        break;
     case UnaryOP::NOT:
-        lhs = !lhs;
+        // result is always U64, -0.0 is false as well
+        if (type == DataType::F64) {
+            lhs = std::bit_cast<double_t>(lhs) == 0;
+        } else {
+            lhs = !lhs;
+        }
         break;
     default:
         err = Error::ILLEGAL_OP;
@@ -196,7 +224,8 @@ uint64_t ByteCodeVM::applyBinop(uint64_t lhs, uint64_t rhs, DataType::Type type,
         break;
     case BinaryOP::DIV:
         err = registerTypeVisit(rhs, type, [&lhs, this](auto rhs) {
-            if (rhs == 0) {
+            // float division follows IEEE 754
+            if (!std::is_same_v<decltype(rhs), double_t> && rhs == 0) {
                 this->err = Error::DIVIDED_ZERO;
                 return;
             }
@@ -257,6 +286,18 @@ uint64_t ByteCodeVM::applyBinop(uint64_t lhs, uint64_t rhs, DataType::Type type,
         err = registerTypeVisit(
             rhs, type, [&lhs](auto rhs) { lhs = static_cast<uint64_t>(std::bit_cast<decltype(rhs)>(lhs) == rhs); });
         break;
+    case BinaryOP::NEQ:
+        err = registerTypeVisit(
+            rhs, type, [&lhs](auto rhs) { lhs = static_cast<uint64_t>(std::bit_cast<decltype(rhs)>(lhs) != rhs); });
+        break;
+    case BinaryOP::LT:
+        err = registerTypeVisit(
+            rhs, type, [&lhs](auto rhs) { lhs = static_cast<uint64_t>(std::bit_cast<decltype(rhs)>(lhs) < rhs); });
+        break;
+    case BinaryOP::LE:
+        err = registerTypeVisit(
+            rhs, type, [&lhs](auto rhs) { lhs = static_cast<uint64_t>(std::bit_cast<decltype(rhs)>(lhs) <= rhs); });
+        break;
     default:
         err = Error::ILLEGAL_OP;
         break;
@@ -264,18 +305,108 @@ uint64_t ByteCodeVM::applyBinop(uint64_t lhs, uint64_t rhs, DataType::Type type,
     return lhs;
 }
 
-int ByteCodeVM::execute() {
-    while (functionStack.size()) {
+void ByteCodeVM::systemCall(SystemCall::Type call, FunctionStackFrame& frame, size_t& ip) {
+    switch (call) {
+    // PUT_C, PUT_S, IN_C, IN_S, IN_C_NB, GET_ATTR, STACK_SIZE, LINK_SYM, LOAD_IP
+    // 1, 2, 0, 2, 0, 2, 0, 1, 1
+    case SystemCall::Type::PUT_C: { // (c) -> ()
+        output_buffer << static_cast<char>(registerStack.back());
+        registerStack.pop_back();
+        break;
+    }
+    case SystemCall::Type::PUT_S: { // (ptr, len) -> ()
+        auto len = registerStack.back();
+        registerStack.pop_back();
+        auto p = std::bit_cast<char*>(registerStack.back());
+        registerStack.pop_back();
+        output_buffer << std::string_view{p, len};
+        break;
+    }
+    case SystemCall::Type::IN_C: { // () -> (c)
+        char c;
+        input_buffer >> c;
+        registerStack.push_back(static_cast<uint64_t>(c));
+        break;
+    }
+    case SystemCall::Type::IN_S: { // (ptr, len) -> ()
+        auto len = registerStack.back();
+        registerStack.pop_back();
+        auto p = std::bit_cast<char*>(registerStack.back());
+        registerStack.pop_back();
+        input_buffer.get(p, len);
+        break;
+    }
+    case SystemCall::Type::IN_C_NB: { // () -> (c)
+        err = Error::ILLEGAL_OP;
+        break;
+    }
+    case SystemCall::Type::GET_ATTR: { // (ptr, sym) -> (ptr, ptr)
+        auto id = registerStack.back();
+        registerStack.pop_back();
+        auto p = std::bit_cast<uint64_t*>(registerStack.back());
+        // TODO: attr
+        break;
+    }
+    case SystemCall::Type::STACK_SIZE: { // () -> (l); len before push
+        registerStack.push_back(registerStack.size() - frame.stack_bottom);
+        break;
+    }
+    case SystemCall::Type::LINK_SYM: { // (sym) -> (id)
+        auto& sym = context.functions[frame.functionID].symbol[registerStack.back()];
+        auto it = context.functionIndex.find(sym);
+        if (it == context.functionIndex.end() || !context.linkFunction(it->second).has_value()) {
+            registerStack.back() = -1;
+        } else {
+            registerStack.back() = it->second;
+        }
+        break;
+    }
+    case SystemCall::Type::LOAD_IP: { // (data) -> ()
+        ip = context.linkedFunctionInfo[frame.functionID].ip + registerStack.back();
+        registerStack.pop_back();
+        break;
+    }
+#ifdef __BYTECODE_VM_SAFTY_CHECK__
+    default: {
+        err = Error::ILLEGAL_OP;
+        break;
+    }
+#endif
+    }
+}
+
+int ByteCodeVM::execute(size_t depth) {
+#ifndef __BYTECODE_VM_PROFILING__
+    if (dispatch == Dispatch::REGISTER) {
+        auto& frame = functionStack.back();
+        auto& info = context.linkedFunctionInfo[frame.functionID];
+        if (info.registerReady && registerStack.size() - frame.stack_bottom == info.registerCode->paramCount) {
+            return executeRegister(depth);
+        }
+    }
+    if (dispatch == Dispatch::THREADED || dispatch == Dispatch::REGISTER) {
+        return executeThreaded(this, depth);
+    }
+#endif
+    return executeSwitch(depth);
+}
+
+int ByteCodeVM::executeSwitch(size_t depth) {
+    auto& code = context.textSegment;
+    const bool profiling = dispatch == Dispatch::PROFILE;
+    recentIP.fill(static_cast<size_t>(-1) - SequenceProfile::maxLength);
+    while (functionStack.size() > depth) {
         // load function context
         auto& thisFunc = functionStack.back();
+        auto& funcInfo = context.linkedFunctionInfo[thisFunc.functionID];
 #ifdef __BYTECODE_VM_PROFILING__
-        auto& func_profile = profile[thisFunc.func->symbol[0]];
-        func_profile.ins.resize(thisFunc.func->code.size());
+        auto& func_profile = profile[context.functions[thisFunc.functionID].symbol[0]];
+        func_profile.ins.resize(context.functions[thisFunc.functionID].code.size());
         auto time_function_start = std::chrono::high_resolution_clock::now();
 #endif
-        auto& code = thisFunc.func->code;
-        const uint8_t* constTable = reinterpret_cast<const uint8_t*>(thisFunc.func->constant.data());
-        uint8_t* varTable = reinterpret_cast<uint8_t*>(thisFunc.varTable.data());
+        const uint8_t* constTable = reinterpret_cast<const uint8_t*>(funcInfo.constant.data());
+        uint8_t* varTable = reinterpret_cast<uint8_t*>(varStack.data() + thisFunc.varBase);
+        uint8_t* dataTable = reinterpret_cast<uint8_t*>(dataSegment.data());
         auto ip = thisFunc.ip;
         bool same_function = true;
         while (same_function) {
@@ -285,9 +416,12 @@ int ByteCodeVM::execute() {
                 return -1;
             }
 #ifdef __BYTECODE_VM_PROFILING__
-            auto this_ip = ip;
+            auto this_ip = ip - funcInfo.ip;
             auto time_instruction_start = std::chrono::high_resolution_clock::now();
 #endif
+            if (profiling) {
+                recordSequence(ip);
+            }
             auto [opCode, type0, data] = code[ip];
             ip++;
             switch (static_cast<OPCode::Type>(opCode)) {
@@ -334,7 +468,7 @@ int ByteCodeVM::execute() {
                 DETECT_OVERFLOW(2);
                 size_t back = registerStack.back();
                 registerStack.pop_back();
-                store(std::bit_cast<uint8_t*>(static_cast<size_t>(registerStack.back())), &back,
+                store(std::bit_cast<uint8_t*>(static_cast<size_t>(registerStack.back())) + data, &back,
                       static_cast<DataType::Type>(type0));
                 break;
             }
@@ -372,87 +506,23 @@ int ByteCodeVM::execute() {
                     break;
                 }
                 DETECT_OVERFLOW(SystemCallParamCount[data]);
-                switch (static_cast<SystemCall::Type>(data)) {
-                // PUT_C, PUT_S, IN_C, IN_S, IN_C_NB, GET_ATTR, STACK_SIZE, LINK_SYM, LOAD_IP
-                // 1, 2, 0, 2, 0, 2, 0, 1, 1
-                case SystemCall::Type::PUT_C: { // (c) -> ()
-                    output_buffer << static_cast<char>(registerStack.back());
-                    registerStack.pop_back();
-                    break;
-                }
-                case SystemCall::Type::PUT_S: { // (ptr, len) -> ()
-                    auto len = registerStack.back();
-                    registerStack.pop_back();
-                    auto p = std::bit_cast<char*>(registerStack.back());
-                    registerStack.pop_back();
-                    output_buffer << std::string_view{p, len};
-                    break;
-                }
-                case SystemCall::Type::IN_C: { // () -> (c)
-                    char c;
-                    input_buffer >> c;
-                    registerStack.push_back(static_cast<uint64_t>(c));
-                    break;
-                }
-                case SystemCall::Type::IN_S: { // (ptr, len) -> ()
-                    auto len = registerStack.back();
-                    registerStack.pop_back();
-                    auto p = std::bit_cast<char*>(registerStack.back());
-                    registerStack.pop_back();
-                    input_buffer.get(p, len);
-                    break;
-                }
-                case SystemCall::Type::IN_C_NB: { // () -> (c)
-                    err = Error::ILLEGAL_OP;
-                    break;
-                }
-                case SystemCall::Type::GET_ATTR: { // (ptr, sym) -> (ptr, ptr)
-                    auto id = registerStack.back();
-                    registerStack.pop_back();
-                    auto p = std::bit_cast<uint64_t*>(registerStack.back());
-                    // TODO: attr
-                    break;
-                }
-                case SystemCall::Type::STACK_SIZE: { // () -> (l); len before push
-                    registerStack.push_back(registerStack.size() - functionStack.back().stack_bottom);
-                    break;
-                }
-                case SystemCall::Type::LINK_SYM: { // (sym) -> (id)
-                    auto& sym = functionStack.back().func->symbol[registerStack.back()];
-                    auto it = context.symbolTable.find(sym);
-                    if (it == context.symbolTable.end()) {
-                        registerStack.back() = -1;
-                    } else {
-                        registerStack.back() = it->second;
-                    }
-                    break;
-                }
-                case SystemCall::Type::LOAD_IP: { // (data) -> ()
-                    ip = registerStack.back();
-                    registerStack.pop_back();
-                    break;
-                }
-#ifdef __BYTECODE_VM_SAFTY_CHECK__
-                default: {
-                    err = Error::ILLEGAL_OP;
-                    break;
-                }
-#endif
-                }
+                systemCall(static_cast<SystemCall::Type>(data), thisFunc, ip);
                 break;
             }
-            case OPCode::BEZ: { // BEZ - - TARGET (data) -> ()
+            case OPCode::BEZ: { // BEZ TYPE - TARGET (data) -> (); compare as F64 if TYPE is F64, else as raw bits
                 DETECT_OVERFLOW(1);
-                if (registerStack.back() == 0) {
+                if (type0 == DataType::F64 ? std::bit_cast<double_t>(registerStack.back()) == 0
+                                           : registerStack.back() == 0) {
                     // TODO: size independent
                     ip += std::bit_cast<ByteCode::TypedData>(data);
                 }
                 registerStack.pop_back();
                 break;
             }
-            case OPCode::BNZ: { // BEZ - - TARGET (data) -> ()
+            case OPCode::BNZ: { // BNZ TYPE - TARGET (data) -> (); compare as F64 if TYPE is F64, else as raw bits
                 DETECT_OVERFLOW(1);
-                if (registerStack.back() != 0) {
+                if (type0 == DataType::F64 ? std::bit_cast<double_t>(registerStack.back()) != 0
+                                           : registerStack.back() != 0) {
                     ip += std::bit_cast<ByteCode::TypedData>(data);
                 }
                 registerStack.pop_back();
@@ -465,20 +535,22 @@ int ByteCodeVM::execute() {
             case OPCode::CALL: { // CALL - - ARG_CNT (data[cnt], func) -> (), (data[cnt])
                 DETECT_OVERFLOW(data + 1);
                 uint64_t id = registerStack.back();
-                if (id > context.functions.size()) {
+                if (id >= context.linkedFunctionInfo.size()) {
                     err = Error::TABLE_OVERFLOW;
                     break;
                 }
                 thisFunc.ip = ip;
                 same_function = false;
                 registerStack.pop_back();
-                functionStack.push_back(FunctionStackFrame(context.functions[id], registerStack.size() - data));
+                // thisFunc is invalidated since here
+                pushFrame(id, registerStack.size() - data);
                 break;
             }
             case OPCode::RET: { // RET - - ARG_CNT (), (data[...], data[cnt]) -> (data[cnt])
                 DETECT_OVERFLOW(data);
                 registerStack.erase(registerStack.begin() + thisFunc.stack_bottom, registerStack.end() - data);
                 same_function = false;
+                varStack.resize(thisFunc.varBase);
                 functionStack.pop_back();
                 break;
             }
@@ -487,6 +559,30 @@ int ByteCodeVM::execute() {
                 registerStack.pop_back();
                 break;
             }
+            case OPCode::LOAD_GLOBAL: { // LOAD_GLOBAL VAR_TYPE - BYTE_DIFF () -> (data)
+                registerStack.push_back(0);
+                load(dataTable + data, &registerStack.back(), static_cast<DataType::Type>(type0));
+                break;
+            }
+            case OPCode::STORE_GLOBAL: { // STORE_GLOBAL VAR_TYPE - BYTE_DIFF (data) -> ()
+                DETECT_OVERFLOW(1);
+                store(dataTable + data, &registerStack.back(), static_cast<DataType::Type>(type0));
+                registerStack.pop_back();
+                break;
+            }
+            case OPCode::CALL_NATIVE: { // CALL_NATIVE - - NATIVE_ID (data[cnt]) -> (data)
+                if (data >= context.nativeFunctions.size()) {
+                    err = Error::TABLE_OVERFLOW;
+                    break;
+                }
+                auto& native = context.nativeFunctions[data];
+                DETECT_OVERFLOW(native.paramCount);
+                auto paramBegin = registerStack.size() - native.paramCount;
+                auto ret = native.function(registerStack.data() + paramBegin);
+                registerStack.resize(paramBegin);
+                registerStack.push_back(ret);
+                break;
+            }
 #ifdef __BYTECODE_VM_SAFTY_CHECK__
             default: {
                 err = Error::ILLEGAL_OP;
@@ -495,7 +591,9 @@ int ByteCodeVM::execute() {
 #endif
             }
             if (err != Error::NONE) {
-                thisFunc.ip = ip;
+                if (same_function) {
+                    thisFunc.ip = ip;
+                }
                 return -1;
             }
 #ifdef __BYTECODE_VM_PROFILING__
@@ -513,4 +611,4 @@ int ByteCodeVM::execute() {
     return 0;
 }
 
-} // namespace bytecode
\ No newline at end of file
+} // namespace bytecode
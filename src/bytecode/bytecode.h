@@ -10,15 +10,23 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-09-18</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Finish link-time context, add data segment and native calls.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add direct-threaded dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add register bytecode converted from stack bytecode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add sequence profiling and superinstructions.</td></tr>
  * </table>
  */
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <bit>
+#include <cassert>
+#include <cmath>
 #include <format>
 #include <map>
 #include <memory>
+#include <optional>
 #include <ranges>
 #include <sstream>
 #include <string_view>
@@ -29,6 +37,11 @@
 // #define __BYTECODE_VM_PROFILING__
 // #define __BYTECODE_VM_SAFTY_CHECK__
 
+// labels as values, used by direct-threaded dispatch
+#if defined(__GNUC__) || defined(__clang__)
+#define __BYTECODE_VM_COMPUTED_GOTO__
+#endif
+
 #include "dynamicstruct.hpp"
 
 #define READABLE_ENUM(name, ...)                                                                                       \
@@ -74,9 +87,10 @@ consteval std::array<std::string_view, len> split(std::string_view src) {
 }
 
 READABLE_ENUM(OPCode, NOP, COPY, LOAD_IMM, LOAD_VAR, LOAD_CONST, LOAD_MEM, STORE_VAR, STORE_MEM, VAR_ADDRESS,
-              CONST_ADDRESS, TYPE_TRANS, BIN_OP, UNARY_OP, SYSCALL, BEZ, BNZ, BRANCH, CALL, RET, POP);
+              CONST_ADDRESS, TYPE_TRANS, BIN_OP, UNARY_OP, SYSCALL, BEZ, BNZ, BRANCH, CALL, RET, POP, LOAD_GLOBAL,
+              STORE_GLOBAL, CALL_NATIVE);
 
-READABLE_ENUM(BinaryOP, ADD, SUB, MUL, DIV, MOD, AND, OR, BAND, BOR, BXOR, GE, GT, EQU);
+READABLE_ENUM(BinaryOP, ADD, SUB, MUL, DIV, MOD, AND, OR, BAND, BOR, BXOR, GE, GT, EQU, NEQ, LT, LE);
 
 READABLE_ENUM(UnaryOP, NEG, NOT);
 
@@ -84,6 +98,25 @@ READABLE_ENUM(SystemCall, PUT_C, PUT_S, IN_C, IN_S, IN_C_NB, GET_ATTR, STACK_SIZ
 
 inline constexpr std::array<size_t, SystemCall::__END> SystemCallParamCount = {1, 2, 0, 2, 0, 2, 0, 1, 1};
 
+// handlers of direct-threaded dispatch, OPCode specialized by type and operand at link time
+READABLE_ENUM(ThreadedOP, TRAP, NOP, COPY, PUSH, LOAD_VAR, LOAD_VAR_64, LOAD_CONST, LOAD_MEM, STORE_VAR, STORE_VAR_64,
+              STORE_MEM, VAR_ADDRESS, CONST_ADDRESS, TYPE_TRANS, U64_TO_F64, I64_TO_F64, F64_TO_I64, F64_TO_U64, BIN_OP,
+              ADD_F64, SUB_F64, MUL_F64, DIV_F64, GE_F64, GT_F64, EQU_F64, NEQ_F64, LT_F64, LE_F64, UNARY_OP, NEG_F64,
+              NOT_F64, SYSCALL, BEZ, BNZ, BEZ_F64, BNZ_F64, BRANCH, CALL, RET, POP, LOAD_GLOBAL, LOAD_GLOBAL_64,
+              STORE_GLOBAL, STORE_GLOBAL_64, CALL_NATIVE,
+              // superinstructions, see superinstructionTable
+              LOAD_GLOBAL_64_2, LOAD_GLOBAL_64_PUSH, LOAD_VAR_64_2, LOAD_VAR_64_PUSH, POP_LOAD_GLOBAL_64, GE_F64_BOOL,
+              GT_F64_BOOL, EQU_F64_BOOL, NEQ_F64_BOOL, LT_F64_BOOL, LE_F64_BOOL, PUSH_GE_F64_BOOL, PUSH_GT_F64_BOOL,
+              PUSH_EQU_F64_BOOL, PUSH_NEQ_F64_BOOL, PUSH_LT_F64_BOOL, PUSH_LE_F64_BOOL, GE_F64_BEZ, GT_F64_BEZ,
+              EQU_F64_BEZ, NEQ_F64_BEZ, LT_F64_BEZ, LE_F64_BEZ, BOOL_BEZ_F64, BOOL_BNZ_F64, BOOL_COPY_BEZ_F64,
+              BOOL_COPY_BNZ_F64, COPY_BEZ_F64, COPY_BNZ_F64, BEZ_F64_POP, BNZ_F64_POP);
+
+// three-address instructions of register bytecode
+READABLE_ENUM(RegisterOP, MOV, LOADK, LOADI, LOAD_VAR, STORE_VAR, LOAD_GLOBAL, STORE_GLOBAL, TYPE_TRANS, U64_TO_F64,
+              I64_TO_F64, F64_TO_I64, F64_TO_U64, BIN_OP, ADD_F64, SUB_F64, MUL_F64, DIV_F64, GE_F64, GT_F64, EQU_F64,
+              NEQ_F64, LT_F64, LE_F64, UNARY_OP, NEG_F64, NOT_F64, BEZ, BNZ, BEZ_F64, BNZ_F64, BRANCH, CALL,
+              CALL_NATIVE, ARG, RET);
+
 READABLE_ENUM(DataType, NONE, U8, U16, U32, U64, I8, I16, I32, I64, F32, F64, PTR);
 
 // inline constexpr std::array<size_t, DataType::__END> DataTypeLen = {0, 1, 2, 4, 8, 1, 2, 4, 8, 4, 8, 8};
@@ -98,6 +131,80 @@ static_assert(sizeof(int32_t) == sizeof(ByteCode));
 
 using MemUnit = uint64_t;
 
+/**
+ * @brief pre-decoded instruction of direct-threaded dispatch, one for each ByteCode in text segment
+ *
+ */
+struct ThreadedCode {
+    // label of handler, nullptr if computed goto is not supported and handlers are dispatched by switch
+    const void* handler;
+    // ThreadedOP, a superinstruction if fused
+    uint16_t op;
+    uint8_t type;
+    uint16_t data;
+    // ThreadedOP decoded before fusion, instructions fused into a superinstruction keep their own
+    uint16_t base;
+    // resolved operand, immediate value of PUSH, absolute ip of jumps, ByteCodeVM::Error of TRAP
+    MemUnit operand;
+};
+
+/**
+ * @brief instruction of register bytecode, registers of a frame are its var table followed by stack slots and
+ * temporaries, so 64bit variables are accessed as registers directly
+ *
+ */
+struct RegisterCode {
+    // RegisterOP
+    uint8_t opCode;
+    // DataType of operands, CALL has result if not NONE
+    uint8_t type;
+    // BinaryOP, UnaryOP, target DataType of TYPE_TRANS, count of ARG after CALL/CALL_NATIVE, count of RET values
+    uint8_t subOP;
+    // register; byte offset of STORE_VAR/STORE_GLOBAL; ip of jumps
+    uint16_t dst;
+    // register; byte offset of LOAD_VAR/LOAD_GLOBAL; constant index of LOADK; immediate of LOADI; id of CALL_NATIVE
+    uint16_t src0;
+    // register; function id of CALL
+    uint16_t src1;
+};
+
+/**
+ * @brief function converted into register bytecode
+ *
+ */
+struct RegisterFunction {
+    std::vector<RegisterCode> code;
+    // params are passed in registers [paramBase, paramBase + paramCount)
+    size_t paramBase;
+    size_t paramCount;
+    size_t returnCount;
+    // size of register file of a frame
+    size_t registerCount;
+
+    std::string decompile() const;
+};
+
+/**
+ * @brief allocator leaves elements uninitialized when resized, so register stack can be grown without filling
+ *
+ */
+template <typename T>
+struct DefaultInitAllocator : std::allocator<T> {
+    template <typename U>
+    struct rebind {
+        using other = DefaultInitAllocator<U>;
+    };
+    using std::allocator<T>::allocator;
+    template <typename U>
+    void construct(U* p) noexcept(std::is_nothrow_default_constructible_v<U>) {
+        ::new (static_cast<void*>(p)) U;
+    }
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args) {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+};
+
 struct Function {
     // struct DebugInfo {
     //     // diff -> name, type
@@ -125,6 +232,46 @@ struct Function {
     std::string decompile() const;
 };
 
+/**
+ * @brief function implemented by host, called through CALL_NATIVE with its params on register stack
+ *
+ */
+struct NativeFunction {
+    size_t paramCount;
+    MemUnit (*function)(const MemUnit* params);
+};
+
+/**
+ * @brief executed count of adjacent ThreadedOP sequences, recorded by Dispatch::PROFILE,
+ * superinstructions are selected by it
+ *
+ */
+struct SequenceProfile {
+    inline static constexpr size_t maxLength = 4;
+    // shorter sequence is terminated by ThreadedOP::__END
+    using Sequence = std::array<uint16_t, maxLength>;
+    std::map<Sequence, size_t> count;
+
+    void merge(const SequenceProfile& other) {
+        for (auto& [sequence, n] : other.count) {
+            count[sequence] += n;
+        }
+    }
+    /**
+     * @brief one sequence per line as "count OP OP...", hottest first
+     *
+     * @return std::string
+     */
+    std::string dump() const;
+    /**
+     * @brief parse text produced by dump
+     *
+     * @param text
+     * @return std::optional<SequenceProfile> nullopt if any line is ill-formed
+     */
+    static std::optional<SequenceProfile> parse(std::string_view text);
+};
+
 struct ByteCodeVM {
     struct Context {
         friend struct ByteCodeVM;
@@ -147,40 +294,144 @@ struct ByteCodeVM {
             return id;
         }
 
+        std::optional<size_t> getFunctionID(const std::string& name) const {
+            if (auto it = functionIndex.find(name); it != functionIndex.end()) {
+                return it->second;
+            }
+            return std::nullopt;
+        }
+
+        const Function& getFunction(size_t functionID) const { return functions[functionID]; }
+
+        /**
+         * @brief register a native function, the returned id is the data of CALL_NATIVE
+         *
+         * @param f native function
+         * @return size_t id of native function
+         */
+        size_t addNativeFunction(NativeFunction f) {
+            nativeFunctions.push_back(f);
+            return nativeFunctions.size() - 1;
+        }
+
+        /**
+         * @brief copy function and all functions it refers into text segment
+         * @attention the first constTableInfo.linkedFunctionCount symbols of a function are functions,
+         * whose id is placed at the head of its linked constant table
+         *
+         * @param functionID id returned by addFunction
+         * @return std::optional<size_t> ip of function in text segment,
+         * nullopt if any referred function is unknown, then nothing is linked
+         */
         std::optional<size_t> linkFunction(size_t functionID) {
+            auto textSize = textSegment.size();
+            std::vector<size_t> linked;
+            auto ret = linkFunctionImpl(functionID, linked);
+            if (!ret.has_value()) {
+                textSegment.resize(textSize);
+                threadedSegment.resize(std::min(threadedSegment.size(), textSize));
+                for (auto id : linked) {
+                    functionIndexInTextSegment.erase(id);
+                }
+                return ret;
+            }
+            if (!linked.empty()) {
+                for (auto id : linked) {
+                    linkedFunctionInfo[id].registerCode = convertToRegister(id);
+                }
+                updateRegisterReady();
+            }
+            return ret;
+        }
+
+        /**
+         * @brief select superinstructions executed in profile, and fuse them into linked and later linked functions
+         *
+         * @param profile recorded by Dispatch::PROFILE, empty profile disables superinstructions
+         * @return size_t count of superinstructions selected
+         */
+        size_t setSuperinstructions(const SequenceProfile& profile);
+
+      private:
+        std::optional<size_t> linkFunctionImpl(size_t functionID, std::vector<size_t>& linked) {
+            if (functionID >= functions.size()) {
+                return std::nullopt;
+            }
             if (auto it = functionIndexInTextSegment.find(functionID); it != functionIndexInTextSegment.end()) {
                 return it->second;
             }
             auto ip = textSegment.size();
             functionIndexInTextSegment.emplace(functionID, ip);
+            linked.push_back(functionID);
             auto& func = functions[functionID];
             textSegment.insert(textSegment.end(), func.code.cbegin(), func.code.cend());
             if (linkedFunctionInfo.size() <= functionID) {
-                linkedFunctionInfo.resize(functionID);
+                linkedFunctionInfo.resize(functionID + 1);
             }
             std::vector<MemUnit> constant;
             auto& originalContant = func.constTableInfo.compileTimeConstant;
             constant.reserve(func.constTableInfo.linkedFunctionCount + originalContant.size());
             for (size_t i = 0; i < func.constTableInfo.linkedFunctionCount; ++i) {
                 auto it = functionIndex.find(func.symbol[i]);
-                // TODO: check?
-                if(it == functionIndex.end()) {
+                if (it == functionIndex.end()) {
                     return std::nullopt;
                 }
-                auto newID = linkFunction(it->second);
-                if(!newID.has_value()) {
+                if (!linkFunctionImpl(it->second, linked).has_value()) {
                     return std::nullopt;
                 }
-                constant.push_back(newID.value());
+                // CALL takes function id, ip is kept in linkedFunctionInfo
+                constant.push_back(it->second);
             }
             constant.insert(constant.end(), originalContant.begin(), originalContant.end());
-            linkedFunctionInfo[functionID] = {ip, func.registerInfo.registerStackSizeRequired,
-                                                         func.varTableInfo.byteSize, func.varTableInfo.escaped,
-                                                         std::move(constant)};
+            // callees are appended after this function
+            threadedSegment.resize(textSegment.size());
+            for (size_t i = 0; i < func.code.size(); ++i) {
+                threadedSegment[ip + i] = decode(func.code[i], ip + i, ip, ip + func.code.size(), constant);
+            }
+            fuse(ip, ip + func.code.size());
+            linkedFunctionInfo[functionID] = {ip,
+                                              func.registerInfo.registerStackSizeRequired,
+                                              func.varTableInfo.byteSize,
+                                              func.varTableInfo.escaped,
+                                              std::move(constant),
+                                              std::nullopt,
+                                              false};
             return ip;
         }
 
-      private:
+        /**
+         * @brief decode instruction for direct-threaded dispatch
+         *
+         * @param bc instruction
+         * @param ip ip of instruction in text segment
+         * @param begin ip of the first instruction of function
+         * @param end ip after the last instruction of function, jumps must stay in [begin, end)
+         * @param constant linked constant table of function
+         * @return ThreadedCode
+         */
+        static ThreadedCode decode(ByteCode bc, size_t ip, size_t begin, size_t end,
+                                   const std::vector<MemUnit>& constant);
+        /**
+         * @brief fuse selected superinstructions in threaded segment [begin, end) of a function,
+         * only the first instruction of a sequence is replaced, so jumping into the middle is still valid
+         *
+         */
+        void fuse(size_t begin, size_t end);
+
+        /**
+         * @brief convert linked function into register bytecode
+         *
+         * @param functionID id of linked function
+         * @return std::optional<RegisterFunction> nullopt if function uses instructions not supported by
+         * register bytecode (SYSCALL, memory access, indirect call...)
+         */
+        std::optional<RegisterFunction> convertToRegister(size_t functionID) const;
+        /**
+         * @brief a function runs in register dispatch only if it and all functions it calls are converted
+         *
+         */
+        void updateRegisterReady();
+
         dynamicstruct::StructLayoutManager& typeManager;
 
         struct LinkedFunctionInfo {
@@ -189,29 +440,43 @@ struct ByteCodeVM {
             size_t varTableSize;
             bool varTableEscaped;
             std::vector<MemUnit> constant;
+            std::optional<RegisterFunction> registerCode;
+            bool registerReady;
         };
         std::vector<LinkedFunctionInfo> linkedFunctionInfo{};
+        std::vector<NativeFunction> nativeFunctions{};
 
         // load time:
         std::vector<Function> functions{};
         std::unordered_map<std::string, size_t> functionIndex{};
         // link time:
         std::vector<ByteCode> textSegment{};
+        // textSegment pre-decoded, same ip
+        std::vector<ThreadedCode> threadedSegment{};
         std::unordered_map<size_t, size_t> functionIndexInTextSegment{};
+        // ThreadedOP of superinstructions selected, preferred first
+        std::vector<uint16_t> superinstructions{};
     } & context;
 
-    ByteCodeVM(Context& c) : context(c), registerStack(), functionStack(), input_buffer(), output_buffer() {
+    ByteCodeVM(Context& c)
+        : context(c), input_buffer(), output_buffer(), registerStack(), varStack(), functionStack(), dataSegment() {
         registerStack.reserve(1024);
+        varStack.reserve(1024);
         functionStack.reserve(512);
     }
     struct FunctionStackFrame {
-        FunctionStackFrame(Function& targetFunction, size_t stack_bottom)
-            : varTable((targetFunction.varTableInfo.byteSize + sizeof(MemUnit) - 1) / sizeof(MemUnit), 0),
-              func(&targetFunction), stack_bottom(stack_bottom), ip(0) {}
-        const Function* func;
-        std::vector<MemUnit> varTable;
-        size_t stack_bottom;
+        FunctionStackFrame(size_t functionID, size_t ip, size_t varBase, size_t stack_bottom,
+                           size_t returnRegister = 0)
+            : functionID(functionID), ip(ip), varBase(varBase), stack_bottom(stack_bottom),
+              returnRegister(returnRegister) {}
+        size_t functionID;
+        // absolute in text segment
         size_t ip;
+        // var table of this frame is varStack[varBase, varBase + size)
+        size_t varBase;
+        size_t stack_bottom;
+        // register dispatch: register of caller receives returned value
+        size_t returnRegister;
     };
 
 #ifdef __BYTECODE_VM_PROFILING__
@@ -229,8 +494,12 @@ struct ByteCodeVM {
 
     std::stringstream input_buffer, output_buffer;
 
-    std::vector<MemUnit> registerStack;
+    std::vector<MemUnit, DefaultInitAllocator<MemUnit>> registerStack;
+    // var tables of all frames, so a call does not allocate
+    std::vector<MemUnit> varStack;
     std::vector<FunctionStackFrame> functionStack;
+    // global variables of this vm, accessed by LOAD_GLOBAL / STORE_GLOBAL
+    std::vector<MemUnit> dataSegment;
     enum struct Error {
         NONE,
         ILLEGAL_OP,
@@ -241,32 +510,25 @@ struct ByteCodeVM {
         DIVIDED_ZERO
     } err = Error::NONE;
 
-    // void run(std::string_view name) {}
-
-    [[deprecated]] size_t loadFunction(const Function& f) { return loadFunction(Function{f}); }
-    [[deprecated]] size_t loadFunction(Function&& f) {
-        if (auto bc = f.code.back();
-            bc.opCode != OPCode::RET && bc.opCode != OPCode::CALL && bc.opCode != OPCode::BRANCH) {
-            // ill-formed function
-            return -1;
-        }
-        size_t id = context.functions.size();
-        context.symbolTable.emplace(f.symbol[0], id);
-        context.functions.push_back(std::move(f));
-        auto& realFunc = context.functions.back();
-        for (size_t i = 0; i < realFunc.symbol.size(); ++i) {
-            // link
-            if (auto it = context.symbolTable.find(realFunc.symbol[i]); it != context.symbolTable.end()) {
-                context.functions[id].constant[i] = it->second;
-            }
-        }
-        return id;
-    }
-
-    // template <typename FuncType>
-    // size_t loadFunction(FuncType&& f) {
-    //     return 0;
-    // }
+    /**
+     * @brief how instructions are dispatched, can be changed between calls
+     *
+     */
+    enum struct Dispatch {
+        // switch over OPCode of every instruction
+        SWITCH,
+        // jump through handlers pre-decoded at link time
+        THREADED,
+        // run register bytecode, functions not converted run in THREADED
+        REGISTER,
+        // SWITCH, and count executed sequences into sequenceProfile
+        PROFILE,
+    } dispatch = Dispatch::THREADED;
+
+    SequenceProfile sequenceProfile;
+
+    [[deprecated]] size_t loadFunction(const Function& f) { return context.addFunction(f).value_or(-1); }
+    [[deprecated]] size_t loadFunction(Function&& f) { return context.addFunction(f).value_or(-1); }
 
   private:
     template <typename Ty>
@@ -275,15 +537,25 @@ struct ByteCodeVM {
     template <typename Ret, typename... Args>
     struct getFuncHelper<Ret(Args...)> {
         static auto get(ByteCodeVM* base, size_t id) {
-            return [base, id](Args... args) -> std::optional<Ret> {
+            return [base, id, linked = base->context.linkFunction(id).has_value()](Args... args) -> std::optional<Ret> {
                 using namespace std;
+                if (!linked) {
+                    return nullopt;
+                }
                 auto bottom = base->registerStack.size();
-                bool input = (... && base->pushStack(args));
+                auto depth = base->functionStack.size();
+                auto vars = base->varStack.size();
+                base->err = Error::NONE;
+                bool input = (true && ... && base->pushStack(args));
                 if (!input) {
+                    base->registerStack.resize(bottom);
                     return nullopt;
                 }
-                base->functionStack.emplace_back(base->context.functions[id], bottom);
-                if (base->execute()) {
+                base->pushFrame(id, bottom);
+                if (base->execute(depth)) {
+                    base->registerStack.resize(bottom);
+                    base->functionStack.erase(base->functionStack.begin() + depth, base->functionStack.end());
+                    base->varStack.resize(vars);
                     return nullopt;
                 }
                 auto back = base->registerStack.back();
@@ -308,11 +580,14 @@ struct ByteCodeVM {
     template <typename Ret, typename... Args>
     struct getFuncUnsafeHelper<Ret(Args...)> {
         static auto get(ByteCodeVM* base, size_t id) {
+            base->context.linkFunction(id);
             return [base, id](Args... args) -> Ret {
                 using namespace std;
-                bool input = (... && base->pushStack(args));
-                base->functionStack.emplace_back(base->context.functions[id], 0);
-                base->execute();
+                auto bottom = base->registerStack.size();
+                auto depth = base->functionStack.size();
+                bool input = (true && ... && base->pushStack(args));
+                base->pushFrame(id, bottom);
+                base->execute(depth);
                 auto back = base->registerStack.back();
                 base->registerStack.pop_back();
                 if constexpr (is_same_v<Ret, float_t> || is_same_v<Ret, double_t>) {
@@ -329,6 +604,13 @@ struct ByteCodeVM {
     };
 
   public:
+    /**
+     * @brief get callable of function, function is linked when this is called
+     *
+     * @tparam Ty function type
+     * @param id id returned by Context::addFunction
+     * @return callable returns std::optional<Ret>, nullopt if link failed or runtime error
+     */
     template <typename Ty>
     auto getFunc(size_t id) {
         return getFuncHelper<Ty>::get(this, id);
@@ -360,12 +642,76 @@ struct ByteCodeVM {
         }
         return true;
     }
+    void pushFrame(size_t functionID, size_t stack_bottom) {
+        auto& info = context.linkedFunctionInfo[functionID];
+        auto varBase = varStack.size();
+        varStack.resize(varBase + (info.varTableSize + sizeof(MemUnit) - 1) / sizeof(MemUnit), 0);
+        functionStack.emplace_back(functionID, info.ip, varBase, stack_bottom);
+    }
+    /**
+     * @brief count sequences ending with instruction at ip, in Dispatch::PROFILE
+     *
+     * @param ip absolute ip of instruction executed
+     */
+    void recordSequence(size_t ip) {
+        auto& text = context.threadedSegment;
+        SequenceProfile::Sequence sequence;
+        sequence.fill(ThreadedOP::__END);
+        // executed ips, the latest last, a call or jump breaks the sequence
+        size_t length = 1;
+        while (length < SequenceProfile::maxLength && recentIP[recentIP.size() - length] + length == ip) {
+            length++;
+        }
+        for (size_t n = 2; n <= length; n++) {
+            for (size_t i = 0; i < n; i++) {
+                sequence[i] = text[ip + 1 - n + i].base;
+            }
+            sequenceProfile.count[sequence]++;
+        }
+        std::shift_left(recentIP.begin(), recentIP.end(), 1);
+        recentIP.back() = ip;
+    }
     bool visitIllegal(size_t depth) {
         if (functionStack.empty())
             return registerStack.size() < depth;
         return registerStack.size() - functionStack.back().stack_bottom < depth;
     }
-    int execute();
+    /**
+     * @brief execute system call, params are on register stack
+     *
+     * @param call system call
+     * @param frame frame of caller
+     * @param ip ip after SYSCALL, may be changed by LOAD_IP
+     */
+    void systemCall(SystemCall::Type call, FunctionStackFrame& frame, size_t& ip);
+    /**
+     * @brief run until function stack shrinks to given depth
+     *
+     * @param depth depth of function stack when the outermost frame is pushed
+     * @return int 0 if success, -1 if err is set
+     */
+    int execute(size_t depth = 0);
+    int executeSwitch(size_t depth);
+    // recently executed ips for recordSequence, the latest last
+    std::array<size_t, SequenceProfile::maxLength - 1> recentIP;
+    /**
+     * @brief direct-threaded execution of Context::threadedSegment
+     *
+     * @param vm vm to run, nullptr to get handler table only
+     * @param depth see execute
+     * @param handlers if not nullptr, receives labels of handlers indexed by ThreadedOP and nothing is executed
+     * @return int see execute
+     */
+    static int executeThreaded(ByteCodeVM* vm, size_t depth, const void* const** handlers = nullptr);
+    static const void* const* threadedHandlers();
+    /**
+     * @brief run register bytecode, the outermost frame is pushed with its params on register stack
+     * @attention all functions called must be ready for register dispatch
+     *
+     * @param depth see execute
+     * @return int see execute
+     */
+    int executeRegister(size_t depth);
 };
 
-} // namespace bytecode
\ No newline at end of file
+} // namespace bytecode
@@ -0,0 +1,958 @@
+/**
+ * @file bytecoderegister.cpp
+ * @author djw
+ * @brief
+ * @date 2026-10-17
+ *
+ * @details Register bytecode of ByteCodeVM.
+ *
+ * Linked stack bytecode is converted by simulating its register stack symbolically: loads of 64bit variables,
+ * constants and immediates are not emitted but used as operands of the instruction consuming them, so
+ * "LOAD_VAR a; LOAD_VAR b; BIN_OP ADD; STORE_VAR c" becomes "ADD c, a, b". Stack slots live at block boundaries
+ * are kept in fixed registers (params are the bottom slots of entry), other values are temporaries local to a
+ * block, which are packed by linear-scan allocation.
+ *
+ * Register file of a frame: [var table][stack slots][temporaries], all in MemUnit.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include <cstring>
+#include <queue>
+
+#include "bytecode.h"
+
+namespace {
+
+using namespace bytecode;
+
+bool is64(uint8_t type) { return type == DataType::U64 || type == DataType::I64 || type == DataType::F64; }
+
+size_t dataTypeSize(uint8_t type) {
+    switch (type) {
+    case DataType::U8:
+    case DataType::I8:
+        return 1;
+    case DataType::U16:
+    case DataType::I16:
+        return 2;
+    case DataType::U32:
+    case DataType::I32:
+    case DataType::F32:
+        return 4;
+    default:
+        return 8;
+    }
+}
+
+/**
+ * @brief call f(register, isDef) on each register field of instruction, uses before def
+ *
+ */
+template <typename Functor>
+void forEachRegister(RegisterCode& c, Functor f) {
+    switch (c.opCode) {
+    case RegisterOP::LOADK:
+    case RegisterOP::LOADI:
+    case RegisterOP::LOAD_VAR:
+    case RegisterOP::LOAD_GLOBAL:
+    case RegisterOP::CALL_NATIVE:
+        f(c.dst, true);
+        break;
+    case RegisterOP::CALL:
+        if (c.type != DataType::NONE) {
+            f(c.dst, true);
+        }
+        break;
+    case RegisterOP::STORE_VAR:
+    case RegisterOP::STORE_GLOBAL:
+    case RegisterOP::BEZ:
+    case RegisterOP::BNZ:
+    case RegisterOP::BEZ_F64:
+    case RegisterOP::BNZ_F64:
+    case RegisterOP::ARG:
+        f(c.src0, false);
+        break;
+    case RegisterOP::RET:
+        if (c.subOP) {
+            f(c.src0, false);
+        }
+        break;
+    case RegisterOP::BRANCH:
+        break;
+    case RegisterOP::BIN_OP:
+    case RegisterOP::ADD_F64:
+    case RegisterOP::SUB_F64:
+    case RegisterOP::MUL_F64:
+    case RegisterOP::DIV_F64:
+    case RegisterOP::GE_F64:
+    case RegisterOP::GT_F64:
+    case RegisterOP::EQU_F64:
+    case RegisterOP::NEQ_F64:
+    case RegisterOP::LT_F64:
+    case RegisterOP::LE_F64:
+        f(c.src0, false);
+        f(c.src1, false);
+        f(c.dst, true);
+        break;
+    default:
+        // MOV, TYPE_TRANS, UNARY_OP and specialized ones
+        f(c.src0, false);
+        f(c.dst, true);
+        break;
+    }
+}
+
+RegisterOP::Type specializeBinop(uint8_t type, uint8_t op) {
+    if (type != DataType::F64) {
+        return RegisterOP::BIN_OP;
+    }
+    switch (op) {
+    case BinaryOP::ADD:
+        return RegisterOP::ADD_F64;
+    case BinaryOP::SUB:
+        return RegisterOP::SUB_F64;
+    case BinaryOP::MUL:
+        return RegisterOP::MUL_F64;
+    case BinaryOP::DIV:
+        return RegisterOP::DIV_F64;
+    case BinaryOP::GE:
+        return RegisterOP::GE_F64;
+    case BinaryOP::GT:
+        return RegisterOP::GT_F64;
+    case BinaryOP::EQU:
+        return RegisterOP::EQU_F64;
+    case BinaryOP::NEQ:
+        return RegisterOP::NEQ_F64;
+    case BinaryOP::LT:
+        return RegisterOP::LT_F64;
+    case BinaryOP::LE:
+        return RegisterOP::LE_F64;
+    default:
+        return RegisterOP::BIN_OP;
+    }
+}
+
+RegisterOP::Type specializeTypeTrans(uint8_t from, uint8_t to) {
+    if (from == DataType::U64 && to == DataType::F64) {
+        return RegisterOP::U64_TO_F64;
+    } else if (from == DataType::I64 && to == DataType::F64) {
+        return RegisterOP::I64_TO_F64;
+    } else if (from == DataType::F64 && to == DataType::I64) {
+        return RegisterOP::F64_TO_I64;
+    } else if (from == DataType::F64 && to == DataType::U64) {
+        return RegisterOP::F64_TO_U64;
+    }
+    return RegisterOP::TYPE_TRANS;
+}
+
+/**
+ * @brief value on symbolic register stack
+ *
+ */
+struct Operand {
+    enum Kind : uint8_t {
+        REG,
+        CONST,
+        IMM,
+    } kind;
+    size_t value;
+    bool operator==(const Operand&) const = default;
+};
+
+} // namespace
+
+namespace bytecode {
+
+std::string RegisterFunction::decompile() const {
+    std::string ret = std::format("    params: r{}..r{}, registers: {}\n\n", paramBase, paramBase + paramCount,
+                                  registerCount);
+    for (size_t i = 0; i < code.size(); i++) {
+        auto& c = code[i];
+        std::string operand;
+        switch (c.opCode) {
+        case RegisterOP::LOADK:
+            operand = std::format("r{}, k{}", c.dst, c.src0);
+            break;
+        case RegisterOP::LOADI:
+            operand = std::format("r{}, {:#x}", c.dst, c.src0);
+            break;
+        case RegisterOP::LOAD_VAR:
+        case RegisterOP::LOAD_GLOBAL:
+            operand = std::format("r{}, [{}]", c.dst, c.src0);
+            break;
+        case RegisterOP::STORE_VAR:
+        case RegisterOP::STORE_GLOBAL:
+            operand = std::format("[{}], r{}", c.dst, c.src0);
+            break;
+        case RegisterOP::BEZ:
+        case RegisterOP::BNZ:
+        case RegisterOP::BEZ_F64:
+        case RegisterOP::BNZ_F64:
+            operand = std::format("r{}, {}", c.src0, c.dst);
+            break;
+        case RegisterOP::BRANCH:
+            operand = std::format("{}", c.dst);
+            break;
+        case RegisterOP::CALL:
+            operand = std::format("r{}, f{}, {} args", c.dst, c.src1, c.subOP);
+            break;
+        case RegisterOP::CALL_NATIVE:
+            operand = std::format("r{}, native{}, {} args", c.dst, c.src0, c.subOP);
+            break;
+        case RegisterOP::ARG:
+            operand = std::format("r{}", c.src0);
+            break;
+        case RegisterOP::RET:
+            operand = c.subOP ? std::format("r{}", c.src0) : "";
+            break;
+        case RegisterOP::BIN_OP:
+            operand = std::format("r{}, r{}, r{} ({})", c.dst, c.src0, c.src1, BinaryOP(c.subOP).getName());
+            break;
+        case RegisterOP::UNARY_OP:
+            operand = std::format("r{}, r{} ({})", c.dst, c.src0, UnaryOP(c.subOP).getName());
+            break;
+        case RegisterOP::TYPE_TRANS:
+            operand = std::format("r{}, r{} ({})", c.dst, c.src0, DataType(c.subOP).getName());
+            break;
+        default:
+            if (c.opCode >= RegisterOP::ADD_F64 && c.opCode <= RegisterOP::LE_F64) {
+                operand = std::format("r{}, r{}, r{}", c.dst, c.src0, c.src1);
+            } else {
+                operand = std::format("r{}, r{}", c.dst, c.src0);
+            }
+            break;
+        }
+        auto typeName = c.type == DataType::NONE ? "-" : DataType(c.type).getName();
+        ret += std::format(" {:<6} {:14}{:4}  {}\n", i, RegisterOP(c.opCode).getName(), typeName, operand);
+    }
+    return ret;
+}
+
+std::optional<RegisterFunction> ByteCodeVM::Context::convertToRegister(size_t functionID) const {
+    auto& func = functions[functionID];
+    auto& info = linkedFunctionInfo[functionID];
+    auto& code = func.code;
+    const auto size = code.size();
+    const size_t varSlots = (info.varTableSize + sizeof(MemUnit) - 1) / sizeof(MemUnit);
+    const size_t linkedCount = func.constTableInfo.linkedFunctionCount;
+
+    auto jumpTarget = [&](size_t ip) {
+        return static_cast<std::ptrdiff_t>(ip + 1) + std::bit_cast<ByteCode::TypedData>(code[ip].data);
+    };
+    // values returned by function, all RET must agree
+    auto returnCountOf = [this](size_t id) -> std::optional<size_t> {
+        std::optional<size_t> ret;
+        for (auto& bc : functions[id].code) {
+            if (bc.opCode == OPCode::RET) {
+                if (ret.has_value() && ret.value() != bc.data) {
+                    return std::nullopt;
+                }
+                ret = bc.data;
+            }
+        }
+        return ret;
+    };
+    // callee of CALL at ip, function id is loaded by the instruction before
+    auto calleeOf = [&](size_t ip) -> std::optional<size_t> {
+        if (ip == 0 || code[ip - 1].opCode != OPCode::LOAD_CONST || code[ip - 1].type != DataType::U64 ||
+            code[ip - 1].data % sizeof(MemUnit) != 0 || code[ip - 1].data / sizeof(MemUnit) >= linkedCount) {
+            return std::nullopt;
+        }
+        return info.constant[code[ip - 1].data / sizeof(MemUnit)];
+    };
+    // {pop, push}
+    auto effect = [&](size_t ip) -> std::optional<std::pair<size_t, size_t>> {
+        auto [opCode, type, data] = code[ip];
+        switch (opCode) {
+        case OPCode::NOP:
+        case OPCode::BRANCH:
+            return std::pair{0, 0};
+        case OPCode::COPY:
+            return std::pair{data, 2 * data};
+        case OPCode::LOAD_IMM:
+        case OPCode::LOAD_VAR:
+        case OPCode::LOAD_CONST:
+        case OPCode::LOAD_GLOBAL:
+            return std::pair{0, 1};
+        case OPCode::STORE_VAR:
+        case OPCode::STORE_GLOBAL:
+        case OPCode::POP:
+        case OPCode::BEZ:
+        case OPCode::BNZ:
+            return std::pair{1, 0};
+        case OPCode::TYPE_TRANS:
+        case OPCode::UNARY_OP:
+            return std::pair{1, 1};
+        case OPCode::BIN_OP:
+            return std::pair{2, 1};
+        case OPCode::RET:
+            return std::pair{data, 0};
+        case OPCode::CALL: {
+            auto callee = calleeOf(ip);
+            if (!callee.has_value() || callee.value() >= functions.size()) {
+                return std::nullopt;
+            }
+            auto count = returnCountOf(callee.value());
+            if (!count.has_value() || count.value() > 1) {
+                return std::nullopt;
+            }
+            return std::pair{data + 1, count.value()};
+        }
+        case OPCode::CALL_NATIVE:
+            if (data >= nativeFunctions.size()) {
+                return std::nullopt;
+            }
+            return std::pair{nativeFunctions[data].paramCount, 1};
+        default:
+            // SYSCALL, memory access and addresses are not supported
+            return std::nullopt;
+        }
+    };
+
+    // stack depth before each instruction relative to entry, params are below 0
+    std::vector<std::optional<std::ptrdiff_t>> depth(size);
+    std::vector<bool> leader(size, false);
+    std::ptrdiff_t minDepth = 0, maxDepth = 0;
+    if (size == 0) {
+        return std::nullopt;
+    }
+    leader[0] = true;
+    std::vector<size_t> worklist{0};
+    depth[0] = 0;
+    auto reach = [&](size_t from, std::ptrdiff_t target, std::ptrdiff_t d) {
+        if (target < 0 || target >= static_cast<std::ptrdiff_t>(size)) {
+            return false;
+        }
+        if (depth[target].has_value()) {
+            return depth[target].value() == d;
+        }
+        depth[target] = d;
+        worklist.push_back(target);
+        return true;
+    };
+    while (!worklist.empty()) {
+        auto ip = worklist.back();
+        worklist.pop_back();
+        auto e = effect(ip);
+        if (!e.has_value()) {
+            return std::nullopt;
+        }
+        auto d = depth[ip].value() - static_cast<std::ptrdiff_t>(e->first);
+        minDepth = std::min(minDepth, d);
+        d += e->second;
+        maxDepth = std::max(maxDepth, d);
+        auto op = code[ip].opCode;
+        if (op == OPCode::BEZ || op == OPCode::BNZ || op == OPCode::BRANCH) {
+            auto target = jumpTarget(ip);
+            if (!reach(ip, target, d)) {
+                return std::nullopt;
+            }
+            leader[target] = true;
+            if (ip + 1 < size) {
+                leader[ip + 1] = true;
+            }
+        }
+        if (op == OPCode::RET) {
+            if (ip + 1 < size) {
+                leader[ip + 1] = true;
+            }
+        } else if (op != OPCode::BRANCH && !reach(ip, ip + 1, d)) {
+            return std::nullopt;
+        }
+    }
+    const size_t paramCount = -minDepth;
+    const size_t slotBase = varSlots;
+    const size_t slotCount = maxDepth + paramCount;
+    const size_t tempBase = slotBase + slotCount;
+
+    RegisterFunction ret{{}, slotBase, paramCount, 0, 0};
+    std::optional<size_t> returnCount;
+    auto& out = ret.code;
+    std::vector<size_t> regIP(size, 0);
+    std::vector<size_t> jumps;
+    std::vector<Operand> stack;
+    size_t tempCount = 0;
+    size_t blockBegin = 0;
+    bool failed = false;
+
+    auto emit = [&](RegisterOP::Type op, uint8_t type, size_t subOP, size_t dst, size_t src0, size_t src1) {
+        if (subOP > UINT8_MAX || dst > UINT16_MAX || src0 > UINT16_MAX || src1 > UINT16_MAX) {
+            failed = true;
+        }
+        out.push_back(RegisterCode{static_cast<uint8_t>(op), type, static_cast<uint8_t>(subOP),
+                                   static_cast<uint16_t>(dst), static_cast<uint16_t>(src0),
+                                   static_cast<uint16_t>(src1)});
+    };
+    auto fresh = [&] { return tempBase + tempCount++; };
+    auto isSlot = [&](size_t reg) { return reg >= slotBase && reg < tempBase; };
+    auto assign = [&](size_t dst, Operand v) {
+        if (v.kind == Operand::CONST) {
+            emit(RegisterOP::LOADK, DataType::U64, 0, dst, v.value, 0);
+        } else if (v.kind == Operand::IMM) {
+            emit(RegisterOP::LOADI, DataType::U64, 0, dst, v.value, 0);
+        } else if (v.value != dst) {
+            emit(RegisterOP::MOV, DataType::U64, 0, dst, v.value, 0);
+        }
+    };
+    auto materialize = [&](Operand v) {
+        if (v.kind == Operand::REG) {
+            return v.value;
+        }
+        auto reg = fresh();
+        assign(reg, v);
+        return reg;
+    };
+    auto pop = [&] {
+        auto v = stack.back();
+        stack.pop_back();
+        return v;
+    };
+    // values of variables in [begin, end) on stack are copied before the variables are written
+    auto protect = [&](size_t begin, size_t end) {
+        for (size_t i = 0; i < stack.size(); i++) {
+            auto v = stack[i];
+            if (v.kind == Operand::REG && v.value >= begin && v.value < end) {
+                auto reg = fresh();
+                emit(RegisterOP::MOV, DataType::U64, 0, reg, v.value, 0);
+                std::replace(stack.begin() + i, stack.end(), v, Operand{Operand::REG, reg});
+            }
+        }
+    };
+    // at block boundary, each stack slot is in its fixed register
+    auto canonicalize = [&] {
+        for (size_t i = 0; i < stack.size(); i++) {
+            auto& v = stack[i];
+            // slots are written below, so values from other slots are saved first
+            if (v.kind == Operand::REG && isSlot(v.value) && v.value != slotBase + i) {
+                auto reg = fresh();
+                emit(RegisterOP::MOV, DataType::U64, 0, reg, v.value, 0);
+                v = {Operand::REG, reg};
+            }
+        }
+        for (size_t i = 0; i < stack.size(); i++) {
+            assign(slotBase + i, stack[i]);
+            stack[i] = {Operand::REG, slotBase + i};
+        }
+    };
+    auto definesDst = [](uint8_t op) {
+        return op != RegisterOP::STORE_VAR && op != RegisterOP::STORE_GLOBAL && op != RegisterOP::BEZ &&
+               op != RegisterOP::BNZ && op != RegisterOP::BEZ_F64 && op != RegisterOP::BNZ_F64 &&
+               op != RegisterOP::BRANCH && op != RegisterOP::CALL && op != RegisterOP::ARG && op != RegisterOP::RET;
+    };
+
+    bool reachable = false;
+    for (size_t ip = 0; ip < size && !failed; ip++) {
+        if (leader[ip]) {
+            reachable = depth[ip].has_value();
+            if (reachable) {
+                stack.clear();
+                for (size_t i = 0; i < depth[ip].value() + paramCount; i++) {
+                    stack.push_back({Operand::REG, slotBase + i});
+                }
+                regIP[ip] = out.size();
+                blockBegin = out.size();
+            }
+        }
+        if (!reachable) {
+            continue;
+        }
+        auto [opCode, type, data] = code[ip];
+        switch (opCode) {
+        case OPCode::NOP:
+            break;
+        case OPCode::COPY: {
+            auto n = stack.size();
+            for (size_t i = n - data; i < n; i++) {
+                stack.push_back(stack[i]);
+            }
+            break;
+        }
+        case OPCode::LOAD_IMM:
+            stack.push_back({Operand::IMM, data});
+            break;
+        case OPCode::LOAD_VAR:
+            if (is64(type) && data % sizeof(MemUnit) == 0 && data / sizeof(MemUnit) < varSlots) {
+                stack.push_back({Operand::REG, data / sizeof(MemUnit)});
+            } else {
+                auto reg = fresh();
+                emit(RegisterOP::LOAD_VAR, type, 0, reg, data, 0);
+                stack.push_back({Operand::REG, reg});
+            }
+            break;
+        case OPCode::LOAD_CONST:
+            if (!is64(type) || data % sizeof(MemUnit) != 0 || data / sizeof(MemUnit) >= info.constant.size()) {
+                failed = true;
+                break;
+            }
+            stack.push_back({Operand::CONST, data / sizeof(MemUnit)});
+            break;
+        case OPCode::STORE_VAR: {
+            auto v = pop();
+            if (is64(type) && data % sizeof(MemUnit) == 0 && data / sizeof(MemUnit) < varSlots) {
+                auto slot = data / sizeof(MemUnit);
+                protect(slot, slot + 1);
+                // write result of last instruction into variable directly
+                if (v.kind == Operand::REG && v.value >= tempBase && out.size() > blockBegin &&
+                    out.back().dst == v.value && definesDst(out.back().opCode) &&
+                    std::find(stack.begin(), stack.end(), v) == stack.end()) {
+                    out.back().dst = static_cast<uint16_t>(slot);
+                } else {
+                    assign(slot, v);
+                }
+            } else {
+                auto reg = materialize(v);
+                protect(data / sizeof(MemUnit), (data + dataTypeSize(type) - 1) / sizeof(MemUnit) + 1);
+                emit(RegisterOP::STORE_VAR, type, 0, data, reg, 0);
+            }
+            break;
+        }
+        case OPCode::TYPE_TRANS: {
+            auto src = materialize(pop());
+            auto reg = fresh();
+            emit(specializeTypeTrans(type, data), type, data, reg, src, 0);
+            stack.push_back({Operand::REG, reg});
+            break;
+        }
+        case OPCode::BIN_OP: {
+            auto rhs = materialize(pop());
+            auto lhs = materialize(pop());
+            auto reg = fresh();
+            emit(specializeBinop(type, data), type, data, reg, lhs, rhs);
+            stack.push_back({Operand::REG, reg});
+            break;
+        }
+        case OPCode::UNARY_OP: {
+            auto src = materialize(pop());
+            auto reg = fresh();
+            auto op = RegisterOP::UNARY_OP;
+            if (type == DataType::F64 && data == UnaryOP::NEG) {
+                op = RegisterOP::NEG_F64;
+            } else if (type == DataType::F64 && data == UnaryOP::NOT) {
+                op = RegisterOP::NOT_F64;
+            }
+            emit(op, type, data, reg, src, 0);
+            stack.push_back({Operand::REG, reg});
+            break;
+        }
+        case OPCode::BEZ:
+        case OPCode::BNZ: {
+            auto cond = materialize(pop());
+            canonicalize();
+            RegisterOP::Type op = opCode == OPCode::BEZ ? (type == DataType::F64 ? RegisterOP::BEZ_F64 : RegisterOP::BEZ)
+                                                        : (type == DataType::F64 ? RegisterOP::BNZ_F64 : RegisterOP::BNZ);
+            jumps.push_back(out.size());
+            emit(op, type, 0, jumpTarget(ip), cond, 0);
+            break;
+        }
+        case OPCode::BRANCH:
+            canonicalize();
+            jumps.push_back(out.size());
+            emit(RegisterOP::BRANCH, DataType::NONE, 0, jumpTarget(ip), 0, 0);
+            break;
+        case OPCode::CALL: {
+            auto callee = pop();
+            if (callee.kind != Operand::CONST || callee.value >= linkedCount) {
+                failed = true;
+                break;
+            }
+            auto id = info.constant[callee.value];
+            std::vector<size_t> args(data);
+            for (size_t i = data; i > 0; i--) {
+                args[i - 1] = materialize(pop());
+            }
+            auto count = returnCountOf(id).value();
+            auto reg = count ? fresh() : 0;
+            emit(RegisterOP::CALL, count ? DataType::U64 : DataType::NONE, data, reg, 0, id);
+            for (auto arg : args) {
+                emit(RegisterOP::ARG, DataType::NONE, 0, 0, arg, 0);
+            }
+            if (count) {
+                stack.push_back({Operand::REG, reg});
+            }
+            break;
+        }
+        case OPCode::RET: {
+            if (data > 1 || (returnCount.has_value() && returnCount.value() != data)) {
+                failed = true;
+                break;
+            }
+            returnCount = data;
+            emit(RegisterOP::RET, DataType::NONE, data, 0, data ? materialize(pop()) : 0, 0);
+            break;
+        }
+        case OPCode::POP:
+            stack.pop_back();
+            break;
+        case OPCode::LOAD_GLOBAL: {
+            auto reg = fresh();
+            emit(RegisterOP::LOAD_GLOBAL, type, 0, reg, data, 0);
+            stack.push_back({Operand::REG, reg});
+            break;
+        }
+        case OPCode::STORE_GLOBAL:
+            emit(RegisterOP::STORE_GLOBAL, type, 0, data, materialize(pop()), 0);
+            break;
+        case OPCode::CALL_NATIVE: {
+            auto count = nativeFunctions[data].paramCount;
+            std::vector<size_t> args(count);
+            for (size_t i = count; i > 0; i--) {
+                args[i - 1] = materialize(pop());
+            }
+            auto reg = fresh();
+            emit(RegisterOP::CALL_NATIVE, DataType::NONE, count, reg, data, 0);
+            for (auto arg : args) {
+                emit(RegisterOP::ARG, DataType::NONE, 0, 0, arg, 0);
+            }
+            stack.push_back({Operand::REG, reg});
+            break;
+        }
+        default:
+            failed = true;
+            break;
+        }
+        if (ip + 1 < size && leader[ip + 1] && opCode != OPCode::BRANCH && opCode != OPCode::RET) {
+            canonicalize();
+        }
+    }
+    if (failed) {
+        return std::nullopt;
+    }
+    for (auto pos : jumps) {
+        out[pos].dst = static_cast<uint16_t>(regIP[out[pos].dst]);
+    }
+    ret.returnCount = returnCount.value_or(0);
+
+    // linear scan, temporaries never live across blocks so no interval is extended by loops
+    constexpr size_t none = static_cast<size_t>(-1);
+    std::vector<std::pair<size_t, size_t>> interval(tempCount, {none, 0});
+    for (size_t i = 0; i < out.size(); i++) {
+        forEachRegister(out[i], [&](uint16_t& reg, bool) {
+            if (reg >= tempBase) {
+                auto& [begin, end] = interval[reg - tempBase];
+                begin = std::min(begin, i);
+                end = std::max(end, i);
+            }
+        });
+    }
+    std::vector<size_t> order;
+    for (size_t i = 0; i < tempCount; i++) {
+        if (interval[i].first != none) {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [&](auto a, auto b) { return interval[a].first < interval[b].first; });
+    std::vector<size_t> physical(tempCount, 0);
+    // {end, physical register}
+    std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, std::greater<>> active;
+    std::vector<size_t> freeRegister;
+    size_t physicalCount = 0;
+    for (auto temp : order) {
+        // sources are read before destination is written, so a register freed at this instruction can be reused
+        while (!active.empty() && active.top().first <= interval[temp].first) {
+            freeRegister.push_back(active.top().second);
+            active.pop();
+        }
+        if (freeRegister.empty()) {
+            physical[temp] = physicalCount++;
+        } else {
+            physical[temp] = freeRegister.back();
+            freeRegister.pop_back();
+        }
+        active.emplace(interval[temp].second, physical[temp]);
+    }
+    for (auto& c : out) {
+        forEachRegister(c, [&](uint16_t& reg, bool) {
+            if (reg >= tempBase) {
+                reg = static_cast<uint16_t>(tempBase + physical[reg - tempBase]);
+            }
+        });
+    }
+    ret.registerCount = tempBase + physicalCount;
+    return ret;
+}
+
+void ByteCodeVM::Context::updateRegisterReady() {
+    for (auto& info : linkedFunctionInfo) {
+        info.registerReady = info.registerCode.has_value();
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto& info : linkedFunctionInfo) {
+            if (!info.registerReady) {
+                continue;
+            }
+            for (auto& c : info.registerCode->code) {
+                if (c.opCode == RegisterOP::CALL &&
+                    (c.src1 >= linkedFunctionInfo.size() || !linkedFunctionInfo[c.src1].registerReady)) {
+                    info.registerReady = false;
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+int ByteCodeVM::executeRegister(size_t depth) {
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+    // same order as RegisterOP
+    static const void* const labels[] = {
+        &&L_MOV,        &&L_LOADK,       &&L_LOADI,      &&L_LOAD_VAR,   &&L_STORE_VAR,  &&L_LOAD_GLOBAL,
+        &&L_STORE_GLOBAL, &&L_TYPE_TRANS, &&L_U64_TO_F64, &&L_I64_TO_F64, &&L_F64_TO_I64, &&L_F64_TO_U64,
+        &&L_BIN_OP,     &&L_ADD_F64,     &&L_SUB_F64,    &&L_MUL_F64,    &&L_DIV_F64,    &&L_GE_F64,
+        &&L_GT_F64,     &&L_EQU_F64,     &&L_NEQ_F64,    &&L_LT_F64,     &&L_LE_F64,     &&L_UNARY_OP,
+        &&L_NEG_F64,    &&L_NOT_F64,     &&L_BEZ,        &&L_BNZ,        &&L_BEZ_F64,    &&L_BNZ_F64,
+        &&L_BRANCH,     &&L_CALL,        &&L_CALL_NATIVE, &&L_ARG,       &&L_RET,
+    };
+    static_assert(std::size(labels) == RegisterOP::__END);
+#define REGISTER_TARGET(name) L_##name:
+#define REGISTER_DISPATCH() goto* labels[pc->opCode]
+#else
+#define REGISTER_TARGET(name) case RegisterOP::name:
+#define REGISTER_DISPATCH() goto dispatch
+#endif
+#define REGISTER_CHECK_ERROR()                                                                                         \
+    if (err != Error::NONE) {                                                                                          \
+        return -1;                                                                                                     \
+    }
+
+    // params of the outermost frame are moved from register stack into its register file
+    {
+        auto& frame = functionStack.back();
+        auto& function = *context.linkedFunctionInfo[frame.functionID].registerCode;
+        varStack.resize(frame.varBase + function.registerCount, 0);
+        std::copy(registerStack.begin() + frame.stack_bottom, registerStack.end(),
+                  varStack.begin() + frame.varBase + function.paramBase);
+        registerStack.resize(frame.stack_bottom);
+        frame.ip = 0;
+    }
+
+    uint8_t* dataTable = reinterpret_cast<uint8_t*>(dataSegment.data());
+    const RegisterCode* code;
+    const RegisterCode* pc;
+    const MemUnit* constTable;
+    MemUnit* r;
+    auto loadFrame = [&] {
+        auto& frame = functionStack.back();
+        auto& info = context.linkedFunctionInfo[frame.functionID];
+        code = info.registerCode->code.data();
+        constTable = info.constant.data();
+        r = varStack.data() + frame.varBase;
+        pc = code + frame.ip;
+    };
+    loadFrame();
+    err = Error::NONE;
+
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+    REGISTER_DISPATCH();
+#else
+dispatch:
+    switch (static_cast<RegisterOP::Type>(pc->opCode)) {
+#endif
+    REGISTER_TARGET(MOV) {
+        r[pc->dst] = r[pc->src0];
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(LOADK) {
+        r[pc->dst] = constTable[pc->src0];
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(LOADI) {
+        r[pc->dst] = pc->src0;
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(LOAD_VAR) {
+        MemUnit tmp;
+        load(reinterpret_cast<uint8_t*>(r) + pc->src0, &tmp, static_cast<DataType::Type>(pc->type));
+        REGISTER_CHECK_ERROR();
+        r[pc->dst] = tmp;
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(STORE_VAR) {
+        store(reinterpret_cast<uint8_t*>(r) + pc->dst, &r[pc->src0], static_cast<DataType::Type>(pc->type));
+        REGISTER_CHECK_ERROR();
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(LOAD_GLOBAL) {
+        if (is64(pc->type)) {
+            std::memcpy(&r[pc->dst], dataTable + pc->src0, sizeof(MemUnit));
+        } else {
+            load(dataTable + pc->src0, &r[pc->dst], static_cast<DataType::Type>(pc->type));
+            REGISTER_CHECK_ERROR();
+        }
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(STORE_GLOBAL) {
+        if (is64(pc->type)) {
+            std::memcpy(dataTable + pc->dst, &r[pc->src0], sizeof(MemUnit));
+        } else {
+            store(dataTable + pc->dst, &r[pc->src0], static_cast<DataType::Type>(pc->type));
+            REGISTER_CHECK_ERROR();
+        }
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(TYPE_TRANS) {
+        MemUnit tmp = r[pc->src0];
+        typeTrans(&tmp, static_cast<DataType::Type>(pc->type), static_cast<DataType::Type>(pc->subOP));
+        REGISTER_CHECK_ERROR();
+        r[pc->dst] = tmp;
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(U64_TO_F64) {
+        r[pc->dst] = std::bit_cast<MemUnit>(static_cast<double_t>(r[pc->src0]));
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(I64_TO_F64) {
+        r[pc->dst] = std::bit_cast<MemUnit>(static_cast<double_t>(std::bit_cast<int64_t>(r[pc->src0])));
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(F64_TO_I64) {
+        r[pc->dst] = std::bit_cast<MemUnit>(static_cast<int64_t>(std::bit_cast<double_t>(r[pc->src0])));
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(F64_TO_U64) {
+        r[pc->dst] = static_cast<uint64_t>(std::bit_cast<double_t>(r[pc->src0]));
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BIN_OP) {
+        r[pc->dst] = applyBinop(r[pc->src0], r[pc->src1], static_cast<DataType::Type>(pc->type),
+                                static_cast<BinaryOP::Type>(pc->subOP));
+        REGISTER_CHECK_ERROR();
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+#define REGISTER_F64_BIN_OP(name, expr)                                                                                \
+    REGISTER_TARGET(name) {                                                                                            \
+        auto lhs = std::bit_cast<double_t>(r[pc->src0]);                                                               \
+        auto rhs = std::bit_cast<double_t>(r[pc->src1]);                                                               \
+        r[pc->dst] = (expr);                                                                                           \
+        ++pc;                                                                                                          \
+        REGISTER_DISPATCH();                                                                                           \
+    }
+    REGISTER_F64_BIN_OP(ADD_F64, std::bit_cast<MemUnit>(lhs + rhs))
+    REGISTER_F64_BIN_OP(SUB_F64, std::bit_cast<MemUnit>(lhs - rhs))
+    REGISTER_F64_BIN_OP(MUL_F64, std::bit_cast<MemUnit>(lhs * rhs))
+    REGISTER_F64_BIN_OP(DIV_F64, std::bit_cast<MemUnit>(lhs / rhs))
+    REGISTER_F64_BIN_OP(GE_F64, static_cast<MemUnit>(lhs >= rhs))
+    REGISTER_F64_BIN_OP(GT_F64, static_cast<MemUnit>(lhs > rhs))
+    REGISTER_F64_BIN_OP(EQU_F64, static_cast<MemUnit>(lhs == rhs))
+    REGISTER_F64_BIN_OP(NEQ_F64, static_cast<MemUnit>(lhs != rhs))
+    REGISTER_F64_BIN_OP(LT_F64, static_cast<MemUnit>(lhs < rhs))
+    REGISTER_F64_BIN_OP(LE_F64, static_cast<MemUnit>(lhs <= rhs))
+#undef REGISTER_F64_BIN_OP
+    REGISTER_TARGET(UNARY_OP) {
+        r[pc->dst] =
+            applyUnaryop(r[pc->src0], static_cast<DataType::Type>(pc->type), static_cast<UnaryOP::Type>(pc->subOP));
+        REGISTER_CHECK_ERROR();
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(NEG_F64) {
+        r[pc->dst] = std::bit_cast<MemUnit>(-std::bit_cast<double_t>(r[pc->src0]));
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(NOT_F64) {
+        r[pc->dst] = std::bit_cast<double_t>(r[pc->src0]) == 0;
+        ++pc;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BEZ) {
+        pc = r[pc->src0] == 0 ? code + pc->dst : pc + 1;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BNZ) {
+        pc = r[pc->src0] != 0 ? code + pc->dst : pc + 1;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BEZ_F64) {
+        pc = std::bit_cast<double_t>(r[pc->src0]) == 0 ? code + pc->dst : pc + 1;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BNZ_F64) {
+        pc = std::bit_cast<double_t>(r[pc->src0]) != 0 ? code + pc->dst : pc + 1;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(BRANCH) {
+        pc = code + pc->dst;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(CALL) {
+        size_t id = pc->src1;
+        auto& callee = *context.linkedFunctionInfo[id].registerCode;
+        auto& caller = functionStack.back();
+        auto callerBase = caller.varBase;
+        caller.ip = pc + 1 + pc->subOP - code;
+        auto base = varStack.size();
+        // may reallocate, registers of caller are reloaded
+        varStack.resize(base + callee.registerCount, 0);
+        r = varStack.data() + callerBase;
+        for (size_t i = 0; i < pc->subOP; i++) {
+            varStack[base + callee.paramBase + i] = r[pc[i + 1].src0];
+        }
+        functionStack.emplace_back(id, 0, base, 0, pc->dst);
+        loadFrame();
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(CALL_NATIVE) {
+        MemUnit params[UINT8_MAX];
+        for (size_t i = 0; i < pc->subOP; i++) {
+            params[i] = r[pc[i + 1].src0];
+        }
+        r[pc->dst] = context.nativeFunctions[pc->src0].function(params);
+        pc += 1 + pc->subOP;
+        REGISTER_DISPATCH();
+    }
+    REGISTER_TARGET(ARG) {
+        // consumed by CALL
+        err = Error::ILLEGAL_OP;
+        return -1;
+    }
+    REGISTER_TARGET(RET) {
+        MemUnit value = pc->subOP ? r[pc->src0] : 0;
+        auto count = pc->subOP;
+        auto returnRegister = functionStack.back().returnRegister;
+        varStack.resize(functionStack.back().varBase);
+        functionStack.pop_back();
+        if (functionStack.size() <= depth) {
+            if (count) {
+                registerStack.push_back(value);
+            }
+            return 0;
+        }
+        loadFrame();
+        if (count) {
+            r[returnRegister] = value;
+        }
+        REGISTER_DISPATCH();
+    }
+#ifndef __BYTECODE_VM_COMPUTED_GOTO__
+    default:
+        err = Error::ILLEGAL_OP;
+        return -1;
+    }
+#endif
+
+#undef REGISTER_CHECK_ERROR
+#undef REGISTER_DISPATCH
+#undef REGISTER_TARGET
+}
+
+} // namespace bytecode
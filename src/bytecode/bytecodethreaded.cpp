@@ -0,0 +1,855 @@
+/**
+ * @file bytecodethreaded.cpp
+ * @author djw
+ * @brief
+ * @date 2026-10-17
+ *
+ * @details Direct-threaded dispatch of ByteCodeVM.
+ *
+ * Every ByteCode is decoded into a ThreadedCode when its function is linked, OPCode is specialized by type and
+ * operand (e.g. BIN_OP F64 ADD -> ADD_F64, LOAD_CONST of 64bit -> PUSH of the constant itself, relative jump ->
+ * absolute ip), and the label of its handler is stored in it, so each handler jumps to the next one directly.
+ * Without computed goto, handlers are dispatched by switch over ThreadedOP.
+ *
+ * Hot sequences recorded in a SequenceProfile can be fused into superinstructions, whose handler executes the whole
+ * sequence with operands read from the following ThreadedCode, then skips them.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add superinstructions selected by sequence profile.</td></tr>
+ * </table>
+ */
+#include <cstring>
+#include <sstream>
+
+#include "bytecode.h"
+
+namespace {
+
+using namespace bytecode;
+
+struct Superinstruction {
+    ThreadedOP::Type fused;
+    SequenceProfile::Sequence sequence;
+};
+
+constexpr SequenceProfile::Sequence sequenceOf(std::initializer_list<ThreadedOP::Type> ops) {
+    SequenceProfile::Sequence ret;
+    ret.fill(ThreadedOP::__END);
+    std::copy(ops.begin(), ops.end(), ret.begin());
+    return ret;
+}
+
+// handlers are in executeThreaded, each executes its sequence exactly as unfused ones without error,
+// comparison yields U64 which is converted to F64 when used as bool value of rules
+#define SUPERINSTRUCTION_COMPARE(name)                                                                                 \
+    {ThreadedOP::name##_F64_BOOL, sequenceOf({ThreadedOP::name##_F64, ThreadedOP::U64_TO_F64})},                       \
+        {ThreadedOP::PUSH_##name##_F64_BOOL,                                                                           \
+         sequenceOf({ThreadedOP::PUSH, ThreadedOP::name##_F64, ThreadedOP::U64_TO_F64})},                              \
+        {ThreadedOP::name##_F64_BEZ, sequenceOf({ThreadedOP::name##_F64, ThreadedOP::BEZ})}
+constexpr Superinstruction superinstructionTable[] = {
+    {ThreadedOP::LOAD_GLOBAL_64_2, sequenceOf({ThreadedOP::LOAD_GLOBAL_64, ThreadedOP::LOAD_GLOBAL_64})},
+    {ThreadedOP::LOAD_GLOBAL_64_PUSH, sequenceOf({ThreadedOP::LOAD_GLOBAL_64, ThreadedOP::PUSH})},
+    {ThreadedOP::LOAD_VAR_64_2, sequenceOf({ThreadedOP::LOAD_VAR_64, ThreadedOP::LOAD_VAR_64})},
+    {ThreadedOP::LOAD_VAR_64_PUSH, sequenceOf({ThreadedOP::LOAD_VAR_64, ThreadedOP::PUSH})},
+    {ThreadedOP::POP_LOAD_GLOBAL_64, sequenceOf({ThreadedOP::POP, ThreadedOP::LOAD_GLOBAL_64})},
+    SUPERINSTRUCTION_COMPARE(GE),
+    SUPERINSTRUCTION_COMPARE(GT),
+    SUPERINSTRUCTION_COMPARE(EQU),
+    SUPERINSTRUCTION_COMPARE(NEQ),
+    SUPERINSTRUCTION_COMPARE(LT),
+    SUPERINSTRUCTION_COMPARE(LE),
+    {ThreadedOP::BOOL_BEZ_F64, sequenceOf({ThreadedOP::U64_TO_F64, ThreadedOP::BEZ_F64})},
+    {ThreadedOP::BOOL_BNZ_F64, sequenceOf({ThreadedOP::U64_TO_F64, ThreadedOP::BNZ_F64})},
+    {ThreadedOP::BOOL_COPY_BEZ_F64, sequenceOf({ThreadedOP::U64_TO_F64, ThreadedOP::COPY, ThreadedOP::BEZ_F64})},
+    {ThreadedOP::BOOL_COPY_BNZ_F64, sequenceOf({ThreadedOP::U64_TO_F64, ThreadedOP::COPY, ThreadedOP::BNZ_F64})},
+    {ThreadedOP::COPY_BEZ_F64, sequenceOf({ThreadedOP::COPY, ThreadedOP::BEZ_F64})},
+    {ThreadedOP::COPY_BNZ_F64, sequenceOf({ThreadedOP::COPY, ThreadedOP::BNZ_F64})},
+    {ThreadedOP::BEZ_F64_POP, sequenceOf({ThreadedOP::BEZ_F64, ThreadedOP::POP})},
+    {ThreadedOP::BNZ_F64_POP, sequenceOf({ThreadedOP::BNZ_F64, ThreadedOP::POP})},
+};
+#undef SUPERINSTRUCTION_COMPARE
+static_assert(std::size(superinstructionTable) == ThreadedOP::__END - ThreadedOP::LOAD_GLOBAL_64_2);
+
+size_t sequenceLength(const SequenceProfile::Sequence& sequence) {
+    return std::find(sequence.begin(), sequence.end(), ThreadedOP::__END) - sequence.begin();
+}
+
+} // namespace
+
+namespace bytecode {
+
+std::string SequenceProfile::dump() const {
+    std::vector<std::pair<size_t, Sequence>> sorted;
+    for (auto& [sequence, n] : count) {
+        sorted.emplace_back(n, sequence);
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), [](auto& a, auto& b) { return a.first > b.first; });
+    std::string ret;
+    for (auto& [n, sequence] : sorted) {
+        ret += std::to_string(n);
+        for (size_t i = 0; i < sequenceLength(sequence); i++) {
+            ret += ' ';
+            ret += ThreadedOP(sequence[i]).getName();
+        }
+        ret += '\n';
+    }
+    return ret;
+}
+
+std::optional<SequenceProfile> SequenceProfile::parse(std::string_view text) {
+    SequenceProfile ret;
+    std::istringstream in{std::string(text)};
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        size_t n;
+        if (!(fields >> n)) {
+            // empty line or comment
+            if (line.find_first_not_of(" \t\r") == std::string::npos || line[line.find_first_not_of(" \t")] == '#') {
+                continue;
+            }
+            return std::nullopt;
+        }
+        Sequence sequence;
+        sequence.fill(ThreadedOP::__END);
+        size_t length = 0;
+        std::string name;
+        while (fields >> name) {
+            auto it = std::find(ThreadedOP::names.begin(), ThreadedOP::names.end(), name);
+            if (it == ThreadedOP::names.end() || length == maxLength) {
+                return std::nullopt;
+            }
+            sequence[length++] = static_cast<uint16_t>(it - ThreadedOP::names.begin());
+        }
+        if (length < 2) {
+            return std::nullopt;
+        }
+        ret.count[sequence] += n;
+    }
+    return ret;
+}
+
+size_t ByteCodeVM::Context::setSuperinstructions(const SequenceProfile& profile) {
+    // dispatches saved by each superinstruction
+    std::vector<std::pair<size_t, uint16_t>> selected;
+    for (auto& [fused, sequence] : superinstructionTable) {
+        if (auto it = profile.count.find(sequence); it != profile.count.end() && it->second > 0) {
+            selected.emplace_back(it->second * (sequenceLength(sequence) - 1), fused);
+        }
+    }
+    std::stable_sort(selected.begin(), selected.end(), [](auto& a, auto& b) { return a.first > b.first; });
+    superinstructions.clear();
+    for (auto& [saved, fused] : selected) {
+        superinstructions.push_back(fused);
+    }
+    for (auto& [id, ip] : functionIndexInTextSegment) {
+        fuse(ip, ip + functions[id].code.size());
+    }
+    return superinstructions.size();
+}
+
+void ByteCodeVM::Context::fuse(size_t begin, size_t end) {
+    for (size_t ip = begin; ip < end; ip++) {
+        auto& code = threadedSegment[ip];
+        code.op = code.base;
+        for (auto fused : superinstructions) {
+            auto& sequence = std::find_if(std::begin(superinstructionTable), std::end(superinstructionTable),
+                                          [&](auto& s) { return s.fused == fused; })
+                                 ->sequence;
+            auto length = sequenceLength(sequence);
+            bool matched = ip + length <= end;
+            for (size_t i = 0; matched && i < length; i++) {
+                matched = threadedSegment[ip + i].base == sequence[i];
+            }
+            if (matched) {
+                code.op = fused;
+                break;
+            }
+        }
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+        code.handler = threadedHandlers()[code.op];
+#endif
+    }
+}
+
+const void* const* ByteCodeVM::threadedHandlers() {
+    static const void* const* handlers = [] {
+        const void* const* ret = nullptr;
+        executeThreaded(nullptr, 0, &ret);
+        return ret;
+    }();
+    return handlers;
+}
+
+ThreadedCode ByteCodeVM::Context::decode(ByteCode bc, size_t ip, size_t begin, size_t end,
+                                         const std::vector<MemUnit>& constant) {
+    auto [opCode, type, data] = bc;
+    auto is64 = [](uint8_t type) { return type == DataType::U64 || type == DataType::I64 || type == DataType::F64; };
+    ThreadedCode ret{nullptr, ThreadedOP::TRAP, type, data, ThreadedOP::TRAP, static_cast<MemUnit>(Error::ILLEGAL_OP)};
+    auto jump = [&](ThreadedOP::Type op) {
+        auto target = static_cast<std::ptrdiff_t>(ip + 1) + std::bit_cast<ByteCode::TypedData>(data);
+        if (target < static_cast<std::ptrdiff_t>(begin) || target >= static_cast<std::ptrdiff_t>(end)) {
+            ret.operand = static_cast<MemUnit>(Error::CODE_OVERFLOW);
+        } else {
+            ret.op = op;
+            ret.operand = static_cast<MemUnit>(target);
+        }
+    };
+    switch (static_cast<OPCode::Type>(opCode)) {
+    case OPCode::NOP:
+        ret.op = ThreadedOP::NOP;
+        break;
+    case OPCode::COPY:
+        ret.op = ThreadedOP::COPY;
+        break;
+    case OPCode::LOAD_IMM:
+        ret.op = ThreadedOP::PUSH;
+        ret.operand = data;
+        break;
+    case OPCode::LOAD_VAR:
+        ret.op = is64(type) ? ThreadedOP::LOAD_VAR_64 : ThreadedOP::LOAD_VAR;
+        break;
+    case OPCode::LOAD_CONST:
+        // constants never change after linked
+        if (is64(type) && data % sizeof(MemUnit) == 0 && data / sizeof(MemUnit) < constant.size()) {
+            ret.op = ThreadedOP::PUSH;
+            ret.operand = constant[data / sizeof(MemUnit)];
+        } else {
+            ret.op = ThreadedOP::LOAD_CONST;
+        }
+        break;
+    case OPCode::LOAD_MEM:
+        ret.op = ThreadedOP::LOAD_MEM;
+        break;
+    case OPCode::STORE_VAR:
+        ret.op = is64(type) ? ThreadedOP::STORE_VAR_64 : ThreadedOP::STORE_VAR;
+        break;
+    case OPCode::STORE_MEM:
+        ret.op = ThreadedOP::STORE_MEM;
+        break;
+    case OPCode::VAR_ADDRESS:
+        ret.op = ThreadedOP::VAR_ADDRESS;
+        break;
+    case OPCode::CONST_ADDRESS:
+        ret.op = ThreadedOP::CONST_ADDRESS;
+        break;
+    case OPCode::TYPE_TRANS:
+        if (type == DataType::U64 && data == DataType::F64) {
+            ret.op = ThreadedOP::U64_TO_F64;
+        } else if (type == DataType::I64 && data == DataType::F64) {
+            ret.op = ThreadedOP::I64_TO_F64;
+        } else if (type == DataType::F64 && data == DataType::I64) {
+            ret.op = ThreadedOP::F64_TO_I64;
+        } else if (type == DataType::F64 && data == DataType::U64) {
+            ret.op = ThreadedOP::F64_TO_U64;
+        } else {
+            ret.op = ThreadedOP::TYPE_TRANS;
+        }
+        break;
+    case OPCode::BIN_OP:
+        ret.op = ThreadedOP::BIN_OP;
+        if (type == DataType::F64) {
+            switch (data) {
+            case BinaryOP::ADD:
+                ret.op = ThreadedOP::ADD_F64;
+                break;
+            case BinaryOP::SUB:
+                ret.op = ThreadedOP::SUB_F64;
+                break;
+            case BinaryOP::MUL:
+                ret.op = ThreadedOP::MUL_F64;
+                break;
+            case BinaryOP::DIV:
+                ret.op = ThreadedOP::DIV_F64;
+                break;
+            case BinaryOP::GE:
+                ret.op = ThreadedOP::GE_F64;
+                break;
+            case BinaryOP::GT:
+                ret.op = ThreadedOP::GT_F64;
+                break;
+            case BinaryOP::EQU:
+                ret.op = ThreadedOP::EQU_F64;
+                break;
+            case BinaryOP::NEQ:
+                ret.op = ThreadedOP::NEQ_F64;
+                break;
+            case BinaryOP::LT:
+                ret.op = ThreadedOP::LT_F64;
+                break;
+            case BinaryOP::LE:
+                ret.op = ThreadedOP::LE_F64;
+                break;
+            default:
+                break;
+            }
+        }
+        break;
+    case OPCode::UNARY_OP:
+        ret.op = ThreadedOP::UNARY_OP;
+        if (type == DataType::F64 && data == UnaryOP::NEG) {
+            ret.op = ThreadedOP::NEG_F64;
+        } else if (type == DataType::F64 && data == UnaryOP::NOT) {
+            ret.op = ThreadedOP::NOT_F64;
+        }
+        break;
+    case OPCode::SYSCALL:
+        if (data < SystemCall::__END) {
+            ret.op = ThreadedOP::SYSCALL;
+        }
+        break;
+    case OPCode::BEZ:
+        jump(type == DataType::F64 ? ThreadedOP::BEZ_F64 : ThreadedOP::BEZ);
+        break;
+    case OPCode::BNZ:
+        jump(type == DataType::F64 ? ThreadedOP::BNZ_F64 : ThreadedOP::BNZ);
+        break;
+    case OPCode::BRANCH:
+        jump(ThreadedOP::BRANCH);
+        break;
+    case OPCode::CALL:
+        ret.op = ThreadedOP::CALL;
+        break;
+    case OPCode::RET:
+        ret.op = ThreadedOP::RET;
+        break;
+    case OPCode::POP:
+        ret.op = ThreadedOP::POP;
+        break;
+    case OPCode::LOAD_GLOBAL:
+        ret.op = is64(type) ? ThreadedOP::LOAD_GLOBAL_64 : ThreadedOP::LOAD_GLOBAL;
+        break;
+    case OPCode::STORE_GLOBAL:
+        ret.op = is64(type) ? ThreadedOP::STORE_GLOBAL_64 : ThreadedOP::STORE_GLOBAL;
+        break;
+    case OPCode::CALL_NATIVE:
+        ret.op = ThreadedOP::CALL_NATIVE;
+        break;
+    default:
+        break;
+    }
+    ret.base = ret.op;
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+    ret.handler = threadedHandlers()[ret.op];
+#endif
+    return ret;
+}
+
+int ByteCodeVM::executeThreaded(ByteCodeVM* vm, size_t depth, const void* const** handlers) {
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+    // same order as ThreadedOP
+    static const void* const labels[] = {
+        &&L_TRAP,         &&L_NOP,        &&L_COPY,          &&L_PUSH,         &&L_LOAD_VAR,     &&L_LOAD_VAR_64,
+        &&L_LOAD_CONST,   &&L_LOAD_MEM,   &&L_STORE_VAR,     &&L_STORE_VAR_64, &&L_STORE_MEM,    &&L_VAR_ADDRESS,
+        &&L_CONST_ADDRESS, &&L_TYPE_TRANS, &&L_U64_TO_F64,    &&L_I64_TO_F64,   &&L_F64_TO_I64,   &&L_F64_TO_U64,
+        &&L_BIN_OP,       &&L_ADD_F64,    &&L_SUB_F64,       &&L_MUL_F64,      &&L_DIV_F64,      &&L_GE_F64,
+        &&L_GT_F64,       &&L_EQU_F64,    &&L_NEQ_F64,       &&L_LT_F64,       &&L_LE_F64,       &&L_UNARY_OP,
+        &&L_NEG_F64,      &&L_NOT_F64,    &&L_SYSCALL,       &&L_BEZ,          &&L_BNZ,          &&L_BEZ_F64,
+        &&L_BNZ_F64,      &&L_BRANCH,     &&L_CALL,          &&L_RET,          &&L_POP,          &&L_LOAD_GLOBAL,
+        &&L_LOAD_GLOBAL_64, &&L_STORE_GLOBAL, &&L_STORE_GLOBAL_64, &&L_CALL_NATIVE,
+        // superinstructions
+        &&L_LOAD_GLOBAL_64_2, &&L_LOAD_GLOBAL_64_PUSH, &&L_LOAD_VAR_64_2, &&L_LOAD_VAR_64_PUSH, &&L_POP_LOAD_GLOBAL_64,
+        &&L_GE_F64_BOOL,  &&L_GT_F64_BOOL,  &&L_EQU_F64_BOOL,  &&L_NEQ_F64_BOOL,  &&L_LT_F64_BOOL,  &&L_LE_F64_BOOL,
+        &&L_PUSH_GE_F64_BOOL, &&L_PUSH_GT_F64_BOOL, &&L_PUSH_EQU_F64_BOOL, &&L_PUSH_NEQ_F64_BOOL, &&L_PUSH_LT_F64_BOOL,
+        &&L_PUSH_LE_F64_BOOL, &&L_GE_F64_BEZ, &&L_GT_F64_BEZ, &&L_EQU_F64_BEZ, &&L_NEQ_F64_BEZ, &&L_LT_F64_BEZ,
+        &&L_LE_F64_BEZ, &&L_BOOL_BEZ_F64, &&L_BOOL_BNZ_F64, &&L_BOOL_COPY_BEZ_F64, &&L_BOOL_COPY_BNZ_F64,
+        &&L_COPY_BEZ_F64, &&L_COPY_BNZ_F64, &&L_BEZ_F64_POP, &&L_BNZ_F64_POP,
+    };
+    static_assert(std::size(labels) == ThreadedOP::__END);
+#define THREADED_TARGET(name) L_##name:
+#define THREADED_DISPATCH() goto *pc->handler
+#else
+#define THREADED_TARGET(name) case ThreadedOP::name:
+#define THREADED_DISPATCH() goto dispatch
+#endif
+
+    if (handlers) {
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+        *handlers = labels;
+#else
+        *handlers = nullptr;
+#endif
+        return 0;
+    }
+
+    auto& context = vm->context;
+    auto& err = vm->err;
+    auto& registers = vm->registerStack;
+
+    // register stack is used through sp, whose size is fixed up when leaving
+    const ThreadedCode* text = context.threadedSegment.data();
+    uint8_t* dataTable = reinterpret_cast<uint8_t*>(vm->dataSegment.data());
+    MemUnit *base, *sp, *limit;
+    auto enter = [&](size_t size) {
+        registers.resize(std::max(registers.capacity(), size + 64));
+        base = registers.data();
+        sp = base + size;
+        limit = base + registers.size();
+    };
+    auto leave = [&] { registers.resize(sp - base); };
+    auto reserve = [&](size_t n) {
+        if (static_cast<size_t>(limit - sp) < n) {
+            auto size = sp - base;
+            registers.resize(registers.size() * 2 + n);
+            base = registers.data();
+            sp = base + size;
+            limit = base + registers.size();
+        }
+    };
+    enter(registers.size());
+
+    const ThreadedCode* pc;
+    const uint8_t* constTable;
+    uint8_t* varTable;
+    size_t bottom;
+    auto loadFrame = [&] {
+        auto& frame = vm->functionStack.back();
+        constTable = reinterpret_cast<const uint8_t*>(context.linkedFunctionInfo[frame.functionID].constant.data());
+        varTable = reinterpret_cast<uint8_t*>(vm->varStack.data() + frame.varBase);
+        bottom = frame.stack_bottom;
+        pc = text + frame.ip;
+    };
+    if (vm->functionStack.size() <= depth) {
+        leave();
+        return 0;
+    }
+    loadFrame();
+
+#ifdef __BYTECODE_VM_SAFTY_CHECK__
+#define THREADED_DETECT_OVERFLOW(depth)                                                                                \
+    if (static_cast<size_t>(sp - base) - bottom < (depth)) {                                                           \
+        err = Error::STACK_OVERFLOW;                                                                                   \
+        goto error;                                                                                                    \
+    }
+#else
+#define THREADED_DETECT_OVERFLOW(depth) ((void)0);
+#endif
+#define THREADED_CHECK_ERROR()                                                                                         \
+    if (err != Error::NONE) {                                                                                          \
+        goto error;                                                                                                    \
+    }
+
+    err = Error::NONE;
+#ifdef __BYTECODE_VM_COMPUTED_GOTO__
+    THREADED_DISPATCH();
+#else
+dispatch:
+    switch (static_cast<ThreadedOP::Type>(pc->op)) {
+#endif
+    THREADED_TARGET(TRAP) {
+        err = static_cast<Error>(pc->operand);
+        goto error;
+    }
+    THREADED_TARGET(NOP) {
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(COPY) {
+        THREADED_DETECT_OVERFLOW(pc->data);
+        reserve(pc->data);
+        std::memcpy(sp, sp - pc->data, pc->data * sizeof(MemUnit));
+        sp += pc->data;
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(PUSH) {
+        reserve(1);
+        *sp++ = pc->operand;
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_VAR) {
+        reserve(1);
+        vm->load(varTable + pc->data, sp++, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_VAR_64) {
+        reserve(1);
+        std::memcpy(sp++, varTable + pc->data, sizeof(MemUnit));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_CONST) {
+        reserve(1);
+        vm->load(const_cast<uint8_t*>(constTable) + pc->data, sp++, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_MEM) {
+        THREADED_DETECT_OVERFLOW(1);
+        reserve(1);
+        auto p = std::bit_cast<uint8_t*>(static_cast<size_t>(sp[-1]));
+        vm->load(p + pc->data, sp++, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(STORE_VAR) {
+        THREADED_DETECT_OVERFLOW(1);
+        vm->store(varTable + pc->data, --sp, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(STORE_VAR_64) {
+        THREADED_DETECT_OVERFLOW(1);
+        std::memcpy(varTable + pc->data, --sp, sizeof(MemUnit));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(STORE_MEM) {
+        THREADED_DETECT_OVERFLOW(2);
+        --sp;
+        vm->store(std::bit_cast<uint8_t*>(static_cast<size_t>(sp[-1])) + pc->data, sp,
+                  static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(VAR_ADDRESS) {
+        reserve(1);
+        *sp++ = static_cast<uint64_t>(reinterpret_cast<size_t>(varTable + pc->data));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(CONST_ADDRESS) {
+        reserve(1);
+        *sp++ = static_cast<uint64_t>(reinterpret_cast<size_t>(constTable + pc->data));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(TYPE_TRANS) {
+        THREADED_DETECT_OVERFLOW(1);
+        vm->typeTrans(sp - 1, static_cast<DataType::Type>(pc->type), static_cast<DataType::Type>(pc->data));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(U64_TO_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = std::bit_cast<MemUnit>(static_cast<double_t>(sp[-1]));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(I64_TO_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = std::bit_cast<MemUnit>(static_cast<double_t>(std::bit_cast<int64_t>(sp[-1])));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(F64_TO_I64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = std::bit_cast<MemUnit>(static_cast<int64_t>(std::bit_cast<double_t>(sp[-1])));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(F64_TO_U64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = static_cast<uint64_t>(std::bit_cast<double_t>(sp[-1]));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BIN_OP) {
+        THREADED_DETECT_OVERFLOW(2);
+        --sp;
+        sp[-1] = vm->applyBinop(sp[-1], *sp, static_cast<DataType::Type>(pc->type),
+                                static_cast<BinaryOP::Type>(pc->data));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+#define THREADED_F64_BIN_OP(name, expr)                                                                                \
+    THREADED_TARGET(name) {                                                                                            \
+        THREADED_DETECT_OVERFLOW(2);                                                                                   \
+        --sp;                                                                                                          \
+        auto lhs = std::bit_cast<double_t>(sp[-1]);                                                                    \
+        auto rhs = std::bit_cast<double_t>(*sp);                                                                       \
+        sp[-1] = (expr);                                                                                               \
+        ++pc;                                                                                                          \
+        THREADED_DISPATCH();                                                                                           \
+    }
+    THREADED_F64_BIN_OP(ADD_F64, std::bit_cast<MemUnit>(lhs + rhs))
+    THREADED_F64_BIN_OP(SUB_F64, std::bit_cast<MemUnit>(lhs - rhs))
+    THREADED_F64_BIN_OP(MUL_F64, std::bit_cast<MemUnit>(lhs * rhs))
+    THREADED_F64_BIN_OP(DIV_F64, std::bit_cast<MemUnit>(lhs / rhs))
+    THREADED_F64_BIN_OP(GE_F64, static_cast<MemUnit>(lhs >= rhs))
+    THREADED_F64_BIN_OP(GT_F64, static_cast<MemUnit>(lhs > rhs))
+    THREADED_F64_BIN_OP(EQU_F64, static_cast<MemUnit>(lhs == rhs))
+    THREADED_F64_BIN_OP(NEQ_F64, static_cast<MemUnit>(lhs != rhs))
+    THREADED_F64_BIN_OP(LT_F64, static_cast<MemUnit>(lhs < rhs))
+    THREADED_F64_BIN_OP(LE_F64, static_cast<MemUnit>(lhs <= rhs))
+#undef THREADED_F64_BIN_OP
+    THREADED_TARGET(UNARY_OP) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = vm->applyUnaryop(sp[-1], static_cast<DataType::Type>(pc->type), static_cast<UnaryOP::Type>(pc->data));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(NEG_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = std::bit_cast<MemUnit>(-std::bit_cast<double_t>(sp[-1]));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(NOT_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        sp[-1] = std::bit_cast<double_t>(sp[-1]) == 0;
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(SYSCALL) {
+        THREADED_DETECT_OVERFLOW(SystemCallParamCount[pc->data]);
+        size_t ip = pc + 1 - text;
+        leave();
+        vm->systemCall(static_cast<SystemCall::Type>(pc->data), vm->functionStack.back(), ip);
+        // LINK_SYM may append to threaded segment
+        text = context.threadedSegment.data();
+        enter(registers.size());
+        pc = text + ip;
+        if (err != Error::NONE) {
+            --pc;
+            goto error;
+        }
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BEZ) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = *--sp == 0 ? text + pc->operand : pc + 1;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BNZ) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = *--sp != 0 ? text + pc->operand : pc + 1;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BEZ_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = std::bit_cast<double_t>(*--sp) == 0 ? text + pc->operand : pc + 1;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BNZ_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = std::bit_cast<double_t>(*--sp) != 0 ? text + pc->operand : pc + 1;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BRANCH) {
+        pc = text + pc->operand;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(CALL) {
+        THREADED_DETECT_OVERFLOW(pc->data + 1);
+        uint64_t id = *--sp;
+        if (id >= context.linkedFunctionInfo.size()) {
+            ++sp;
+            err = Error::TABLE_OVERFLOW;
+            goto error;
+        }
+        vm->functionStack.back().ip = pc + 1 - text;
+        // frame of caller is invalidated since here
+        vm->pushFrame(id, (sp - base) - pc->data);
+        loadFrame();
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(RET) {
+        THREADED_DETECT_OVERFLOW(pc->data);
+        auto count = pc->data;
+        std::memmove(base + bottom, sp - count, count * sizeof(MemUnit));
+        sp = base + bottom + count;
+        vm->varStack.resize(vm->functionStack.back().varBase);
+        vm->functionStack.pop_back();
+        if (vm->functionStack.size() <= depth) {
+            leave();
+            return 0;
+        }
+        loadFrame();
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(POP) {
+        THREADED_DETECT_OVERFLOW(1);
+        --sp;
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_GLOBAL) {
+        reserve(1);
+        vm->load(dataTable + pc->data, sp++, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_GLOBAL_64) {
+        reserve(1);
+        std::memcpy(sp++, dataTable + pc->data, sizeof(MemUnit));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(STORE_GLOBAL) {
+        THREADED_DETECT_OVERFLOW(1);
+        vm->store(dataTable + pc->data, --sp, static_cast<DataType::Type>(pc->type));
+        THREADED_CHECK_ERROR();
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(STORE_GLOBAL_64) {
+        THREADED_DETECT_OVERFLOW(1);
+        std::memcpy(dataTable + pc->data, --sp, sizeof(MemUnit));
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(CALL_NATIVE) {
+        if (pc->data >= context.nativeFunctions.size()) {
+            err = Error::TABLE_OVERFLOW;
+            goto error;
+        }
+        auto& native = context.nativeFunctions[pc->data];
+        THREADED_DETECT_OVERFLOW(native.paramCount);
+        reserve(1);
+        sp -= native.paramCount;
+        *sp = native.function(sp);
+        ++sp;
+        ++pc;
+        THREADED_DISPATCH();
+    }
+    // superinstructions, operands of the n-th instruction fused are in pc[n]
+    THREADED_TARGET(LOAD_GLOBAL_64_2) {
+        reserve(2);
+        std::memcpy(sp, dataTable + pc->data, sizeof(MemUnit));
+        std::memcpy(sp + 1, dataTable + pc[1].data, sizeof(MemUnit));
+        sp += 2;
+        pc += 2;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_GLOBAL_64_PUSH) {
+        reserve(2);
+        std::memcpy(sp, dataTable + pc->data, sizeof(MemUnit));
+        sp[1] = pc[1].operand;
+        sp += 2;
+        pc += 2;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_VAR_64_2) {
+        reserve(2);
+        std::memcpy(sp, varTable + pc->data, sizeof(MemUnit));
+        std::memcpy(sp + 1, varTable + pc[1].data, sizeof(MemUnit));
+        sp += 2;
+        pc += 2;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(LOAD_VAR_64_PUSH) {
+        reserve(2);
+        std::memcpy(sp, varTable + pc->data, sizeof(MemUnit));
+        sp[1] = pc[1].operand;
+        sp += 2;
+        pc += 2;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(POP_LOAD_GLOBAL_64) {
+        THREADED_DETECT_OVERFLOW(1);
+        std::memcpy(sp - 1, dataTable + pc[1].data, sizeof(MemUnit));
+        pc += 2;
+        THREADED_DISPATCH();
+    }
+#define THREADED_F64_COMPARE(name, op)                                                                                 \
+    THREADED_TARGET(name##_F64_BOOL) {                                                                                 \
+        THREADED_DETECT_OVERFLOW(2);                                                                                   \
+        --sp;                                                                                                          \
+        sp[-1] = std::bit_cast<MemUnit>(                                                                               \
+            static_cast<double_t>(std::bit_cast<double_t>(sp[-1]) op std::bit_cast<double_t>(*sp)));                  \
+        pc += 2;                                                                                                       \
+        THREADED_DISPATCH();                                                                                           \
+    }                                                                                                                  \
+    THREADED_TARGET(PUSH_##name##_F64_BOOL) {                                                                          \
+        THREADED_DETECT_OVERFLOW(1);                                                                                   \
+        sp[-1] = std::bit_cast<MemUnit>(                                                                               \
+            static_cast<double_t>(std::bit_cast<double_t>(sp[-1]) op std::bit_cast<double_t>(pc->operand)));          \
+        pc += 3;                                                                                                       \
+        THREADED_DISPATCH();                                                                                           \
+    }                                                                                                                  \
+    THREADED_TARGET(name##_F64_BEZ) {                                                                                  \
+        THREADED_DETECT_OVERFLOW(2);                                                                                   \
+        sp -= 2;                                                                                                       \
+        pc = !(std::bit_cast<double_t>(sp[0]) op std::bit_cast<double_t>(sp[1])) ? text + pc[1].operand : pc + 2;      \
+        THREADED_DISPATCH();                                                                                           \
+    }
+    THREADED_F64_COMPARE(GE, >=)
+    THREADED_F64_COMPARE(GT, >)
+    THREADED_F64_COMPARE(EQU, ==)
+    THREADED_F64_COMPARE(NEQ, !=)
+    THREADED_F64_COMPARE(LT, <)
+    THREADED_F64_COMPARE(LE, <=)
+#undef THREADED_F64_COMPARE
+    // U64_TO_F64 of bool is zero iff bool is zero
+    THREADED_TARGET(BOOL_BEZ_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = *--sp == 0 ? text + pc[1].operand : pc + 2;
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BOOL_BNZ_F64) {
+        THREADED_DETECT_OVERFLOW(1);
+        pc = *--sp != 0 ? text + pc[1].operand : pc + 2;
+        THREADED_DISPATCH();
+    }
+#define THREADED_COPY_BRANCH(name, convert, condition)                                                                 \
+    THREADED_TARGET(name) {                                                                                            \
+        auto& copy = pc[convert ? 1 : 0];                                                                              \
+        THREADED_DETECT_OVERFLOW(std::max<size_t>(copy.data, 1));                                                      \
+        if (convert) {                                                                                                 \
+            sp[-1] = std::bit_cast<MemUnit>(static_cast<double_t>(sp[-1]));                                            \
+        }                                                                                                              \
+        reserve(copy.data);                                                                                            \
+        std::memcpy(sp, sp - copy.data, copy.data * sizeof(MemUnit));                                                  \
+        sp += copy.data;                                                                                               \
+        pc = std::bit_cast<double_t>(*--sp) condition 0 ? text + (&copy)[1].operand : &copy + 2;                       \
+        THREADED_DISPATCH();                                                                                           \
+    }
+    THREADED_COPY_BRANCH(BOOL_COPY_BEZ_F64, true, ==)
+    THREADED_COPY_BRANCH(BOOL_COPY_BNZ_F64, true, !=)
+    THREADED_COPY_BRANCH(COPY_BEZ_F64, false, ==)
+    THREADED_COPY_BRANCH(COPY_BNZ_F64, false, !=)
+#undef THREADED_COPY_BRANCH
+    THREADED_TARGET(BEZ_F64_POP) {
+        THREADED_DETECT_OVERFLOW(1);
+        if (std::bit_cast<double_t>(*--sp) == 0) {
+            pc = text + pc->operand;
+        } else {
+            THREADED_DETECT_OVERFLOW(1);
+            --sp;
+            pc += 2;
+        }
+        THREADED_DISPATCH();
+    }
+    THREADED_TARGET(BNZ_F64_POP) {
+        THREADED_DETECT_OVERFLOW(1);
+        if (std::bit_cast<double_t>(*--sp) != 0) {
+            pc = text + pc->operand;
+        } else {
+            THREADED_DETECT_OVERFLOW(1);
+            --sp;
+            pc += 2;
+        }
+        THREADED_DISPATCH();
+    }
+#ifndef __BYTECODE_VM_COMPUTED_GOTO__
+    }
+#endif
+
+error:
+    // same as switch dispatch, ip of frame is after the failed instruction
+    vm->functionStack.back().ip = pc + 1 - text;
+    leave();
+    return -1;
+
+#undef THREADED_CHECK_ERROR
+#undef THREADED_DETECT_OVERFLOW
+#undef THREADED_DISPATCH
+#undef THREADED_TARGET
+}
+
+} // namespace bytecode
@@ -11,6 +11,7 @@
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-28</td><td>Initial version.</td></tr>
  * <tr><td>djw</td><td>2023-09-20</td><td>reuse in bytecode VM.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Allow struct as member of struct, keep member order of same alignment.</td></tr>
  * </table>
  */
 #pragma once
@@ -111,9 +112,9 @@ struct StructLayoutManager {
             {"i64", [](uint8_t* p) { return std::to_string(*reinterpret_cast<i64*>(p)); }},
             {"f32", [](uint8_t* p) { return std::to_string(*reinterpret_cast<f32*>(p)); }},
             {"f64", [](uint8_t* p) { return std::to_string(*reinterpret_cast<f64*>(p)); }},
-            {"ptr", [](uint8_t* p) { return std::format("{#08x}", *reinterpret_cast<uint64_t*>(p)); }},
+            {"ptr", [](uint8_t* p) { return std::format("{:#08x}", *reinterpret_cast<uint64_t*>(p)); }},
             {"func", [](uint8_t* p) {
-                 return std::format("{#08x}({#08x})", reinterpret_cast<uint64_t*>(p)[1],
+                 return std::format("{:#08x}({:#08x})", reinterpret_cast<uint64_t*>(p)[1],
                                     reinterpret_cast<uint64_t*>(p)[0]);
              }}};
         if (auto it = table.find(type); it != table.end()) {
@@ -128,6 +129,7 @@ struct StructLayoutManager {
             return "[unknown]";
         }
     }
+    bool hasType(const std::string& s) const { return typeLayout.contains(s); }
     TypeLayoutInfo getTypeLayoutInfo(const std::string& s) const {
         auto it = typeLayout.find(s);
         assert(it != typeLayout.end());
@@ -136,8 +138,10 @@ struct StructLayoutManager {
     ComplexType* addDefinition(const std::string& name, const StructInfo& defines) {
         if (complexType.find(name) != complexType.end())
             return nullptr; // TODO: check if is same definition
-        complexType.emplace(name, ComplexType{defines, *this});
-        return &complexType.find(name)->second;
+        auto it = complexType.emplace(name, ComplexType{defines, *this}).first;
+        // so it can be used as member of following definitions
+        typeLayout.emplace(name, it->second.getLayout());
+        return &it->second;
     }
     const ComplexType& getInfo(const std::string& name) const {
         auto it = complexType.find(name);
@@ -157,7 +161,8 @@ struct StructLayoutManager {
 inline void ComplexType::optimize(StructInfo& info, const StructLayoutManager& structManager) {
     // if (info.size() <= 1)
     //     return;
-    std::sort(info.begin(), info.end(), [&](auto& a, auto& b) {
+    // stable, so members with same alignment keep their defined order
+    std::stable_sort(info.begin(), info.end(), [&](auto& a, auto& b) {
         auto align_a = structManager.getTypeLayoutInfo(std::get<1>(a)).align;
         auto align_b = structManager.getTypeLayoutInfo(std::get<1>(b)).align;
         return align_a < align_b;
@@ -166,7 +171,8 @@ inline void ComplexType::optimize(StructInfo& info, const StructLayoutManager& s
 
 inline ComplexType::ComplexType(const StructInfo& defines, const StructLayoutManager& structManager)
     : defines(defines), layoutInfo(), memberOffset() {
-    size_t align = 0, offset = 0;
+    // empty struct is aligned to 1
+    size_t align = 1, offset = 0;
     optimize(this->defines, structManager);
     auto alignOffset = [](size_t align, size_t& offset) {
         if (offset % align != 0) {
@@ -10,6 +10,15 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-28</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_CLOSURE_ENGINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_BYTECODE_ENGINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_JIT_ENGINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_TIERED_ENGINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_DISABLE_INLINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_DISABLE_CSE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_DECISION_TREE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_INCREMENTAL_ENGINE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add __RULEJIT_CQ_TYPED_STORAGE.</td></tr>
  * </table>
  */
 #pragma once
@@ -24,6 +33,17 @@
 
 // #define __RULEJIT_SOA_VIRTUAL
 // #define __RULEJIT_PARALLEL_ENGINE
+// #define __RULEJIT_CQ_CLOSURE_ENGINE
+// #define __RULEJIT_CQ_BYTECODE_ENGINE
+// defined by CMake option RULEJIT_CQ_JIT, which links LLVM into cq targets
+// #define __RULEJIT_CQ_JIT
+// #define __RULEJIT_CQ_JIT_ENGINE
+// #define __RULEJIT_CQ_TIERED_ENGINE
+// #define __RULEJIT_DISABLE_INLINE
+// #define __RULEJIT_DISABLE_CSE
+// #define __RULEJIT_DECISION_TREE
+// #define __RULEJIT_CQ_INCREMENTAL_ENGINE
+// #define __RULEJIT_CQ_TYPED_STORAGE
 
 // #define __DISABLE_ASSERT
 
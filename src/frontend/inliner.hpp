@@ -0,0 +1,528 @@
+/**
+ * @file inliner.hpp
+ * @author djw
+ * @brief FrontEnd/Inliner
+ * @date 2026-10-17
+ *
+ * @details Includes FunctionInliner, an optimization pass run after ExpressionSemantic and before any backend, which
+ * replaces calls to small non-recursive functions in ContextGlobal::realFuncDefinition by a copy of their body.
+ *
+ * A call "f(x, a + b)" of "func f(p f64, q f64)->f64 {...}" becomes "{var _inline0_q f64 = a + b; ...}", where
+ * literal and identifier args are substituted into the body directly when it is safe, and every variable of the
+ * copied body is renamed, so names of the caller are never captured. Only functions whose body reads nothing but
+ * its params and locals, has no control flow and takes numerical or string params are inlined.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add report of inlined calls.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <format>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "defines/typedef.hpp"
+
+namespace rulejit {
+
+/**
+ * @brief inline calls to small non-recursive user functions, callees are inlined into first
+ *
+ */
+struct FunctionInliner : public ASTVisitor {
+    /// @brief default max count of ast nodes in body of inlined function
+    inline static constexpr size_t defaultBudget = 64;
+
+    /**
+     * @brief Constructor
+     *
+     * @param global context with checked function defines
+     * @param budget max count of ast nodes in body of inlined function
+     */
+    FunctionInliner(ContextGlobal &global, size_t budget = defaultBudget)
+        : global(global), budget(budget), candidates(), visiting(), counter(0), needChange(), report() {}
+    virtual ~FunctionInliner() = default;
+
+    /**
+     * @brief inline calls in all real functions, including the ones represent subrulesets
+     *
+     */
+    void inlineAll() {
+        std::vector<std::string> names;
+        for (auto &[name, _] : global.realFuncDefinition) {
+            names.push_back(name);
+        }
+        for (auto &name : names) {
+            inlineInto(name);
+        }
+    }
+
+    /**
+     * @brief get calls inlined so far, one line per call, like "_inline0 <= f (1 of 2 args substituted)"
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReport() const { return report; }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {}
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        callAccept(v.baseVar);
+        callAccept(v.memberToken);
+    }
+    VISIT_FUNCTION(LiteralExprAST) {}
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        callAccept(v.functionIdent);
+        for (auto &arg : v.params) {
+            callAccept(arg);
+        }
+        auto p = dynamic_cast<LiteralExprAST *>(v.functionIdent.get());
+        if (!p) {
+            return;
+        }
+        auto it = global.realFuncDefinition.find(p->value);
+        if (it == global.realFuncDefinition.end()) {
+            return;
+        }
+        inlineInto(p->value);
+        if (auto candidate = candidates.find(p->value); candidate != candidates.end() && candidate->second) {
+            needChange = expand(v, *(it->second), *(candidate->second));
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        callAccept(v.lhs);
+        callAccept(v.rhs);
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) { callAccept(v.rhs); }
+    VISIT_FUNCTION(BranchExprAST) {
+        callAccept(v.condition);
+        callAccept(v.trueExpr);
+        callAccept(v.falseExpr);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        for (auto &[index, value] : v.members) {
+            if (index) {
+                callAccept(index);
+            }
+            callAccept(value);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        callAccept(v.init);
+        callAccept(v.condition);
+        callAccept(v.body);
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        for (auto &stmt : v.exprs) {
+            callAccept(stmt);
+        }
+    }
+    VISIT_FUNCTION(ControlFlowAST) { callAccept(v.value); }
+    VISIT_FUNCTION(TypeDefAST) {}
+    VISIT_FUNCTION(VarDefAST) { callAccept(v.definedValue); }
+    VISIT_FUNCTION(FunctionDefAST) {}
+    VISIT_FUNCTION(SymbolDefAST) {}
+
+  private:
+    /**
+     * @brief what FunctionInliner needs to know about body of an inlinable function
+     *
+     */
+    struct Candidate {
+        /// @brief body calls functions which may write variables, see BodyAnalyzer::calls
+        bool calls;
+        /// @brief param name -> times it is read
+        std::map<std::string, size_t> uses;
+        /// @brief params assigned in body
+        std::set<std::string> assigned;
+    };
+
+    /**
+     * @brief collect size, free variables and side effects of function body or args
+     *
+     */
+    struct BodyAnalyzer : public ASTVisitor {
+        BodyAnalyzer(const ContextGlobal &global, std::set<std::string> params)
+            : global(global), scopes{std::move(params)} {}
+
+        /// @brief count of ast nodes
+        size_t size = 0;
+        /// @brief reads variables other than params and locals
+        bool free = false;
+        /// @brief contains nodes can not be inlined, like control flow and defines other than var
+        bool unsupported = false;
+        /// @brief calls user defined functions, function values or build-in functions modifying array
+        bool calls = false;
+        /// @brief contains assignment
+        bool assigns = false;
+        std::map<std::string, size_t> uses;
+        std::set<std::string> assigned;
+
+      protected:
+        VISIT_FUNCTION(IdentifierExprAST) {
+            size++;
+            for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+                if (it->contains(v.name)) {
+                    if (it == std::prev(scopes.rend())) {
+                        uses[v.name]++;
+                    }
+                    return;
+                }
+            }
+            free = true;
+        }
+        VISIT_FUNCTION(MemberAccessExprAST) {
+            size++;
+            v.baseVar->accept(this);
+            v.memberToken->accept(this);
+        }
+        VISIT_FUNCTION(LiteralExprAST) { size++; }
+        VISIT_FUNCTION(FunctionCallExprAST) {
+            size++;
+            if (auto p = dynamic_cast<LiteralExprAST *>(v.functionIdent.get()); p) {
+                if (global.realFuncDefinition.contains(p->value) || p->value == "push" || p->value == "resize") {
+                    calls = true;
+                }
+            } else {
+                calls = true;
+            }
+            v.functionIdent->accept(this);
+            for (auto &arg : v.params) {
+                arg->accept(this);
+            }
+        }
+        VISIT_FUNCTION(BinOpExprAST) {
+            size++;
+            if (v.op == "=") {
+                assigns = true;
+                if (auto p = dynamic_cast<IdentifierExprAST *>(v.lhs.get()); p && isParam(p->name)) {
+                    assigned.insert(p->name);
+                }
+            }
+            v.lhs->accept(this);
+            v.rhs->accept(this);
+        }
+        VISIT_FUNCTION(UnaryOpExprAST) {
+            size++;
+            v.rhs->accept(this);
+        }
+        VISIT_FUNCTION(BranchExprAST) {
+            size++;
+            v.condition->accept(this);
+            v.trueExpr->accept(this);
+            v.falseExpr->accept(this);
+        }
+        VISIT_FUNCTION(ComplexLiteralExprAST) {
+            size++;
+            for (auto &[index, value] : v.members) {
+                if (index) {
+                    index->accept(this);
+                }
+                value->accept(this);
+            }
+        }
+        VISIT_FUNCTION(LoopAST) {
+            size++;
+            scopes.emplace_back();
+            v.init->accept(this);
+            v.condition->accept(this);
+            v.body->accept(this);
+            scopes.pop_back();
+        }
+        VISIT_FUNCTION(BlockExprAST) {
+            size++;
+            scopes.emplace_back();
+            for (auto &stmt : v.exprs) {
+                stmt->accept(this);
+            }
+            scopes.pop_back();
+        }
+        VISIT_FUNCTION(ControlFlowAST) { unsupported = true; }
+        VISIT_FUNCTION(TypeDefAST) { unsupported = true; }
+        VISIT_FUNCTION(VarDefAST) {
+            size++;
+            // defined value can not see the variable itself
+            v.definedValue->accept(this);
+            scopes.back().insert(v.name);
+        }
+        VISIT_FUNCTION(FunctionDefAST) { unsupported = true; }
+        VISIT_FUNCTION(SymbolDefAST) { unsupported = true; }
+        VISIT_FUNCTION(TemplateDefAST) { unsupported = true; }
+        VISIT_FUNCTION(ClosureExprAST) { unsupported = true; }
+
+      private:
+        bool isParam(const std::string &name) {
+            for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+                if (it->contains(name)) {
+                    return it == std::prev(scopes.rend());
+                }
+            }
+            return false;
+        }
+
+        const ContextGlobal &global;
+        /// @brief first scope holds params
+        std::vector<std::set<std::string>> scopes;
+    };
+
+    /**
+     * @brief rewrite copied function body, rename variables and substitute params
+     *
+     */
+    struct BodyRewriter : public ASTVisitor {
+        BodyRewriter(std::string prefix) : prefix(std::move(prefix)), scopes{{}}, substitutes(), needChange() {}
+
+        /// @brief param is defined as a variable of new name
+        void rename(const std::string &param, std::string name) { scopes.front().emplace(param, std::move(name)); }
+        /// @brief param is replaced by copy of arg
+        void substitute(const std::string &param, ExprAST *arg) { substitutes.emplace(param, arg); }
+
+        void friend operator|(std::unique_ptr<ExprAST> &ast, BodyRewriter &rewriter) { rewriter.callAccept(ast); }
+
+      protected:
+        VISIT_FUNCTION(IdentifierExprAST) {
+            for (auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+                if (auto name = it->find(v.name); name != it->end()) {
+                    v.name = name->second;
+                    return;
+                }
+            }
+            if (auto arg = substitutes.find(v.name); arg != substitutes.end()) {
+                needChange = arg->second->copy();
+            }
+        }
+        VISIT_FUNCTION(MemberAccessExprAST) {
+            callAccept(v.baseVar);
+            callAccept(v.memberToken);
+        }
+        VISIT_FUNCTION(LiteralExprAST) {}
+        VISIT_FUNCTION(FunctionCallExprAST) {
+            callAccept(v.functionIdent);
+            for (auto &arg : v.params) {
+                callAccept(arg);
+            }
+        }
+        VISIT_FUNCTION(BinOpExprAST) {
+            callAccept(v.lhs);
+            callAccept(v.rhs);
+        }
+        VISIT_FUNCTION(UnaryOpExprAST) { callAccept(v.rhs); }
+        VISIT_FUNCTION(BranchExprAST) {
+            callAccept(v.condition);
+            callAccept(v.trueExpr);
+            callAccept(v.falseExpr);
+        }
+        VISIT_FUNCTION(ComplexLiteralExprAST) {
+            for (auto &[index, value] : v.members) {
+                if (index) {
+                    callAccept(index);
+                }
+                callAccept(value);
+            }
+        }
+        VISIT_FUNCTION(LoopAST) {
+            scopes.emplace_back();
+            callAccept(v.init);
+            callAccept(v.condition);
+            callAccept(v.body);
+            scopes.pop_back();
+        }
+        VISIT_FUNCTION(BlockExprAST) {
+            scopes.emplace_back();
+            for (auto &stmt : v.exprs) {
+                callAccept(stmt);
+            }
+            scopes.pop_back();
+        }
+        VISIT_FUNCTION(ControlFlowAST) {}
+        VISIT_FUNCTION(TypeDefAST) {}
+        VISIT_FUNCTION(VarDefAST) {
+            callAccept(v.definedValue);
+            auto name = prefix + v.name;
+            scopes.back()[v.name] = name;
+            v.name = std::move(name);
+        }
+        VISIT_FUNCTION(FunctionDefAST) {}
+        VISIT_FUNCTION(SymbolDefAST) {}
+
+      private:
+        void callAccept(std::unique_ptr<ExprAST> &tar) {
+            tar->accept(this);
+            if (needChange) {
+                tar = std::move(needChange);
+            }
+        }
+
+        /// @brief prefix of renamed variables, unique for each inlined call
+        std::string prefix;
+        /// @brief variable name -> new name, first scope holds params
+        std::vector<std::map<std::string, std::string>> scopes;
+        std::map<std::string, ExprAST *> substitutes;
+        std::unique_ptr<ExprAST> needChange;
+    };
+
+    static bool isNumericalType(const TypeInfo &type) { return type == RealType || type == IntType; }
+
+    void callAccept(std::unique_ptr<ExprAST> &tar) {
+        tar->accept(this);
+        if (needChange) {
+            tar = std::move(needChange);
+        }
+    }
+
+    /**
+     * @brief inline calls in body of real function, then check if the function itself can be inlined
+     *
+     * @param name real function name
+     */
+    void inlineInto(const std::string &name) {
+        if (candidates.contains(name) || visiting.contains(name)) {
+            return;
+        }
+        auto it = global.realFuncDefinition.find(name);
+        if (it == global.realFuncDefinition.end()) {
+            return;
+        }
+        visiting.insert(name);
+        callAccept(it->second->returnValue);
+        visiting.erase(name);
+        candidates.emplace(name, analyze(name, *(it->second)));
+    }
+
+    /**
+     * @brief check if real function can be inlined
+     *
+     * @param name real function name
+     * @param func function define, with calls in body already inlined
+     * @return std::optional<Candidate> nullopt if can not be inlined
+     */
+    std::optional<Candidate> analyze(const std::string &name, FunctionDefAST &func) {
+        if (isRecursive(name)) {
+            return std::nullopt;
+        }
+        std::set<std::string> params;
+        for (auto &param : func.params) {
+            if (!isNumericalType(*(param->type)) && *(param->type) != StringType) {
+                return std::nullopt;
+            }
+            params.insert(param->name);
+        }
+        BodyAnalyzer analyzer(global, std::move(params));
+        func.returnValue->accept(&analyzer);
+        if (analyzer.free || analyzer.unsupported || analyzer.size > budget) {
+            return std::nullopt;
+        }
+        return Candidate{analyzer.calls, std::move(analyzer.uses), std::move(analyzer.assigned)};
+    }
+
+    /**
+     * @brief check if real function depends on itself through ContextGlobal::funcDependency
+     *
+     * @param name real function name
+     * @return bool
+     */
+    bool isRecursive(const std::string &name) {
+        std::set<std::string> visited;
+        std::vector<std::string> open{name};
+        while (!open.empty()) {
+            auto cur = std::move(open.back());
+            open.pop_back();
+            auto it = global.funcDependency.find(cur);
+            if (it == global.funcDependency.end()) {
+                continue;
+            }
+            for (auto &dep : it->second) {
+                if (dep == name) {
+                    return true;
+                }
+                if (visited.insert(dep).second) {
+                    open.push_back(dep);
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief build inlined body of call
+     *
+     * @param v function call, args are moved into result
+     * @param callee called function
+     * @param candidate information of called function
+     * @return std::unique_ptr<ExprAST> nullptr if this call can not be inlined
+     */
+    std::unique_ptr<ExprAST> expand(FunctionCallExprAST &v, FunctionDefAST &callee, const Candidate &candidate) {
+        // identifier read in body instead of before other args is only safe when nothing may write it in between
+        bool writes = candidate.calls;
+        for (auto &arg : v.params) {
+            BodyAnalyzer analyzer(global, {});
+            arg->accept(&analyzer);
+            writes = writes || analyzer.calls || analyzer.assigns;
+        }
+        std::vector<bool> substituted;
+        for (size_t i = 0; i < v.params.size(); i++) {
+            auto &param = *(callee.params[i]);
+            auto &arg = v.params[i];
+            auto uses = candidate.uses.find(param.name);
+            bool numerical = isNumericalType(*(param.type));
+            bool identifier = isType<IdentifierExprAST>(arg) && !writes &&
+                              (!numerical || uses == candidate.uses.end() || uses->second <= 1);
+            substituted.push_back(!candidate.assigned.contains(param.name) &&
+                                  (isType<LiteralExprAST>(arg) || identifier));
+            if (!numerical && !substituted.back()) {
+                // string args are passed by reference, which var define can not do
+                return nullptr;
+            }
+        }
+        auto id = "_inline" + std::to_string(counter++);
+        auto prefix = id + "_";
+        report.push_back(std::format("{} <= {} ({} of {} args substituted)", id, callee.name,
+                                     std::ranges::count(substituted, true), substituted.size()));
+        BodyRewriter rewriter(prefix);
+        std::vector<std::unique_ptr<ExprAST>> exprs;
+        for (size_t i = 0; i < v.params.size(); i++) {
+            auto &param = *(callee.params[i]);
+            if (substituted[i]) {
+                rewriter.substitute(param.name, v.params[i].get());
+                continue;
+            }
+            auto name = prefix + param.name;
+            rewriter.rename(param.name, name);
+            exprs.push_back(
+                std::make_unique<VarDefAST>(name, std::make_unique<TypeInfo>(*(param.type)), std::move(v.params[i])));
+        }
+        auto body = callee.returnValue->copy();
+        body | rewriter;
+        if (exprs.empty()) {
+            return body;
+        }
+        exprs.push_back(std::move(body));
+        return std::make_unique<BlockExprAST>(std::make_unique<TypeInfo>(*(v.type)), std::move(exprs));
+    }
+
+    ContextGlobal &global;
+    size_t budget;
+    /// @brief real function name -> information if it can be inlined, only for functions already processed
+    std::unordered_map<std::string, std::optional<Candidate>> candidates;
+    /// @brief real functions being processed, calls to them are never inlined
+    std::set<std::string> visiting;
+    /// @brief count of inlined calls, used to generate unique variable names
+    size_t counter;
+    std::unique_ptr<ExprAST> needChange;
+    /// @brief inlined calls
+    std::vector<std::string> report;
+};
+
+} // namespace rulejit
@@ -0,0 +1,114 @@
+/**
+ * @file astpasses.hpp
+ * @author djw
+ * @brief FrontEnd/Ruleset/AST Passes
+ * @date 2026-10-17
+ *
+ * @details Includes runAstPasses, the optimization pipeline run by every backend over checked subrulesets before
+ * they are lowered, so all backends see the same ast and name subrulesets the same way in selectivity profiles.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>State order of decision tree and CSE.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Report inlined calls.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "ast/constantfolder.hpp"
+#include "ast/context.hpp"
+#include "defines/marco.hpp"
+#include "frontend/inliner.hpp"
+#include "frontend/ruleset/conditioncse.hpp"
+#include "frontend/ruleset/decisiontree.hpp"
+#include "frontend/ruleset/selectivity.hpp"
+
+namespace rulejit::ruleset {
+
+/// @brief reports of runAstPasses, one line per change
+struct AstPassReports {
+    /// @brief expressions folded by ConstantFolder
+    std::vector<std::string> folding;
+    /// @brief subexpressions shared by ConditionCSE
+    std::vector<std::string> sharing;
+    /// @brief calls inlined by FunctionInliner
+    std::vector<std::string> inlining;
+    /// @brief chains of "&&"/"||" reordered by ShortCutReorderer
+    std::vector<std::string> reordering;
+};
+
+/**
+ * @brief name of a pre-process subruleset, used as key of SelectivityProfile and symbol of compiled code
+ *
+ * @param index index in pre-process subrulesets
+ * @return std::string
+ */
+inline std::string preProcessName(size_t index) { return "preprocess@" + std::to_string(index); }
+
+/**
+ * @brief name of a subruleset, used as key of SelectivityProfile and symbol of compiled code
+ *
+ * @param index index in subrulesets
+ * @return std::string
+ */
+inline std::string subRuleSetName(size_t index) { return "subruleset@" + std::to_string(index); }
+
+/**
+ * @brief run optimization passes over checked function defines, in place
+ * @attention call after RuleSetParser::readSource and before subrulesets are moved out of global
+ *
+ * @param global context with checked function defines
+ * @param preProcess real function names of pre-process subrulesets
+ * @param subRuleSets real function names of subrulesets
+ * @param profile selectivity profile to reorder "&&"/"||" by, if any
+ * @param[out] reports reports of passes run
+ */
+inline void runAstPasses(ContextGlobal &global, const std::vector<std::string> &preProcess,
+                         const std::vector<std::string> &subRuleSets, const std::optional<SelectivityProfile> &profile,
+                         AstPassReports &reports) {
+#ifdef __RULEJIT_DECISION_TREE
+    // before CSE, which then shares within each first-match chain of the tree, like residual conditions of a leaf,
+    // instead of the whole subruleset; subexpressions of keys are evaluated once per tick by the tree itself
+    DecisionTreeBuilder tree(global);
+    for (auto &&name : subRuleSets) {
+        tree.build(global.realFuncDefinition[name]->returnValue);
+    }
+#endif
+#ifndef __RULEJIT_DISABLE_CSE
+    // before inlining, so calls like "abs(x)" can be shared as a whole
+    ConditionCSE cse(global);
+    for (auto &&name : subRuleSets) {
+        cse.eliminate(global.realFuncDefinition[name]->returnValue);
+    }
+    reports.sharing = cse.getReport();
+#endif
+#ifndef __RULEJIT_DISABLE_INLINE
+    FunctionInliner inliner(global);
+    inliner.inlineAll();
+    reports.inlining = inliner.getReport();
+#endif
+    ConstantFolder folder;
+    for (auto &[name, func] : global.realFuncDefinition) {
+        func->returnValue | folder;
+    }
+    reports.folding = folder.getReport();
+    // after all other passes, so chains are numbered as in the ast a profile is recorded on
+    if (profile) {
+        ShortCutReorderer reorderer(global, *profile);
+        for (size_t i = 0; i < preProcess.size(); i++) {
+            reorderer.reorder(preProcessName(i), global.realFuncDefinition[preProcess[i]]->returnValue);
+        }
+        for (size_t i = 0; i < subRuleSets.size(); i++) {
+            reorderer.reorder(subRuleSetName(i), global.realFuncDefinition[subRuleSets[i]]->returnValue);
+        }
+        reports.reordering = reorderer.getReport();
+    }
+}
+
+} // namespace rulejit::ruleset
@@ -0,0 +1,446 @@
+/**
+ * @file conditioncse.hpp
+ * @author djw
+ * @brief FrontEnd/Ruleset/Condition CSE
+ * @date 2026-10-17
+ *
+ * @details Includes ConditionCSE, an optimization pass over checked subrulesets which shares pure subexpressions
+ * repeated in conditions of atom rules.
+ *
+ * RuleSetParser::readSource turns a subruleset into "{if({c0}){...0}else if({c1}){...1}else ... {-1}}", so c1 is
+ * only evaluated after c0 is evaluated and false. A numerical subexpression, built by variables, literals, member
+ * access, operators and calls to pure functions, which appears more than once in c0, c1, ... is stored in a per-tick
+ * temporary "_cseN" defined at the start of the subruleset:
+ *
+ * - if its first appearance is in a condition before all others, and is evaluated whenever that condition is,
+ *   the first appearance becomes "{_cseN = expr; _cseN}" and others read "_cseN";
+ *
+ * - otherwise every appearance becomes "if(_cseN_ready) _cseN else {_cseN = expr; _cseN_ready = 1; _cseN}".
+ *
+ * So expressions are still evaluated lazily, only where they were evaluated before, and at most once per tick.
+ * Subexpressions reading variables written in conditions are never shared, and subrulesets whose conditions call
+ * functions with side effects are left unchanged.
+ *
+ * A subruleset rebuilt by DecisionTreeBuilder has no such chain at top, so every first-match chain in its tree, like
+ * the residual conditions in a leaf, is shared in on its own, with its own temporaries.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Move EffectAnalyzer to effectanalyzer.hpp.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Share in chains of decision trees.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <format>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "ast/decompiler.hpp"
+#include "defines/typedef.hpp"
+#include "frontend/ruleset/decisiontree.hpp"
+#include "frontend/ruleset/effectanalyzer.hpp"
+
+namespace rulejit::ruleset {
+
+/**
+ * @brief share pure subexpressions repeated in atom rule conditions of a subruleset
+ *
+ */
+struct ConditionCSE {
+    /// @brief default min cost of shared subexpression, operators and member access cost 1, calls cost 2
+    inline static constexpr size_t defaultMinCost = 2;
+
+    /**
+     * @brief Constructor
+     *
+     * @param global context with checked function defines
+     * @param minCost min cost of shared subexpression
+     */
+    ConditionCSE(const ContextGlobal &global, size_t minCost = defaultMinCost)
+        : functions(global), minCost(minCost), counter(0), report() {}
+
+    /**
+     * @brief share subexpressions in conditions of one subruleset
+     *
+     * @param subruleset checked body of subruleset, temporaries are defined at its start
+     */
+    void eliminate(std::unique_ptr<ExprAST> &subruleset) {
+        std::vector<std::vector<std::unique_ptr<ExprAST> *>> chains;
+        auto block = dynamic_cast<BlockExprAST *>(subruleset.get());
+        ExprAST *cur = block && !block->exprs.empty() ? block->exprs.back().get() : subruleset.get();
+        EffectAnalyzer effects(functions);
+        if (auto tree = DecisionTreeBuilder::treeOf(cur)) {
+            (*tree)->accept(&effects);
+            collectChains(*tree, chains);
+        } else {
+            chains.emplace_back();
+            while (auto p = dynamic_cast<BranchExprAST *>(cur)) {
+                chains.back().push_back(&(p->condition));
+                cur = p->falseExpr.get();
+            }
+            for (auto condition : chains.back()) {
+                (*condition)->accept(&effects);
+            }
+        }
+        if (effects.impure) {
+            return;
+        }
+        effects.written.merge(effects.defined);
+
+        std::vector<std::unique_ptr<ExprAST>> defines;
+        for (auto &conditions : chains) {
+            shareChain(conditions, effects.written, defines);
+        }
+        if (defines.empty()) {
+            return;
+        }
+        if (block) {
+            block->exprs.insert(block->exprs.begin(), std::make_move_iterator(defines.begin()),
+                                std::make_move_iterator(defines.end()));
+        } else {
+            auto type = std::make_unique<TypeInfo>(*(subruleset->type));
+            defines.push_back(std::move(subruleset));
+            subruleset = std::make_unique<BlockExprAST>(std::move(type), std::move(defines));
+        }
+    }
+
+    /**
+     * @brief get what is shared so far, one line per temporary, like "_cse0 <= abs(phiA) (4 uses)"
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReport() const { return report; }
+
+  private:
+    /**
+     * @brief collect conditions of every first-match chain in expr, a chain in a branch or in else of another chain
+     * is collected as a chain of its own
+     *
+     * @param expr expr to search
+     * @param chains receives conditions of chains, in order of evaluation
+     */
+    static void collectChains(std::unique_ptr<ExprAST> &expr,
+                              std::vector<std::vector<std::unique_ptr<ExprAST> *>> &chains) {
+        if (auto p = dynamic_cast<BlockExprAST *>(expr.get())) {
+            for (auto &stmt : p->exprs) {
+                collectChains(stmt, chains);
+            }
+            return;
+        }
+        if (auto p = dynamic_cast<VarDefAST *>(expr.get())) {
+            collectChains(p->definedValue, chains);
+            return;
+        }
+        auto p = dynamic_cast<BranchExprAST *>(expr.get());
+        if (!p) {
+            return;
+        }
+        // by index, as chains grows while collecting branches
+        auto index = chains.size();
+        chains.emplace_back();
+        while (p) {
+            chains[index].push_back(&(p->condition));
+            collectChains(p->trueExpr, chains);
+            auto next = dynamic_cast<BranchExprAST *>(p->falseExpr.get());
+            if (!next) {
+                collectChains(p->falseExpr, chains);
+            }
+            p = next;
+        }
+    }
+
+    /**
+     * @brief share subexpressions in conditions of one first-match chain
+     *
+     * @param conditions conditions of chain, in order of evaluation
+     * @param written variables written or defined in subruleset
+     * @param defines receives defines of temporaries
+     */
+    void shareChain(const std::vector<std::unique_ptr<ExprAST> *> &conditions, const std::set<std::string> &written,
+                    std::vector<std::unique_ptr<ExprAST>> &defines) {
+        std::vector<Occurrence> occurrences;
+        Collector collector(*this, written, occurrences);
+        for (size_t i = 0; i < conditions.size(); i++) {
+            collector.condition = i;
+            collector.collect(*conditions[i]);
+        }
+
+        // larger subexpressions first, so ones inside a shared subexpression are not shared again
+        std::map<std::string, std::vector<size_t>> groups;
+        for (size_t i = 0; i < occurrences.size(); i++) {
+            groups[occurrences[i].key].push_back(i);
+        }
+        std::vector<std::vector<size_t> *> order;
+        for (auto &[key, group] : groups) {
+            if (group.size() > 1) {
+                order.push_back(&group);
+            }
+        }
+        std::ranges::stable_sort(order, [&](auto *a, auto *b) {
+            auto &x = occurrences[a->front()], &y = occurrences[b->front()];
+            return x.size != y.size ? x.size > y.size : a->front() < b->front();
+        });
+        std::vector<bool> shared(occurrences.size(), false);
+        std::vector<std::vector<size_t>> chosen;
+        for (auto *group : order) {
+            std::vector<size_t> live;
+            for (auto i : *group) {
+                bool inside = false;
+                for (auto p = occurrences[i].parent; p != SIZE_MAX && !inside; p = occurrences[p].parent) {
+                    inside = shared[p];
+                }
+                if (!inside) {
+                    live.push_back(i);
+                }
+            }
+            if (live.size() < 2) {
+                continue;
+            }
+            for (auto i : live) {
+                shared[i] = true;
+            }
+            chosen.push_back(std::move(live));
+        }
+        for (auto &group : chosen) {
+            share(occurrences, group, defines);
+        }
+    }
+
+    /**
+     * @brief a subexpression which can be shared
+     *
+     */
+    struct Occurrence {
+        std::unique_ptr<ExprAST> *slot;
+        /// @brief index of condition it appears in
+        size_t condition;
+        /// @brief evaluated whenever its condition is evaluated
+        bool unconditional;
+        std::string key;
+        /// @brief count of ast nodes
+        size_t size;
+        /// @brief index of nearest enclosing occurrence, SIZE_MAX if none
+        size_t parent;
+    };
+
+    /**
+     * @brief collect subexpressions which can be shared, in post order
+     *
+     */
+    struct Collector : public ASTVisitor {
+        Collector(ConditionCSE &cse, const std::set<std::string> &written, std::vector<Occurrence> &occurrences)
+            : condition(0), cse(cse), written(written), occurrences(occurrences), unconditional(true), node() {}
+
+        /// @brief index of condition being collected
+        size_t condition;
+
+        /**
+         * @brief collect subexpressions of expr, including itself
+         *
+         * @param slot expr
+         * @return bool expr is pure
+         */
+        bool collect(std::unique_ptr<ExprAST> &slot) {
+            auto begin = occurrences.size();
+            slot->accept(this);
+            if (node.pure && node.cost >= cse.minCost && slot->type && isNumericalType(*(slot->type))) {
+                for (auto i = begin; i < occurrences.size(); i++) {
+                    if (occurrences[i].parent == SIZE_MAX) {
+                        occurrences[i].parent = occurrences.size();
+                    }
+                }
+                occurrences.push_back({&slot, condition, unconditional, node.key, node.size, SIZE_MAX});
+            }
+            return node.pure;
+        }
+
+      protected:
+        VISIT_FUNCTION(IdentifierExprAST) { node = {!written.contains(v.name), v.name, 1, 0}; }
+        VISIT_FUNCTION(MemberAccessExprAST) {
+            Node ret{true, "(.", 1, 1};
+            add(ret, v.baseVar);
+            add(ret, v.memberToken);
+            finish(ret);
+        }
+        VISIT_FUNCTION(LiteralExprAST) { node = {true, std::format("<{}>{}", v.type->toString(), v.value), 1, 0}; }
+        VISIT_FUNCTION(FunctionCallExprAST) {
+            auto p = dynamic_cast<LiteralExprAST *>(v.functionIdent.get());
+            Node ret{p && cse.functions.isPure(p->value), "(call", 1, 2};
+            add(ret, v.functionIdent);
+            for (auto &arg : v.params) {
+                add(ret, arg);
+            }
+            finish(ret);
+        }
+        VISIT_FUNCTION(BinOpExprAST) {
+            Node ret{v.op != "=", "(" + v.op, 1, 1};
+            add(ret, v.lhs);
+            if (v.op == "&&" || v.op == "and" || v.op == "||" || v.op == "or") {
+                // rhs may be short-cut
+                auto saved = unconditional;
+                unconditional = false;
+                add(ret, v.rhs);
+                unconditional = saved;
+            } else {
+                add(ret, v.rhs);
+            }
+            finish(ret);
+        }
+        VISIT_FUNCTION(UnaryOpExprAST) {
+            Node ret{true, "(" + v.op, 1, 1};
+            add(ret, v.rhs);
+            finish(ret);
+        }
+        VISIT_FUNCTION(BranchExprAST) {
+            collect(v.condition);
+            auto saved = unconditional;
+            unconditional = false;
+            collect(v.trueExpr);
+            collect(v.falseExpr);
+            unconditional = saved;
+            node = {};
+        }
+        VISIT_FUNCTION(ComplexLiteralExprAST) {
+            for (auto &[index, value] : v.members) {
+                if (index) {
+                    collect(index);
+                }
+                collect(value);
+            }
+            node = {};
+        }
+        VISIT_FUNCTION(LoopAST) {
+            auto saved = unconditional;
+            unconditional = false;
+            collect(v.init);
+            collect(v.condition);
+            collect(v.body);
+            unconditional = saved;
+            node = {};
+        }
+        VISIT_FUNCTION(BlockExprAST) {
+            for (auto &stmt : v.exprs) {
+                collect(stmt);
+            }
+            node = {};
+        }
+        VISIT_FUNCTION(ControlFlowAST) { node = {}; }
+        VISIT_FUNCTION(TypeDefAST) { node = {}; }
+        VISIT_FUNCTION(VarDefAST) {
+            collect(v.definedValue);
+            node = {};
+        }
+        VISIT_FUNCTION(FunctionDefAST) { node = {}; }
+        VISIT_FUNCTION(SymbolDefAST) { node = {}; }
+
+      private:
+        struct Node {
+            bool pure = false;
+            std::string key;
+            size_t size = 0;
+            size_t cost = 0;
+        };
+
+        void add(Node &ret, std::unique_ptr<ExprAST> &child) {
+            ret.pure = collect(child) && ret.pure;
+            ret.key += " " + node.key;
+            ret.size += node.size;
+            ret.cost += node.cost;
+        }
+        void finish(Node &ret) {
+            ret.key += ")";
+            node = std::move(ret);
+        }
+
+        ConditionCSE &cse;
+        const std::set<std::string> &written;
+        std::vector<Occurrence> &occurrences;
+        bool unconditional;
+        /// @brief information of last visited node
+        Node node;
+    };
+
+    static bool isNumericalType(const TypeInfo &type) { return type == RealType || type == IntType; }
+
+    /**
+     * @brief replace occurrences of one subexpression by temporary
+     *
+     * @param occurrences all occurrences in subruleset
+     * @param group indexes of occurrences to share, in post order
+     * @param defines receives defines of temporaries
+     */
+    void share(std::vector<Occurrence> &occurrences, const std::vector<size_t> &group,
+               std::vector<std::unique_ptr<ExprAST>> &defines) {
+        auto first = group.front();
+        size_t firsts = 0;
+        for (auto i : group) {
+            if (occurrences[i].condition < occurrences[first].condition) {
+                first = i;
+            }
+        }
+        for (auto i : group) {
+            firsts += occurrences[i].condition == occurrences[first].condition;
+        }
+        bool lazy = firsts > 1 || !occurrences[first].unconditional;
+
+        auto name = "_cse" + std::to_string(counter++);
+        auto ready = name + "_ready";
+        auto &expr = *(occurrences[first].slot);
+        auto type = *(expr->type);
+        report.push_back(std::format("{} <= {} ({} uses{})", name, Decompiler().decompile(expr.get()), group.size(),
+                                     lazy ? ", lazy" : ""));
+
+        auto identifier = [](const std::string &var, const TypeInfo &type) {
+            return std::make_unique<IdentifierExprAST>(std::make_unique<TypeInfo>(type), var);
+        };
+        auto literal = [](const TypeInfo &type, const char *value) {
+            return std::make_unique<LiteralExprAST>(std::make_unique<TypeInfo>(type), value);
+        };
+        auto assign = [&](const std::string &var, const TypeInfo &type, std::unique_ptr<ExprAST> value) {
+            return std::make_unique<BinOpExprAST>(std::make_unique<TypeInfo>(NoInstanceType), "=",
+                                                  identifier(var, type), std::move(value));
+        };
+        defines.push_back(std::make_unique<VarDefAST>(name, std::make_unique<TypeInfo>(type), literal(type, "0")));
+        if (lazy) {
+            defines.push_back(
+                std::make_unique<VarDefAST>(ready, std::make_unique<TypeInfo>(RealType), literal(RealType, "0")));
+        }
+        for (auto i : group) {
+            auto &slot = *(occurrences[i].slot);
+            if (!lazy && i != first) {
+                slot = identifier(name, type);
+                continue;
+            }
+            std::vector<std::unique_ptr<ExprAST>> exprs;
+            exprs.push_back(assign(name, type, std::move(slot)));
+            if (lazy) {
+                exprs.push_back(assign(ready, RealType, literal(RealType, "1")));
+            }
+            exprs.push_back(identifier(name, type));
+            slot = std::make_unique<BlockExprAST>(std::make_unique<TypeInfo>(type), std::move(exprs));
+            if (lazy) {
+                slot = std::make_unique<BranchExprAST>(std::make_unique<TypeInfo>(type), identifier(ready, RealType),
+                                                       identifier(name, type), std::move(slot));
+            }
+        }
+    }
+
+    PureFunctionTable functions;
+    size_t minCost;
+    /// @brief count of temporaries, used to generate unique variable names
+    size_t counter;
+    /// @brief shared subexpressions
+    std::vector<std::string> report;
+};
+
+} // namespace rulejit::ruleset
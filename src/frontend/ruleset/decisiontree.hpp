@@ -0,0 +1,622 @@
+/**
+ * @file decisiontree.hpp
+ * @author djw
+ * @brief FrontEnd/Ruleset/Decision tree
+ * @date 2026-10-17
+ *
+ * @details Includes DecisionTreeBuilder, an optional pass over checked subrulesets which replaces the first-match
+ * chain of atom rule conditions by a decision tree.
+ *
+ * RuleSetParser::readSource turns a subruleset into "{if({c0}){...0}else if({c1}){...1}else ... {-1}}". Conditions
+ * often compare the same key, a variable or a pure expression like "abs(phiA)", with literal thresholds. Thresholds
+ * of a key split the real line into intervals; inside each interval every comparison of the key is known, so each
+ * condition is partially evaluated into true, false or a smaller residual condition. The subruleset becomes
+ *
+ *     {var _dt0 f64 = (binary search on key, each interval a smaller decision tree or first-match chain);
+ *      (binary search on _dt0, each leaf the consequence of one atom rule or the original else)}
+ *
+ * so finding the matched rule takes a few comparisons per key instead of evaluating conditions one by one. Rules
+ * stay in their original order in every leaf, so the first matched rule is the same, and NaN keys, for which every
+ * comparison but "!=" is false, get their own leaf when needed. Only subrulesets whose conditions have no side
+ * effects are rebuilt, since conditions are skipped or evaluated in a different order.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Keys only call build-in functions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add treeOf for passes run after.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <limits>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/context.hpp"
+#include "defines/typedef.hpp"
+#include "frontend/ruleset/effectanalyzer.hpp"
+
+namespace rulejit::ruleset {
+
+/**
+ * @brief replace first-match chain of atom rules in subruleset by decision tree
+ *
+ */
+struct DecisionTreeBuilder {
+    /// @brief default min count of atom rules of rebuilt subruleset
+    inline static constexpr size_t defaultMinRules = 4;
+    /// @brief max depth of keys in decision tree
+    inline static constexpr size_t maxDepth = 8;
+    /// @brief max count of conditions in leaves, as multiple of count of atom rules
+    inline static constexpr size_t maxGrowth = 4;
+
+    /**
+     * @brief Constructor
+     *
+     * @param global context with checked function defines
+     * @param minRules min count of atom rules of rebuilt subruleset
+     */
+    DecisionTreeBuilder(const ContextGlobal &global, size_t minRules = defaultMinRules)
+        : global(global), functions(global), minRules(minRules), defined(), counter(0), budget(0), stats(), report() {}
+
+    /**
+     * @brief rebuild one subruleset, left unchanged if it is too small or its conditions have side effects
+     *
+     * @param subruleset checked body of subruleset
+     */
+    void build(std::unique_ptr<ExprAST> &subruleset) {
+        auto block = dynamic_cast<BlockExprAST *>(subruleset.get());
+        auto &chain = block && !block->exprs.empty() ? block->exprs.back() : subruleset;
+        if (!chain->type || *(chain->type) != RealType) {
+            return;
+        }
+        std::vector<BranchExprAST *> branches;
+        for (auto p = dynamic_cast<BranchExprAST *>(chain.get()); p;
+             p = dynamic_cast<BranchExprAST *>(p->falseExpr.get())) {
+            branches.push_back(p);
+        }
+        if (branches.size() < minRules) {
+            return;
+        }
+        EffectAnalyzer effects(functions);
+        for (auto p : branches) {
+            p->condition->accept(&effects);
+        }
+        if (effects.impure || !effects.written.empty()) {
+            return;
+        }
+        defined = std::move(effects.defined);
+
+        std::vector<Rule> rules;
+        for (size_t i = 0; i < branches.size(); i++) {
+            rules.push_back({i, branches[i]->condition->copy()});
+        }
+        budget = maxGrowth * rules.size();
+        stats = {};
+        auto tree = node(rules, 0);
+        if (stats.keys == 0) {
+            return;
+        }
+
+        // dispatch matched index to consequences, -1 to the original else
+        std::vector<std::unique_ptr<ExprAST>> consequences;
+        consequences.push_back(std::move(branches.back()->falseExpr));
+        for (auto p : branches) {
+            consequences.push_back(std::move(p->trueExpr));
+        }
+        auto name = "_dt" + std::to_string(counter++);
+        auto dispatch = search(
+            consequences.size(),
+            [&](size_t i) {
+                return compare("<", identifier(name), literal(double(i) - 1));
+            },
+            [&](size_t i) { return std::move(consequences[i]); });
+        std::vector<std::unique_ptr<ExprAST>> exprs;
+        exprs.push_back(std::make_unique<VarDefAST>(name, std::make_unique<TypeInfo>(RealType), std::move(tree)));
+        exprs.push_back(std::move(dispatch));
+        chain = std::make_unique<BlockExprAST>(std::make_unique<TypeInfo>(RealType), std::move(exprs));
+        report.push_back(std::format("{} rules: {} keys, depth {}, {} leaves, {} conditions in leaves",
+                                     branches.size(), stats.keys, stats.depth, stats.leaves, stats.conditions));
+    }
+
+    /**
+     * @brief get decision tree of a rebuilt first-match chain, for passes run after this one
+     *
+     * @param chain last expr of subruleset
+     * @return std::unique_ptr<ExprAST>* value of "_dtN", nullptr if chain is not rebuilt
+     */
+    static std::unique_ptr<ExprAST> *treeOf(ExprAST *chain) {
+        auto block = dynamic_cast<BlockExprAST *>(chain);
+        if (!block || block->exprs.size() != 2) {
+            return nullptr;
+        }
+        auto def = dynamic_cast<VarDefAST *>(block->exprs.front().get());
+        return def && def->name.starts_with("_dt") ? &(def->definedValue) : nullptr;
+    }
+
+    /**
+     * @brief get rebuilt subrulesets so far, one line per subruleset
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReport() const { return report; }
+
+  private:
+    /**
+     * @brief atom rule not decided yet
+     *
+     */
+    struct Rule {
+        /// @brief index in subruleset
+        size_t index;
+        /// @brief residual condition, nullptr if it is true
+        std::unique_ptr<ExprAST> condition;
+    };
+
+    /**
+     * @brief comparison of key with literal, normalized as "key op value"
+     *
+     */
+    struct Test {
+        std::string op;
+        double value;
+    };
+
+    /**
+     * @brief key compared in conditions
+     *
+     */
+    struct Key {
+        /// @brief first appearance, copied into tree
+        ExprAST *expr = nullptr;
+        /// @brief index of first rule comparing it
+        size_t first = 0;
+        /// @brief count of rules comparing it
+        size_t rules = 0;
+        /// @brief comparisons, in order of appearance
+        std::vector<Test> tests;
+    };
+
+    /**
+     * @brief partial evaluation result of condition
+     *
+     */
+    struct Residual {
+        enum class Kind { ALWAYS, NEVER, RESIDUAL } kind;
+        std::unique_ptr<ExprAST> expr;
+    };
+
+    /**
+     * @brief build subtree which returns index of matched rule, or -1
+     *
+     * @param rules rules in original order
+     * @param depth count of keys above
+     * @return std::unique_ptr<ExprAST>
+     */
+    std::unique_ptr<ExprAST> node(std::vector<Rule> &rules, size_t depth) {
+        std::map<std::string, Key> keys;
+        for (size_t i = 0; i < rules.size() && depth < maxDepth; i++) {
+            if (rules[i].condition) {
+                std::set<std::string> seen;
+                collect(rules[i].condition.get(), i, keys, seen);
+            }
+        }
+        Key *best = nullptr;
+        const std::string *bestName = nullptr;
+        for (auto &[name, key] : keys) {
+            if (key.rules >= 2 && (!best || key.rules > best->rules ||
+                                   (key.rules == best->rules && key.first < best->first))) {
+                best = &key;
+                bestName = &name;
+            }
+        }
+        if (!best) {
+            return leaf(rules);
+        }
+
+        // atomic intervals are (-inf, t0), [t0], (t0, t1), ..., [tn], (tn, inf), then merged by outcomes of tests
+        std::vector<double> thresholds;
+        for (auto &test : best->tests) {
+            thresholds.push_back(test.value);
+        }
+        std::ranges::sort(thresholds);
+        thresholds.erase(std::unique(thresholds.begin(), thresholds.end()), thresholds.end());
+        auto outcomes = [&](double x) {
+            std::vector<bool> ret;
+            for (auto &test : best->tests) {
+                ret.push_back(evaluate(test.op, x, test.value));
+            }
+            return ret;
+        };
+        std::vector<double> samples{std::nextafter(thresholds.front(), -std::numeric_limits<double>::infinity())};
+        std::vector<Test> bounds;
+        for (auto t : thresholds) {
+            samples.push_back(t);
+            samples.push_back(std::nextafter(t, std::numeric_limits<double>::infinity()));
+            bounds.push_back({"<", t});
+            bounds.push_back({"<=", t});
+        }
+        std::vector<double> regions{samples.front()};
+        std::vector<Test> splits;
+        for (size_t i = 1; i < samples.size(); i++) {
+            if (outcomes(samples[i]) != outcomes(regions.back())) {
+                regions.push_back(samples[i]);
+                splits.push_back(bounds[i - 1]);
+            }
+        }
+        // NaN goes to the last interval in binary search
+        bool nan = outcomes(std::numeric_limits<double>::quiet_NaN()) != outcomes(regions.back());
+        if (regions.size() == 1 && !nan) {
+            return leaf(rules);
+        }
+
+        std::vector<std::vector<Rule>> children;
+        size_t grown = 0;
+        for (auto x : regions) {
+            children.push_back(restrict(rules, *bestName, x));
+            grown += conditions(children.back());
+        }
+        if (nan) {
+            children.push_back(restrict(rules, *bestName, std::numeric_limits<double>::quiet_NaN()));
+            grown += conditions(children.back());
+        }
+        auto current = conditions(rules);
+        if (grown > current && grown - current > budget) {
+            return leaf(rules);
+        }
+        budget -= grown > current ? grown - current : 0;
+
+        stats.keys++;
+        stats.depth = std::max(stats.depth, depth + 1);
+        // a key which is not a variable is evaluated once into a temporary
+        bool simple = isVariable(best->expr);
+        auto name = simple ? std::string() : "_dt" + std::to_string(counter++);
+        auto key = [&]() { return simple ? best->expr->copy() : identifier(name); };
+        std::vector<std::unique_ptr<ExprAST>> subtrees;
+        for (auto &child : children) {
+            subtrees.push_back(node(child, depth + 1));
+        }
+        auto tree = search(
+            regions.size(), [&](size_t i) { return compare(splits[i - 1].op, key(), literal(splits[i - 1].value)); },
+            [&](size_t i) { return std::move(subtrees[i]); });
+        if (nan) {
+            tree = std::make_unique<BranchExprAST>(std::make_unique<TypeInfo>(RealType), compare("==", key(), key()),
+                                                   std::move(tree), std::move(subtrees.back()));
+        }
+        if (simple) {
+            return tree;
+        }
+        std::vector<std::unique_ptr<ExprAST>> exprs;
+        exprs.push_back(
+            std::make_unique<VarDefAST>(name, std::make_unique<TypeInfo>(RealType), best->expr->copy()));
+        exprs.push_back(std::move(tree));
+        return std::make_unique<BlockExprAST>(std::make_unique<TypeInfo>(RealType), std::move(exprs));
+    }
+
+    /**
+     * @brief build first-match chain of residual conditions
+     *
+     * @param rules rules in original order
+     * @return std::unique_ptr<ExprAST>
+     */
+    std::unique_ptr<ExprAST> leaf(std::vector<Rule> &rules) {
+        stats.leaves++;
+        stats.conditions += conditions(rules);
+        std::unique_ptr<ExprAST> ret = literal(-1);
+        for (auto it = rules.rbegin(); it != rules.rend(); ++it) {
+            if (!it->condition) {
+                ret = literal(double(it->index));
+                continue;
+            }
+            ret = std::make_unique<BranchExprAST>(std::make_unique<TypeInfo>(RealType), std::move(it->condition),
+                                                  literal(double(it->index)), std::move(ret));
+        }
+        return ret;
+    }
+
+    /**
+     * @brief partially evaluate rules with key fixed to x, drop false ones and ones after a true one
+     *
+     */
+    std::vector<Rule> restrict(const std::vector<Rule> &rules, const std::string &key, double x) {
+        std::vector<Rule> ret;
+        for (auto &rule : rules) {
+            if (!rule.condition) {
+                ret.push_back({rule.index, nullptr});
+                break;
+            }
+            auto residual = evaluate(rule.condition.get(), key, x);
+            if (residual.kind == Residual::Kind::NEVER) {
+                continue;
+            }
+            ret.push_back({rule.index, std::move(residual.expr)});
+            if (residual.kind == Residual::Kind::ALWAYS) {
+                break;
+            }
+        }
+        return ret;
+    }
+
+    static size_t conditions(const std::vector<Rule> &rules) {
+        return std::ranges::count_if(rules, [](auto &rule) { return rule.condition != nullptr; });
+    }
+
+    /**
+     * @brief collect comparisons of keys with literals, where condition is used as bool
+     *
+     */
+    void collect(ExprAST *expr, size_t rule, std::map<std::string, Key> &keys, std::set<std::string> &seen) {
+        if (auto p = dynamic_cast<BlockExprAST *>(expr); p && p->exprs.size() == 1) {
+            return collect(p->exprs.front().get(), rule, keys, seen);
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p && (p->op == "!" || p->op == "not")) {
+            return collect(p->rhs.get(), rule, keys, seen);
+        }
+        auto p = dynamic_cast<BinOpExprAST *>(expr);
+        if (!p) {
+            return;
+        }
+        if (isLogical(p->op)) {
+            collect(p->lhs.get(), rule, keys, seen);
+            collect(p->rhs.get(), rule, keys, seen);
+            return;
+        }
+        if (auto test = match(p); test) {
+            auto &[name, keyExpr, t] = *test;
+            auto &key = keys[name];
+            if (!key.expr) {
+                key.expr = keyExpr;
+                key.first = rule;
+            }
+            if (seen.insert(name).second) {
+                key.rules++;
+            }
+            key.tests.push_back(std::move(t));
+        }
+    }
+
+    /**
+     * @brief partially evaluate condition used as bool, with key fixed to x
+     *
+     */
+    Residual evaluate(ExprAST *expr, const std::string &key, double x) {
+        if (auto p = dynamic_cast<BlockExprAST *>(expr); p && p->exprs.size() == 1) {
+            return evaluate(p->exprs.front().get(), key, x);
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p && (p->op == "!" || p->op == "not")) {
+            auto r = evaluate(p->rhs.get(), key, x);
+            if (r.kind != Residual::Kind::RESIDUAL) {
+                return {r.kind == Residual::Kind::ALWAYS ? Residual::Kind::NEVER : Residual::Kind::ALWAYS, nullptr};
+            }
+            return {Residual::Kind::RESIDUAL,
+                    std::make_unique<UnaryOpExprAST>(std::make_unique<TypeInfo>(*(p->type)), p->op, std::move(r.expr))};
+        }
+        if (auto value = number(expr); value) {
+            return {*value != 0 ? Residual::Kind::ALWAYS : Residual::Kind::NEVER, nullptr};
+        }
+        auto p = dynamic_cast<BinOpExprAST *>(expr);
+        if (p && isLogical(p->op)) {
+            // conditions have no side effects, so operands can be dropped in any order
+            bool isAnd = p->op == "&&" || p->op == "and";
+            auto shortCut = isAnd ? Residual::Kind::NEVER : Residual::Kind::ALWAYS;
+            auto l = evaluate(p->lhs.get(), key, x);
+            if (l.kind == shortCut) {
+                return l;
+            }
+            auto r = evaluate(p->rhs.get(), key, x);
+            if (l.kind != Residual::Kind::RESIDUAL || r.kind == shortCut) {
+                return r;
+            }
+            if (r.kind != Residual::Kind::RESIDUAL) {
+                return l;
+            }
+            return {Residual::Kind::RESIDUAL, std::make_unique<BinOpExprAST>(std::make_unique<TypeInfo>(*(p->type)), p->op,
+                                                                        std::move(l.expr), std::move(r.expr))};
+        }
+        if (p) {
+            if (auto test = match(p); test && std::get<0>(*test) == key) {
+                auto &t = std::get<2>(*test);
+                return {evaluate(t.op, x, t.value) ? Residual::Kind::ALWAYS : Residual::Kind::NEVER, nullptr};
+            }
+        }
+        return {Residual::Kind::RESIDUAL, expr->copy()};
+    }
+
+    static bool evaluate(const std::string &op, double x, double t) {
+        if (op == "<") {
+            return x < t;
+        } else if (op == "<=") {
+            return x <= t;
+        } else if (op == ">") {
+            return x > t;
+        } else if (op == ">=") {
+            return x >= t;
+        } else if (op == "==") {
+            return x == t;
+        }
+        return x != t;
+    }
+
+    static bool isLogical(const std::string &op) { return op == "&&" || op == "and" || op == "||" || op == "or"; }
+
+    /**
+     * @brief match "key op literal" or "literal op key"
+     *
+     * @return std::optional<std::tuple<std::string, ExprAST *, Test>> name of key, key and normalized comparison
+     */
+    std::optional<std::tuple<std::string, ExprAST *, Test>> match(BinOpExprAST *p) {
+        static const std::map<std::string, std::string> flipped{
+            {"<", ">"}, {"<=", ">="}, {">", "<"}, {">=", "<="}, {"==", "=="}, {"!=", "!="},
+        };
+        auto op = flipped.find(p->op);
+        if (op == flipped.end()) {
+            return std::nullopt;
+        }
+        if (auto value = number(p->rhs.get()); value) {
+            if (auto name = keyOf(p->lhs.get()); name) {
+                return std::make_tuple(std::move(*name), p->lhs.get(), Test{op->first, *value});
+            }
+        }
+        if (auto value = number(p->lhs.get()); value) {
+            if (auto name = keyOf(p->rhs.get()); name) {
+                return std::make_tuple(std::move(*name), p->rhs.get(), Test{op->second, *value});
+            }
+        }
+        return std::nullopt;
+    }
+
+    /**
+     * @brief get name of key, built by variables, struct members, arithmetic and calls to pure build-in functions,
+     * which can be evaluated anywhere in subruleset without failing
+     *
+     * @param expr expression
+     * @return std::optional<std::string> nullopt if expr can not be a key
+     */
+    std::optional<std::string> keyOf(ExprAST *expr) {
+        if (!expr->type || *(expr->type) != RealType || number(expr)) {
+            return std::nullopt;
+        }
+        return name(expr);
+    }
+
+    std::optional<std::string> name(ExprAST *expr) {
+        if (auto p = dynamic_cast<IdentifierExprAST *>(expr); p) {
+            if (defined.contains(p->name)) {
+                return std::nullopt;
+            }
+            return p->name;
+        }
+        if (auto p = dynamic_cast<LiteralExprAST *>(expr); p) {
+            if (!number(expr)) {
+                return std::nullopt;
+            }
+            return "#" + p->value;
+        }
+        if (auto p = dynamic_cast<MemberAccessExprAST *>(expr); p) {
+            auto token = dynamic_cast<LiteralExprAST *>(p->memberToken.get());
+            auto base = name(p->baseVar.get());
+            if (!token || *(token->type) != StringType || !base) {
+                return std::nullopt;
+            }
+            return *base + "." + token->value;
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p) {
+            auto rhs = name(p->rhs.get());
+            if (p->op != "-" || !rhs) {
+                return std::nullopt;
+            }
+            return "(-" + *rhs + ")";
+        }
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr); p) {
+            auto lhs = name(p->lhs.get()), rhs = name(p->rhs.get());
+            if ((p->op != "+" && p->op != "-" && p->op != "*" && p->op != "/") || !lhs || !rhs) {
+                return std::nullopt;
+            }
+            return "(" + *lhs + p->op + *rhs + ")";
+        }
+        if (auto p = dynamic_cast<FunctionCallExprAST *>(expr); p) {
+            // build-in functions only, user functions may fail inside, and keys are evaluated before any condition
+            auto func = dynamic_cast<LiteralExprAST *>(p->functionIdent.get());
+            if (!func || global.realFuncDefinition.contains(func->value) || !functions.isPure(func->value)) {
+                return std::nullopt;
+            }
+            auto ret = func->value + "(";
+            for (auto &arg : p->params) {
+                auto param = name(arg.get());
+                if (!param) {
+                    return std::nullopt;
+                }
+                ret += *param + ",";
+            }
+            return ret + ")";
+        }
+        return std::nullopt;
+    }
+
+    static bool isVariable(ExprAST *expr) {
+        if (auto p = dynamic_cast<MemberAccessExprAST *>(expr); p) {
+            return isVariable(p->baseVar.get());
+        }
+        return dynamic_cast<IdentifierExprAST *>(expr) != nullptr;
+    }
+
+    static std::optional<double> number(ExprAST *expr) {
+        auto p = dynamic_cast<LiteralExprAST *>(expr);
+        if (!p || (*(p->type) != RealType && *(p->type) != IntType)) {
+            return std::nullopt;
+        }
+        double x;
+        auto [end, ec] = std::from_chars(p->value.data(), p->value.data() + p->value.size(), x);
+        if (ec != std::errc() || end != p->value.data() + p->value.size()) {
+            return std::nullopt;
+        }
+        return x;
+    }
+
+    static std::unique_ptr<ExprAST> literal(double x) {
+        return std::make_unique<LiteralExprAST>(std::make_unique<TypeInfo>(RealType), std::format("{}", x));
+    }
+    static std::unique_ptr<ExprAST> identifier(const std::string &name) {
+        return std::make_unique<IdentifierExprAST>(std::make_unique<TypeInfo>(RealType), name);
+    }
+    static std::unique_ptr<ExprAST> compare(const std::string &op, std::unique_ptr<ExprAST> lhs,
+                                            std::unique_ptr<ExprAST> rhs) {
+        return std::make_unique<BinOpExprAST>(std::make_unique<TypeInfo>(RealType), op, std::move(lhs),
+                                              std::move(rhs));
+    }
+
+    /**
+     * @brief build balanced binary search over n ordered leaves
+     *
+     * @param n count of leaves
+     * @param split condition true for leaves before i
+     * @param leaf get leaf i
+     * @return std::unique_ptr<ExprAST>
+     */
+    template <typename Split, typename Leaf>
+    static std::unique_ptr<ExprAST> search(size_t n, Split &&split, Leaf &&leaf) {
+        auto impl = [&](auto &self, size_t lo, size_t hi) -> std::unique_ptr<ExprAST> {
+            if (lo + 1 == hi) {
+                return leaf(lo);
+            }
+            auto mid = (lo + hi) / 2;
+            auto cond = split(mid);
+            auto lhs = self(self, lo, mid);
+            return std::make_unique<BranchExprAST>(std::make_unique<TypeInfo>(RealType), std::move(cond),
+                                                   std::move(lhs), self(self, mid, hi));
+        };
+        return impl(impl, 0, n);
+    }
+
+    const ContextGlobal &global;
+    PureFunctionTable functions;
+    size_t minRules;
+    /// @brief variables defined in conditions, never used as keys
+    std::set<std::string> defined;
+    /// @brief count of temporaries, used to generate unique variable names
+    size_t counter;
+    /// @brief conditions which can still be added to leaves by duplication
+    size_t budget;
+    /// @brief shape of tree being built
+    struct {
+        size_t keys = 0;
+        size_t depth = 0;
+        size_t leaves = 0;
+        size_t conditions = 0;
+    } stats;
+    /// @brief rebuilt subrulesets
+    std::vector<std::string> report;
+};
+
+} // namespace rulejit::ruleset
@@ -0,0 +1,173 @@
+/**
+ * @file effectanalyzer.hpp
+ * @author djw
+ * @brief FrontEnd/Ruleset/Effect analyzer
+ * @date 2026-10-17
+ *
+ * @details Includes EffectAnalyzer, which collects variables read and written by checked expressions, and
+ * PureFunctionTable, which tells if calling a function has side effects. Used by passes which move, share or skip
+ * evaluation of atom rule conditions.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <set>
+#include <string>
+#include <unordered_map>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "defines/typedef.hpp"
+
+namespace rulejit::ruleset {
+
+/**
+ * @brief check and cache if calling a function has no side effects and its result depends only on args
+ *
+ */
+struct PureFunctionTable {
+    PureFunctionTable(const ContextGlobal &global) : global(global), pure() {}
+
+    /**
+     * @brief check if function is pure
+     *
+     * @param name real function name, or name of build-in function
+     * @return bool
+     */
+    bool isPure(const std::string &name);
+
+  private:
+    const ContextGlobal &global;
+    /// @brief function name -> if it is pure
+    std::unordered_map<std::string, bool> pure;
+};
+
+/**
+ * @brief collect variables written and calls with side effects
+ *
+ */
+struct EffectAnalyzer : public ASTVisitor {
+    EffectAnalyzer(PureFunctionTable &functions) : functions(functions) {}
+
+    /// @brief variables assigned, including the ones whose member or element is assigned
+    std::set<std::string> written;
+    /// @brief variables defined
+    std::set<std::string> defined;
+    /// @brief variables read
+    std::set<std::string> read;
+    /// @brief calls function values or functions with side effects, or contains unsupported nodes
+    bool impure = false;
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) { read.insert(v.name); }
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        v.baseVar->accept(this);
+        v.memberToken->accept(this);
+    }
+    VISIT_FUNCTION(LiteralExprAST) {}
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        auto p = dynamic_cast<LiteralExprAST *>(v.functionIdent.get());
+        if (!p || !functions.isPure(p->value)) {
+            impure = true;
+        }
+        for (auto &arg : v.params) {
+            arg->accept(this);
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        if (v.op == "=") {
+            ExprAST *base = v.lhs.get();
+            while (auto p = dynamic_cast<MemberAccessExprAST *>(base)) {
+                base = p->baseVar.get();
+            }
+            if (auto p = dynamic_cast<IdentifierExprAST *>(base); p) {
+                written.insert(p->name);
+            } else {
+                impure = true;
+            }
+        }
+        v.lhs->accept(this);
+        v.rhs->accept(this);
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) { v.rhs->accept(this); }
+    VISIT_FUNCTION(BranchExprAST) {
+        v.condition->accept(this);
+        v.trueExpr->accept(this);
+        v.falseExpr->accept(this);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        for (auto &[index, value] : v.members) {
+            if (index) {
+                index->accept(this);
+            }
+            value->accept(this);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        v.init->accept(this);
+        v.condition->accept(this);
+        v.body->accept(this);
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        for (auto &stmt : v.exprs) {
+            stmt->accept(this);
+        }
+    }
+    VISIT_FUNCTION(ControlFlowAST) { impure = true; }
+    VISIT_FUNCTION(TypeDefAST) { impure = true; }
+    VISIT_FUNCTION(VarDefAST) {
+        v.definedValue->accept(this);
+        defined.insert(v.name);
+    }
+    VISIT_FUNCTION(FunctionDefAST) { impure = true; }
+    VISIT_FUNCTION(SymbolDefAST) { impure = true; }
+    VISIT_FUNCTION(TemplateDefAST) { impure = true; }
+    VISIT_FUNCTION(ClosureExprAST) { impure = true; }
+
+  private:
+    PureFunctionTable &functions;
+};
+
+inline bool PureFunctionTable::isPure(const std::string &name) {
+    // should match functions defined in initprocess in frontend/ruleset/rulesetparser.cpp
+    static const std::set<std::string> buildIn{
+        "length", "strEqual", "sin",   "cos",  "tan",        "cot", "atan",  "asin", "acos",
+        "fabs",   "exp",      "abs",   "floor", "sqrt",      "normCDFInv", "pow", "atan2",
+    };
+    if (auto it = pure.find(name); it != pure.end()) {
+        return it->second;
+    }
+    auto func = global.realFuncDefinition.find(name);
+    if (func == global.realFuncDefinition.end()) {
+        return pure[name] = buildIn.contains(name);
+    }
+    // recursive functions are treated as impure
+    pure[name] = false;
+    std::set<std::string> params, numerical;
+    for (auto &param : func->second->params) {
+        params.insert(param->name);
+        if (*(param->type) == RealType || *(param->type) == IntType) {
+            numerical.insert(param->name);
+        }
+    }
+    EffectAnalyzer effects(*this);
+    func->second->returnValue->accept(&effects);
+    bool ret = !effects.impure;
+    for (auto &var : effects.read) {
+        // reads nothing but params and locals
+        ret = ret && (params.contains(var) || effects.defined.contains(var));
+    }
+    for (auto &var : effects.written) {
+        // params other than numerical ones are passed by reference
+        ret = ret && (numerical.contains(var) || effects.defined.contains(var));
+    }
+    return pure[name] = ret;
+}
+
+} // namespace rulejit::ruleset
@@ -0,0 +1,462 @@
+/**
+ * @file selectivity.hpp
+ * @author djw
+ * @brief FrontEnd/Ruleset/Selectivity
+ * @date 2026-10-17
+ *
+ * @details Includes SelectivityProfile, which records how often each operand of "&&"/"||" is evaluated, true and
+ * how much it costs, and ShortCutReorderer, an optimization pass over checked subrulesets which moves the cheapest,
+ * most decisive operands of such chains to the front.
+ *
+ * Only chains whose value is used as a condition are reordered, like "if(a && b && c)" or operands of "!", since
+ * "a || b" is a itself when a is true. A chain is cut into segments by operands which have side effects or may fail,
+ * like "n != 0 && x % n == 0" or "i < length(a) && a[i] > 0"; operands never cross these. Lazy temporaries of
+ * ConditionCSE are movable, since they only decide where a shared subexpression is evaluated first. Inside a
+ * segment, operands of "&&" are sorted by cost / P(false) and operands of "||" by cost / P(true), which minimizes
+ * expected cost when operands are independent. Atom rules are not moved, so the first matched rule is the same.
+ *
+ * Chains are numbered in pre-order of each subruleset, operands from left to right, the same way when the profile
+ * is recorded and when it is applied. Operands are also checked by their decompiled text, so a stale profile is
+ * ignored where the rule file has changed.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#pragma once
+
+#include <algorithm>
+#include <format>
+#include <limits>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "ast/ast.hpp"
+#include "ast/astvisitor.hpp"
+#include "ast/context.hpp"
+#include "ast/decompiler.hpp"
+#include "frontend/ruleset/effectanalyzer.hpp"
+
+namespace rulejit::ruleset {
+
+/**
+ * @brief operand statistics of "&&"/"||" chains recorded over real ticks, saved as a profile file
+ *
+ */
+struct SelectivityProfile {
+    struct Operand {
+        /// @brief times evaluated
+        size_t evaluated = 0;
+        /// @brief times evaluated as true
+        size_t truthy = 0;
+        /// @brief total cost of evaluations, in ast nodes visited
+        size_t cost = 0;
+        /// @brief decompiled operand, checked when profile is applied
+        std::string text;
+    };
+    /// @brief (subruleset name, chain index) -> operands from left to right
+    std::map<std::pair<std::string, size_t>, std::vector<Operand>> chains;
+
+    /**
+     * @brief one operand per line as "subruleset chain operand evaluated truthy cost text"
+     *
+     * @return std::string
+     */
+    std::string dump() const {
+        std::string ret = "# subruleset chain operand evaluated truthy cost text\n";
+        for (auto &[key, operands] : chains) {
+            for (size_t i = 0; i < operands.size(); i++) {
+                auto &o = operands[i];
+                ret += std::format("{} {} {} {} {} {} {}\n", key.first, key.second, i, o.evaluated, o.truthy, o.cost,
+                                   o.text);
+            }
+        }
+        return ret;
+    }
+
+    /**
+     * @brief parse text produced by dump
+     *
+     * @param text
+     * @return std::optional<SelectivityProfile> nullopt if any line is ill-formed
+     */
+    static std::optional<SelectivityProfile> parse(std::string_view text) {
+        SelectivityProfile ret;
+        std::istringstream in{std::string(text)};
+        std::string line;
+        while (std::getline(in, line)) {
+            auto first = line.find_first_not_of(" \t\r");
+            if (first == std::string::npos || line[first] == '#') {
+                // empty line or comment
+                continue;
+            }
+            std::istringstream fields(line);
+            std::string name;
+            size_t chain, index;
+            Operand o;
+            if (!(fields >> name >> chain >> index >> o.evaluated >> o.truthy >> o.cost) || o.truthy > o.evaluated) {
+                return std::nullopt;
+            }
+            std::getline(fields >> std::ws, o.text);
+            while (!o.text.empty() && o.text.back() == '\r') {
+                o.text.pop_back();
+            }
+            auto &operands = ret.chains[{name, chain}];
+            if (index != operands.size()) {
+                return std::nullopt;
+            }
+            operands.push_back(std::move(o));
+        }
+        return ret;
+    }
+
+    /**
+     * @brief decompiled text of operand in one line
+     *
+     * @param expr operand
+     * @return std::string
+     */
+    static std::string textOf(ExprAST *expr) {
+        auto ret = Decompiler().decompile(expr);
+        std::replace(ret.begin(), ret.end(), '\n', ' ');
+        return ret;
+    }
+};
+
+/**
+ * @brief "&&"/"||" chains of a subruleset whose value is used as a condition, in pre-order
+ *
+ */
+struct ShortCutChains : public ASTVisitor {
+    struct Chain {
+        /// @brief slot holding the outermost operator of chain
+        std::unique_ptr<ExprAST> *root;
+        bool isAnd;
+        /// @brief operands from left to right, each as (operator, is rhs of operator)
+        std::vector<std::pair<BinOpExprAST *, bool>> operands;
+    };
+
+    /**
+     * @brief collect chains in subruleset
+     *
+     * @param subruleset checked subruleset
+     * @return std::vector<Chain>
+     */
+    static std::vector<Chain> collect(std::unique_ptr<ExprAST> &subruleset) {
+        ShortCutChains collector;
+        collector.visit(subruleset, false);
+        return std::move(collector.chains);
+    }
+
+    static bool isLogical(const std::string &op) { return op == "&&" || op == "and" || op == "||" || op == "or"; }
+    static bool isAnd(const std::string &op) { return op == "&&" || op == "and"; }
+
+    /**
+     * @brief get operand of chain
+     *
+     * @param operand (operator, is rhs of operator)
+     * @return std::unique_ptr<ExprAST>&
+     */
+    static std::unique_ptr<ExprAST> &slotOf(const std::pair<BinOpExprAST *, bool> &operand) {
+        return operand.second ? operand.first->rhs : operand.first->lhs;
+    }
+
+  protected:
+    VISIT_FUNCTION(IdentifierExprAST) {}
+    VISIT_FUNCTION(MemberAccessExprAST) {
+        visit(v.baseVar, false);
+        visit(v.memberToken, false);
+    }
+    VISIT_FUNCTION(LiteralExprAST) {}
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        for (auto &arg : v.params) {
+            visit(arg, false);
+        }
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        if (!isLogical(v.op)) {
+            visit(v.lhs, false);
+            visit(v.rhs, false);
+            return;
+        }
+        if (!condition) {
+            // value of lhs is result when it decides, only rhs is converted to bool
+            visit(v.lhs, false);
+            visit(v.rhs, true);
+            return;
+        }
+        auto index = chains.size();
+        chains.push_back(Chain{slot, isAnd(v.op), {}});
+        flatten(v, chains[index].isAnd, chains[index].operands);
+        auto operands = chains[index].operands;
+        for (auto &operand : operands) {
+            visit(slotOf(operand), true);
+        }
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) { visit(v.rhs, v.op == "!" || v.op == "not"); }
+    VISIT_FUNCTION(BranchExprAST) {
+        auto arms = condition;
+        visit(v.condition, true);
+        visit(v.trueExpr, arms);
+        visit(v.falseExpr, arms);
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) {
+        for (auto &[index, value] : v.members) {
+            if (index) {
+                visit(index, false);
+            }
+            visit(value, false);
+        }
+    }
+    VISIT_FUNCTION(LoopAST) {
+        visit(v.init, false);
+        visit(v.condition, true);
+        visit(v.body, false);
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        auto last = condition;
+        for (size_t i = 0; i < v.exprs.size(); i++) {
+            visit(v.exprs[i], last && i + 1 == v.exprs.size());
+        }
+    }
+    VISIT_FUNCTION(ControlFlowAST) { visit(v.value, false); }
+    VISIT_FUNCTION(TypeDefAST) {}
+    VISIT_FUNCTION(VarDefAST) { visit(v.definedValue, false); }
+    VISIT_FUNCTION(FunctionDefAST) {}
+    VISIT_FUNCTION(SymbolDefAST) {}
+
+  private:
+    ShortCutChains() : chains(), slot(nullptr), condition(false) {}
+
+    void visit(std::unique_ptr<ExprAST> &expr, bool isCondition) {
+        if (!expr) {
+            return;
+        }
+        slot = &expr;
+        condition = isCondition;
+        expr->accept(this);
+    }
+
+    static void flatten(BinOpExprAST &v, bool isAnd, std::vector<std::pair<BinOpExprAST *, bool>> &operands) {
+        for (bool rhs : {false, true}) {
+            auto p = dynamic_cast<BinOpExprAST *>((rhs ? v.rhs : v.lhs).get());
+            if (p && isLogical(p->op) && ShortCutChains::isAnd(p->op) == isAnd) {
+                flatten(*p, isAnd, operands);
+            } else {
+                operands.emplace_back(&v, rhs);
+            }
+        }
+    }
+
+    std::vector<Chain> chains;
+    std::unique_ptr<ExprAST> *slot;
+    /// @brief value of visited expression is only used as a condition
+    bool condition;
+};
+
+/**
+ * @brief reorder operands of "&&"/"||" chains in subrulesets by a recorded SelectivityProfile
+ *
+ */
+struct ShortCutReorderer {
+    /**
+     * @brief Constructor
+     *
+     * @param global context with checked function defines
+     * @param profile recorded profile
+     */
+    ShortCutReorderer(const ContextGlobal &global, const SelectivityProfile &profile)
+        : global(global), functions(global), profile(profile), report() {}
+
+    /**
+     * @brief reorder chains of one subruleset
+     *
+     * @param name name of subruleset in profile
+     * @param subruleset checked subruleset
+     */
+    void reorder(const std::string &name, std::unique_ptr<ExprAST> &subruleset) {
+        auto chains = ShortCutChains::collect(subruleset);
+        // decide on the original ast, then rebuild inner chains first, since rebuilding moves operators of a chain
+        std::vector<std::pair<size_t, std::vector<size_t>>> orders;
+        for (size_t i = 0; i < chains.size(); i++) {
+            if (auto order = decide(name, i, chains[i]); order) {
+                orders.emplace_back(i, std::move(*order));
+            }
+        }
+        for (auto it = orders.rbegin(); it != orders.rend(); it++) {
+            auto &chain = chains[it->first];
+            auto before = Decompiler().decompile(chain.root->get());
+            rebuild(chain, it->second);
+            report.push_back(std::format("{}: {} => {}", name, before, Decompiler().decompile(chain.root->get())));
+        }
+    }
+
+    /**
+     * @brief get chains reordered so far, one line per chain, like "subruleset@0: (a && b) => (b && a)"
+     *
+     * @return const std::vector<std::string>&
+     */
+    const std::vector<std::string> &getReport() const { return report; }
+
+  private:
+    /**
+     * @brief decide new order of operands of chain
+     *
+     * @return std::optional<std::vector<size_t>> nullopt if chain is unchanged
+     */
+    std::optional<std::vector<size_t>> decide(const std::string &name, size_t index,
+                                              const ShortCutChains::Chain &chain) {
+        auto it = profile.chains.find({name, index});
+        if (it == profile.chains.end() || it->second.size() != chain.operands.size()) {
+            return std::nullopt;
+        }
+        auto &recorded = it->second;
+        std::vector<double> rank(recorded.size());
+        std::vector<bool> movable(recorded.size());
+        for (size_t i = 0; i < recorded.size(); i++) {
+            auto operand = ShortCutChains::slotOf(chain.operands[i]).get();
+            if (SelectivityProfile::textOf(operand) != recorded[i].text) {
+                return std::nullopt;
+            }
+            auto &o = recorded[i];
+            // operands never evaluated stay where they are
+            movable[i] = o.evaluated > 0 && canMove(operand);
+            double decisive = double(chain.isAnd ? o.evaluated - o.truthy : o.truthy) / double(o.evaluated);
+            rank[i] = decisive > 0 ? double(o.cost) / double(o.evaluated) / decisive
+                                   : std::numeric_limits<double>::infinity();
+        }
+        std::vector<size_t> order(recorded.size());
+        for (size_t i = 0; i < order.size(); i++) {
+            order[i] = i;
+        }
+        for (size_t begin = 0; begin < order.size();) {
+            auto end = begin;
+            while (end < order.size() && movable[end]) {
+                end++;
+            }
+            std::stable_sort(order.begin() + begin, order.begin() + end,
+                             [&](size_t x, size_t y) { return rank[x] < rank[y]; });
+            begin = end + 1;
+        }
+        if (std::is_sorted(order.begin(), order.end())) {
+            return std::nullopt;
+        }
+        return order;
+    }
+
+    /**
+     * @brief rebuild chain as "((o0 op o1) op o2) ...", reusing its operators
+     *
+     * @param chain chain
+     * @param order new order of operands
+     */
+    void rebuild(ShortCutChains::Chain &chain, const std::vector<size_t> &order) {
+        std::vector<std::unique_ptr<ExprAST>> operands;
+        for (auto &operand : chain.operands) {
+            operands.push_back(std::move(ShortCutChains::slotOf(operand)));
+        }
+        // operators of chain, the outermost first, they are owned by the root slot and by each other
+        std::vector<std::unique_ptr<ExprAST>> operators;
+        operators.push_back(std::move(*chain.root));
+        for (size_t i = 0; i < operators.size(); i++) {
+            auto p = static_cast<BinOpExprAST *>(operators[i].get());
+            for (auto *child : {&(p->lhs), &(p->rhs)}) {
+                if (*child) {
+                    operators.push_back(std::move(*child));
+                }
+            }
+        }
+        auto acc = std::move(operands[order[0]]);
+        for (size_t i = 1; i < order.size(); i++) {
+            auto p = static_cast<BinOpExprAST *>(operators[i - 1].get());
+            p->lhs = std::move(acc);
+            p->rhs = std::move(operands[order[i]]);
+            acc = std::move(operators[i - 1]);
+        }
+        *chain.root = std::move(acc);
+        chain.operands.clear();
+    }
+
+    /**
+     * @brief check if operand can be evaluated earlier or skipped: no side effects, and never fails at runtime
+     *
+     * @param expr operand
+     * @return bool
+     */
+    bool canMove(ExprAST *expr) {
+        if (dynamic_cast<IdentifierExprAST *>(expr) || dynamic_cast<LiteralExprAST *>(expr)) {
+            return true;
+        }
+        if (auto p = dynamic_cast<MemberAccessExprAST *>(expr); p) {
+            // struct member rather than array element
+            auto token = dynamic_cast<LiteralExprAST *>(p->memberToken.get());
+            return token && *(token->type) == StringType && canMove(p->baseVar.get());
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr); p) {
+            return canMove(p->rhs.get());
+        }
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr); p) {
+            return p->op != "=" && p->op != "%" && canMove(p->lhs.get()) && canMove(p->rhs.get());
+        }
+        if (auto p = dynamic_cast<BranchExprAST *>(expr); p) {
+            if (auto lazy = lazyTemporary(p); lazy) {
+                return canMove(lazy);
+            }
+            return canMove(p->condition.get()) && canMove(p->trueExpr.get()) && canMove(p->falseExpr.get());
+        }
+        if (auto p = dynamic_cast<BlockExprAST *>(expr); p) {
+            return std::ranges::all_of(p->exprs, [this](auto &e) { return canMove(e.get()); });
+        }
+        if (auto p = dynamic_cast<FunctionCallExprAST *>(expr); p) {
+            // build-in functions only, user functions may fail inside
+            auto func = dynamic_cast<LiteralExprAST *>(p->functionIdent.get());
+            return func && !global.realFuncDefinition.contains(func->value) && functions.isPure(func->value) &&
+                   std::ranges::all_of(p->params, [this](auto &e) { return canMove(e.get()); });
+        }
+        return false;
+    }
+
+    /**
+     * @brief match lazy temporary of ConditionCSE, "if(_cseN_ready) _cseN else {_cseN = expr; _cseN_ready = 1; _cseN}",
+     * which writes nothing but its own temporaries, so moving it only changes where expr is evaluated first
+     *
+     * @param p branch
+     * @return ExprAST* expr, nullptr if not matched
+     */
+    static ExprAST *lazyTemporary(BranchExprAST *p) {
+        auto ready = dynamic_cast<IdentifierExprAST *>(p->condition.get());
+        auto name = dynamic_cast<IdentifierExprAST *>(p->trueExpr.get());
+        auto block = dynamic_cast<BlockExprAST *>(p->falseExpr.get());
+        if (!ready || !name || !block || !name->name.starts_with("_cse") || ready->name != name->name + "_ready" ||
+            block->exprs.size() != 3) {
+            return nullptr;
+        }
+        auto isVar = [](ExprAST *expr, const std::string &var) {
+            auto q = dynamic_cast<IdentifierExprAST *>(expr);
+            return q && q->name == var;
+        };
+        auto value = dynamic_cast<BinOpExprAST *>(block->exprs[0].get());
+        auto flag = dynamic_cast<BinOpExprAST *>(block->exprs[1].get());
+        if (!value || value->op != "=" || !isVar(value->lhs.get(), name->name) || !flag || flag->op != "=" ||
+            !isVar(flag->lhs.get(), ready->name) || !dynamic_cast<LiteralExprAST *>(flag->rhs.get()) ||
+            !isVar(block->exprs[2].get(), name->name)) {
+            return nullptr;
+        }
+        return value->rhs.get();
+    }
+
+    const ContextGlobal &global;
+    PureFunctionTable functions;
+    const SelectivityProfile &profile;
+    /// @brief reordered chains
+    std::vector<std::string> report;
+};
+
+} // namespace rulejit::ruleset
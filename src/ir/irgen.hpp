@@ -6,38 +6,77 @@
  *
  * @details Includes IRGenerator, a class used to generate IR from AST
  *
+ * Resolved subrulesets and user functions are lowered into LLVM IR over the flat data segment laid out by
+ * cq::ByteCodeProgram, with the same semantics as cq::CQByteCodeGenerator, so the same data segment mapping
+ * (cq::CQDataSegment) is used to run them natively.
+ *
  * @par history
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-28</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Lower resolved subrulesets and user functions.</td></tr>
  * </table>
  */
 #pragma once
 
+#include <cstdint>
 #include <format>
 #include <memory>
+#include <optional>
+#include <set>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
 
 #include "ast/ast.hpp"
 #include "ast/astvisitor.hpp"
 #include "ast/context.hpp"
+#include "ast/type.hpp"
+#include "backend/cq/cqbytecode.hpp"
+#include "backend/cq/cqinterpreter.hpp"
+#include "backend/cq/cqresolver.hpp"
 #include "ir/irholder.hpp"
+#include "tools/myassert.hpp"
 #include "tools/seterror.hpp"
 
 namespace rulejit::ir {
 
 /**
  * @brief Class for generate LLVM-IR from AST
+ * @attention ast must be piped through cq::CQResolver before generate
+ *
+ * Subruleset is lowered into `double name(i8 *segment, i8 *failed)`, user function into
+ * `double name(i8 *failed, double...)`. A function sets *failed and returns at once when it fails at runtime
+ * (same as ByteCodeVM, e.g. integer mod by zero), then the tick should be executed by cq::CQInterpreter.
  *
  */
 struct IRGenerator : public ASTVisitor {
+    /**
+     * @brief subruleset lowered to IR
+     *
+     */
+    struct Lowered {
+        /// @brief symbol of function in module
+        std::string symbol;
+        /// @brief variables read or written by the function
+        std::vector<const cq::ByteCodeProgram::ExternVar *> externs;
+        /// @brief access flag offset in data segment of each writable one in externs
+        std::vector<std::optional<size_t>> flags;
+    };
 
     /**
      * @brief Construct a new IRGenerator object
      *
      * @param holder IRHolder which holds the generated IR
      * @param context ContextStack which provides IR generation context
+     * @param pool literals pre-parsed by CQResolver
+     * @param program layout of data segment
      */
-    IRGenerator(IRHolder &holder, ContextStack &context) : h(holder), c(context) {}
+    IRGenerator(IRHolder &holder, ContextStack &context, const cq::ConstantPool &pool,
+                const cq::ByteCodeProgram &program)
+        : h(holder), c(context), constantPool(pool), program(program), states(), functions(), externs(),
+          value(nullptr), reason() {}
     IRGenerator(const IRGenerator &) = delete;
     IRGenerator(IRGenerator &&) = delete;
     IRGenerator &operator=(const IRGenerator &) = delete;
@@ -45,51 +84,667 @@ struct IRGenerator : public ASTVisitor {
 
     /**
      * @brief pipe operator| used to generate function def in ContextGlobal
-     * @attention function must have checked
+     * @attention function must have checked and resolved
      *
      * @param src real function name need to be generated
      * @param irgen receiver
      */
     void friend operator|(std::string &src, IRGenerator &irgen) {
-        if (irgen.generatedFunc.contains(src)) {
-            return;
-        }
         auto &global = irgen.c.global;
         if (auto it = global.realFuncDefinition.find(src);
             it != global.realFuncDefinition.end() && global.checkedFunc.contains(it->first)) {
-            irgen.generate(it->first, it->second);
+            irgen.generateFunction(it->first, *(it->second));
         } else {
             irgen.setError("No such function or maybe unchecked: " + src);
         }
     }
 
+    /**
+     * @brief lower subruleset into function of module in holder
+     * @attention module should be dropped if failed, functions may be left unfinished
+     *
+     * @param expr subruleset
+     * @param name unique symbol of subruleset
+     * @return std::optional<Lowered> nullopt if subruleset can not be lowered, see getReason()
+     */
+    std::optional<Lowered> generate(std::unique_ptr<ExprAST> &expr, const std::string &name) {
+        externs.clear();
+        auto &ctx = *h.context;
+        auto ptr = llvm::Type::getInt8PtrTy(ctx);
+        auto type = llvm::FunctionType::get(llvm::Type::getDoubleTy(ctx), {ptr, ptr}, false);
+        auto func = llvm::Function::Create(type, llvm::Function::ExternalLinkage, name, *h.module);
+        try {
+            begin(func, func->getArg(0), func->getArg(1));
+            auto ret = emitValue(expr);
+            h.builder->CreateRet(ret);
+            end();
+        } catch (std::logic_error &e) {
+            states.clear();
+            reason = e.what();
+            return std::nullopt;
+        }
+        std::string err;
+        llvm::raw_string_ostream os(err);
+        if (llvm::verifyFunction(*func, &os)) {
+            reason = "verify failed: " + name + "\n" + os.str();
+            return std::nullopt;
+        }
+        Lowered ret{name, {}, {}};
+        for (auto &[var, flag] : externs) {
+            ret.externs.push_back(var);
+            ret.flags.push_back(flag);
+        }
+        return ret;
+    }
+
+    /**
+     * @brief get reason why last generate failed
+     *
+     * @return const std::string&
+     */
+    const std::string &getReason() { return reason; }
+
   protected:
-    VISIT_FUNCTION(IdentifierExprAST) {}
-    VISIT_FUNCTION(MemberAccessExprAST) {}
-    VISIT_FUNCTION(LiteralExprAST) {}
-    VISIT_FUNCTION(FunctionCallExprAST) {}
-    VISIT_FUNCTION(BinOpExprAST) {}
-    VISIT_FUNCTION(UnaryOpExprAST) {}
-    VISIT_FUNCTION(BranchExprAST) {}
-    VISIT_FUNCTION(ComplexLiteralExprAST) {}
-    VISIT_FUNCTION(LoopAST) {}
-    VISIT_FUNCTION(BlockExprAST) {}
+    VISIT_FUNCTION(IdentifierExprAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before generate");
+        if (v.resolved == cq::CQResolver::externalVar) {
+            value = emitExternLoad(externPath(v));
+        } else {
+            value = h.builder->CreateLoad(h.builder->getDoubleTy(), slot(v.resolved));
+        }
+    }
+    VISIT_FUNCTION(MemberAccessExprAST) { value = emitExternLoad(externPath(v)); }
+    VISIT_FUNCTION(LiteralExprAST) {
+        if (!(*(v.type) == RealType)) {
+            setError("only numerical literal is supported");
+        }
+        value = number(v.resolved == ExprAST::unresolved ? std::stod(v.value) : constantPool.numbers[v.resolved]);
+    }
+    VISIT_FUNCTION(FunctionCallExprAST) {
+        using cq::CallCode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(cq::CQResolver::resolveCall(v));
+        }
+        auto code = static_cast<CallCode>(v.resolved);
+        if (code == CallCode::USER) {
+            value = emitUserCall(v);
+            return;
+        }
+        if (code < CallCode::RAND || code > CallCode::ATAN2) {
+            setError("only numerical function call is supported");
+        }
+        size_t paramCount = code == CallCode::RAND ? 0 : (code < CallCode::POW ? 1 : 2);
+        if (v.params.size() != paramCount) {
+            setError("wrong param count of build-in function");
+        }
+        std::vector<llvm::Value *> params;
+        for (auto &param : v.params) {
+            params.push_back(emitValue(param));
+        }
+        auto &b = *h.builder;
+        switch (code) {
+        case CallCode::FABS:
+        case CallCode::ABS:
+            value = b.CreateUnaryIntrinsic(llvm::Intrinsic::fabs, params[0]);
+            return;
+        case CallCode::FLOOR:
+            value = b.CreateUnaryIntrinsic(llvm::Intrinsic::floor, params[0]);
+            return;
+        case CallCode::SQRT:
+            value = b.CreateUnaryIntrinsic(llvm::Intrinsic::sqrt, params[0]);
+            return;
+        default:
+            break;
+        }
+        // others are called by address, so results are exactly the same as interpreter
+        void *address;
+        if (code == CallCode::RAND) {
+            address = reinterpret_cast<void *>(&cq::myrand);
+        } else if (code < CallCode::POW) {
+            address = reinterpret_cast<void *>(cq::buildInOneParamFunc[v.resolved - size_t(CallCode::SIN)]);
+        } else {
+            address = reinterpret_cast<void *>(cq::buildInTwoParamFunc[v.resolved - size_t(CallCode::POW)]);
+        }
+        std::vector<llvm::Type *> paramTypes(paramCount, b.getDoubleTy());
+        auto type = llvm::FunctionType::get(b.getDoubleTy(), paramTypes, false);
+        auto callee = b.CreateIntToPtr(b.getInt64(reinterpret_cast<uintptr_t>(address)), type->getPointerTo());
+        auto call = b.CreateCall(type, callee, params);
+        if (code != CallCode::RAND) {
+            call->setDoesNotAccessMemory();
+        }
+        value = call;
+    }
+    VISIT_FUNCTION(BinOpExprAST) {
+        using cq::BinOpCode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(cq::CQResolver::resolveBinOp(v.op));
+        }
+        auto &b = *h.builder;
+        auto code = static_cast<BinOpCode>(v.resolved);
+        switch (code) {
+        case BinOpCode::ASSIGN:
+            emitAssign(v);
+            value = nullptr;
+            return;
+        case BinOpCode::AND:
+        case BinOpCode::OR: {
+            // if shortcutted, result is lhs itself
+            auto lhs = emitValue(v.lhs);
+            auto lhsEnd = b.GetInsertBlock();
+            auto rhsBegin = block("rhs");
+            auto merge = block("shortcut");
+            if (code == BinOpCode::AND) {
+                b.CreateCondBr(truth(lhs), rhsBegin, merge);
+            } else {
+                b.CreateCondBr(truth(lhs), merge, rhsBegin);
+            }
+            b.SetInsertPoint(rhsBegin);
+            auto rhs = toNumber(truth(emitValue(v.rhs)));
+            auto rhsEnd = b.GetInsertBlock();
+            b.CreateBr(merge);
+            b.SetInsertPoint(merge);
+            auto phi = b.CreatePHI(b.getDoubleTy(), 2);
+            phi->addIncoming(lhs, lhsEnd);
+            phi->addIncoming(rhs, rhsEnd);
+            value = phi;
+            return;
+        }
+        case BinOpCode::MOD: {
+            // same as interpreter, operands are truncated
+            auto lhs = b.CreateFPToSI(emitValue(v.lhs), b.getInt64Ty());
+            auto rhs = b.CreateFPToSI(emitValue(v.rhs), b.getInt64Ty());
+            auto ok = block("mod");
+            b.CreateCondBr(b.CreateICmpEQ(rhs, b.getInt64(0)), failBlock(), ok);
+            b.SetInsertPoint(ok);
+            value = b.CreateSIToFP(b.CreateSRem(lhs, rhs), b.getDoubleTy());
+            return;
+        }
+        case BinOpCode::UNKNOWN:
+            setError(std::format("bin op \"{}\" not support for now", v.op));
+        default:
+            break;
+        }
+        auto lhs = emitValue(v.lhs);
+        auto rhs = emitValue(v.rhs);
+        switch (code) {
+        case BinOpCode::ADD:
+            value = b.CreateFAdd(lhs, rhs);
+            break;
+        case BinOpCode::SUB:
+            value = b.CreateFSub(lhs, rhs);
+            break;
+        case BinOpCode::MUL:
+            value = b.CreateFMul(lhs, rhs);
+            break;
+        case BinOpCode::DIV:
+            value = b.CreateFDiv(lhs, rhs);
+            break;
+        default:
+            value = toNumber(compare(code, lhs, rhs));
+        }
+    }
+    VISIT_FUNCTION(UnaryOpExprAST) {
+        using cq::UnaryOpCode;
+        if (v.resolved == ExprAST::unresolved) {
+            v.resolved = static_cast<size_t>(cq::CQResolver::resolveUnaryOp(v.op));
+        }
+        switch (static_cast<UnaryOpCode>(v.resolved)) {
+        case UnaryOpCode::NEG:
+            value = h.builder->CreateFNeg(emitValue(v.rhs));
+            break;
+        case UnaryOpCode::NOT:
+            // -0.0 is false as well
+            value = toNumber(h.builder->CreateFCmpOEQ(emitValue(v.rhs), number(0)));
+            break;
+        default:
+            setError(std::format("unary op \"{}\" not support for now", v.op));
+        }
+    }
+    VISIT_FUNCTION(BranchExprAST) {
+        auto &b = *h.builder;
+        auto trueBegin = block("then");
+        auto falseBegin = block("else");
+        auto merge = block("endif");
+        emitCondition(v.condition, trueBegin, falseBegin);
+        b.SetInsertPoint(trueBegin);
+        auto trueValue = emitAny(v.trueExpr);
+        auto trueEnd = b.GetInsertBlock();
+        b.CreateBr(merge);
+        b.SetInsertPoint(falseBegin);
+        auto falseValue = emitAny(v.falseExpr);
+        auto falseEnd = b.GetInsertBlock();
+        b.CreateBr(merge);
+        b.SetInsertPoint(merge);
+        if ((trueValue == nullptr) != (falseValue == nullptr)) {
+            setError("branches return different kind of value");
+        }
+        value = nullptr;
+        if (trueValue) {
+            auto phi = b.CreatePHI(b.getDoubleTy(), 2);
+            phi->addIncoming(trueValue, trueEnd);
+            phi->addIncoming(falseValue, falseEnd);
+            value = phi;
+        }
+    }
+    VISIT_FUNCTION(ComplexLiteralExprAST) { setError("complex literal is not supported"); }
+    VISIT_FUNCTION(LoopAST) {
+        auto &b = *h.builder;
+        // same as interpreter, loop returns the last (false) condition
+        emitStatement(v.init);
+        auto header = block("loop");
+        auto body = block("body");
+        auto exit = block("endloop");
+        b.CreateBr(header);
+        b.SetInsertPoint(header);
+        auto condition = emitValue(v.condition);
+        b.CreateCondBr(truth(condition), body, exit);
+        b.SetInsertPoint(body);
+        emitStatement(v.body);
+        b.CreateBr(header);
+        b.SetInsertPoint(exit);
+        value = condition;
+    }
+    VISIT_FUNCTION(BlockExprAST) {
+        llvm::Value *ret = nullptr;
+        for (size_t i = 0; i < v.exprs.size(); i++) {
+            if (i + 1 == v.exprs.size()) {
+                ret = emitAny(v.exprs[i]);
+            } else {
+                emitStatement(v.exprs[i]);
+            }
+        }
+        value = ret;
+    }
     VISIT_FUNCTION(ControlFlowAST) { setError("ControlFlowAST not supported for now"); }
     VISIT_FUNCTION(TypeDefAST) { setError("TypeDefAST should not be visited"); }
-    VISIT_FUNCTION(VarDefAST) {}
+    VISIT_FUNCTION(VarDefAST) {
+        my_assert(v.resolved != ExprAST::unresolved, "ast should be resolved before generate");
+        if (v.resolved == cq::CQResolver::redefinedVar) {
+            setError("redefine variable: " + v.name);
+        }
+        h.builder->CreateStore(emitValue(v.definedValue), slot(v.resolved));
+        value = nullptr;
+    }
     VISIT_FUNCTION(FunctionDefAST) { setError("FunctionDefAST should not be visited"); }
     VISIT_FUNCTION(SymbolDefAST) { setError("SymbolDefAST should not be visited"); }
 
   private:
+    using ExternVar = cq::ByteCodeProgram::ExternVar;
+    using TypeLayout = cq::ByteCodeProgram::TypeLayout;
+
+    /**
+     * @brief function being generated
+     *
+     */
+    struct State {
+        llvm::Function *func;
+        /// @brief data segment, nullptr if function can not access DataStore
+        llvm::Value *segment;
+        /// @brief flag set when failed at runtime
+        llvm::Value *failed;
+        /// @brief block setting failed, created when needed
+        llvm::BasicBlock *fail;
+        /// @brief local variables, allocated at entry when used
+        std::vector<llvm::AllocaInst *> slots;
+        /// @brief insert point of caller
+        llvm::IRBuilderBase::InsertPoint caller;
+    };
+
+    State &current() { return states.back(); }
+
+    void begin(llvm::Function *func, llvm::Value *segment, llvm::Value *failed) {
+        auto caller = h.builder->saveIP();
+        states.push_back(State{func, segment, failed, nullptr, {}, caller});
+        h.builder->SetInsertPoint(llvm::BasicBlock::Create(*h.context, "entry", func));
+    }
+    void end() {
+        h.builder->restoreIP(current().caller);
+        states.pop_back();
+    }
+
+    llvm::BasicBlock *block(const std::string &name) {
+        return llvm::BasicBlock::Create(*h.context, name, current().func);
+    }
+    llvm::BasicBlock *failBlock() {
+        auto &s = current();
+        if (!s.fail) {
+            s.fail = block("fail");
+            llvm::IRBuilder<> b(s.fail);
+            b.CreateStore(b.getInt8(1), s.failed);
+            b.CreateRet(llvm::ConstantFP::get(b.getDoubleTy(), 0.0));
+        }
+        return s.fail;
+    }
+
+    llvm::Value *number(double x) { return llvm::ConstantFP::get(h.builder->getDoubleTy(), x); }
+    /// @brief i1 -> 1.0 or 0.0
+    llvm::Value *toNumber(llvm::Value *x) { return h.builder->CreateUIToFP(x, h.builder->getDoubleTy()); }
+    /// @brief F64 -> i1, NaN is true and -0.0 is false, same as BEZ/BNZ of ByteCodeVM
+    llvm::Value *truth(llvm::Value *x) { return h.builder->CreateFCmpUNE(x, number(0)); }
+
+    llvm::Value *compare(cq::BinOpCode code, llvm::Value *lhs, llvm::Value *rhs) {
+        using cq::BinOpCode;
+        auto &b = *h.builder;
+        switch (code) {
+        case BinOpCode::GT:
+            return b.CreateFCmpOGT(lhs, rhs);
+        case BinOpCode::LT:
+            return b.CreateFCmpOLT(lhs, rhs);
+        case BinOpCode::EQ:
+            return b.CreateFCmpOEQ(lhs, rhs);
+        case BinOpCode::NE:
+            return b.CreateFCmpUNE(lhs, rhs);
+        case BinOpCode::GE:
+            return b.CreateFCmpOGE(lhs, rhs);
+        case BinOpCode::LE:
+            return b.CreateFCmpOLE(lhs, rhs);
+        default:
+            my_assert(false, "unreachable");
+            return nullptr;
+        }
+    }
+    static bool isCompare(cq::BinOpCode code) { return code >= cq::BinOpCode::GT && code <= cq::BinOpCode::LE; }
+
+    /// @brief alloca of local variable, initialized as 0 at entry
+    llvm::AllocaInst *slot(size_t index) {
+        auto &s = current();
+        if (s.slots.size() <= index) {
+            s.slots.resize(index + 1, nullptr);
+        }
+        if (!s.slots[index]) {
+            auto &entry = s.func->getEntryBlock();
+            llvm::IRBuilder<> b(&entry, entry.begin());
+            s.slots[index] = b.CreateAlloca(b.getDoubleTy());
+            b.CreateStore(llvm::ConstantFP::get(b.getDoubleTy(), 0.0), s.slots[index]);
+        }
+        return s.slots[index];
+    }
+
+    llvm::Value *emitAny(std::unique_ptr<ExprAST> &expr) {
+        if (!expr) {
+            return nullptr;
+        }
+        expr->accept(this);
+        return value;
+    }
+    /// @brief returns one F64
+    llvm::Value *emitValue(std::unique_ptr<ExprAST> &expr) {
+        auto ret = emitAny(expr);
+        if (!ret) {
+            setError("expression returns no numerical value");
+        }
+        return ret;
+    }
+    void emitStatement(std::unique_ptr<ExprAST> &expr) { emitAny(expr); }
+
+    /**
+     * @brief evaluate expression as condition and branch, shortcut and compare branch directly without making F64
+     *
+     * @param expr condition
+     * @param whenTrue target when true
+     * @param whenFalse target when false
+     */
+    void emitCondition(std::unique_ptr<ExprAST> &expr, llvm::BasicBlock *whenTrue, llvm::BasicBlock *whenFalse) {
+        using cq::BinOpCode;
+        auto &b = *h.builder;
+        if (auto p = dynamic_cast<BinOpExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(cq::CQResolver::resolveBinOp(p->op));
+            }
+            auto code = static_cast<BinOpCode>(p->resolved);
+            if (code == BinOpCode::AND || code == BinOpCode::OR) {
+                // truth of shortcut value is same as truth of the whole expression
+                auto rhs = block(code == BinOpCode::AND ? "and" : "or");
+                if (code == BinOpCode::AND) {
+                    emitCondition(p->lhs, rhs, whenFalse);
+                } else {
+                    emitCondition(p->lhs, whenTrue, rhs);
+                }
+                b.SetInsertPoint(rhs);
+                emitCondition(p->rhs, whenTrue, whenFalse);
+                return;
+            }
+            if (isCompare(code)) {
+                auto lhs = emitValue(p->lhs);
+                auto rhs = emitValue(p->rhs);
+                b.CreateCondBr(compare(code, lhs, rhs), whenTrue, whenFalse);
+                return;
+            }
+        }
+        if (auto p = dynamic_cast<UnaryOpExprAST *>(expr.get())) {
+            if (p->resolved == ExprAST::unresolved) {
+                p->resolved = static_cast<size_t>(cq::CQResolver::resolveUnaryOp(p->op));
+            }
+            if (static_cast<cq::UnaryOpCode>(p->resolved) == cq::UnaryOpCode::NOT) {
+                emitCondition(p->rhs, whenFalse, whenTrue);
+                return;
+            }
+        }
+        b.CreateCondBr(truth(emitValue(expr)), whenTrue, whenFalse);
+    }
+
+    /**
+     * @brief get position of variable or member of variable in data segment
+     *
+     * @param v identifier of external variable, or member access on it
+     * @return std::tuple<const ExternVar *, size_t, const TypeLayout *> {variable, offset, layout of the value}
+     */
+    std::tuple<const ExternVar *, size_t, const TypeLayout *> externPath(ExprAST &v) {
+        if (!current().segment) {
+            setError("function can not access variable in DataStore");
+        }
+        if (auto p = dynamic_cast<IdentifierExprAST *>(&v)) {
+            if (p->resolved != cq::CQResolver::externalVar) {
+                setError("member access of local variable is not supported");
+            }
+            auto it = program.externVars.find(p->name);
+            if (it == program.externVars.end()) {
+                setError("variable can not be mapped onto data segment: " + p->name);
+            }
+            return {&it->second, it->second.offset, it->second.layout};
+        }
+        auto p = dynamic_cast<MemberAccessExprAST *>(&v);
+        if (!p || !p->baseVar) {
+            setError("only member access on variable is supported");
+        }
+        auto [var, offset, layout] = externPath(*p->baseVar);
+        auto member = dynamic_cast<LiteralExprAST *>(p->memberToken.get());
+        if (!member || !(*(member->type) == StringType) || layout->kind != TypeLayout::Kind::STRUCT) {
+            setError("only struct member access is supported");
+        }
+        for (auto &[name, memberOffset, memberLayout] : layout->members) {
+            if (name == member->value) {
+                return {var, offset + memberOffset, memberLayout};
+            }
+        }
+        setError("unknown member: " + member->value);
+    }
+
+    /// @brief pointer to offset of data segment
+    llvm::Value *address(size_t offset, llvm::Type *type) {
+        auto &b = *h.builder;
+        auto p = b.CreateConstInBoundsGEP1_64(b.getInt8Ty(), current().segment, offset);
+        return b.CreatePointerCast(p, type->getPointerTo());
+    }
+
+    /// @brief mark variable accessed in this run, same as ResourceHandler::readIn
+    void touch(const ExternVar *var) {
+        auto [it, inserted] = externs.try_emplace(var, std::nullopt);
+        if (inserted && var->writable) {
+            size_t cnt = 0;
+            for (auto &[_, flag] : externs) {
+                cnt += flag.has_value();
+            }
+            it->second = program.flagBase + cnt;
+        }
+        if (it->second.has_value()) {
+            h.builder->CreateStore(h.builder->getInt8(1), address(it->second.value(), h.builder->getInt8Ty()));
+        }
+    }
+
+    /**
+     * @brief {memory type, memory is signed}
+     *
+     */
+    std::tuple<llvm::Type *, bool> memoryType(TypeLayout::Kind kind) {
+        using Kind = TypeLayout::Kind;
+        auto &b = *h.builder;
+        switch (kind) {
+        case Kind::BOOL:
+        case Kind::U8:
+            return {b.getInt8Ty(), false};
+        case Kind::I8:
+            return {b.getInt8Ty(), true};
+        case Kind::I16:
+            return {b.getInt16Ty(), true};
+        case Kind::U16:
+            return {b.getInt16Ty(), false};
+        case Kind::I32:
+            return {b.getInt32Ty(), true};
+        case Kind::U32:
+            return {b.getInt32Ty(), false};
+        case Kind::I64:
+            return {b.getInt64Ty(), true};
+        case Kind::U64:
+            return {b.getInt64Ty(), false};
+        case Kind::F32:
+            return {b.getFloatTy(), true};
+        default:
+            return {b.getDoubleTy(), true};
+        }
+    }
+
+    llvm::Value *emitExternLoad(std::tuple<const ExternVar *, size_t, const TypeLayout *> path) {
+        auto &b = *h.builder;
+        auto [var, offset, layout] = path;
+        if (!layout->isNumerical()) {
+            setError("only numerical variable is supported");
+        }
+        touch(var);
+        auto [type, isSigned] = memoryType(layout->kind);
+        llvm::Value *ret = b.CreateAlignedLoad(type, address(offset, type), llvm::MaybeAlign(1));
+        if (type->isFloatTy()) {
+            return b.CreateFPExt(ret, b.getDoubleTy());
+        }
+        if (type->isDoubleTy()) {
+            return ret;
+        }
+        // same as ByteCodeVM, loaded into I64/U64 register first
+        return isSigned ? b.CreateSIToFP(ret, b.getDoubleTy()) : b.CreateUIToFP(ret, b.getDoubleTy());
+    }
+
+    /// @brief store F64, converted same as ResourceHandler::writeValue
+    void emitExternStore(std::tuple<const ExternVar *, size_t, const TypeLayout *> path, llvm::Value *x) {
+        using Kind = TypeLayout::Kind;
+        auto &b = *h.builder;
+        auto [var, offset, layout] = path;
+        if (!layout->isNumerical()) {
+            setError("only numerical variable is supported");
+        }
+        touch(var);
+        auto [type, _] = memoryType(layout->kind);
+        if (layout->kind == Kind::BOOL) {
+            x = b.CreateZExt(truth(x), type);
+        } else if (type->isFloatTy()) {
+            x = b.CreateFPTrunc(x, type);
+        } else if (layout->kind == Kind::U64) {
+            x = b.CreateFPToUI(x, type);
+        } else if (!type->isDoubleTy()) {
+            x = b.CreateTrunc(b.CreateFPToSI(x, b.getInt64Ty()), type);
+        }
+        b.CreateAlignedStore(x, address(offset, type), llvm::MaybeAlign(1));
+    }
+
+    void emitAssign(BinOpExprAST &v) {
+        if (auto p = dynamic_cast<IdentifierExprAST *>(v.lhs.get());
+            p && p->resolved != cq::CQResolver::externalVar) {
+            my_assert(p->resolved != ExprAST::unresolved, "ast should be resolved before generate");
+            h.builder->CreateStore(emitValue(v.rhs), slot(p->resolved));
+            return;
+        }
+        if (!v.lhs) {
+            setError("only allow direct or member variable assignment for now");
+        }
+        auto path = externPath(*v.lhs);
+        emitExternStore(path, emitValue(v.rhs));
+    }
+
+    llvm::Value *emitUserCall(FunctionCallExprAST &v) {
+        auto &b = *h.builder;
+        auto name = dynamic_cast<LiteralExprAST *>(v.functionIdent.get())->value;
+        auto f = c.global.realFuncDefinition.find(name);
+        if (f == c.global.realFuncDefinition.end()) {
+            setError(std::format("function \"{}\" not found", name));
+        }
+        auto &callee = *(f->second);
+        if (v.params.size() != callee.params.size()) {
+            setError(std::format("wrong param count of function \"{}\"", name));
+        }
+        auto func = generateFunction(name, callee);
+        std::vector<llvm::Value *> params{current().failed};
+        for (auto &param : v.params) {
+            params.push_back(emitValue(param));
+        }
+        auto ret = b.CreateCall(func, params);
+        auto ok = block("call");
+        auto failed = b.CreateLoad(b.getInt8Ty(), current().failed);
+        b.CreateCondBr(b.CreateICmpNE(failed, b.getInt8(0)), failBlock(), ok);
+        b.SetInsertPoint(ok);
+        return ret;
+    }
+
+    /**
+     * @brief lower user function into module if not lowered
+     *
+     * @param name function name
+     * @param func function define
+     * @return llvm::Function*
+     */
+    llvm::Function *generateFunction(const std::string &name, FunctionDefAST &func) {
+        my_assert(func.resolved != ExprAST::unresolved, "function should be resolved before generate");
+        if (auto it = functions.find(&func); it != functions.end()) {
+            // lowered, or being lowered by recursion
+            return it->second;
+        }
+        auto &ctx = *h.context;
+        std::vector<llvm::Type *> paramTypes{llvm::Type::getInt8PtrTy(ctx)};
+        for (auto &param : func.params) {
+            if (!(*(param->type) == RealType || *(param->type) == IntType)) {
+                setError(std::format("function \"{}\" has non-numerical param", name));
+            }
+            paramTypes.push_back(llvm::Type::getDoubleTy(ctx));
+        }
+        auto type = llvm::FunctionType::get(llvm::Type::getDoubleTy(ctx), paramTypes, false);
+        // every module has its own copy, which is inlined mostly
+        auto ret = llvm::Function::Create(type, llvm::Function::InternalLinkage, name, *h.module);
+        functions.emplace(&func, ret);
+        begin(ret, nullptr, ret->getArg(0));
+        for (size_t i = 0; i < func.params.size(); i++) {
+            h.builder->CreateStore(ret->getArg(i + 1), slot(func.params[i]->resolved));
+        }
+        h.builder->CreateRet(emitValue(func.returnValue));
+        end();
+        return ret;
+    }
+
     IRHolder &h;
     ContextStack &c;
-    std::set<std::string> generatedFunc;
-    std::set<std::string> generatedVar;
+    /// @brief literals pre-parsed by CQResolver
+    const cq::ConstantPool &constantPool;
+    /// @brief layout of data segment
+    const cq::ByteCodeProgram &program;
+    /// @brief functions being generated, caller first
+    std::vector<State> states;
+    /// @brief user functions in module
+    std::unordered_map<FunctionDefAST *, llvm::Function *> functions;
+    /// @brief variables accessed by current subruleset -> access flag offset
+    std::unordered_map<const ExternVar *, std::optional<size_t>> externs;
+    /// @brief value of last visited expression, nullptr if it returns nothing
+    llvm::Value *value;
+    /// @brief reason why last generate failed
+    std::string reason;
 
-    void generate(const std::string &name, std::unique_ptr<FunctionDefAST> &ast) {
-    }
-    void allocateVar(){}
     SET_ERROR_MEMBER("IR Generate", void)
 };
 
-} // namespace rulejit::ir
\ No newline at end of file
+} // namespace rulejit::ir
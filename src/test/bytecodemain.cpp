@@ -10,6 +10,11 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-09-19</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Follow link-time context.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Benchmark switch and direct-threaded dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Benchmark register dispatch.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Benchmark superinstructions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Cast negative branch offsets to data of ByteCode.</td></tr>
  * </table>
  */
 #include <chrono>
@@ -58,6 +63,14 @@ int fib_cpp_tail(uint64_t n, uint64_t need_add) {
         return fib_cpp_tail(n - 2, fib_cpp_tail(n - 1, need_add));
 }
 
+double sum_cpp(double n) {
+    double sum = 0;
+    for (double i = 0; i < n; i += 1) {
+        sum += i * 0.5;
+    }
+    return sum;
+}
+
 int main() {
     using namespace std;
     using namespace bytecode;
@@ -78,8 +91,9 @@ int main() {
                        ByteCode{OPCode::RET, DataType::NONE, 1},
                    },
                    {sf1, 16},
-                   {"add2u"},
-                   {0}};
+                   {0, {}},
+                   {2},
+                   {"add2u"}};
     Function add2f{{
                        ByteCode{OPCode::STORE_VAR, DataType::F64, 8},
                        ByteCode{OPCode::STORE_VAR, DataType::F64, 0},
@@ -89,14 +103,15 @@ int main() {
                        ByteCode{OPCode::RET, DataType::NONE, 1},
                    },
                    {sf1, 16},
-                   {"add2f"},
-                   {0}};
+                   {0, {}},
+                   {2},
+                   {"add2f"}};
     Function fib{{
                      ByteCode{OPCode::STORE_VAR, DataType::U64, 0},
                      ByteCode{OPCode::LOAD_IMM, DataType::NONE, 1},
                      ByteCode{OPCode::LOAD_VAR, DataType::U64, 0},
                      ByteCode{OPCode::BIN_OP, DataType::U64, BinaryOP::GE},
-                     ByteCode{OPCode::BEZ, DataType::NONE, 7},
+                     ByteCode{OPCode::BEZ, DataType::NONE, 2},
                      ByteCode{OPCode::LOAD_IMM, DataType::NONE, 1},
                      ByteCode{OPCode::RET, DataType::NONE, 1},
                      // LABEL:
@@ -114,8 +129,9 @@ int main() {
                      ByteCode{OPCode::RET, DataType::NONE, 1},
                  },
                  {m.addDefinition("fib@frame", StructInfo{{"n", "u64"}}), 8},
-                 {"fib"},
-                 {0}};
+                 {1, {}},
+                 {2},
+                 {"fib"}};
     Function fib2{{
                      ByteCode{OPCode::STORE_VAR, DataType::U64, 0},
                      ByteCode{OPCode::LOAD_IMM, DataType::NONE, 1},
@@ -134,36 +150,97 @@ int main() {
                      ByteCode{OPCode::LOAD_VAR, DataType::U64, 0},
                      ByteCode{OPCode::LOAD_IMM, DataType::NONE, 2},
                      ByteCode{OPCode::BIN_OP, DataType::U64, BinaryOP::SUB},
-                     ByteCode{OPCode::BRANCH, DataType::NONE, -17},
+                     ByteCode{OPCode::BRANCH, DataType::NONE, static_cast<uint16_t>(ByteCode::TypedData{-17})},
                  },
                  {m.addDefinition("fib2@frame", StructInfo{{"n", "u64"}, {"need_add", "u64"}}), 16},
-                 {"fib"},
-                 {0}};
+                 {1, {}},
+                 {2},
+                 {"fib2"}};
+
+    // (n) -> sum of i * 0.5 for i in [0, n), arithmetic loop without call
+    Function sum{{
+                     ByteCode{OPCode::STORE_VAR, DataType::F64, 0},
+                     ByteCode{OPCode::LOAD_CONST, DataType::F64, 0},
+                     ByteCode{OPCode::STORE_VAR, DataType::F64, 8},
+                     ByteCode{OPCode::LOAD_CONST, DataType::F64, 0},
+                     ByteCode{OPCode::STORE_VAR, DataType::F64, 16},
+                     // LOOP:
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 8},
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 0},
+                     ByteCode{OPCode::BIN_OP, DataType::F64, BinaryOP::LT},
+                     ByteCode{OPCode::BEZ, DataType::NONE, 11},
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 16},
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 8},
+                     ByteCode{OPCode::LOAD_CONST, DataType::F64, 16},
+                     ByteCode{OPCode::BIN_OP, DataType::F64, BinaryOP::MUL},
+                     ByteCode{OPCode::BIN_OP, DataType::F64, BinaryOP::ADD},
+                     ByteCode{OPCode::STORE_VAR, DataType::F64, 16},
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 8},
+                     ByteCode{OPCode::LOAD_CONST, DataType::F64, 8},
+                     ByteCode{OPCode::BIN_OP, DataType::F64, BinaryOP::ADD},
+                     ByteCode{OPCode::STORE_VAR, DataType::F64, 8},
+                     ByteCode{OPCode::BRANCH, DataType::NONE, static_cast<uint16_t>(ByteCode::TypedData{-15})},
+                     // END:
+                     ByteCode{OPCode::LOAD_VAR, DataType::F64, 16},
+                     ByteCode{OPCode::RET, DataType::NONE, 1},
+                 },
+                 {m.addDefinition("sum@frame", StructInfo{{"n", "f64"}, {"i", "f64"}, {"sum", "f64"}}), 24},
+                 {0, {bit_cast<MemUnit>(0.0), bit_cast<MemUnit>(1.0), bit_cast<MemUnit>(0.5)}},
+                 {2},
+                 {"sum"}};
 
     cout << fib2.decompile();
 
     auto func = vm.getFunc<int(int, int)>(vm.loadFunction(move(add2u)));
     auto func2 = vm.getFunc<double(double, double)>(vm.loadFunction(move(add2f)));
     auto func3 = vm.getFuncUnsafe<uint64_t(uint64_t)>(vm.loadFunction(move(fib)));
-    auto func4 = vm.getFunc<uint64_t(uint64_t, uint64_t)>(vm.loadFunction(move(fib2)));
+    auto func4 = vm.getFunc<double(double)>(vm.loadFunction(move(sum)));
+    // fib2 reuses caller's register stack as accumulator, which is not allowed since frames are isolated
     // cout << func(4, 5).value() << endl;
     // cout << func2(10.2, 0.3).value() << endl;
 
     constexpr uint64_t input = 20;
 
     auto start1 = high_resolution_clock::now();
-    for(int i = 0; i < 10; ++i)if(fib_cpp_tail(input, 0) != 10946)cout << "err";
+    for(int i = 0; i < 10; ++i)if(fib_cpp(input) != 10946)cout << "err";
     auto end1 = high_resolution_clock::now();
     auto duration1 = duration_cast<nanoseconds>(end1 - start1);
 
     auto start2 = high_resolution_clock::now();
-    for(int i = 0; i < 10; ++i)if(func4(input, 0) != 10946)cout << "err";
+    for(int i = 0; i < 10; ++i)if(func3(input) != 10946)cout << "err";
     auto end2 = high_resolution_clock::now();
     auto duration2 = duration_cast<nanoseconds>(end2 - start2);
 
     cout << duration1 / 10 << ": " << duration2 / 10 << endl;
     // seconds
 
+    // switch vs direct-threaded vs register dispatch, on call-heavy and arithmetic loop
+    constexpr double loop = 100000;
+    auto bench = [&](auto name, auto f, auto expected) {
+        for (auto [mode, modeName] : {pair{ByteCodeVM::Dispatch::SWITCH, "switch"},
+                                      pair{ByteCodeVM::Dispatch::THREADED, "threaded"},
+                                      pair{ByteCodeVM::Dispatch::REGISTER, "register"}}) {
+            vm.dispatch = mode;
+            auto start = high_resolution_clock::now();
+            for (int i = 0; i < 10; ++i)
+                if (f() != expected)
+                    cout << "err";
+            auto duration = duration_cast<nanoseconds>(high_resolution_clock::now() - start);
+            cout << std::format("{:<6} {:<10} {} ns", name, modeName, duration.count() / 10) << endl;
+        }
+    };
+    bench("fib", [&] { return func3(input); }, uint64_t{10946});
+    bench("sum", [&] { return func4(loop).value_or(-1); }, sum_cpp(loop));
+
+    // superinstructions selected by sequences recorded on the same workload
+    vm.dispatch = ByteCodeVM::Dispatch::PROFILE;
+    func3(input);
+    func4(loop);
+    auto profile = SequenceProfile::parse(vm.sequenceProfile.dump());
+    cout << vm.context.setSuperinstructions(profile.value()) << " superinstructions selected" << endl;
+    bench("fib+si", [&] { return func3(input); }, uint64_t{10946});
+    bench("sum+si", [&] { return func4(loop).value_or(-1); }, sum_cpp(loop));
+
 #ifdef __BYTECODE_VM_PROFILING__
     auto& pf = vm.profile["fib"].ins;
     for(int i = 0; i < pf.size(); ++i){
@@ -0,0 +1,178 @@
+/**
+ * @file cqbatchbenchmain.cpp
+ * @author djw
+ * @brief Test/CQ batch benchmark
+ * @date 2026-10-17
+ *
+ * @details Scaling benchmark of RuleSetBatch: many instances of one rule file are ticked once per frame with
+ * different counts of threads. Every run is fed with the same pseudo-random inputs, outputs are compared against
+ * the run on one thread after each frame.
+ *
+ * Counts of threads larger than TickThreadPool are capped, the count used is printed.
+ *
+ * usage: [CQ_BENCH_FILE=xml file] [CQ_BENCH_INSTANCES=instances] [CQ_BENCH_FRAMES=frames]
+ *        [CQ_BENCH_THREADS=n,n...] [CQ_BENCH_MODE=interpreter|closure|bytecode] cq_batch_bench
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "backend/cq/cqbatch.h"
+#include "tools/printcsvaluemap.hpp"
+
+namespace {
+
+using namespace rulejit;
+using namespace rulejit::cq;
+using CSValueMap = std::unordered_map<std::string, std::any>;
+
+/**
+ * @brief generate pseudo-random instance of given xml type, same as cq_bench
+ *
+ */
+std::any randomInstance(DataStore &data, std::mt19937_64 &rng, const std::string &type) {
+    if (data.isArray(type)) {
+        std::vector<std::any> ret;
+        for (size_t i = rng() % 4; i > 0; i--) {
+            ret.push_back(randomInstance(data, rng, data.arrayElementType(type)));
+        }
+        return ret;
+    }
+    if (type == "string") {
+        static const char *candidate[] = {"a", "b", "init", "AIM120"};
+        return std::string(candidate[rng() % 4]);
+    }
+    if (ruleset::baseNumericalData.contains(type)) {
+        double x = (rng() % 3 == 0) ? double(rng() % 3) : double(rng() % 60000) * ((rng() % 2) ? 1 : 0.01);
+        auto ret = data.makeTypeEmptyInstance(type);
+        if (ret.type() == typeid(bool)) {
+            return bool(rng() % 2);
+        } else if (ret.type() == typeid(double)) {
+            return x;
+        } else if (ret.type() == typeid(float)) {
+            return float(x);
+        } else if (ret.type() == typeid(int8_t)) {
+            return int8_t(int(x) % 100);
+        } else if (ret.type() == typeid(uint8_t)) {
+            return uint8_t(int(x) % 200);
+        } else if (ret.type() == typeid(int16_t)) {
+            return int16_t(x);
+        } else if (ret.type() == typeid(uint16_t)) {
+            return uint16_t(x);
+        } else if (ret.type() == typeid(int32_t)) {
+            return int32_t(x);
+        } else if (ret.type() == typeid(uint32_t)) {
+            return uint32_t(x);
+        } else if (ret.type() == typeid(int64_t)) {
+            return int64_t(x);
+        } else if (ret.type() == typeid(uint64_t)) {
+            return uint64_t(x);
+        }
+        return ret;
+    }
+    CSValueMap ret;
+    for (auto &[name, memberType] : data.metaInfo.typeDefines[type]) {
+        ret[name] = randomInstance(data, rng, memberType);
+    }
+    return ret;
+}
+
+} // namespace
+
+int main() {
+    // argv is not available since main is declared without params in cqinterpreter.hpp
+    auto fileEnv = std::getenv("CQ_BENCH_FILE");
+    auto instancesEnv = std::getenv("CQ_BENCH_INSTANCES");
+    auto framesEnv = std::getenv("CQ_BENCH_FRAMES");
+    auto threadsEnv = std::getenv("CQ_BENCH_THREADS");
+    auto modeEnv = std::getenv("CQ_BENCH_MODE");
+    std::string file = fileEnv ? fileEnv : __PROJECT_ROOT_PATH "/doc/test_xml/BVR1.0.xml";
+    size_t instances = instancesEnv ? std::stoull(instancesEnv) : 1000;
+    size_t frames = framesEnv ? std::stoull(framesEnv) : 100;
+    std::string_view threadList = threadsEnv ? threadsEnv : "1,2,4,8,16,32,64";
+    std::string_view modeName = modeEnv ? modeEnv : "bytecode";
+    auto mode = modeName == "interpreter" ? RuleSetEngine::ExecutionMode::INTERPRETER
+                : modeName == "closure"   ? RuleSetEngine::ExecutionMode::CLOSURE
+                                          : RuleSetEngine::ExecutionMode::BYTECODE;
+
+    RuleSetBatch batch;
+    auto buildStart = std::chrono::steady_clock::now();
+    try {
+        batch.buildFromFile(file, instances);
+    } catch (std::logic_error &e) {
+        std::cout << e.what() << std::endl;
+        return 0;
+    }
+    batch.setExecutionMode(mode);
+    std::cout << std::format(
+        "{} instances of {} in {} mode built in {:.3f} ms, {} threads in pool\n", instances, file, modeName,
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - buildStart).count(),
+        TickThreadPool::instance().size());
+
+    std::vector<std::string> reference;
+    // run with given count of threads, return time per frame
+    auto run = [&](size_t threads, size_t &failed, size_t &mismatch) {
+        batch.setThreads(threads);
+        batch.init();
+        std::mt19937_64 rng(42);
+        std::chrono::steady_clock::duration cost{};
+        for (size_t frame = 0; frame < frames; frame++) {
+            for (size_t i = 0; i < batch.size(); i++) {
+                auto &data = batch.instance(i).dataStorage;
+                CSValueMap input;
+                for (auto &var : data.metaInfo.inputVar) {
+                    input[var] = randomInstance(data, rng, data.metaInfo.varType[var]);
+                }
+                batch.setInput(i, input);
+            }
+            auto start = std::chrono::steady_clock::now();
+            failed += batch.tickAll();
+            cost += std::chrono::steady_clock::now() - start;
+            // hash of outputs of all instances in order of index
+            std::string result;
+            for (size_t i = 0; i < batch.size(); i++) {
+                result +=
+                    batch.getError(i) ? "[tick failed]" : tools::myany::printCSValueMapToString(*batch.getOutput(i));
+            }
+            auto hash = std::to_string(std::hash<std::string>()(result));
+            if (reference.size() <= frame) {
+                reference.push_back(std::move(hash));
+            } else if (reference[frame] != hash) {
+                mismatch++;
+            }
+        }
+        return std::chrono::duration<double, std::micro>(cost).count() / std::max<size_t>(frames, 1);
+    };
+
+    // warm up caches and allocator on one thread, which also records reference outputs
+    size_t failed = 0, mismatch = 0;
+    run(1, failed, mismatch);
+    double single = 0;
+    for (auto threadsText : threadList | std::views::split(',')) {
+        size_t threads = std::stoull(std::string(threadsText.begin(), threadsText.end()));
+        size_t steals = batch.getSteals();
+        failed = mismatch = 0;
+        double perFrame = run(threads, failed, mismatch);
+        if (single == 0) {
+            single = perFrame;
+        }
+        std::cout << std::format("{:>3} threads ({:>3} used) {:>12.3f} us/frame, speedup {:>6.2f}, {} steals, "
+                                 "{} instance ticks failed, {} frames mismatch\n",
+                                 threads, std::min(threads == 0 ? TickThreadPool::instance().size() : threads,
+                                                   TickThreadPool::instance().size()),
+                                 perFrame, single / perFrame, batch.getSteals() - steals, failed, mismatch);
+    }
+    return 0;
+}
@@ -0,0 +1,326 @@
+/**
+ * @file cqbenchmain.cpp
+ * @author djw
+ * @brief Test/CQ benchmark
+ * @date 2026-10-17
+ *
+ * @details A/B benchmark of RuleSetEngine execution modes on one rule file.
+ * Every mode is fed with the same pseudo-random inputs, outputs are compared against
+ * the interpreter after each tick.
+ *
+ * With CQ_BENCH_PROFILE, bytecode mode is also run with sequence profiling, whose profile is written to the file
+ * if it does not exist, otherwise superinstructions are selected by the file.
+ *
+ * With CQ_BENCH_SELECTIVITY, interpreter mode is also run with selectivity profiling, whose profile is written to
+ * the file if it does not exist, otherwise interpreter and bytecode mode are also run with "&&"/"||" reordered by it.
+ *
+ * Interpreter and bytecode mode are also run in incremental mode. With CQ_BENCH_HOLD=n, each input variable is
+ * regenerated once every n ticks, at different ticks for different variables, so subrulesets can be skipped.
+ *
+ * Interpreter mode is also run in parallel mode on all threads of TickThreadPool, and on each count of threads
+ * listed in CQ_BENCH_THREADS like "2,4,8". With CQ_BENCH_REPLICATE=n, subrulesets in the file are repeated n times,
+ * so rule sets with many subrulesets can be made from small files.
+ *
+ * Bytecode and jit mode are also run with typed storage of variables, whose conversion is done in setInput and
+ * getOutput, so both are timed with the tick in all modes.
+ *
+ * Jit and tiered mode are only run when built with CMake option RULEJIT_CQ_JIT.
+ *
+ * usage: [CQ_BENCH_FILE=xml file] [CQ_BENCH_TICKS=ticks] [CQ_BENCH_PROFILE=profile file]
+ *        [CQ_BENCH_SELECTIVITY=profile file] [CQ_BENCH_HOLD=n] [CQ_BENCH_THREADS=n,n...]
+ *        [CQ_BENCH_REPLICATE=n] cq_bench
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record and load sequence profile.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add jit mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add tiered mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Show count of folded expressions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Show count of shared subexpressions.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Record and load selectivity profile.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add incremental mode.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add parallel mode and replicated subrulesets.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Add typed storage modes, time setInput and getOutput with tick.</td></tr>
+ * </table>
+ */
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "backend/cq/cqrulesetengine.h"
+#include "tools/printcsvaluemap.hpp"
+
+namespace {
+
+using namespace rulejit;
+using namespace rulejit::cq;
+using CSValueMap = std::unordered_map<std::string, std::any>;
+
+/**
+ * @brief generate pseudo-random instance of given xml type
+ *
+ */
+std::any randomInstance(DataStore &data, std::mt19937_64 &rng, const std::string &type) {
+    if (data.isArray(type)) {
+        std::vector<std::any> ret;
+        for (size_t i = rng() % 4; i > 0; i--) {
+            ret.push_back(randomInstance(data, rng, data.arrayElementType(type)));
+        }
+        return ret;
+    }
+    if (type == "string") {
+        static const char *candidate[] = {"a", "b", "init", "AIM120"};
+        return std::string(candidate[rng() % 4]);
+    }
+    if (ruleset::baseNumericalData.contains(type)) {
+        double x = (rng() % 3 == 0) ? double(rng() % 3) : double(rng() % 60000) * ((rng() % 2) ? 1 : 0.01);
+        auto ret = data.makeTypeEmptyInstance(type);
+        if (ret.type() == typeid(bool)) {
+            return bool(rng() % 2);
+        } else if (ret.type() == typeid(double)) {
+            return x;
+        } else if (ret.type() == typeid(float)) {
+            return float(x);
+        } else if (ret.type() == typeid(int8_t)) {
+            return int8_t(int(x) % 100);
+        } else if (ret.type() == typeid(uint8_t)) {
+            return uint8_t(int(x) % 200);
+        } else if (ret.type() == typeid(int16_t)) {
+            return int16_t(x);
+        } else if (ret.type() == typeid(uint16_t)) {
+            return uint16_t(x);
+        } else if (ret.type() == typeid(int32_t)) {
+            return int32_t(x);
+        } else if (ret.type() == typeid(uint32_t)) {
+            return uint32_t(x);
+        } else if (ret.type() == typeid(int64_t)) {
+            return int64_t(x);
+        } else if (ret.type() == typeid(uint64_t)) {
+            return uint64_t(x);
+        }
+        return ret;
+    }
+    CSValueMap ret;
+    for (auto &[name, memberType] : data.metaInfo.typeDefines[type]) {
+        ret[name] = randomInstance(data, rng, memberType);
+    }
+    return ret;
+}
+
+/**
+ * @brief result of one tick, used to compare execution modes
+ *
+ */
+std::string snapshot(RuleSetEngine &engine) {
+    std::string ret = tools::myany::printCSValueMapToString(engine.getCache());
+    ret += tools::myany::printCSValueMapToString(*engine.getOutput());
+    for (auto hit : engine.hitRules()) {
+        ret += std::to_string(hit) + " ";
+    }
+    return ret;
+}
+
+/**
+ * @brief repeat content of <SubRuleSets> in xml source
+ *
+ */
+std::string replicate(const std::string &src, size_t n) {
+    auto begin = src.find("<SubRuleSets>"), end = src.find("</SubRuleSets>");
+    if (begin == std::string::npos || end == std::string::npos) {
+        return src;
+    }
+    begin += std::string_view("<SubRuleSets>").size();
+    std::string ret = src.substr(0, begin);
+    for (size_t i = 0; i < n; i++) {
+        ret += src.substr(begin, end - begin);
+    }
+    return ret + src.substr(end);
+}
+
+} // namespace
+
+int main() {
+    // argv is not available since main is declared without params in cqinterpreter.hpp
+    auto fileEnv = std::getenv("CQ_BENCH_FILE");
+    auto ticksEnv = std::getenv("CQ_BENCH_TICKS");
+    auto profileEnv = std::getenv("CQ_BENCH_PROFILE");
+    auto selectivityEnv = std::getenv("CQ_BENCH_SELECTIVITY");
+    auto holdEnv = std::getenv("CQ_BENCH_HOLD");
+    auto threadsEnv = std::getenv("CQ_BENCH_THREADS");
+    auto replicateEnv = std::getenv("CQ_BENCH_REPLICATE");
+    std::string file = fileEnv ? fileEnv : __PROJECT_ROOT_PATH "/doc/test_xml/BVR1.0.xml";
+    size_t ticks = ticksEnv ? std::stoull(ticksEnv) : 1000;
+    size_t hold = std::max<size_t>(holdEnv ? std::stoull(holdEnv) : 1, 1);
+
+    std::vector<std::tuple<std::string, RuleSetEngine::ExecutionMode>> modes{
+        {"interpreter", RuleSetEngine::ExecutionMode::INTERPRETER},
+        {"closure", RuleSetEngine::ExecutionMode::CLOSURE},
+        {"bytecode", RuleSetEngine::ExecutionMode::BYTECODE},
+#ifdef __RULEJIT_CQ_JIT
+        {"jit", RuleSetEngine::ExecutionMode::JIT},
+        {"tiered", RuleSetEngine::ExecutionMode::TIERED},
+#endif // __RULEJIT_CQ_JIT
+        {"incremental", RuleSetEngine::ExecutionMode::INTERPRETER},
+        {"increment-bc", RuleSetEngine::ExecutionMode::BYTECODE},
+        {"parallel", RuleSetEngine::ExecutionMode::INTERPRETER},
+        {"typed-bc", RuleSetEngine::ExecutionMode::BYTECODE},
+#ifdef __RULEJIT_CQ_JIT
+        {"typed-jit", RuleSetEngine::ExecutionMode::JIT},
+#endif // __RULEJIT_CQ_JIT
+        {"increment-ty", RuleSetEngine::ExecutionMode::BYTECODE},
+    };
+    if (threadsEnv) {
+        for (auto threads : std::string_view(threadsEnv) | std::views::split(',')) {
+            modes.emplace_back("parallel-" + std::string(threads.begin(), threads.end()),
+                               RuleSetEngine::ExecutionMode::INTERPRETER);
+        }
+    }
+    std::string source;
+    {
+        std::ifstream xml(file);
+        source.assign(std::istreambuf_iterator<char>(xml), std::istreambuf_iterator<char>());
+        if (replicateEnv) {
+            source = replicate(source, std::stoull(replicateEnv));
+        }
+    }
+    std::string profileText;
+    if (profileEnv) {
+        std::ifstream profileFile(profileEnv);
+        profileText.assign(std::istreambuf_iterator<char>(profileFile), std::istreambuf_iterator<char>());
+        modes.emplace_back(profileFile ? "superinst" : "profile", RuleSetEngine::ExecutionMode::BYTECODE);
+    }
+    std::string selectivityText;
+    if (selectivityEnv) {
+        std::ifstream selectivityFile(selectivityEnv);
+        selectivityText.assign(std::istreambuf_iterator<char>(selectivityFile), std::istreambuf_iterator<char>());
+        if (selectivityFile) {
+            modes.emplace_back("reordered", RuleSetEngine::ExecutionMode::INTERPRETER);
+            modes.emplace_back("reordered-bc", RuleSetEngine::ExecutionMode::BYTECODE);
+        } else {
+            modes.emplace_back("selectivity", RuleSetEngine::ExecutionMode::INTERPRETER);
+        }
+    }
+
+    std::vector<std::string> reference;
+    for (auto &[name, mode] : modes) {
+        RuleSetEngine engine;
+        if (name.starts_with("reordered") && !engine.loadSelectivityProfile(selectivityText)) {
+            std::cout << std::format("{:<12} ill-formed selectivity profile\n", name);
+            continue;
+        }
+        try {
+            engine.buildFromSource(source);
+            engine.init();
+        } catch (std::logic_error &e) {
+            std::cout << e.what() << std::endl;
+            return 0;
+        }
+        if (reference.empty()) {
+            std::cout << std::format("{:<12} {} subrulesets, {} threads in pool\n", "build",
+                                     engine.getIncrementalStatistics().size(), TickThreadPool::instance().size());
+            std::cout << std::format("{:<12} {} expressions folded\n", "build", engine.getFoldingReport().size());
+            std::cout << std::format("{:<12} {} subexpressions shared\n", "build", engine.getSharingReport().size());
+        }
+        [[maybe_unused]] auto compileStart = std::chrono::steady_clock::now();
+        engine.setExecutionMode(mode);
+        engine.setIncremental(name.starts_with("increment"));
+        engine.setTypedStorage(name.starts_with("typed") || name == "increment-ty");
+        if (name.starts_with("parallel")) {
+            engine.setParallelism(name == "parallel" ? 0 : std::stoull(name.substr(name.find('-') + 1)));
+        }
+#ifdef __RULEJIT_CQ_JIT
+        if (mode == RuleSetEngine::ExecutionMode::JIT) {
+            std::cout << std::format("{:<12} compiled in {:.3f} ms\n", name,
+                                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() -
+                                                                               compileStart)
+                                         .count());
+        }
+#endif // __RULEJIT_CQ_JIT
+        if (name == "reordered") {
+            std::cout << std::format("{:<12} {} chains reordered\n", "build", engine.getReorderingReport().size());
+        }
+        if (name == "profile") {
+            engine.setSequenceProfiling(true);
+        } else if (name == "selectivity") {
+            engine.setSelectivityProfiling(true);
+        } else if (name == "superinst") {
+            std::cout << std::format("{} superinstructions selected\n", engine.loadSequenceProfile(profileText));
+        }
+        std::mt19937_64 rng(42);
+        std::chrono::steady_clock::duration cost{};
+        size_t failed = 0, mismatch = 0;
+        for (size_t i = 0; i < ticks; i++) {
+            CSValueMap input;
+            for (size_t k = 0; k < engine.dataStorage.metaInfo.inputVar.size(); k++) {
+                if ((i + k) % hold != 0) {
+                    continue;
+                }
+                auto &var = engine.dataStorage.metaInfo.inputVar[k];
+                input[var] = randomInstance(engine.dataStorage, rng, engine.dataStorage.metaInfo.varType[var]);
+            }
+            std::string result = "[tick failed]";
+            auto start = std::chrono::steady_clock::now();
+            engine.setInput(input);
+            try {
+                engine.tick();
+                engine.getOutput();
+                cost += std::chrono::steady_clock::now() - start;
+                result = snapshot(engine);
+            } catch (std::logic_error &e) {
+                failed++;
+            }
+            if (reference.size() <= i) {
+                reference.push_back(std::move(result));
+            } else if (reference[i] != result) {
+                mismatch++;
+            }
+        }
+        std::cout << std::format("{:<12} {:>10.3f} us/tick, {} ticks failed, {} ticks mismatch\n", name,
+                                 std::chrono::duration<double, std::micro>(cost).count() /
+                                     std::max<size_t>(ticks - failed, 1),
+                                 failed, mismatch);
+        if (name == "profile") {
+            std::ofstream(profileEnv) << engine.dumpSequenceProfile();
+        } else if (name == "selectivity") {
+            std::ofstream(selectivityEnv) << engine.dumpSelectivityProfile();
+        }
+        if (name.starts_with("increment")) {
+            size_t executed = 0, skipped = 0, alwaysDirty = 0;
+            for (auto &stat : engine.getIncrementalStatistics()) {
+                executed += stat.executed;
+                skipped += stat.skipped;
+                alwaysDirty += stat.alwaysDirty;
+            }
+            std::cout << std::format("{:<12} subruleset ticks: executed {}, skipped {}, {} never skipped\n", name,
+                                     executed, skipped, alwaysDirty);
+        }
+#ifdef __RULEJIT_CQ_JIT
+        if (mode == RuleSetEngine::ExecutionMode::TIERED) {
+            std::array<size_t, size_t(Tier::END)> tierTicks{};
+            size_t fallbacks = 0;
+            double compileTime = 0;
+            for (auto &stat : engine.getTierStatistics()) {
+                for (size_t i = 0; i < tierTicks.size(); i++) {
+                    tierTicks[i] += stat.ticks[i];
+                }
+                fallbacks += stat.fallbacks;
+                compileTime += stat.jitCompileTime;
+            }
+            std::cout << std::format("{:<12} subruleset ticks: interpreter {}, bytecode {}, jit {}, {} fallbacks, "
+                                     "jit compiled in {:.3f} ms\n",
+                                     name, tierTicks[0], tierTicks[1], tierTicks[2], fallbacks, compileTime / 1000);
+        }
+#endif // __RULEJIT_CQ_JIT
+    }
+    return 0;
+}
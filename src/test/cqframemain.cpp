@@ -0,0 +1,102 @@
+/**
+ * @file cqframemain.cpp
+ * @author djw
+ * @brief Test/CQ frames
+ * @date 2026-10-17
+ *
+ * @details Checks that variables defined at top level inside args of a user function call, which grow the
+ * top-level frame while args are evaluated, neither overwrite params of the callee nor are lost after the call,
+ * in CQInterpreter and CQClosureEngine.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include <format>
+#include <iostream>
+
+#include "backend/cq/cqclosure.hpp"
+#include "backend/cq/cqinterpreter.hpp"
+#include "backend/cq/cqresolver.hpp"
+#include "backend/cq/cqresourcehandler.h"
+#include "frontend/lexer.h"
+#include "frontend/parser.h"
+#include "frontend/semantic.hpp"
+
+int testCase(const std::string &s, double expected) {
+    using namespace rulejit;
+    using namespace rulejit::cq;
+
+    static ExpressionLexer lexer;
+    static ExpressionParser parser;
+
+    ContextStack context;
+    ExpressionSemantic semantic(context);
+    DataStore data;
+    ResourceHandler handler(data);
+    ConstantPool pool;
+
+    std::vector<double> got;
+    try {
+        auto name = s | lexer | parser | semantic;
+        // top-level expression is executed like a subruleset, not as a function
+        auto expr = std::move(context.global.realFuncDefinition[name]->returnValue);
+        context.global.realFuncDefinition.erase(name);
+        CQResolver resolver(pool, context.global);
+        expr | resolver;
+        for (auto &[_, func] : context.global.realFuncDefinition) {
+            func | resolver;
+        }
+        CQInterpreter interpreter(context, handler, &pool);
+        expr | interpreter;
+        got.push_back(interpreter.getReturned());
+        CQClosureEngine closure(context, handler, &pool);
+        closure.compile(expr);
+        closure.run();
+        got.push_back(closure.getReturned());
+    } catch (std::logic_error &e) {
+        std::cout << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    int failed = 0;
+    for (auto [engine, value] : {std::tuple{"interpreter", got[0]}, std::tuple{"closure", got[1]}}) {
+        if (value != expected) {
+            std::cout << std::format("FAILED {}: expected {}, got {}\n", engine, expected, value);
+            failed = 1;
+        }
+    }
+    if (!failed) {
+        std::cout << "PASSED" << std::endl;
+    }
+    return failed;
+}
+
+int main() {
+    int failed = 0;
+    // variable defined in arg must not take slot of param "a"
+    failed += testCase(R"(
+        func f(a f64, b f64)->f64 a * 100 + b
+        f(1, {var t f64 = 7; t})
+    )",
+                       107);
+    // also in args of nested call
+    failed += testCase(R"(
+        func f(a f64, b f64)->f64 a * 100 + b
+        f(1, f(2, {var t f64 = 7; t}))
+    )",
+                       307);
+    // variables of caller are kept after the call
+    failed += testCase(R"(
+        func f(a f64, b f64)->f64 a * 100 + b
+        {
+            var u f64 = 3
+            var r f64 = f(u, {var t f64 = 7; t})
+            var w f64 = 5
+            r + u + w
+        }
+    )",
+                       315);
+    return failed;
+}
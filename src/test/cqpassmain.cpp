@@ -0,0 +1,171 @@
+/**
+ * @file cqpassmain.cpp
+ * @author djw
+ * @brief Test/CQ ast passes
+ * @date 2026-10-17
+ *
+ * @details Checks that a rule set built with ast passes gives the same outputs and hit rules as one built without,
+ * in every execution mode, for conditions where calls with string params are inlined, repeated subexpressions are
+ * shared by lazy "_cseN_ready" temporaries and a constant false rule is folded away.
+ *
+ * @par history
+ * <table>
+ * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Initial version.</td></tr>
+ * </table>
+ */
+#include <format>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "backend/cq/cqrulesetengine.h"
+
+namespace {
+
+const char *source = R"(<?xml version="1.0" encoding="utf-8"?>
+<RuleSet version="1.0">
+    <TypeDefines></TypeDefines>
+    <MetaInfo>
+        <Inputs>
+            <Param name="name" type="string"/>
+            <Param name="x" type="float64"/>
+            <Param name="y" type="float64"/>
+        </Inputs>
+        <Outputs>
+            <Param name="out" type="float64"/>
+        </Outputs>
+        <Caches></Caches>
+    </MetaInfo>
+    <SubRuleSets>
+        <SubRuleSet>
+            <Rules>
+                <Rule>
+                    <Condition><Expression>name == "stop"</Expression></Condition>
+                    <Consequence><Assignment><Target>out</Target>
+                        <Value><Expression>1</Expression></Value>
+                    </Assignment></Consequence>
+                </Rule>
+                <Rule>
+                    <Condition><Expression>1 &gt; 2</Expression></Condition>
+                    <Consequence><Assignment><Target>out</Target>
+                        <Value><Expression>2</Expression></Value>
+                    </Assignment></Consequence>
+                </Rule>
+                <Rule>
+                    <Condition><Expression>x &gt; 10 &amp;&amp; abs(x - y) &gt; 5</Expression></Condition>
+                    <Consequence><Assignment><Target>out</Target>
+                        <Value><Expression>3</Expression></Value>
+                    </Assignment></Consequence>
+                </Rule>
+                <Rule>
+                    <Condition><Expression>x &lt; -10 &amp;&amp; abs(x - y) &gt; 5</Expression></Condition>
+                    <Consequence><Assignment><Target>out</Target>
+                        <Value><Expression>4</Expression></Value>
+                    </Assignment></Consequence>
+                </Rule>
+                <Rule>
+                    <Condition><Expression>abs(x - y) &gt; 1 &amp;&amp; name != "go"</Expression></Condition>
+                    <Consequence><Assignment><Target>out</Target>
+                        <Value><Expression>x - y</Expression></Value>
+                    </Assignment></Consequence>
+                </Rule>
+            </Rules>
+        </SubRuleSet>
+    </SubRuleSets>
+</RuleSet>
+)";
+
+const std::vector<std::tuple<std::string, double, double>> inputs{
+    {"stop", 20, 0}, {"go", 20, 0},   {"go", 20, 18},  {"run", -20, 0}, {"run", -20, -18},
+    {"go", 3, 0},    {"run", 3, 0},   {"run", 0, 0},   {"stop", 0, 0},  {"", 11, 11},
+};
+
+struct Result {
+    std::vector<double> outputs;
+    std::vector<std::vector<int>> hits;
+};
+
+Result run(bool passes, rulejit::cq::RuleSetEngine::ExecutionMode mode, rulejit::ruleset::AstPassReports &reports) {
+    rulejit::cq::RuleSetEngine engine;
+    engine.setAstPasses(passes);
+    engine.buildFromSource(source);
+    engine.setExecutionMode(mode);
+    engine.init();
+    reports = {engine.getFoldingReport(), engine.getSharingReport(), engine.getInliningReport(),
+               engine.getReorderingReport()};
+    Result ret;
+    for (auto &[name, x, y] : inputs) {
+        engine.setInput({{"name", name}, {"x", x}, {"y", y}});
+        engine.tick();
+        ret.outputs.push_back(std::any_cast<double>(engine.getOutput()->at("out")));
+        ret.hits.push_back(engine.hitRules());
+    }
+    return ret;
+}
+
+bool reported(const std::vector<std::string> &report, const std::string &what) {
+    for (auto &line : report) {
+        if (line.find(what) != std::string::npos) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int main() {
+    using namespace rulejit;
+    using ExecutionMode = cq::RuleSetEngine::ExecutionMode;
+
+    std::vector<std::tuple<const char *, ExecutionMode>> modes{
+        {"interpreter", ExecutionMode::INTERPRETER},
+        {"closure", ExecutionMode::CLOSURE},
+        {"bytecode", ExecutionMode::BYTECODE},
+#ifdef __RULEJIT_CQ_JIT
+        {"jit", ExecutionMode::JIT},
+#endif // __RULEJIT_CQ_JIT
+    };
+    int failed = 0;
+    try {
+        ruleset::AstPassReports plainReports, reports;
+        auto expected = run(false, ExecutionMode::INTERPRETER, plainReports);
+        for (auto &[modeName, mode] : modes) {
+            auto got = run(true, mode, reports);
+            for (size_t i = 0; i < inputs.size(); i++) {
+                if (got.outputs[i] != expected.outputs[i] || got.hits[i] != expected.hits[i]) {
+                    std::cout << std::format("FAILED {}: tick {}, expected out {}, got {}\n", modeName, i,
+                                             expected.outputs[i], got.outputs[i]);
+                    failed = 1;
+                }
+            }
+        }
+        // the transformations checked above are really made
+        for (auto [passName, report, what] : {
+#ifndef __RULEJIT_DISABLE_INLINE
+                 std::tuple{"inlining", &reports.inlining, "(2 of 2 args substituted)"},
+#endif // __RULEJIT_DISABLE_INLINE
+#ifndef __RULEJIT_DISABLE_CSE
+                 std::tuple{"sharing", &reports.sharing, ", lazy)"},
+#endif // __RULEJIT_DISABLE_CSE
+                 std::tuple{"folding", &reports.folding, "=> false arm"},
+             }) {
+            if (!reported(*report, what)) {
+                std::cout << std::format("FAILED {}: no \"{}\" in report\n", passName, what);
+                for (auto &line : *report) {
+                    std::cout << "    " << line << std::endl;
+                }
+                failed = 1;
+            }
+        }
+    } catch (std::logic_error &e) {
+        std::cout << "ERROR: " << e.what() << std::endl;
+        return 1;
+    }
+    if (!failed) {
+        std::cout << "PASSED" << std::endl;
+    }
+    return failed;
+}
@@ -10,6 +10,7 @@
  * <table>
  * <tr><th>Author</th><th>Date</th><th>Changes</th></tr>
  * <tr><td>djw</td><td>2023-03-30</td><td>Initial version.</td></tr>
+ * <tr><td>djw</td><td>2026-10-17</td><td>Build with LLVM 14.</td></tr>
  * </table>
  */
 // #include "backend/jit/jitengine.hpp"
@@ -40,6 +41,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/Orc/LLJIT.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/IRBuilder.h"
@@ -107,7 +109,11 @@ int main(int argc, char *argv[]) {
 
     // Look up the JIT'd function, cast it to a function pointer, then call it.
     auto Add1Addr = ExitOnErr(J->lookup("add1"));
+#if LLVM_VERSION_MAJOR >= 15
     int (*Add1)(int) = Add1Addr.toPtr<int(int)>();
+#else
+    auto Add1 = reinterpret_cast<int (*)(int)>(Add1Addr.getAddress());
+#endif
 
     int Result = Add1(42);
     outs() << "add1(42) = " << Result << "\n";